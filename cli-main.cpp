@@ -2,6 +2,8 @@
 #include <iostream>
 #include <csignal>
 #include <climits>
+#include <thread>
+#include <chrono>
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
 #include <direct.h>
@@ -26,6 +28,10 @@
 #define DAEMONIZE_CLOSE_FILE_DESCRIPTORS_AFTER_FORK true
 #endif
 
+#ifdef ENABLE_IO_URING
+#include "lorawan/storage/listener/io-uring-listener.h"
+#endif
+
 #include "cli-helper.h"
 
 #ifdef ENABLE_HTTP
@@ -69,6 +75,14 @@
 #include "lorawan/storage/serialization/gateway-binary-serialization.h"
 #include "lorawan/helper/file-helper.h"
 #include "lorawan/storage/service/identity-service-udp.h"
+#include "lorawan/storage/service/identity-service-tcp-pool.h"
+#include "lorawan/storage/service/identity-service-sharded.h"
+#include "lorawan/storage/service/identity-service-journal.h"
+#include "lorawan/storage/service/identity-service-coalescing.h"
+#include "lorawan/storage/service/identity-service-mem-concurrent.h"
+#include "lorawan/storage/service/gateway-service-mem-concurrent.h"
+#include "lorawan/storage/service/identity-service-rcu.h"
+#include "lorawan/storage/client/replica-client.h"
 
 // i18n
 // #include <libintl.h>
@@ -77,6 +91,8 @@
 
 const char *programName = "lorawan-storage";
 #define DEF_PASSPHRASE  "masterkey"
+// reporter thread checks SIGUSR2 flag
+#define REPORT_POLL_MILLIS  200
 
 enum IP_PROTO {
     PROTO_UDP,
@@ -90,7 +106,11 @@ enum STORAGE_TYPE {
     ST_JSON,
     ST_SQLITE,
     ST_LMDB,
-    ST_CLIENT_UDP
+    ST_CLIENT_UDP,
+    ST_CLIENT_TCP_POOL,
+    ST_CLIENT_SHARDED,
+    ST_MEM_CONCURRENT,
+    ST_RCU
 };
 
 static std::string IP_PROTO2string(
@@ -120,11 +140,16 @@ public:
     std::string httpIntf;
     uint16_t httpPort;
     std::string httpHtmlRootDir;
+    unsigned int httpThreads;
+    unsigned int httpCacheTTL;
 #endif
 #ifdef ENABLE_QRCODE
     StorageListener *httpQRCodeURNServer;
     std::string httpQRCodeURNIntf;
     uint16_t httpQRCodeURNPort;
+#endif
+#ifdef ENABLE_IO_URING
+    bool useIoUring;
 #endif
     int32_t code;
     uint64_t accessCode;
@@ -134,6 +159,18 @@ public:
     STORAGE_TYPE storageType;
     std::string db;
     std::string dbGatewayJson;
+    std::string backend;    ///< storage service(s) address for ST_CLIENT_UDP, ST_CLIENT_TCP_POOL, ST_CLIENT_SHARDED
+    size_t backendConnections;
+    size_t journalCapacity;     ///< change log records kept for the replicas, 0- replication is disabled
+    std::string replicaOf;      ///< primary storage service TCP address, empty- it is not a replica
+    JournalIdentityService *journal;
+    Replicator *replicator;
+    bool coalesce;              ///< share backend lookup between concurrent identical lookups
+    CoalescingIdentityService *coalescing;
+    AdmissionControl admission; ///< requests per second of each client address and account
+    AccessDenials denials;      ///< requests with wrong credentials of each client address
+    size_t workers;             ///< background threads running scans, bulk writes and flushes, 0- run all on the listener thread
+    QueryScheduler *scheduler;
     int32_t retCode;
 #ifdef ENABLE_GEN
     std::string passPhrase;
@@ -142,12 +179,17 @@ public:
     CliServiceDescriptorNParams()
         : storageType(ST_MEM), server(nullptr), proto(PROTO_UDP), port(4244),
 #ifdef ENABLE_HTTP
-        httpServer(nullptr), httpPort(4246),
+        httpServer(nullptr), httpPort(4246), httpThreads(1), httpCacheTTL(1000),
 #endif
 #ifdef ENABLE_QRCODE
           httpQRCodeURNServer(nullptr), httpQRCodeURNPort(4248),
 #endif
-        code(0), accessCode(0), verbose(0), retCode(0),
+#ifdef ENABLE_IO_URING
+        useIoUring(false),
+#endif
+        code(0), accessCode(0), verbose(0), backendConnections(DEF_POOL_CONNECTIONS),
+        journalCapacity(0), journal(nullptr), replicator(nullptr), coalesce(false),
+        coalescing(nullptr), workers(0), scheduler(nullptr), retCode(0),
         runAsDaemon(false)
 #ifdef ENABLE_GEN
         , netid(0, 0)
@@ -159,9 +201,14 @@ public:
     std::string toString() const {
         std::stringstream ss;
         ss << _("Service: ") << intf << ":" << port << " " << IP_PROTO2string(proto) << "\n";
+#ifdef ENABLE_IO_URING
+        if (useIoUring)
+            ss << _("Listener: io_uring") << "\n";
+#endif
 #ifdef ENABLE_HTTP
         ss << _("HTTP: ") << httpIntf << ":" << httpPort << "\n"
-            << _("HTML page root directory: ") << (httpHtmlRootDir.empty() ? _("none") : httpHtmlRootDir) << "\n";
+            << _("HTML page root directory: ") << (httpHtmlRootDir.empty() ? _("none") : httpHtmlRootDir) << "\n"
+            << _("HTTP threads: ") << httpThreads << _(", response cache TTL: ") << httpCacheTTL << "ms\n";
 #endif
 #ifdef ENABLE_QRCODE
         ss << _("HTTP QR Code: ") << httpQRCodeURNIntf << ":" << httpQRCodeURNPort << "\n";
@@ -173,9 +220,41 @@ public:
         if (!dbGatewayJson.empty())
             ss << _("gateway database file name: ") << dbGatewayJson << "\n";
 #endif
+        if (storageType == ST_MEM_CONCURRENT)
+            ss << _("In-memory storage") << "\n";
+        if (storageType == ST_RCU)
+            ss << _("In-memory read-copy-update storage") << "\n";
+        if (storageType == ST_CLIENT_UDP)
+            ss << _("Backend: ") << backend << " UDP\n";
+        if (storageType == ST_CLIENT_TCP_POOL)
+            ss << _("Backend: ") << backend << " TCP, " << std::dec << backendConnections << _(" connections each") << "\n";
+        if (storageType == ST_CLIENT_SHARDED)
+            ss << _("Backend shards: ") << backend << " UDP\n";
+        if (journalCapacity)
+            ss << _("Change log: ") << std::dec << journalCapacity << _(" records") << "\n";
+        if (!replicaOf.empty())
+            ss << _("Replica of: ") << replicaOf << " TCP\n";
+        if (coalesce)
+            ss << _("Concurrent identical lookups are coalesced") << "\n";
+        if (admission.enabled())
+            ss << _("Rate limits, lookups/scans per second. Client: ")
+                << admission.addressLimit[ADMISSION_LOOKUP].rate << "/" << admission.addressLimit[ADMISSION_SCAN].rate
+                << _(", account: ")
+                << admission.accountLimit[ADMISSION_LOOKUP].rate << "/" << admission.accountLimit[ADMISSION_SCAN].rate
+                << _(" (0- unlimited)") << "\n";
+        if (workers)
+            ss << _("Background workers: ") << std::dec << workers
+                << (isConcurrentStorage() ? _(", run side by side") : _(", serialized")) << _(", lookups first") << "\n";
         return ss.str();
     }
 
+    /**
+     * @return true if in-memory concurrent storage is thread safe, others are queried by one thread at a time
+     */
+    bool isConcurrentStorage() const {
+        return storageType == ST_MEM_CONCURRENT || storageType == ST_RCU;
+    }
+
     std::ostream& strm(
         int level
     ) override {
@@ -190,16 +269,59 @@ public:
 CliServiceDescriptorNParams svc;
 
 static void done() {
+    if (svc.replicator) {
+        svc.replicator->stop();
+        delete svc.replicator;
+        svc.replicator = nullptr;
+    }
     if (svc.server) {
         svc.server->stop();
         svc.server->identitySerialization->svc->flush();
         delete svc.server;
         svc.server = nullptr;
+        if (svc.verbose && svc.denials.denied)
+            std::cerr << svc.denials.toString() << std::endl;
+        if (svc.scheduler) {
+            if (svc.verbose)
+                std::cerr << svc.scheduler->toString() << std::endl;
+            delete svc.scheduler;
+            svc.scheduler = nullptr;
+        }
+        if (svc.coalescing)
+            std::cerr << svc.coalescing->toString() << std::endl;
         std::cerr << MSG_GRACEFULLY_STOPPED << std::endl;
         exit(svc.retCode);
     }
 }
 
+// set by SIGUSR2, the report is printed by the reporter thread, signal handler can not lock or allocate
+static volatile sig_atomic_t reportRequested = 0;
+
+/**
+ * Print lane queue depth and wait time, clients with wrong credentials, coalesced lookups
+ */
+static void report() {
+    if (svc.scheduler)
+        std::cerr << svc.scheduler->toString() << std::endl;
+    std::cerr << svc.denials.toString() << std::endl;
+    if (svc.coalescing)
+        std::cerr << svc.coalescing->toString() << std::endl;
+}
+
+static void startReporter() {
+#if !(defined(_MSC_VER) || defined(__MINGW32__))
+    std::thread([] {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(REPORT_POLL_MILLIS));
+            if (reportRequested) {
+                reportRequested = 0;
+                report();
+            }
+        }
+    }).detach();
+#endif
+}
+
 static void stop() {
 	if (svc.server) {
         svc.server->stop();
@@ -212,6 +334,13 @@ void signalHandler(int signal)
 		std::cerr << MSG_INTERRUPTED << std::endl;
         done();
 	}
+#if !(defined(_MSC_VER) || defined(__MINGW32__))
+    // promote replica to primary
+    if (signal == SIGUSR1 && svc.replicator)
+        svc.replicator->requestPromote();
+    if (signal == SIGUSR2)
+        reportRequested = 1;
+#endif
 }
 
 void setSignalHandler()
@@ -222,6 +351,8 @@ void setSignalHandler()
 	action.sa_handler = &signalHandler;
 	sigaction(SIGINT, &action, nullptr);
 	sigaction(SIGHUP, &action, nullptr);
+	sigaction(SIGUSR1, &action, nullptr);
+	sigaction(SIGUSR2, &action, nullptr);
 #endif
 }
 
@@ -245,27 +376,66 @@ void run() {
         identityService->init(svc.db, nullptr);
     }
 #endif
+    if (svc.storageType == ST_MEM_CONCURRENT)
+        identityService = new ConcurrentMemoryIdentityService;
+    if (svc.storageType == ST_RCU)
+        identityService = new RcuIdentityService;
+    if (svc.storageType == ST_CLIENT_UDP || svc.storageType == ST_CLIENT_TCP_POOL || svc.storageType == ST_CLIENT_SHARDED) {
+        if (svc.storageType == ST_CLIENT_UDP)
+            identityService = new ClientUDPIdentityService;
+        else if (svc.storageType == ST_CLIENT_TCP_POOL)
+            identityService = new ClientTCPPoolIdentityService;
+        else
+            identityService = new ShardedIdentityService;
+        identityService->setOption(IDENTITY_OPTION_CODE, &svc.code);
+        identityService->setOption(IDENTITY_OPTION_ACCESS_CODE, &svc.accessCode);
+        identityService->setOption(IDENTITY_OPTION_CONNECTIONS, &svc.backendConnections);
+        int r = identityService->init(svc.backend, nullptr);
+        if (r)
+            std::cerr << ERR_MESSAGE << r << ": " << svc.backend << std::endl;
+    }
     if (!identityService) {
         identityService = new ClientUDPIdentityService;
         identityService->init("", nullptr);
     }
 
-    auto gatewayService =
+    if (svc.journalCapacity) {
+        svc.journal = new JournalIdentityService(identityService, svc.journalCapacity);
+        identityService = svc.journal;
+    }
+    // lookups of the scheduler workers, listener and HTTP threads overlap on the thread safe storage only
+    if (svc.coalesce) {
+        svc.coalescing = new CoalescingIdentityService(identityService);
+        identityService = svc.coalescing;
+    }
+
+    GatewayService *gatewayService;
+    if (svc.isConcurrentStorage()) {
+        gatewayService = new ConcurrentMemoryGatewayService;
+        gatewayService->init("", nullptr);
+    } else {
+        gatewayService =
 #ifdef ENABLE_SQLITE
-        new SqliteGatewayService;
-    gatewayService->init(svc.db, nullptr);
+            new SqliteGatewayService;
+        gatewayService->init(svc.db, nullptr);
 #else
 #ifdef ENABLE_JSON
-        new JsonGatewayService;
-    gatewayService->init(svc.dbGatewayJson, nullptr);
+            new JsonGatewayService;
+        gatewayService->init(svc.dbGatewayJson, nullptr);
 #else
-        new MemoryGatewayService;
-    gatewayService->init("", nullptr);
+            new MemoryGatewayService;
+        gatewayService->init("", nullptr);
 #endif
 #endif
+    }
 
     auto identitySerialization = new IdentityBinarySerialization(identityService, svc.code, svc.accessCode);
     auto gatewaySerialization = new GatewayBinarySerialization(gatewayService, svc.code, svc.accessCode);
+#ifdef ENABLE_IO_URING
+    if (svc.useIoUring)
+        svc.server = new IoUringListener(identitySerialization, gatewaySerialization);
+    else
+#endif
 #ifdef ENABLE_LIBUV
     svc.server = new UVListener(identitySerialization, gatewaySerialization);
 #else
@@ -273,11 +443,31 @@ void run() {
 #endif
     svc.server->setAddress(svc.intf, svc.port);
     svc.server->setLog(svc.verbose, &svc);
+    if (svc.admission.enabled())
+        svc.server->admission = &svc.admission;
+    svc.server->denials = &svc.denials;
+    if (svc.workers) {
+        svc.scheduler = new QueryScheduler(svc.server, svc.workers);
+        svc.scheduler->concurrentService = svc.isConcurrentStorage();
+        svc.server->scheduler = svc.scheduler;
+    }
+    if (svc.journal) {
+        svc.server->changeLog = &svc.journal->log;
+        if (!svc.replicaOf.empty()) {
+            svc.replicator = new Replicator(svc.journal, svc.replicaOf, svc.code, svc.accessCode);
+            svc.replicator->start();
+        }
+    }
 
 #ifdef ENABLE_HTTP
     auto identitySerializationJSON = new IdentityTextJSONSerialization(identityService, svc.code, svc.accessCode);
     auto gatewaySerializationJSON = new GatewayTextJSONSerialization(gatewayService, svc.code, svc.accessCode);
-    svc.httpServer = new HTTPListener(identitySerializationJSON, gatewaySerializationJSON, svc.httpHtmlRootDir);
+    auto httpListener = new HTTPListener(identitySerializationJSON, gatewaySerializationJSON, svc.httpHtmlRootDir);
+    httpListener->threadCount = svc.httpThreads;
+    httpListener->responseCache.ttlMillis = svc.httpCacheTTL;
+    httpListener->gatewayResponseCache.ttlMillis = svc.httpCacheTTL;
+    httpListener->concurrentService = svc.isConcurrentStorage();
+    svc.httpServer = httpListener;
     svc.httpServer->setAddress(svc.httpIntf, svc.httpPort);
     svc.httpServer->setLog(svc.verbose, &svc);
     svc.httpServer->run();
@@ -294,6 +484,7 @@ void run() {
     if (svc.verbose)
         std::cout << _("Identities: ") << svc.server->identitySerialization->svc->size() << std::endl;
 
+    startReporter();
     svc.retCode = svc.server->run();
     if (svc.retCode)
         std::cerr << ERR_MESSAGE << svc.retCode << ": " << std::endl;
@@ -301,10 +492,15 @@ void run() {
 
 int main(int argc, char **argv) {
 	struct arg_str *a_interface_n_port = arg_str0(nullptr, nullptr, _("IP addr:port"), _("Default *:4244"));
+#ifdef ENABLE_IO_URING
+    struct arg_lit *a_io_uring = arg_lit0(nullptr, "io-uring", _("use Linux io_uring UDP/TCP listener"));
+#endif
 
 #ifdef ENABLE_HTTP
     struct arg_str *a_http_interface_n_port = arg_str0("h", "http", _("IP addr:port"), _("Default *:4246"));
     struct arg_str *a_http_html_root_dir = arg_str0("r", "root", _("<path>"), _("web root path. Default none"));
+    struct arg_int *a_http_threads = arg_int0(nullptr, "http-threads", _("<number>"), _("HTTP thread pool size. Default 1"));
+    struct arg_int *a_http_cache_ttl = arg_int0(nullptr, "http-cache-ttl", _("<ms>"), _("read-only JSON response cache TTL, 0- disable. Default 1000"));
 #endif
 #ifdef ENABLE_QRCODE
     struct arg_str *a_http_qrcode_urn_interface_n_port = arg_str0("q", "qr", _("IP addr:port"), _("Default *:4248"));
@@ -318,6 +514,20 @@ int main(int argc, char **argv) {
 #ifdef ENABLE_JSON
     struct arg_str *a_gateway_json_db = arg_str0("g", "gateway-db", _("<database file>"), _("database file name. Default " DEF_DB_GATEWAY_JSON));
 #endif
+    struct arg_lit *a_mem = arg_lit0(nullptr, "mem", _("in-memory storage shared by the listener and worker threads"));
+    struct arg_lit *a_rcu = arg_lit0(nullptr, "rcu", _("in-memory storage for read-mostly tables, lookups never wait for the writes"));
+    struct arg_str *a_backend_udp = arg_str0(nullptr, "backend-udp", _("<host:port>"), _("storage service backend over UDP"));
+    struct arg_str *a_backend = arg_str0(nullptr, "backend", _("<host:port,...>"), _("storage service cluster backend over the pool of TCP connections"));
+    struct arg_str *a_backend_shards = arg_str0(nullptr, "backend-shards", _("<host:port,...>"), _("storage services sharded by address over UDP"));
+    struct arg_int *a_journal = arg_int0(nullptr, "journal", _("<records>"), _("log changes for the replicas and change feed subscribers. Default 65536 if --replica-of is set"));
+    struct arg_str *a_replica_of = arg_str0(nullptr, "replica-of", _("<host:port>"), _("read-only replica of the primary service over TCP, SIGUSR1 promotes it"));
+    struct arg_int *a_workers = arg_int0(nullptr, "workers", _("<number>"), _("run list, filter, bulk writes and save on background threads, lookups first, SIGUSR2 prints queue depth and wait time. More than one worker with --mem or --rcu only, other storages are serialized. libuv listener only. Default 0- listener thread"));
+    struct arg_lit *a_coalesce = arg_lit0(nullptr, "coalesce", _("share one backend lookup between concurrent identical lookups of the workers, listener and HTTP threads, SIGUSR2 prints counters. --mem or --rcu only"));
+    struct arg_int *a_limit_lookups = arg_int0(nullptr, "limit-lookups", _("<number>"), _("lookups per second from each client address. Default unlimited"));
+    struct arg_int *a_limit_scans = arg_int0(nullptr, "limit-scans", _("<number>"), _("list, filter requests per second from each client address. Default unlimited"));
+    struct arg_int *a_account_limit_lookups = arg_int0(nullptr, "account-limit-lookups", _("<number>"), _("lookups per second of all clients of the account (code, access code). Default unlimited"));
+    struct arg_int *a_account_limit_scans = arg_int0(nullptr, "account-limit-scans", _("<number>"), _("list, filter requests per second of all clients of the account (code, access code). Default unlimited"));
+    struct arg_int *a_backend_connections = arg_int0(nullptr, "backend-connections", _("<number>"), _("TCP connections to each backend service. Default 2"));
     struct arg_int *a_code = arg_int0("c", "code", _("<number>"), _("Default 42. 0x - hex number prefix"));
 #ifdef ENABLE_GEN
     struct arg_str *a_pass_phrase = arg_str0("m", _("master-key"), _("<pass-phrase>"), _("Default " DEF_PASSPHRASE));
@@ -334,9 +544,14 @@ int main(int argc, char **argv) {
 
     void* argtable[] = {
             a_interface_n_port,
+#ifdef ENABLE_IO_URING
+            a_io_uring,
+#endif
 #ifdef ENABLE_HTTP
             a_http_interface_n_port,
             a_http_html_root_dir,
+            a_http_threads,
+            a_http_cache_ttl,
 #endif
 #ifdef ENABLE_QRCODE
             a_http_qrcode_urn_interface_n_port,
@@ -353,6 +568,9 @@ int main(int argc, char **argv) {
 #ifdef ENABLE_JSON
             a_gateway_json_db,
 #endif
+            a_mem, a_rcu, a_backend_udp, a_backend, a_backend_shards, a_backend_connections,
+            a_journal, a_replica_of, a_coalesce, a_workers,
+            a_limit_lookups, a_limit_scans, a_account_limit_lookups, a_account_limit_scans,
             a_code, a_access_code, a_verbose, a_daemonize, a_pidfile,
             a_help, a_end
     };
@@ -379,6 +597,10 @@ int main(int argc, char **argv) {
         svc.port = 4244;
     }
 
+#ifdef ENABLE_IO_URING
+    svc.useIoUring = a_io_uring->count > 0;
+#endif
+
 #ifdef ENABLE_HTTP
     if (a_http_interface_n_port->count) {
         splitAddress(svc.httpIntf, svc.httpPort, std::string(*a_http_interface_n_port->sval));
@@ -390,6 +612,14 @@ int main(int argc, char **argv) {
         svc.httpHtmlRootDir = file::expandFileName(*a_http_html_root_dir->sval);
     else
         svc.httpHtmlRootDir = "";
+    if (a_http_threads->count && *a_http_threads->ival > 0)
+        svc.httpThreads = (unsigned int) *a_http_threads->ival;
+    else
+        svc.httpThreads = 1;
+    if (a_http_cache_ttl->count && *a_http_cache_ttl->ival >= 0)
+        svc.httpCacheTTL = (unsigned int) *a_http_cache_ttl->ival;
+    else
+        svc.httpCacheTTL = 1000;
 #endif
 
 #ifdef ENABLE_QRCODE
@@ -434,6 +664,43 @@ int main(int argc, char **argv) {
     else
         svc.dbGatewayJson = DEF_DB_GATEWAY_JSON;
 #endif
+    if (a_mem->count)
+        svc.storageType = ST_MEM_CONCURRENT;
+    if (a_rcu->count)
+        svc.storageType = ST_RCU;
+    if (a_backend_udp->count) {
+        svc.backend = *a_backend_udp->sval;
+        svc.storageType = ST_CLIENT_UDP;
+    }
+    if (a_backend->count) {
+        svc.backend = *a_backend->sval;
+        svc.storageType = ST_CLIENT_TCP_POOL;
+    }
+    if (a_backend_shards->count) {
+        svc.backend = *a_backend_shards->sval;
+        svc.storageType = ST_CLIENT_SHARDED;
+    }
+    if (a_backend_connections->count && *a_backend_connections->ival > 0)
+        svc.backendConnections = (size_t) *a_backend_connections->ival;
+    if (a_journal->count && *a_journal->ival > 0)
+        svc.journalCapacity = (size_t) *a_journal->ival;
+    svc.coalesce = a_coalesce->count > 0;
+    if (a_workers->count && *a_workers->ival > 0)
+        svc.workers = (size_t) *a_workers->ival;
+    // burst of two seconds
+    if (a_limit_lookups->count && *a_limit_lookups->ival > 0)
+        svc.admission.addressLimit[ADMISSION_LOOKUP] = AdmissionLimit(*a_limit_lookups->ival, 2.0 * *a_limit_lookups->ival);
+    if (a_limit_scans->count && *a_limit_scans->ival > 0)
+        svc.admission.addressLimit[ADMISSION_SCAN] = AdmissionLimit(*a_limit_scans->ival, 2.0 * *a_limit_scans->ival);
+    if (a_account_limit_lookups->count && *a_account_limit_lookups->ival > 0)
+        svc.admission.accountLimit[ADMISSION_LOOKUP] = AdmissionLimit(*a_account_limit_lookups->ival, 2.0 * *a_account_limit_lookups->ival);
+    if (a_account_limit_scans->count && *a_account_limit_scans->ival > 0)
+        svc.admission.accountLimit[ADMISSION_SCAN] = AdmissionLimit(*a_account_limit_scans->ival, 2.0 * *a_account_limit_scans->ival);
+    if (a_replica_of->count) {
+        svc.replicaOf = *a_replica_of->sval;
+        if (!svc.journalCapacity)
+            svc.journalCapacity = DEF_CHANGE_LOG_CAPACITY;
+    }
     if (a_code->count)
         svc.code = *a_code->ival;
     else
@@ -456,6 +723,40 @@ int main(int argc, char **argv) {
 	}
 	arg_freetable(argtable, sizeof(argtable) / sizeof(argtable[0]));
 
+#ifndef ENABLE_LIBUV
+    // replica pulls the journal over TCP and serves it over TCP when promoted, UDP listener has no TCP
+    bool tcpListener = false;
+#ifdef ENABLE_IO_URING
+    tcpListener = svc.useIoUring;
+#endif
+    if (!svc.replicaOf.empty() && !tcpListener) {
+        std::cerr << ERR_REPLICA_TCP << std::endl;
+        return ERR_CODE_COMMAND_LINE;
+    }
+#endif
+
+    // UDP and io_uring listeners run all queries on the listener thread
+    bool uvListener = false;
+#ifdef ENABLE_LIBUV
+    uvListener = true;
+#endif
+#ifdef ENABLE_IO_URING
+    if (svc.useIoUring)
+        uvListener = false;
+#endif
+    if (svc.workers && !uvListener) {
+        std::cerr << ERR_WORKERS_LIBUV << std::endl;
+        return ERR_CODE_COMMAND_LINE;
+    }
+    if (svc.workers > 1 && !svc.isConcurrentStorage()) {
+        std::cerr << MSG_WORKERS_SERIALIZED << std::endl;
+        svc.workers = 1;
+    }
+    if (svc.coalesce && !svc.isConcurrentStorage()) {
+        std::cerr << MSG_COALESCE_SERIALIZED << std::endl;
+        svc.coalesce = false;
+    }
+
 #if defined(_MSC_VER) || defined(__MINGW32__)
     WSADATA wsaData;
     int r = WSAStartup(MAKEWORD(2, 2), &wsaData);
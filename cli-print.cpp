@@ -16,6 +16,7 @@
 #include "lorawan/lorawan-msg.h"
 #include "lorawan/lorawan-conv.h"
 #include "lorawan/lorawan-string.h"
+#include "lorawan/lorawan-frame-view.h"
 #include "log.h"
 #include "lorawan/storage/serialization/identity-serialization.h"
 #include "lorawan/storage/serialization/identity-binary-serialization.h"
@@ -25,7 +26,6 @@
 #include "lorawan/storage/client/plugin-client.h"
 #include "lorawan/storage/client/plugin-query-client.h"
 #include "lorawan/storage/client/service-client.h"
-#include "lorawan/helper/aes-helper.h"
 
 const char *programName = "lorawan-identity-print";
 #define DEF_PORT 4244
@@ -247,7 +247,7 @@ static bool getDeviceByAddr(
                 return false;
             }
             // 0- pass master key to generate keys
-            c.svcIdentity->setOption(0, &params.passPhrase);
+            c.svcIdentity->setOption(IDENTITY_OPTION_MASTER_KEY, &params.passPhrase);
             return c.svcIdentity->get(retVal, devaddr) == 0;
         }
     }
@@ -259,41 +259,44 @@ static void printPacket(
     int verbose
 )
 {
-    auto sz = payload.size();
+    LorawanFrameView frame(payload.c_str(), payload.size());
+    auto sz = frame.length();
+    // decrypted FRMPayload
+    std::string pld(frame.payloadSize(), '\0');
     if (verbose) {
         if (sz < SIZE_RFM_HEADER) {
             // try to print major header
-            if (sz < SIZE_MHDR)
+            if (!frame.mhdr())
                 return;
-            auto mhdr = (MHDR *) &payload;
-            strm << mtype2string((MTYPE) mhdr->f.mtype) << DLMT;
+            strm << mtype2string(frame.mtype()) << DLMT;
             return;
         }
-        auto *rfm = (RFM_HEADER *) payload.c_str();
-        strm << rfm_header2string(rfm) << DLMT
-             << mac2string((void *) (payload.c_str() + SIZE_RFM_HEADER), rfm->fhdr.fctrl.f.foptslen, sz - SIZE_RFM_HEADER);
+        auto *rfm = (const RFM_HEADER *) frame.data();
+        strm << rfm_header2string(rfm) << DLMT;
+        if (frame.fopts())
+            strm << mac2string((void *) frame.fopts(), frame.foptsSize(), sz - SIZE_RFM_HEADER);
+        else
+            strm << _("n/a");
 
-        DEVADDR a(rfm->fhdr.devaddr);
+        DEVADDR a(frame.devAddr());
 
-        if (hasFPort((void *) payload.c_str(), sz)) {
-            strm << DLMT << (int) getFPort((void *) payload.c_str());
-            char *pl = hasPayload((void *) payload.c_str(), sz);
-            if (!pl)
+        if (frame.hasFPort()) {
+            strm << DLMT << (int) frame.fport();
+            if (!frame.payload())
                 strm << DLMT << _("n/a");
             else {
                 DEVICEID deviceId;
-                std::string pld(pl, payloadSize((void *) payload.c_str(), sz));
-                if (getDeviceByAddr(deviceId, rfm->fhdr.devaddr)) {
+                if (getDeviceByAddr(deviceId, a)) {
                     strm
-                        << DLMT << _("fcnt: ") << (int) rfm->fhdr.fcnt
-                        << DLMT << _("direction: ") << (int) (rfm->macheader.f.mtype & 1)
-                        << DLMT << _("devAddr: ") << DEVADDR2string(rfm->fhdr.devaddr)
+                        << DLMT << _("fcnt: ") << (int) frame.fcnt()
+                        << DLMT << _("direction: ") << (int) frame.direction()
+                        << DLMT << _("devAddr: ") << DEVADDR2string(a)
                         << DLMT << _("appSKey: ") << KEY2string(deviceId.id.appSKey);
-                    decryptPayloadString(pld, rfm->fhdr.fcnt, rfm->macheader.f.mtype & 1, rfm->fhdr.devaddr, deviceId.id.appSKey);
+                    size_t psz = frame.decrypt(&pld[0], deviceId.id.appSKey, deviceId.id.nwkSKey);
                     strm << DLMT << DEVEUI2string(deviceId.id.devEUI) << DLMT
-                         << hexString(pld);
+                         << hexString(pld.c_str(), psz);
                 } else
-                    strm << DLMT << _("n/a") << DLMT << hexString(pld);
+                    strm << DLMT << _("n/a") << DLMT << hexString(frame.payload(), frame.payloadSize());
             }
         }
         strm << std::endl;
@@ -301,31 +304,29 @@ static void printPacket(
     } else {
         if (sz < SIZE_RFM_HEADER)
             return;
-        auto *rfm = (RFM_HEADER *) payload.c_str();
-        strm << mtype2string((MTYPE) rfm->macheader.f.mtype)
-             << DLMT << DEVADDR2string(rfm->fhdr.devaddr);
-        if (rfm->fhdr.fctrl.f.foptslen == 0)
+        DEVADDR a(frame.devAddr());
+        strm << mtype2string(frame.mtype())
+             << DLMT << DEVADDR2string(a);
+        if (frame.foptsSize() == 0 || !frame.fopts())
             strm << DLMT << _("n/a");
         else
             strm << DLMT
-                 << mac2string((void *) (payload.c_str() + SIZE_RFM_HEADER), rfm->fhdr.fctrl.f.foptslen, sz - SIZE_RFM_HEADER);
+                 << mac2string((void *) frame.fopts(), frame.foptsSize(), sz - SIZE_RFM_HEADER);
 
-        if (!hasFPort((void *) payload.c_str(), sz))
+        if (!frame.hasFPort())
             strm << DLMT << _("n/a");
         else
-            strm << DLMT << (int) getFPort((void *) payload.c_str());
-        char *pl = hasPayload((void *) payload.c_str(), sz);
-        if (!pl)
+            strm << DLMT << (int) frame.fport();
+        if (!frame.payload())
             strm << DLMT << _("n/a");
         else {
             DEVICEID deviceId;
-            std::string pld(pl, sz - (pl - (char *) rfm) - SIZE_MIC);
-            if (getDeviceByAddr(deviceId, rfm->fhdr.devaddr)) {
-                decryptPayloadString(pld, rfm->fhdr.fcnt, rfm->macheader.f.mtype & 1, rfm->fhdr.devaddr, deviceId.id.appSKey);
+            if (getDeviceByAddr(deviceId, a)) {
+                size_t psz = frame.decrypt(&pld[0], deviceId.id.appSKey, deviceId.id.nwkSKey);
                 strm << DLMT << DEVEUI2string(deviceId.id.devEUI) << DLMT
-                     << hexString(pld);
+                     << hexString(pld.c_str(), psz);
             } else
-                strm << DLMT << _("n/a") << DLMT << hexString(pld);
+                strm << DLMT << _("n/a") << DLMT << hexString(frame.payload(), frame.payloadSize());
         }
     }
 }
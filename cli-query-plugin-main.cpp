@@ -114,7 +114,7 @@ static void run()
         return;
     }
     // 0- pass master key to generate keys
-    c->svcIdentity->setOption(0, &params.passPhrase);
+    c->svcIdentity->setOption(IDENTITY_OPTION_MASTER_KEY, &params.passPhrase);
 
     switch (params.tag) {
         case QUERY_IDENTITY_LIST: {
@@ -8,7 +8,7 @@ int main(int argc, char *argv[])
     std::string masterkey = "masterkey";
     ServiceClient c("gen");
     // 0- pass master key to generate keys
-    c.svcIdentity->setOption(0, &masterkey);
+    c.svcIdentity->setOption(IDENTITY_OPTION_MASTER_KEY, &masterkey);
     
     // -- device
     // get
@@ -0,0 +1,514 @@
+#include "lorawan/helper/aes-accel.h"
+
+#include <cstring>
+
+#include "system/crypto/aes.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(ESP_PLATFORM)
+#define AES_X86   1
+#include <immintrin.h>
+#define TARGET_AES  __attribute__((target("aes,sse2")))
+#endif
+
+// AES-128 has 10 rounds, 11 round keys
+#define AES128_ROUNDS   10
+
+static_assert(sizeof(aes_context) <= 244, "aes_context does not fit AesKey schedule");
+
+static AES_LEVEL detectAesLevel()
+{
+#ifdef AES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("aes"))
+        return AES_NI;
+#endif
+    return AES_PORTABLE;
+}
+
+static AES_LEVEL supportedAesLevel()
+{
+    static const AES_LEVEL r = detectAesLevel();
+    return r;
+}
+
+static AES_LEVEL maxAesLevel = AES_NI;
+
+AES_LEVEL aesLevel()
+{
+    AES_LEVEL r = supportedAesLevel();
+    return r < maxAesLevel ? r : maxAesLevel;
+}
+
+AES_LEVEL setAesLevel(
+    AES_LEVEL level
+)
+{
+    maxAesLevel = level;
+    return aesLevel();
+}
+
+const char *aesLevelName(
+    AES_LEVEL level
+)
+{
+    switch (level) {
+        case AES_NI:
+            return "aes-ni";
+        default:
+            return "portable";
+    }
+}
+
+#ifdef AES_X86
+
+static TARGET_AES inline __m128i expandKeyStep(
+    __m128i key,
+    __m128i assist
+)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+// _mm_aeskeygenassist_si128() requires immediate round constant
+#define EXPAND_KEY_NI(i, rcon) rk[i] = expandKeyStep(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+static TARGET_AES void setKeyNI(
+    uint8_t *schedule,
+    const uint8_t *key
+)
+{
+    auto rk = (__m128i *) schedule;
+    rk[0] = _mm_loadu_si128((const __m128i *) key);
+    EXPAND_KEY_NI(1, 0x01);
+    EXPAND_KEY_NI(2, 0x02);
+    EXPAND_KEY_NI(3, 0x04);
+    EXPAND_KEY_NI(4, 0x08);
+    EXPAND_KEY_NI(5, 0x10);
+    EXPAND_KEY_NI(6, 0x20);
+    EXPAND_KEY_NI(7, 0x40);
+    EXPAND_KEY_NI(8, 0x80);
+    EXPAND_KEY_NI(9, 0x1b);
+    EXPAND_KEY_NI(10, 0x36);
+}
+
+static TARGET_AES inline __m128i encryptNI(
+    const __m128i *rk,
+    __m128i b
+)
+{
+    b = _mm_xor_si128(b, rk[0]);
+    for (int r = 1; r < AES128_ROUNDS; r++)
+        b = _mm_aesenc_si128(b, rk[r]);
+    return _mm_aesenclast_si128(b, rk[AES128_ROUNDS]);
+}
+
+static TARGET_AES void encryptBlocksNI(
+    const uint8_t *schedule,
+    uint8_t *retVal,
+    const uint8_t *value,
+    size_t blocks
+)
+{
+    auto rk = (const __m128i *) schedule;
+    // four independent blocks hide aesenc latency
+    for (; blocks >= 4; blocks -= 4, value += 4 * AES_BLOCK_SIZE, retVal += 4 * AES_BLOCK_SIZE) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) value), rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (value + 16)), rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (value + 32)), rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (value + 48)), rk[0]);
+        for (int r = 1; r < AES128_ROUNDS; r++) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+            b1 = _mm_aesenc_si128(b1, rk[r]);
+            b2 = _mm_aesenc_si128(b2, rk[r]);
+            b3 = _mm_aesenc_si128(b3, rk[r]);
+        }
+        _mm_storeu_si128((__m128i *) retVal, _mm_aesenclast_si128(b0, rk[AES128_ROUNDS]));
+        _mm_storeu_si128((__m128i *) (retVal + 16), _mm_aesenclast_si128(b1, rk[AES128_ROUNDS]));
+        _mm_storeu_si128((__m128i *) (retVal + 32), _mm_aesenclast_si128(b2, rk[AES128_ROUNDS]));
+        _mm_storeu_si128((__m128i *) (retVal + 48), _mm_aesenclast_si128(b3, rk[AES128_ROUNDS]));
+    }
+    for (; blocks > 0; blocks--, value += AES_BLOCK_SIZE, retVal += AES_BLOCK_SIZE)
+        _mm_storeu_si128((__m128i *) retVal, encryptNI(rk, _mm_loadu_si128((const __m128i *) value)));
+}
+
+static TARGET_AES void cbcMacNI(
+    const uint8_t *schedule,
+    uint8_t *x,
+    const uint8_t *data,
+    size_t blocks
+)
+{
+    auto rk = (const __m128i *) schedule;
+    __m128i v = _mm_loadu_si128((const __m128i *) x);
+    for (; blocks > 0; blocks--, data += AES_BLOCK_SIZE)
+        v = encryptNI(rk, _mm_xor_si128(v, _mm_loadu_si128((const __m128i *) data)));
+    _mm_storeu_si128((__m128i *) x, v);
+}
+
+static TARGET_AES void encrypt4KeysNI(
+    const uint8_t *const *schedules,
+    uint8_t *retVal,
+    const uint8_t *value
+)
+{
+    auto k0 = (const __m128i *) schedules[0];
+    auto k1 = (const __m128i *) schedules[1];
+    auto k2 = (const __m128i *) schedules[2];
+    auto k3 = (const __m128i *) schedules[3];
+    __m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) value), k0[0]);
+    __m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (value + 16)), k1[0]);
+    __m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (value + 32)), k2[0]);
+    __m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (value + 48)), k3[0]);
+    for (int r = 1; r < AES128_ROUNDS; r++) {
+        b0 = _mm_aesenc_si128(b0, k0[r]);
+        b1 = _mm_aesenc_si128(b1, k1[r]);
+        b2 = _mm_aesenc_si128(b2, k2[r]);
+        b3 = _mm_aesenc_si128(b3, k3[r]);
+    }
+    _mm_storeu_si128((__m128i *) retVal, _mm_aesenclast_si128(b0, k0[AES128_ROUNDS]));
+    _mm_storeu_si128((__m128i *) (retVal + 16), _mm_aesenclast_si128(b1, k1[AES128_ROUNDS]));
+    _mm_storeu_si128((__m128i *) (retVal + 32), _mm_aesenclast_si128(b2, k2[AES128_ROUNDS]));
+    _mm_storeu_si128((__m128i *) (retVal + 48), _mm_aesenclast_si128(b3, k3[AES128_ROUNDS]));
+}
+
+/**
+ * Last CMAC block of the message xor-ed with K1 if complete or padded and xor-ed with K2
+ */
+static TARGET_AES __m128i cmacLastNI(
+    const AesCmacJob &job
+)
+{
+    size_t c = job.size ? (job.size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE : 1;
+    size_t lastSize = job.size - (c - 1) * AES_BLOCK_SIZE;
+    if (lastSize == AES_BLOCK_SIZE)
+        return _mm_xor_si128(_mm_loadu_si128((const __m128i *) (job.data + (c - 1) * AES_BLOCK_SIZE)),
+            _mm_loadu_si128((const __m128i *) job.key->k1));
+    alignas(16) uint8_t last[AES_BLOCK_SIZE] = {};
+    memmove(last, job.data + (c - 1) * AES_BLOCK_SIZE, lastSize);
+    last[lastSize] = 0x80;
+    return _mm_xor_si128(_mm_load_si128((const __m128i *) last), _mm_loadu_si128((const __m128i *) job.key->k2));
+}
+
+// chains of aesCmacBatchNI() encrypted at once
+#define CMAC_NI_LANES   4
+
+/**
+ * Each lane runs a CBC-MAC chain, finished lane takes the next message
+ */
+static TARGET_AES void aesCmacBatchNI(
+    AesCmacJob *jobs,
+    const uint8_t *const *schedules,
+    size_t count
+)
+{
+    AesCmacJob *job[CMAC_NI_LANES];
+    const __m128i *rk[CMAC_NI_LANES];
+    size_t block[CMAC_NI_LANES];
+    size_t blocks[CMAC_NI_LANES];
+    __m128i x[CMAC_NI_LANES];
+    size_t nextJob = 0;
+    size_t running = 0;
+    for (int l = 0; l < CMAC_NI_LANES; l++) {
+        if (nextJob < count) {
+            job[l] = &jobs[nextJob++];
+            running++;
+        } else
+            job[l] = nullptr;
+        block[l] = 0;
+        blocks[l] = job[l] ? (job[l]->size ? (job[l]->size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE : 1) : 0;
+        // idle lane encrypts garbage by the first key
+        rk[l] = (const __m128i *) schedules[job[l] ? nextJob - 1 : 0];
+        x[l] = _mm_setzero_si128();
+    }
+    while (running) {
+        __m128i b[CMAC_NI_LANES];
+        for (int l = 0; l < CMAC_NI_LANES; l++) {
+            __m128i m = _mm_setzero_si128();
+            if (job[l])
+                m = block[l] + 1 == blocks[l] ? cmacLastNI(*job[l])
+                    : _mm_loadu_si128((const __m128i *) (job[l]->data + block[l] * AES_BLOCK_SIZE));
+            b[l] = _mm_xor_si128(_mm_xor_si128(x[l], m), rk[l][0]);
+        }
+        for (int r = 1; r < AES128_ROUNDS; r++) {
+            b[0] = _mm_aesenc_si128(b[0], rk[0][r]);
+            b[1] = _mm_aesenc_si128(b[1], rk[1][r]);
+            b[2] = _mm_aesenc_si128(b[2], rk[2][r]);
+            b[3] = _mm_aesenc_si128(b[3], rk[3][r]);
+        }
+        for (int l = 0; l < CMAC_NI_LANES; l++) {
+            x[l] = _mm_aesenclast_si128(b[l], rk[l][AES128_ROUNDS]);
+            if (!job[l] || ++block[l] < blocks[l])
+                continue;
+            _mm_storeu_si128((__m128i *) job[l]->mac, x[l]);
+            x[l] = _mm_setzero_si128();
+            block[l] = 0;
+            if (nextJob < count) {
+                job[l] = &jobs[nextJob++];
+                blocks[l] = job[l]->size ? (job[l]->size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE : 1;
+                rk[l] = (const __m128i *) schedules[nextJob - 1];
+            } else {
+                job[l] = nullptr;
+                running--;
+            }
+        }
+    }
+}
+
+#endif
+
+/**
+ * CMAC subkey generation, RFC 4493 2.3
+ */
+static void doubleBlock(
+    uint8_t *retVal,
+    const uint8_t *value
+)
+{
+    uint8_t carry = value[0] & 0x80;
+    for (int i = 0; i < AES_BLOCK_SIZE - 1; i++)
+        retVal[i] = (uint8_t) (value[i] << 1 | value[i + 1] >> 7);
+    retVal[AES_BLOCK_SIZE - 1] = (uint8_t) (value[AES_BLOCK_SIZE - 1] << 1);
+    if (carry)
+        retVal[AES_BLOCK_SIZE - 1] ^= 0x87;
+}
+
+AesKey::AesKey()
+    : level(AES_PORTABLE)
+{
+    memset(schedule, 0, sizeof(schedule));
+    memset(k1, 0, sizeof(k1));
+    memset(k2, 0, sizeof(k2));
+}
+
+AesKey::AesKey(
+    const KEY128 &key
+)
+{
+    set(key.c);
+}
+
+AesKey::AesKey(
+    const uint8_t *key
+)
+{
+    set(key);
+}
+
+void AesKey::set(
+    const uint8_t *key
+)
+{
+    level = aesLevel();
+    memset(schedule, 0, sizeof(schedule));
+#ifdef AES_X86
+    if (level == AES_NI)
+        setKeyNI(schedule, key);
+    else
+#endif
+        aes_set_key(key, AES_BLOCK_SIZE, (aes_context *) schedule);
+    uint8_t l[AES_BLOCK_SIZE];
+    memset(l, 0, sizeof(l));
+    encrypt(l, l);
+    doubleBlock(k1, l);
+    doubleBlock(k2, k1);
+}
+
+void AesKey::encrypt(
+    uint8_t *retVal,
+    const uint8_t *value
+) const
+{
+    encryptBlocks(retVal, value, 1);
+}
+
+void AesKey::encryptBlocks(
+    uint8_t *retVal,
+    const uint8_t *value,
+    size_t blocks
+) const
+{
+#ifdef AES_X86
+    if (level == AES_NI) {
+        encryptBlocksNI(schedule, retVal, value, blocks);
+        return;
+    }
+#endif
+    for (; blocks > 0; blocks--, value += AES_BLOCK_SIZE, retVal += AES_BLOCK_SIZE)
+        aes_encrypt(value, retVal, (const aes_context *) schedule);
+}
+
+void AesKey::cbcMac(
+    uint8_t *x,
+    const uint8_t *data,
+    size_t blocks
+) const
+{
+#ifdef AES_X86
+    if (level == AES_NI) {
+        cbcMacNI(schedule, x, data, blocks);
+        return;
+    }
+#endif
+    for (; blocks > 0; blocks--, data += AES_BLOCK_SIZE) {
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+            x[i] ^= data[i];
+        aes_encrypt(x, x, (const aes_context *) schedule);
+    }
+}
+
+AesCmac::AesCmac(
+    const AesKey &aKey
+)
+    : key(aKey), lastSize(0)
+{
+    memset(x, 0, sizeof(x));
+}
+
+void AesCmac::update(
+    const void *data,
+    size_t size
+)
+{
+    auto p = (const uint8_t *) data;
+    if (lastSize > 0) {
+        size_t sz = AES_BLOCK_SIZE - lastSize;
+        if (sz > size)
+            sz = size;
+        memmove(last + lastSize, p, sz);
+        lastSize += sz;
+        p += sz;
+        size -= sz;
+        // keep the last block until final()
+        if (size == 0)
+            return;
+        key.cbcMac(x, last, 1);
+    }
+    if (size > AES_BLOCK_SIZE) {
+        size_t blocks = (size - 1) / AES_BLOCK_SIZE;
+        key.cbcMac(x, p, blocks);
+        p += blocks * AES_BLOCK_SIZE;
+        size -= blocks * AES_BLOCK_SIZE;
+    }
+    memmove(last, p, size);
+    lastSize = size;
+}
+
+void AesCmac::final(
+    uint8_t *retVal
+)
+{
+    const uint8_t *k;
+    if (lastSize == AES_BLOCK_SIZE)
+        k = key.k1;
+    else {
+        // padding
+        last[lastSize] = 0x80;
+        memset(last + lastSize + 1, 0, AES_BLOCK_SIZE - lastSize - 1);
+        k = key.k2;
+    }
+    for (int i = 0; i < AES_BLOCK_SIZE; i++)
+        last[i] ^= k[i];
+    key.cbcMac(x, last, 1);
+    memmove(retVal, x, AES_BLOCK_SIZE);
+}
+
+void AesKey::encryptBlocksMultiKey(
+    const AesKey *const *keys,
+    uint8_t *retVal,
+    const uint8_t *value,
+    size_t blocks
+)
+{
+#ifdef AES_X86
+    for (; blocks >= 4; blocks -= 4, keys += 4, value += 4 * AES_BLOCK_SIZE, retVal += 4 * AES_BLOCK_SIZE) {
+        if (keys[0]->level == AES_NI && keys[1]->level == AES_NI && keys[2]->level == AES_NI && keys[3]->level == AES_NI) {
+            const uint8_t *schedules[4] = { keys[0]->schedule, keys[1]->schedule, keys[2]->schedule, keys[3]->schedule };
+            encrypt4KeysNI(schedules, retVal, value);
+        } else {
+            for (int i = 0; i < 4; i++)
+                keys[i]->encrypt(retVal + i * AES_BLOCK_SIZE, value + i * AES_BLOCK_SIZE);
+        }
+    }
+#endif
+    for (; blocks > 0; blocks--, keys++, value += AES_BLOCK_SIZE, retVal += AES_BLOCK_SIZE)
+        (*keys)->encrypt(retVal, value);
+}
+
+// messages encrypted side by side by aesCmacBatch()
+#define CMAC_BATCH_LANES    16
+
+void aesCmacBatch(
+    AesCmacJob *jobs,
+    size_t count
+)
+{
+    uint8_t last[CMAC_BATCH_LANES][AES_BLOCK_SIZE];
+    size_t blockCount[CMAC_BATCH_LANES];
+    const AesKey *keys[CMAC_BATCH_LANES];
+    uint8_t blocks[CMAC_BATCH_LANES * AES_BLOCK_SIZE];
+    size_t lanes[CMAC_BATCH_LANES];
+
+    for (; count > 0; ) {
+        size_t n = count < CMAC_BATCH_LANES ? count : CMAC_BATCH_LANES;
+#ifdef AES_X86
+        const uint8_t *schedules[CMAC_BATCH_LANES];
+        bool ni = true;
+        for (size_t i = 0; i < n && ni; i++) {
+            ni = jobs[i].key->level == AES_NI;
+            schedules[i] = jobs[i].key->schedule;
+        }
+        if (ni) {
+            aesCmacBatchNI(jobs, schedules, n);
+            jobs += n;
+            count -= n;
+            continue;
+        }
+#endif
+        size_t maxBlocks = 0;
+        for (size_t i = 0; i < n; i++) {
+            AesCmacJob &j = jobs[i];
+            // last block is xor-ed with K1 if complete or padded and xor-ed with K2
+            size_t c = j.size ? (j.size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE : 1;
+            size_t lastSize = j.size - (c - 1) * AES_BLOCK_SIZE;
+            const uint8_t *k;
+            memmove(last[i], j.data + (c - 1) * AES_BLOCK_SIZE, lastSize);
+            if (lastSize == AES_BLOCK_SIZE)
+                k = j.key->k1;
+            else {
+                last[i][lastSize] = 0x80;
+                memset(last[i] + lastSize + 1, 0, AES_BLOCK_SIZE - lastSize - 1);
+                k = j.key->k2;
+            }
+            for (int b = 0; b < AES_BLOCK_SIZE; b++)
+                last[i][b] ^= k[b];
+            memset(j.mac, 0, AES_BLOCK_SIZE);
+            blockCount[i] = c;
+            if (c > maxBlocks)
+                maxBlocks = c;
+        }
+        // step b of each chain at once
+        for (size_t b = 0; b < maxBlocks; b++) {
+            size_t active = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (b >= blockCount[i])
+                    continue;
+                const uint8_t *m = b + 1 == blockCount[i] ? last[i] : jobs[i].data + b * AES_BLOCK_SIZE;
+                uint8_t *x = blocks + active * AES_BLOCK_SIZE;
+                for (int k = 0; k < AES_BLOCK_SIZE; k++)
+                    x[k] = jobs[i].mac[k] ^ m[k];
+                keys[active] = jobs[i].key;
+                lanes[active] = i;
+                active++;
+            }
+            AesKey::encryptBlocksMultiKey(keys, blocks, blocks, active);
+            for (size_t a = 0; a < active; a++)
+                memmove(jobs[lanes[a]].mac, blocks + a * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+        }
+        jobs += n;
+        count -= n;
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef LORAWAN_STORAGE_AES_ACCEL_H
+#define LORAWAN_STORAGE_AES_ACCEL_H
+
+#include <cstddef>
+#include <cinttypes>
+
+#include "lorawan/lorawan-types.h"
+
+#define AES_BLOCK_SIZE 16
+
+/**
+ * AES implementation used by AesKey.
+ * AES-NI is detected at startup on x86 built by GCC or Clang, portable third-party aes.c elsewhere.
+ */
+enum AES_LEVEL {
+    AES_PORTABLE = 0,
+    AES_NI = 1
+};
+
+/**
+ * @return implementation in use
+ */
+AES_LEVEL aesLevel();
+
+/**
+ * Limit implementation e.g. to compare with portable code. Level is never raised above the supported one.
+ * Keys expanded before the call keep their implementation.
+ * @param level maximum level
+ * @return implementation in use
+ */
+AES_LEVEL setAesLevel(
+    AES_LEVEL level
+);
+
+/**
+ * @return "portable" or "aes-ni"
+ */
+const char *aesLevelName(
+    AES_LEVEL level
+);
+
+class AesCmacJob;
+
+/**
+ * Expanded AES-128 encryption key with CMAC subkeys.
+ * Expand once, then encrypt any number of blocks, object can be copied and shared between threads.
+ */
+class AesKey {
+private:
+    AES_LEVEL level;
+    // AES-NI round keys or third-party aes_context
+    alignas(16) uint8_t schedule[244];
+public:
+    uint8_t k1[AES_BLOCK_SIZE];   ///< CMAC subkey K1
+    uint8_t k2[AES_BLOCK_SIZE];   ///< CMAC subkey K2
+
+    AesKey();
+    explicit AesKey(
+        const KEY128 &key
+    );
+    explicit AesKey(
+        const uint8_t *key
+    );
+    /**
+     * Expand key
+     * @param key 16 bytes
+     */
+    void set(
+        const uint8_t *key
+    );
+    /**
+     * Encrypt one block
+     * @param retVal 16 bytes, may be the same as value
+     * @param value 16 bytes
+     */
+    void encrypt(
+        uint8_t *retVal,
+        const uint8_t *value
+    ) const;
+    /**
+     * Encrypt independent blocks (ECB). AES-NI encrypts four blocks at once.
+     * @param retVal blocks * 16 bytes, may be the same as value
+     * @param value blocks * 16 bytes
+     * @param blocks count of blocks
+     */
+    void encryptBlocks(
+        uint8_t *retVal,
+        const uint8_t *value,
+        size_t blocks
+    ) const;
+    /**
+     * CBC-MAC chain: x = E(x ^ block) for each block
+     * @param x 16 bytes chain value
+     * @param data blocks * 16 bytes
+     * @param blocks count of blocks
+     */
+    void cbcMac(
+        uint8_t *x,
+        const uint8_t *data,
+        size_t blocks
+    ) const;
+    /**
+     * Encrypt independent blocks, each by its own key. AES-NI encrypts four blocks of different keys at once.
+     * @param keys key of each block
+     * @param retVal blocks * 16 bytes, may be the same as value
+     * @param value blocks * 16 bytes
+     * @param blocks count of blocks
+     */
+    static void encryptBlocksMultiKey(
+        const AesKey *const *keys,
+        uint8_t *retVal,
+        const uint8_t *value,
+        size_t blocks
+    );
+    friend void aesCmacBatch(
+        AesCmacJob *jobs,
+        size_t count
+    );
+};
+
+/**
+ * AES-CMAC (RFC 4493) over the expanded key, same result as third-party AES_CMAC_Update()/AES_CMAC_Final()
+ */
+class AesCmac {
+private:
+    const AesKey &key;
+    uint8_t x[AES_BLOCK_SIZE];
+    uint8_t last[AES_BLOCK_SIZE];
+    size_t lastSize;
+public:
+    explicit AesCmac(
+        const AesKey &key
+    );
+    void update(
+        const void *data,
+        size_t size
+    );
+    /**
+     * @param retVal 16 bytes digest
+     */
+    void final(
+        uint8_t *retVal
+    );
+};
+
+/**
+ * Message for aesCmacBatch()
+ */
+class AesCmacJob {
+public:
+    const AesKey *key;
+    const uint8_t *data;
+    size_t size;
+    uint8_t mac[AES_BLOCK_SIZE];    ///< result
+};
+
+/**
+ * AES-CMAC of independent messages. Chains of the messages are encrypted side by side
+ * so throughput is not bound by the AES latency of one chain.
+ * @param jobs messages, mac is set
+ * @param count messages count
+ */
+void aesCmacBatch(
+    AesCmacJob *jobs,
+    size_t count
+);
+
+#endif
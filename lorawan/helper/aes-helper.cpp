@@ -1,6 +1,9 @@
 #include <cstring>
 #include "lorawan/helper/aes-helper.h"
-#include "system/crypto/aes.h"
+#include "lorawan/helper/aes-accel.h"
+
+// counter blocks encrypted at once
+#define CTR_BLOCKS 16
 
 /**
  * @see 4.3.3 MAC Frame Payload Encryption (FRMPayload)
@@ -15,11 +18,20 @@ void encryptPayload(
     const KEY128 &appSKey
 )
 {
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', 240);
-    aes_set_key(appSKey.c, SIZE_KEY128, &aesContext);
+    AesKey key(appSKey);
+    encryptPayload(payload, payloadSize, frameCounter, direction, devAddr, key);
+}
 
-    uint8_t a[16];
+void encryptPayload(
+    void *payload,
+    size_t payloadSize,
+    unsigned int frameCounter,
+    unsigned char direction,
+    const DEVADDR &devAddr,
+    const AesKey &appSKey
+)
+{
+    uint8_t a[CTR_BLOCKS * AES_BLOCK_SIZE];
     a[0] = 1;
     a[1] = 0;
     a[2] = 0;
@@ -35,32 +47,93 @@ void encryptPayload(
     a[12] = 0; // frame counter upper Bytes
     a[13] = 0;
     a[14] = 0;
+    for (int i = 1; i < CTR_BLOCKS; i++)
+        memmove(a + i * AES_BLOCK_SIZE, a, AES_BLOCK_SIZE - 1);
+
+    uint8_t s[CTR_BLOCKS * AES_BLOCK_SIZE];
+    uint8_t ctr = 1;
+    auto encBuffer = (uint8_t *) payload;
+    while (payloadSize > 0) {
+        // encrypt counter blocks at once, then xor
+        size_t blocks = (payloadSize + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+        if (blocks > CTR_BLOCKS)
+            blocks = CTR_BLOCKS;
+        for (size_t i = 0; i < blocks; i++)
+            a[i * AES_BLOCK_SIZE + AES_BLOCK_SIZE - 1] = ctr++;
+        appSKey.encryptBlocks(s, a, blocks);
+        size_t sz = blocks * AES_BLOCK_SIZE;
+        if (sz > payloadSize)
+            sz = payloadSize;
+        for (size_t i = 0; i < sz; i++)
+            encBuffer[i] ^= s[i];
+        encBuffer += sz;
+        payloadSize -= sz;
+    }
+}
 
-    uint8_t s[16];
-    memset(s, 0, 16);
-
-    int size = (int) payloadSize;
-    uint16_t ctr = 1;
-    uint8_t bufferIndex = 0;
-    int8_t *encBuffer = (int8_t *) payload;
-    while (size >= 16) {
-        a[15] = ctr & 0xff;
-        ctr++;
-        aes_encrypt(a, s, &aesContext);
-        for (int i = 0; i < 16; i++) {
-            encBuffer[bufferIndex + i] = encBuffer[bufferIndex + i] ^ s[i];
-        }
-        size -= 16;
-        bufferIndex += 16;
+/**
+ * Encrypt counter blocks of the frames and xor payloads
+ */
+static void flushCtrBlocks(
+    const AesKey **keys,
+    uint8_t *a,
+    uint8_t **payloads,
+    const size_t *sizes,
+    size_t blocks
+)
+{
+    AesKey::encryptBlocksMultiKey(keys, a, a, blocks);
+    for (size_t b = 0; b < blocks; b++) {
+        const uint8_t *s = a + b * AES_BLOCK_SIZE;
+        for (size_t i = 0; i < sizes[b]; i++)
+            payloads[b][i] ^= s[i];
     }
+}
 
-    if (size > 0) {
-        a[15] = ctr & 0xff;
-        aes_encrypt(a, s, &aesContext);
-        for (int i = 0; i < size; i++) {
-            encBuffer[bufferIndex + i] = encBuffer[bufferIndex + i] ^ s[i];
+void encryptPayloadBatch(
+    const PayloadCryptJob *jobs,
+    size_t count
+)
+{
+    const AesKey *keys[CTR_BLOCKS];
+    uint8_t a[CTR_BLOCKS * AES_BLOCK_SIZE];
+    uint8_t *payloads[CTR_BLOCKS];
+    size_t sizes[CTR_BLOCKS];
+    size_t blocks = 0;
+    for (size_t j = 0; j < count; j++) {
+        const PayloadCryptJob &job = jobs[j];
+        auto p = (uint8_t *) job.payload;
+        uint8_t ctr = 1;
+        for (size_t ofs = 0; ofs < job.size; ofs += AES_BLOCK_SIZE) {
+            uint8_t *b = a + blocks * AES_BLOCK_SIZE;
+            b[0] = 1;
+            b[1] = 0;
+            b[2] = 0;
+            b[3] = 0;
+            b[4] = 0;
+            b[5] = job.direction;
+            b[6] = job.devAddr.c[0];
+            b[7] = job.devAddr.c[1];
+            b[8] = job.devAddr.c[2];
+            b[9] = job.devAddr.c[3];
+            b[10] = (job.frameCounter & 0x00ff);
+            b[11] = ((job.frameCounter >> 8) & 0x00ff);
+            b[12] = 0;
+            b[13] = 0;
+            b[14] = 0;
+            b[15] = ctr++;
+            keys[blocks] = job.appSKey;
+            payloads[blocks] = p + ofs;
+            sizes[blocks] = job.size - ofs < AES_BLOCK_SIZE ? job.size - ofs : AES_BLOCK_SIZE;
+            blocks++;
+            if (blocks == CTR_BLOCKS) {
+                flushCtrBlocks(keys, a, payloads, sizes, blocks);
+                blocks = 0;
+            }
         }
     }
+    if (blocks)
+        flushCtrBlocks(keys, a, payloads, sizes, blocks);
 }
 
 /**
@@ -72,26 +145,11 @@ void decryptJoinAccept(
     size_t size,
     const KEY128 &key
 ) {
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', 240);
-    aes_set_key(key.c, SIZE_KEY128, &aesContext);
-
-    uint8_t a[16];
-    memset(a, 0, 16);
-    uint8_t s[16];
-    memset(s, 0, 16);
-
-    uint8_t *encBuffer = (uint8_t *) payload;
     if (size == 0)
         return;
-    size--;
-    uint8_t bufferIndex = 1;
-
-    while (size >= 16) {
-        aes_encrypt(encBuffer + bufferIndex, encBuffer + bufferIndex, &aesContext);
-        size -= 16;
-        bufferIndex += 16;
-    }
+    AesKey aesKey(key);
+    // aes128_decrypt() of the network server is aes128_encrypt() on the device side
+    aesKey.encryptBlocks((uint8_t *) payload + 1, (const uint8_t *) payload + 1, (size - 1) / AES_BLOCK_SIZE);
 }
 
 /**
@@ -117,18 +175,15 @@ void encryptJoinAcceptResponse(
     const KEY128 &key   // NwkKey or JSEncKey
 )
 {
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', 240);
-    aes_set_key(key.c, SIZE_KEY128, &aesContext);
+    AesKey aesKey(key);
 
     uint8_t a[16];
     memset(a, 0, 16);
     uint8_t s[16];
-    memset(s, 0, 16);
 
     auto e = (uint8_t *) &frame.hdr;
 
-    aes_encrypt(a, s, &aesContext);
+    aesKey.encrypt(s, a);
     for (int i = 0; i < SIZE_JOIN_ACCEPT_FRAME - 1; i++) {
         e[i] = e[i] ^ s[i];
     }
@@ -139,21 +194,18 @@ void encryptJoinAcceptCFListResponse(
     const KEY128 &key   // NwkKey or JSEncKey
 )
 {
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', 240);
-    aes_set_key(key.c, SIZE_KEY128, &aesContext);
+    AesKey aesKey(key);
 
     uint8_t a[16];
     memset(a, 0, 16);
     uint8_t s[16];
-    memset(s, 0, 16);
 
     auto e = (uint8_t *) &frame.hdr;
-    aes_encrypt(a, s, &aesContext);
+    aesKey.encrypt(s, a);
     for (int i = 0; i < 16; i++) {
         e[i] = e[i] ^ s[i];
     }
-    aes_encrypt(a, s, &aesContext);
+    aesKey.encrypt(s, a);
     for (int i = 16; i < SIZE_JOIN_ACCEPT_FRAME_CFLIST - 1; i++) {
         e[i] = e[i] ^ s[i - 16];
     }
@@ -7,6 +7,8 @@
 #define LORAWAN_UPLINK 0
 #define LORAWAN_DOWNLINK  1
 
+class AesKey;
+
 /**
  * @see 4.3.3 MAC Frame Payload Encryption (FRMPayload)
  * @see https://os.mbed.com/teams/Semtech/code/LoRaWAN-lib//file/2426a05fe29e/LoRaMacCrypto.cpp/
@@ -20,6 +22,18 @@ void encryptPayload(
     const KEY128 &appSKey
 );
 
+/**
+ * Same as encryptPayload() with already expanded AppSKey
+ */
+void encryptPayload(
+    void *payload,
+    size_t size,
+    unsigned int frameCounter,
+    unsigned char direction,
+    const DEVADDR &devAddr,
+    const AesKey &appSKey
+);
+
 void encryptPayloadString(
     std::string &payload,
     unsigned int frameCounter,
@@ -28,6 +42,30 @@ void encryptPayloadString(
     const KEY128 &appSKey
 );
 
+/**
+ * FRMPayload of one frame for encryptPayloadBatch()
+ */
+class PayloadCryptJob {
+public:
+    void *payload;
+    size_t size;
+    unsigned int frameCounter;
+    unsigned char direction;
+    DEVADDR devAddr;
+    const AesKey *appSKey;
+};
+
+/**
+ * Encrypt or decrypt payloads of the frames as encryptPayload() does.
+ * Counter blocks of all frames are encrypted side by side, each frame by its own key.
+ * @param jobs frames
+ * @param count frames count
+ */
+void encryptPayloadBatch(
+    const PayloadCryptJob *jobs,
+    size_t count
+);
+
 #define decryptPayload(payload, size, frameCounter, direction, devAddr,appSKey) encryptPayload(payload, size, frameCounter, direction, devAddr,appSKey)
 #define encryptPayloadString(payload, frameCounter, direction, devAddr,appSKey) encryptPayload((void *) payload.c_str(), payload.size(), frameCounter, direction, devAddr,appSKey)
 #define decryptPayloadString(payload, frameCounter, direction, devAddr,appSKey) encryptPayloadString(payload, frameCounter, direction, devAddr,appSKey)
@@ -0,0 +1,93 @@
+#include "lorawan/helper/aes-key-cache.h"
+
+#include <cstring>
+
+static uint64_t cacheKey(
+    const DEVADDR &addr,
+    AES_KEY_TYPE keyType
+)
+{
+    return ((uint64_t) addr.u << 8) | (uint64_t) keyType;
+}
+
+AesKeyCache::AesKeyCache(
+    size_t aMaxEntries
+)
+    : maxEntries(aMaxEntries), hits(0), misses(0)
+{
+}
+
+void AesKeyCache::get(
+    AesKey &retVal,
+    const DEVADDR &addr,
+    AES_KEY_TYPE keyType,
+    const KEY128 &key
+)
+{
+    if (maxEntries == 0) {
+        retVal.set(key.c);
+        return;
+    }
+    uint64_t k = cacheKey(addr, keyType);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = entries.find(k);
+        if (it != entries.end() && memcmp(it->second.key.c, key.c, sizeof(key.c)) == 0) {
+            hits++;
+            recent.splice(recent.begin(), recent, it->second.position);
+            retVal = it->second.expanded;
+            return;
+        }
+        misses++;
+    }
+    // expand out of the lock
+    retVal.set(key.c);
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(k);
+    if (it == entries.end()) {
+        if (entries.size() >= maxEntries) {
+            // replace the least recently used
+            entries.erase(recent.back());
+            recent.pop_back();
+        }
+        recent.push_front(k);
+        it = entries.emplace(k, Entry()).first;
+        it->second.position = recent.begin();
+    } else
+        recent.splice(recent.begin(), recent, it->second.position);
+    memmove(it->second.key.c, key.c, sizeof(key.c));
+    it->second.expanded = retVal;
+}
+
+void AesKeyCache::remove(
+    const DEVADDR &addr
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto keyType : { AES_KEY_APPSKEY, AES_KEY_NWKSKEY }) {
+        auto it = entries.find(cacheKey(addr, keyType));
+        if (it == entries.end())
+            continue;
+        recent.erase(it->second.position);
+        entries.erase(it);
+    }
+}
+
+void AesKeyCache::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+    recent.clear();
+}
+
+size_t AesKeyCache::size()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.size();
+}
+
+AesKeyCache &aesKeyCache()
+{
+    static AesKeyCache cache;
+    return cache;
+}
@@ -0,0 +1,75 @@
+#ifndef LORAWAN_STORAGE_AES_KEY_CACHE_H
+#define LORAWAN_STORAGE_AES_KEY_CACHE_H
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+
+#include "lorawan/helper/aes-accel.h"
+
+// about 330 bytes per entry, two entries per device
+#define DEF_AES_KEY_CACHE_SIZE  8192
+
+enum AES_KEY_TYPE {
+    AES_KEY_APPSKEY = 0,    ///< payload encryption
+    AES_KEY_NWKSKEY = 1     ///< MIC
+};
+
+/**
+ * Expanded session keys by device address and key type.
+ * Entry is expanded again if the device has got a new key e.g. after rejoin.
+ * When cache is full the least recently used entry is replaced.
+ * Thread safe.
+ */
+class AesKeyCache {
+private:
+    class Entry {
+    public:
+        KEY128 key;
+        AesKey expanded;
+        std::list<uint64_t>::iterator position;    ///< position in the recent list
+    };
+    std::mutex lock;
+    std::map<uint64_t, Entry> entries;
+    std::list<uint64_t> recent;     ///< most recently used first
+    const size_t maxEntries;        ///< 0- cache disabled
+public:
+    // counters
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+    /**
+     * @param maxEntries maximum count of expanded keys, 0- cache disabled
+     */
+    explicit AesKeyCache(
+        size_t maxEntries = DEF_AES_KEY_CACHE_SIZE
+    );
+    /**
+     * Get expanded key, expand and remember it if not cached yet
+     * @param retVal expanded key
+     * @param addr device address
+     * @param keyType AppSKey or NwkSKey
+     * @param key session key
+     */
+    void get(
+        AesKey &retVal,
+        const DEVADDR &addr,
+        AES_KEY_TYPE keyType,
+        const KEY128 &key
+    );
+    /**
+     * Drop expanded keys of the device e.g. when identity is removed
+     */
+    void remove(
+        const DEVADDR &addr
+    );
+    void clear();
+    size_t size();
+};
+
+/**
+ * @return process wide cache used by LORAWAN_MESSAGE_STORAGE::decode() and matchMic()
+ */
+AesKeyCache &aesKeyCache();
+
+#endif
@@ -0,0 +1,384 @@
+#include "lorawan/helper/codec-helper.h"
+
+#include <cinttypes>
+#include <cstdlib>
+
+#include "base64/base64.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(ESP_PLATFORM)
+#define CODEC_X86   1
+#include <immintrin.h>
+#define TARGET_SSSE3    __attribute__((target("ssse3")))
+#endif
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// hex digit value, -1 if not a hex digit
+static const signed char HEX_VALUES[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const char *BASE64_DIGITS[2] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+};
+
+static CODEC_LEVEL detectCodecLevel()
+{
+#ifdef CODEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        return CODEC_SSSE3;
+#endif
+    return CODEC_SCALAR;
+}
+
+static CODEC_LEVEL supportedCodecLevel()
+{
+    static const CODEC_LEVEL r = detectCodecLevel();
+    return r;
+}
+
+static CODEC_LEVEL maxCodecLevel = CODEC_SSSE3;
+
+CODEC_LEVEL codecLevel()
+{
+    CODEC_LEVEL r = supportedCodecLevel();
+    return r < maxCodecLevel ? r : maxCodecLevel;
+}
+
+CODEC_LEVEL setCodecLevel(
+    CODEC_LEVEL level
+)
+{
+    maxCodecLevel = level;
+    return codecLevel();
+}
+
+const char *codecLevelName(
+    CODEC_LEVEL level
+)
+{
+    switch (level) {
+        case CODEC_SSSE3:
+            return "ssse3";
+        default:
+            return "scalar";
+    }
+}
+
+static void hexEncodeScalar(
+    char *retVal,
+    const unsigned char *data,
+    size_t size
+)
+{
+    for (size_t i = 0; i < size; i++) {
+        *retVal++ = HEX_DIGITS[data[i] >> 4];
+        *retVal++ = HEX_DIGITS[data[i] & 0xf];
+    }
+}
+
+static void hexDecodeScalar(
+    unsigned char *retVal,
+    const char *hex,
+    size_t pairs
+)
+{
+    for (size_t i = 0; i < pairs; i++) {
+        int h = HEX_VALUES[(unsigned char) hex[0]];
+        int l = HEX_VALUES[(unsigned char) hex[1]];
+        if (h >= 0 && l >= 0)
+            retVal[i] = (unsigned char) ((h << 4) | l);
+        else {
+            // keep strtol() semantics of the pairs like " f", "+f", "-1", "f-"
+            char c[3] = { hex[0], hex[1], 0 };
+            retVal[i] = (unsigned char) strtol(c, nullptr, 16);
+        }
+        hex += 2;
+    }
+}
+
+static void base64EncodeScalar(
+    char *retVal,
+    const unsigned char *data,
+    size_t size,
+    bool url
+)
+{
+    const char *digits = BASE64_DIGITS[url ? 1 : 0];
+    char trailing = url ? '.' : '=';
+    for (; size >= 3; size -= 3, data += 3) {
+        *retVal++ = digits[data[0] >> 2];
+        *retVal++ = digits[((data[0] & 0x03) << 4) | (data[1] >> 4)];
+        *retVal++ = digits[((data[1] & 0x0f) << 2) | (data[2] >> 6)];
+        *retVal++ = digits[data[2] & 0x3f];
+    }
+    if (size == 2) {
+        *retVal++ = digits[data[0] >> 2];
+        *retVal++ = digits[((data[0] & 0x03) << 4) | (data[1] >> 4)];
+        *retVal++ = digits[(data[1] & 0x0f) << 2];
+        *retVal = trailing;
+    } else if (size == 1) {
+        *retVal++ = digits[data[0] >> 2];
+        *retVal++ = digits[(data[0] & 0x03) << 4];
+        *retVal++ = trailing;
+        *retVal = trailing;
+    }
+}
+
+#ifdef CODEC_X86
+
+/**
+ * Each nibble is an index of the hex digit table, high and low nibble digits are interleaved.
+ */
+static TARGET_SSSE3 void hexEncodeSSSE3(
+    char *retVal,
+    const unsigned char *data,
+    size_t size
+)
+{
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+        '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    for (; size >= 16; size -= 16, data += 16, retVal += 32) {
+        __m128i v = _mm_loadu_si128((const __m128i *) data);
+        __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *) retVal, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (retVal + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    // EUI
+    if (size >= 8) {
+        __m128i v = _mm_loadl_epi64((const __m128i *) data);
+        __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *) retVal, _mm_unpacklo_epi8(hi, lo));
+        size -= 8;
+        data += 8;
+        retVal += 16;
+    }
+    hexEncodeScalar(retVal, data, size);
+}
+
+/**
+ * Decode 16 hex digits to 8 bytes
+ * @return false if any character is not a hex digit, nothing is written
+ */
+static TARGET_SSSE3 bool hexDecode16SSSE3(
+    unsigned char *retVal,
+    const char *hex
+)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *) hex);
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+        _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+        _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff)
+        return false;
+    __m128i nibbles = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+        _mm_andnot_si128(digit, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    // high nibble * 16 + low nibble
+    __m128i bytes = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+    _mm_storel_epi64((__m128i *) retVal, _mm_packus_epi16(bytes, bytes));
+    return true;
+}
+
+static TARGET_SSSE3 void hexDecodeSSSE3(
+    unsigned char *retVal,
+    const char *hex,
+    size_t pairs
+)
+{
+    for (; pairs >= 8; pairs -= 8, hex += 16, retVal += 8) {
+        if (!hexDecode16SSSE3(retVal, hex))
+            hexDecodeScalar(retVal, hex, 8);
+    }
+    hexDecodeScalar(retVal, hex, pairs);
+}
+
+/**
+ * Encode 12 bytes to 16 characters, 16 bytes are read
+ * @see http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+ */
+static TARGET_SSSE3 void base64Encode12SSSE3(
+    char *retVal,
+    const unsigned char *data,
+    const __m128i &shifts
+)
+{
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) data),
+        _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    // split 24-bit groups to the 6-bit indexes
+    __m128i a = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i b = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    __m128i indexes = _mm_or_si128(a, b);
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i ranges = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indexes);
+    ranges = _mm_or_si128(ranges, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    _mm_storeu_si128((__m128i *) retVal, _mm_add_epi8(_mm_shuffle_epi8(shifts, ranges), indexes));
+}
+
+/**
+ * @return bytes encoded, multiple of 3
+ */
+static TARGET_SSSE3 size_t base64EncodeSSSE3(
+    char *retVal,
+    const unsigned char *data,
+    size_t size,
+    bool url
+)
+{
+    const __m128i shifts = url
+        ? _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0)
+        : _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t r = 0;
+    for (; r + 16 <= size; r += 12, retVal += 16) {
+        base64Encode12SSSE3(retVal, data + r, shifts);
+    }
+    return r;
+}
+
+/**
+ * Decode 16 characters of the '+/' alphabet to 12 bytes, 16 bytes are written
+ * @see http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+ * @return false if any character is not a base64 digit ('-', '_', '=' and '.' too), nothing is written
+ */
+static TARGET_SSSE3 bool base64Decode16SSSE3(
+    unsigned char *retVal,
+    const char *data
+)
+{
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2f = _mm_set1_epi8(0x2f);
+    __m128i v = _mm_loadu_si128((const __m128i *) data);
+    __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask2f);
+    __m128i lo = _mm_shuffle_epi8(lutLo, _mm_and_si128(v, mask2f));
+    __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff)
+        return false;
+    // character to 6-bit index
+    __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask2f), hiNibbles));
+    v = _mm_add_epi8(v, roll);
+    // join 6-bit indexes to 24-bit groups
+    __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+    _mm_storeu_si128((__m128i *) retVal, _mm_shuffle_epi8(merged,
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+    return true;
+}
+
+/**
+ * @param retVal buffer at least size / 4 * 3 + 4 bytes
+ * @return characters decoded, multiple of 4
+ */
+static TARGET_SSSE3 size_t base64DecodeSSSE3(
+    unsigned char *retVal,
+    const char *data,
+    size_t size
+)
+{
+    size_t r = 0;
+    for (; r + 16 <= size; r += 16, retVal += 12) {
+        if (!base64Decode16SSSE3(retVal, data + r))
+            break;
+    }
+    return r;
+}
+
+#endif
+
+void hexEncode(
+    char *retVal,
+    const void *data,
+    size_t size
+)
+{
+#ifdef CODEC_X86
+    if (codecLevel() >= CODEC_SSSE3) {
+        hexEncodeSSSE3(retVal, (const unsigned char *) data, size);
+        return;
+    }
+#endif
+    hexEncodeScalar(retVal, (const unsigned char *) data, size);
+}
+
+size_t hexDecode(
+    void *retVal,
+    const char *hex,
+    size_t len
+)
+{
+    size_t pairs = len / 2;
+#ifdef CODEC_X86
+    if (codecLevel() >= CODEC_SSSE3) {
+        hexDecodeSSSE3((unsigned char *) retVal, hex, pairs);
+        return pairs;
+    }
+#endif
+    hexDecodeScalar((unsigned char *) retVal, hex, pairs);
+    return pairs;
+}
+
+std::string base64Encode(
+    const void *data,
+    size_t size,
+    bool url
+)
+{
+    std::string r((size + 2) / 3 * 4, '\0');
+    size_t done = 0;
+#ifdef CODEC_X86
+    if (codecLevel() >= CODEC_SSSE3)
+        done = base64EncodeSSSE3(&r[0], (const unsigned char *) data, size, url);
+#endif
+    // encoded groups are independent, the rest starts at the 3 bytes boundary
+    base64EncodeScalar(&r[done / 3 * 4], (const unsigned char *) data + done, size - done, url);
+    return r;
+}
+
+std::string base64Decode(
+    const char *data,
+    size_t size
+)
+{
+    size_t done = 0;
+    std::string r;
+#ifdef CODEC_X86
+    if (codecLevel() >= CODEC_SSSE3 && size >= 16) {
+        // SIMD store writes 4 bytes more
+        r.resize(size / 4 * 3 + 4);
+        done = base64DecodeSSSE3((unsigned char *) &r[0], data, size);
+        r.resize(done / 4 * 3);
+    }
+#endif
+    if (done == 0)
+        return base64_decode(std::string(data, size));
+    // padding, url alphabet and errors are left to the third-party decoder, 4 characters groups are independent
+    if (done < size)
+        r += base64_decode(std::string(data + done, size - done));
+    return r;
+}
@@ -0,0 +1,89 @@
+#ifndef LORAWAN_STORAGE_CODEC_HELPER_H
+#define LORAWAN_STORAGE_CODEC_HELPER_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Instruction set used by the hex and base64 codecs.
+ * Detected at startup on x86 built by GCC or Clang, scalar code elsewhere.
+ * Keys and EUIs are 8..16 bytes long, wider registers are not used.
+ */
+enum CODEC_LEVEL {
+    CODEC_SCALAR = 0,
+    CODEC_SSSE3 = 1
+};
+
+/**
+ * @return instruction set in use
+ */
+CODEC_LEVEL codecLevel();
+
+/**
+ * Limit instruction set e.g. to compare with scalar code. Level is never raised above the supported one.
+ * @param level maximum level
+ * @return instruction set in use
+ */
+CODEC_LEVEL setCodecLevel(
+    CODEC_LEVEL level
+);
+
+/**
+ * @return "scalar" or "ssse3"
+ */
+const char *codecLevelName(
+    CODEC_LEVEL level
+);
+
+/**
+ * Write lower case hex digits, MSB first. No trailing zero is written.
+ * @param retVal buffer at least 2 * size characters
+ * @param data bytes to encode
+ * @param size bytes count
+ */
+void hexEncode(
+    char *retVal,
+    const void *data,
+    size_t size
+);
+
+/**
+ * Decode pairs of hex digits. Pair which is not two hex digits is parsed as strtol(pair, nullptr, 16) does,
+ * odd trailing character is ignored.
+ * @param retVal buffer at least len / 2 bytes
+ * @param hex hex string
+ * @param len string length
+ * @return bytes written, len / 2
+ */
+size_t hexDecode(
+    void *retVal,
+    const char *hex,
+    size_t len
+);
+
+/**
+ * Same as third-party base64_encode()
+ * @param data bytes to encode
+ * @param size bytes count
+ * @param url true- use '-', '_' and '.' instead of '+', '/' and '='
+ * @return base64 string
+ */
+std::string base64Encode(
+    const void *data,
+    size_t size,
+    bool url = false
+);
+
+/**
+ * Same as third-party base64_decode(). Both alphabets are accepted.
+ * @param data base64 string
+ * @param size string length
+ * @return decoded bytes
+ * @throws std::runtime_error if input is not valid base64-encoded data
+ */
+std::string base64Decode(
+    const char *data,
+    size_t size
+);
+
+#endif
@@ -13,26 +13,39 @@
 std::string sockaddr2string(
     const struct sockaddr *value
 ) {
-    char buf[INET6_ADDRSTRLEN];
+    char buf[SOCKADDR_STRLEN];
+    return std::string(buf, sockaddr2chars(buf, value));
+}
+
+size_t sockaddr2chars(
+    char *retVal,
+    const struct sockaddr *value
+) {
     int port;
     switch (value->sa_family) {
         case AF_INET:
-            if (inet_ntop(AF_INET, &((struct sockaddr_in *) value)->sin_addr, buf, sizeof(buf)) == nullptr)
-                return "";
+            if (inet_ntop(AF_INET, &((struct sockaddr_in *) value)->sin_addr, retVal, INET6_ADDRSTRLEN) == nullptr)
+                return 0;
             port = ntohs(((struct sockaddr_in *) value)->sin_port);
             break;
         case AF_INET6:
-            if (inet_ntop(AF_INET6, &((struct sockaddr_in6 *) value)->sin6_addr, buf, sizeof(buf)) == nullptr) {
-                return "";
-            }
+            if (inet_ntop(AF_INET6, &((struct sockaddr_in6 *) value)->sin6_addr, retVal, INET6_ADDRSTRLEN) == nullptr)
+                return 0;
             port = ntohs(((struct sockaddr_in6 *) value)->sin6_port);
             break;
         default:
-            return "";
+            return 0;
     }
-    std::stringstream ss;
-    ss << buf << ":" << port;
-    return ss.str();
+    size_t r = strlen(retVal);
+    retVal[r++] = ':';
+    char s[5];
+    char *p = s + sizeof(s);
+    do {
+        *--p = (char) ('0' + port % 10);
+        port /= 10;
+    } while (port);
+    memmove(retVal + r, p, s + sizeof(s) - p);
+    return r + (s + sizeof(s) - p);
 }
 
 /**
@@ -30,6 +30,19 @@ std::string sockaddr2string(
     const struct sockaddr *value
 );
 
+// IPv6 address, colon and port
+#define SOCKADDR_STRLEN (INET6_ADDRSTRLEN + 6)
+
+/**
+ * Write IP adress:port text representation without allocation
+ * @param retVal buffer at least SOCKADDR_STRLEN bytes
+ * @return string length, 0 if address family is not IPv4 or IPv6
+ */
+size_t sockaddr2chars(
+    char *retVal,
+    const struct sockaddr *value
+);
+
 /**
  * Trying parseRX I v6 address, then IPv4
  * @param retval return address into struct sockaddr_in6 struct pointer
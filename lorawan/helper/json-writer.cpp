@@ -0,0 +1,138 @@
+#include <cstring>
+
+#include "lorawan/helper/json-writer.h"
+#include "lorawan/helper/codec-helper.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+JsonWriter::JsonWriter(
+    std::string &aBuffer
+)
+    : buffer(aBuffer)
+{
+}
+
+JsonWriter &JsonWriter::raw(
+    char value
+)
+{
+    buffer += value;
+    return *this;
+}
+
+JsonWriter &JsonWriter::raw(
+    const char *value
+)
+{
+    buffer.append(value, strlen(value));
+    return *this;
+}
+
+JsonWriter &JsonWriter::raw(
+    const char *value,
+    size_t size
+)
+{
+    buffer.append(value, size);
+    return *this;
+}
+
+JsonWriter &JsonWriter::hex(
+    const void *data,
+    size_t size
+)
+{
+    size_t sz = buffer.size();
+    buffer.resize(sz + size * 2);
+    hexEncode(&buffer[sz], data, size);
+    return *this;
+}
+
+JsonWriter &JsonWriter::hex(
+    uint64_t value
+)
+{
+    char s[16];
+    char *p = s + sizeof(s);
+    do {
+        *--p = HEX_DIGITS[value & 0xf];
+        value >>= 4;
+    } while (value);
+    buffer.append(p, s + sizeof(s) - p);
+    return *this;
+}
+
+JsonWriter &JsonWriter::dec(
+    uint64_t value
+)
+{
+    char s[20];
+    char *p = s + sizeof(s);
+    do {
+        *--p = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+    buffer.append(p, s + sizeof(s) - p);
+    return *this;
+}
+
+JsonWriter &JsonWriter::dec(
+    int64_t value
+)
+{
+    if (value < 0) {
+        buffer += '-';
+        return dec((uint64_t) 0 - (uint64_t) value);
+    }
+    return dec((uint64_t) value);
+}
+
+JsonWriter &JsonWriter::str(
+    const char *value,
+    size_t size
+)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < size; i++) {
+        auto c = (unsigned char) value[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        buffer.append(value + start, i - start);
+        start = i + 1;
+        buffer += '\\';
+        switch (c) {
+            case '"':
+            case '\\':
+                buffer += (char) c;
+                break;
+            case '\b':
+                buffer += 'b';
+                break;
+            case '\f':
+                buffer += 'f';
+                break;
+            case '\n':
+                buffer += 'n';
+                break;
+            case '\r':
+                buffer += 'r';
+                break;
+            case '\t':
+                buffer += 't';
+                break;
+            default:
+                buffer.append("u00", 3);
+                buffer += HEX_DIGITS[c >> 4];
+                buffer += HEX_DIGITS[c & 0xf];
+        }
+    }
+    buffer.append(value + start, size - start);
+    return *this;
+}
+
+JsonWriter &JsonWriter::str(
+    const std::string &value
+)
+{
+    return str(value.c_str(), value.size());
+}
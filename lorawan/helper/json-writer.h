@@ -0,0 +1,72 @@
+#ifndef LORAWAN_STORAGE_JSON_WRITER_H
+#define LORAWAN_STORAGE_JSON_WRITER_H
+
+#include <cstddef>
+#include <cinttypes>
+#include <string>
+
+// JSON file stores write the buffer to the file when it grows over
+#define DEF_JSON_WRITER_FLUSH_SIZE  65536
+
+/**
+ * Append-only JSON writer.
+ * Appends straight to the caller's buffer, nothing is allocated while the buffer capacity is enough.
+ * Clear and reuse the buffer (clear() keeps capacity) to write without allocations at all.
+ * Writer does not check the document structure, caller writes punctuation by raw().
+ */
+class JsonWriter {
+public:
+    std::string &buffer;
+
+    explicit JsonWriter(
+        std::string &buffer
+    );
+
+    /**
+     * Append as is
+     */
+    JsonWriter &raw(
+        char value
+    );
+    JsonWriter &raw(
+        const char *value
+    );
+    JsonWriter &raw(
+        const char *value,
+        size_t size
+    );
+    /**
+     * Append lower case hex digits of the bytes, first byte first
+     */
+    JsonWriter &hex(
+        const void *data,
+        size_t size
+    );
+    /**
+     * Append lower case hex number without leading zeros as std::hex does
+     */
+    JsonWriter &hex(
+        uint64_t value
+    );
+    /**
+     * Append decimal number
+     */
+    JsonWriter &dec(
+        uint64_t value
+    );
+    JsonWriter &dec(
+        int64_t value
+    );
+    /**
+     * Append string escaped, without quotes
+     */
+    JsonWriter &str(
+        const char *value,
+        size_t size
+    );
+    JsonWriter &str(
+        const std::string &value
+    );
+};
+
+#endif
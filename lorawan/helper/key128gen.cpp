@@ -8,9 +8,7 @@
 #include <random>
 #endif
 
-#include "system/crypto/aes.h"
-#include "system/crypto/cmac.h"
-#include "lorawan/helper/aes-const.h"
+#include "lorawan/helper/aes-accel.h"
 
 #ifdef ESP_PLATFORM
 #include <iostream>
@@ -61,15 +59,10 @@ uint8_t* keyGen(
 	blockB[14] = 90;
 	blockB[15] = 73;
 
-	aes_context aesContext;
-	memset(aesContext.ksch, '\0', KSCH_SIZE);
-	aes_set_key(key, 16, &aesContext);
-
-	AES_CMAC_CTX aesCmacCtx;
-	AES_CMAC_Init(&aesCmacCtx);
-	AES_CMAC_SetKey(&aesCmacCtx, key);
-	AES_CMAC_Update(&aesCmacCtx, blockB, sizeof(blockB));
-	AES_CMAC_Final(retVal, &aesCmacCtx);
+	AesKey aesKey(key);
+	AesCmac cmac(aesKey);
+	cmac.update(blockB, sizeof(blockB));
+	cmac.final(retVal);
 	return retVal;
 }
 
@@ -130,8 +123,6 @@ uint8_t* phrase2key(
 	blockB[14] = 90;
 	blockB[15] = 73;
 
-	aes_context aesContext;
-	memset(aesContext.ksch, '\0', KSCH_SIZE);
 	uint8_t key[16];
 	memset(key, 0, 16);
 	uint32_t sz;
@@ -141,13 +132,11 @@ uint8_t* phrase2key(
 		sz = 16;
 	memmove(key, phrase, sz);
 
-	aes_set_key(key, 16, &aesContext);
-	AES_CMAC_CTX aesCmacCtx;
-	AES_CMAC_Init(&aesCmacCtx);
-	AES_CMAC_SetKey(&aesCmacCtx, key);
-	AES_CMAC_Update(&aesCmacCtx, blockB, sizeof(blockB));
-	AES_CMAC_Update(&aesCmacCtx, (uint8_t *) phrase, (uint32_t) size);
-	AES_CMAC_Final(retVal, &aesCmacCtx);
+	AesKey aesKey(key);
+	AesCmac cmac(aesKey);
+	cmac.update(blockB, sizeof(blockB));
+	cmac.update(phrase, size);
+	cmac.final(retVal);
 	return retVal;
 }
 
@@ -185,10 +174,7 @@ uint8_t *sessionKeyGen(
 	a[7] = devNonce.c[0];
 	a[8] = devNonce.c[1];
 
-	aes_context aesContext;
-	memset(aesContext.ksch, '\0', 240);
-	aes_set_key(key.c, 16, &aesContext);
-	memset(retVal, 0, 16);
-	aes_encrypt(a, retVal, &aesContext);
+	AesKey aesKey(key);
+	aesKey.encrypt(retVal, a);
 	return retVal;
 }
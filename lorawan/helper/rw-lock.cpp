@@ -0,0 +1,69 @@
+#include "lorawan/helper/rw-lock.h"
+
+RWLock::RWLock()
+    : readers(0), writersWaiting(0), writer(false)
+{
+}
+
+void RWLock::lockShared()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return !writer && writersWaiting == 0; });
+    readers++;
+}
+
+void RWLock::unlockShared()
+{
+    bool last;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        readers--;
+        last = readers == 0;
+    }
+    if (last)
+        changed.notify_all();
+}
+
+void RWLock::lockExclusive()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    writersWaiting++;
+    changed.wait(guard, [this] { return !writer && readers == 0; });
+    writersWaiting--;
+    writer = true;
+}
+
+void RWLock::unlockExclusive()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        writer = false;
+    }
+    changed.notify_all();
+}
+
+SharedGuard::SharedGuard(
+    RWLock &aValue
+)
+    : value(aValue)
+{
+    value.lockShared();
+}
+
+SharedGuard::~SharedGuard()
+{
+    value.unlockShared();
+}
+
+ExclusiveGuard::ExclusiveGuard(
+    RWLock &aValue
+)
+    : value(aValue)
+{
+    value.lockExclusive();
+}
+
+ExclusiveGuard::~ExclusiveGuard()
+{
+    value.unlockExclusive();
+}
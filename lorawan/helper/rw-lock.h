@@ -0,0 +1,42 @@
+#ifndef LORAWAN_STORAGE_RW_LOCK_H
+#define LORAWAN_STORAGE_RW_LOCK_H
+
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Readers-writer lock (C++11 has no std::shared_mutex).
+ * Waiting writer blocks new readers, writers are not starved by the stream of lookups.
+ */
+class RWLock {
+private:
+    std::mutex lock;
+    std::condition_variable changed;
+    size_t readers;
+    size_t writersWaiting;
+    bool writer;
+public:
+    RWLock();
+    void lockShared();
+    void unlockShared();
+    void lockExclusive();
+    void unlockExclusive();
+};
+
+class SharedGuard {
+private:
+    RWLock &value;
+public:
+    explicit SharedGuard(RWLock &value);
+    ~SharedGuard();
+};
+
+class ExclusiveGuard {
+private:
+    RWLock &value;
+public:
+    explicit ExclusiveGuard(RWLock &value);
+    ~ExclusiveGuard();
+};
+
+#endif
@@ -208,6 +208,12 @@
 #define ERR_CODE_LORA_GATEWAY_SPECTRAL_SCAN_RESULT          (-5180)
 #define ERR_CODE_STOPPED                                    (-5181)
 #define ERR_CODE_ACCESS_DENIED                              (-5182)
+#define ERR_CODE_IO_URING_INIT                              (-5183)
+#define ERR_CODE_TIMEOUT                                    (-5184)
+#define ERR_CODE_REPLICA_SNAPSHOT                           (-5185)
+#define ERR_CODE_THROTTLED                                  (-5186)
+#define ERR_CODE_REQUEST_TRUNCATED                          (-5187)
+#define ERR_CODE_NO_CHANGE_FEED                             (-5188)
 
 const char *logLevelString(
     int logLevel
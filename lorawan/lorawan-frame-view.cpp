@@ -0,0 +1,280 @@
+#include <cstring>
+
+#include "lorawan/lorawan-frame-view.h"
+#include "lorawan/lorawan-mic.h"
+#include "lorawan/helper/aes-accel.h"
+#include "lorawan/helper/aes-helper.h"
+
+LorawanFrameView::LorawanFrameView()
+    : buf(nullptr), size(0)
+{
+}
+
+LorawanFrameView::LorawanFrameView(
+    const void *aBuf,
+    size_t aSize
+)
+    : buf((const uint8_t *) aBuf), size(aBuf ? aSize : 0)
+{
+}
+
+void LorawanFrameView::set(
+    const void *aBuf,
+    size_t aSize
+)
+{
+    buf = (const uint8_t *) aBuf;
+    size = aBuf ? aSize : 0;
+}
+
+const uint8_t *LorawanFrameView::data() const
+{
+    return buf;
+}
+
+size_t LorawanFrameView::length() const
+{
+    return size;
+}
+
+const MHDR *LorawanFrameView::mhdr() const
+{
+    if (size < SIZE_MHDR)
+        return nullptr;
+    return (const MHDR *) buf;
+}
+
+MTYPE LorawanFrameView::mtype() const
+{
+    if (size < SIZE_MHDR)
+        return MTYPE_PROPRIETARYRADIO;
+    return (MTYPE) ((const MHDR *) buf)->f.mtype;
+}
+
+bool LorawanFrameView::isData() const
+{
+    // B0 block of the MIC has one byte for the frame size
+    if (size < SIZE_RFM_HEADER + SIZE_MIC || size > MAX_FRAME_SIZE)
+        return false;
+    switch (mtype()) {
+        case MTYPE_UNCONFIRMED_DATA_UP:
+        case MTYPE_CONFIRMED_DATA_UP:
+        case MTYPE_UNCONFIRMED_DATA_DOWN:
+        case MTYPE_CONFIRMED_DATA_DOWN:
+            return size >= (size_t) (SIZE_RFM_HEADER + foptsSize() + SIZE_MIC);
+        default:
+            return false;
+    }
+}
+
+unsigned char LorawanFrameView::direction() const
+{
+    return (unsigned char) (mtype() & 1);
+}
+
+const RFM_HEADER *LorawanFrameView::header() const
+{
+    if (!isData())
+        return nullptr;
+    return (const RFM_HEADER *) buf;
+}
+
+DEVADDR LorawanFrameView::devAddr() const
+{
+    DEVADDR r;
+    if (size < SIZE_MHDR + sizeof(r.c))
+        return r;
+    memmove(r.c, buf + SIZE_MHDR, sizeof(r.c));
+    return r;
+}
+
+uint16_t LorawanFrameView::fcnt() const
+{
+    if (size < SIZE_RFM_HEADER)
+        return 0;
+    // little endian on the air
+    return (uint16_t) (buf[6] | (buf[7] << 8));
+}
+
+const uint8_t *LorawanFrameView::fopts() const
+{
+    if (size < (size_t) (SIZE_RFM_HEADER + foptsSize()))
+        return nullptr;
+    return buf + SIZE_RFM_HEADER;
+}
+
+uint8_t LorawanFrameView::foptsSize() const
+{
+    if (size < SIZE_RFM_HEADER)
+        return 0;
+    return ((const RFM_HEADER *) buf)->fhdr.fctrl.f.foptslen;
+}
+
+bool LorawanFrameView::hasFPort() const
+{
+    return size > (size_t) (SIZE_RFM_HEADER + foptsSize() + SIZE_MIC);
+}
+
+uint8_t LorawanFrameView::fport() const
+{
+    if (!hasFPort())
+        return 0;
+    return buf[SIZE_RFM_HEADER + foptsSize()];
+}
+
+const uint8_t *LorawanFrameView::payload() const
+{
+    if (payloadSize() == 0)
+        return nullptr;
+    return buf + SIZE_RFM_HEADER + foptsSize() + SIZE_FPORT;
+}
+
+size_t LorawanFrameView::payloadSize() const
+{
+    if (size < SIZE_RFM_HEADER)
+        return 0;
+    size_t h = SIZE_RFM_HEADER + foptsSize() + SIZE_FPORT + SIZE_MIC;
+    if (size <= h)
+        return 0;
+    return size - h;
+}
+
+uint32_t LorawanFrameView::mic() const
+{
+    if (!isData())
+        return 0;
+    const uint8_t *m = buf + size - SIZE_MIC;
+    return (uint32_t) ((uint32_t) m[3] << 24 | (uint32_t) m[2] << 16 | (uint32_t) m[1] << 8 | (uint32_t) m[0]);
+}
+
+uint32_t LorawanFrameView::calculateMic(
+    const KEY128 &nwkSKey
+) const
+{
+    return calculateMic(AesKey(nwkSKey));
+}
+
+/**
+ * MIC is calculated over MHDR..FRMPayload as it is in the buffer
+ */
+uint32_t LorawanFrameView::calculateMic(
+    const AesKey &nwkSKey
+) const
+{
+    // isData() limits size to MAX_FRAME_SIZE, MHDR..FRMPayload size fits one byte
+    if (!isData())
+        return 0;
+    return calculateMICFrmPayload(buf, (unsigned char) (size - SIZE_MIC), fcnt(), direction(), devAddr(), nwkSKey);
+}
+
+bool LorawanFrameView::matchMic(
+    const KEY128 &nwkSKey
+) const
+{
+    return isData() && mic() == calculateMic(nwkSKey);
+}
+
+bool LorawanFrameView::matchMic(
+    const AesKey &nwkSKey
+) const
+{
+    return isData() && mic() == calculateMic(nwkSKey);
+}
+
+size_t LorawanFrameView::cryptPayload(
+    void *retVal,
+    const AesKey &key
+) const
+{
+    const uint8_t *p = payload();
+    if (!p || !isData())
+        return 0;
+    size_t sz = payloadSize();
+    if (retVal != p)
+        memmove(retVal, p, sz);
+    encryptPayload(retVal, sz, fcnt(), direction(), devAddr(), key);
+    return sz;
+}
+
+size_t LorawanFrameView::decrypt(
+    void *retVal,
+    const KEY128 &appSKey,
+    const KEY128 &nwkSKey
+) const
+{
+    // expand one key only
+    if (retVal == payload())
+        return 0;
+    return cryptPayload(retVal, AesKey(fport() == 0 ? nwkSKey : appSKey));
+}
+
+size_t LorawanFrameView::decrypt(
+    void *retVal,
+    const AesKey &appSKey,
+    const AesKey &nwkSKey
+) const
+{
+    if (retVal == payload())
+        return 0;
+    return cryptPayload(retVal, fport() == 0 ? nwkSKey : appSKey);
+}
+
+size_t LorawanFrameView::decrypt(
+    void *retVal,
+    const KEY128 &appSKey
+) const
+{
+    if (fport() == 0 || retVal == payload())
+        return 0;
+    return cryptPayload(retVal, AesKey(appSKey));
+}
+
+size_t LorawanFrameView::decrypt(
+    void *retVal,
+    const AesKey &appSKey
+) const
+{
+    if (fport() == 0 || retVal == payload())
+        return 0;
+    return cryptPayload(retVal, appSKey);
+}
+
+LorawanMutableFrameView::LorawanMutableFrameView() = default;
+
+LorawanMutableFrameView::LorawanMutableFrameView(
+    void *aBuf,
+    size_t aSize
+)
+    : LorawanFrameView(aBuf, aSize)
+{
+}
+
+void LorawanMutableFrameView::set(
+    void *aBuf,
+    size_t aSize
+)
+{
+    LorawanFrameView::set(aBuf, aSize);
+}
+
+uint8_t *LorawanMutableFrameView::payload()
+{
+    // buffer is writable, it is passed to the constructor or set() as non-const
+    return const_cast<uint8_t *>(LorawanFrameView::payload());
+}
+
+size_t LorawanMutableFrameView::decrypt(
+    const KEY128 &appSKey,
+    const KEY128 &nwkSKey
+)
+{
+    return cryptPayload(payload(), AesKey(fport() == 0 ? nwkSKey : appSKey));
+}
+
+size_t LorawanMutableFrameView::decrypt(
+    const AesKey &appSKey,
+    const AesKey &nwkSKey
+)
+{
+    return cryptPayload(payload(), fport() == 0 ? nwkSKey : appSKey);
+}
@@ -0,0 +1,173 @@
+#ifndef LORAWAN_FRAME_VIEW_H_
+#define LORAWAN_FRAME_VIEW_H_
+
+#include <cstddef>
+#include <cinttypes>
+
+#include "lorawan/lorawan-types.h"
+
+class AesKey;
+
+// LoRa PHYPayload maximum size
+#define MAX_FRAME_SIZE  255
+
+/**
+ * Non-owning view of the received radio frame (PHYPayload) as is, in the wire byte order.
+ * Fields are read by accessors from the buffer, nothing is copied. Buffer must outlive the view.
+ * Use it instead of LORAWAN_MESSAGE_STORAGE to parse many frames.
+ *
+ * MHDR | FHDR(DevAddr FCtrl FCnt FOpts) | FPort | FRMPayload | MIC
+ */
+class LorawanFrameView {
+private:
+    const uint8_t *buf;
+    size_t size;
+public:
+    LorawanFrameView();
+    LorawanFrameView(
+        const void *buf,
+        size_t size
+    );
+    void set(
+        const void *buf,
+        size_t size
+    );
+    const uint8_t *data() const;
+    size_t length() const;
+
+    /**
+     * @return nullptr if buffer is empty
+     */
+    const MHDR *mhdr() const;
+    MTYPE mtype() const;
+    /**
+     * @return true if frame is data up or down with complete FHDR, FOpts and MIC, not longer than MAX_FRAME_SIZE
+     */
+    bool isData() const;
+    /**
+     * @return LORAWAN_UPLINK(0) or LORAWAN_DOWNLINK(1)
+     */
+    unsigned char direction() const;
+    /**
+     * @return MHDR and FHDR without FOpts, nullptr if not a data frame
+     */
+    const RFM_HEADER *header() const;
+    /**
+     * Accessors below are valid for data frames only, check isData() first.
+     * Fields beyond the buffer are returned empty: zero address and counter, nullptr FOpts
+     */
+    DEVADDR devAddr() const;
+    uint16_t fcnt() const;
+    /**
+     * @return FOpts, nullptr if FOpts are truncated
+     */
+    const uint8_t *fopts() const;
+    uint8_t foptsSize() const;
+    bool hasFPort() const;
+    uint8_t fport() const;
+    /**
+     * @return FRMPayload, nullptr if frame has no payload
+     */
+    const uint8_t *payload() const;
+    size_t payloadSize() const;
+    /**
+     * @return received MIC, 0 if not a data frame
+     */
+    uint32_t mic() const;
+
+    /**
+     * Calculate MIC of the frame
+     * @param nwkSKey network session key
+     * @return MIC, 0 if not a data frame
+     */
+    uint32_t calculateMic(
+        const KEY128 &nwkSKey
+    ) const;
+    uint32_t calculateMic(
+        const AesKey &nwkSKey
+    ) const;
+    bool matchMic(
+        const KEY128 &nwkSKey
+    ) const;
+    bool matchMic(
+        const AesKey &nwkSKey
+    ) const;
+    /**
+     * Decrypt FRMPayload into the caller buffer.
+     * FPort 0 payload (MAC commands) is encrypted by NwkSKey, FPort 1..255 by AppSKey.
+     * View is read-only, use LorawanMutableFrameView to decrypt in place.
+     * @param retVal at least payloadSize() bytes, not the frame buffer
+     * @param appSKey application session key
+     * @param nwkSKey network session key
+     * @return payload size, 0 if frame has no payload or retVal is the frame payload
+     */
+    size_t decrypt(
+        void *retVal,
+        const KEY128 &appSKey,
+        const KEY128 &nwkSKey
+    ) const;
+    size_t decrypt(
+        void *retVal,
+        const AesKey &appSKey,
+        const AesKey &nwkSKey
+    ) const;
+    /**
+     * Decrypt application payload (FPort 1..255) into the caller buffer
+     * @param retVal at least payloadSize() bytes, not the frame buffer
+     * @param appSKey application session key
+     * @return payload size, 0 if frame has no payload, FPort is 0 or retVal is the frame payload
+     */
+    size_t decrypt(
+        void *retVal,
+        const KEY128 &appSKey
+    ) const;
+    size_t decrypt(
+        void *retVal,
+        const AesKey &appSKey
+    ) const;
+protected:
+    /**
+     * Copy payload to the retVal if it is not the payload, decrypt it
+     */
+    size_t cryptPayload(
+        void *retVal,
+        const AesKey &key
+    ) const;
+};
+
+/**
+ * View of the writable frame buffer, FRMPayload is decrypted in place.
+ */
+class LorawanMutableFrameView : public LorawanFrameView {
+public:
+    LorawanMutableFrameView();
+    LorawanMutableFrameView(
+        void *buf,
+        size_t size
+    );
+    void set(
+        void *buf,
+        size_t size
+    );
+    using LorawanFrameView::payload;
+    /**
+     * @return FRMPayload, nullptr if frame has no payload
+     */
+    uint8_t *payload();
+    using LorawanFrameView::decrypt;
+    /**
+     * Decrypt FRMPayload in the frame buffer, FPort 0 by NwkSKey, FPort 1..255 by AppSKey.
+     * MIC is calculated over encrypted payload, check it before.
+     * @return payload size, 0 if frame has no payload
+     */
+    size_t decrypt(
+        const KEY128 &appSKey,
+        const KEY128 &nwkSKey
+    );
+    size_t decrypt(
+        const AesKey &appSKey,
+        const AesKey &nwkSKey
+    );
+};
+
+#endif
@@ -1,9 +1,7 @@
 #include "lorawan/lorawan-key.h"
 
 #include <cstring>
-#include "system/crypto/aes.h"
-#include "system/crypto/cmac.h"
-#include "lorawan/helper/aes-const.h"
+#include "lorawan/helper/aes-accel.h"
 
 /**
  * JSEncKey is used to encrypt the Join-Accept triggered by a Rejoin-Request
@@ -19,15 +17,10 @@ static void deriveKeyBlock(
     size_t size
 )
 {
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', KSCH_SIZE);
-    aes_set_key(nwkKey.c, sizeof(KEY128), &aesContext);
-
-    AES_CMAC_CTX aesCmacCtx;
-    AES_CMAC_Init(&aesCmacCtx);
-    AES_CMAC_SetKey(&aesCmacCtx, nwkKey.c);
-    AES_CMAC_Update(&aesCmacCtx, (const uint8_t *) &value, (std::uint32_t) size);
-    AES_CMAC_Final(retval.c, &aesCmacCtx);
+    AesKey aesKey(nwkKey);
+    AesCmac cmac(aesKey);
+    cmac.update((const uint8_t *) &value, size);
+    cmac.final(retval.c);
 }
 
 // The network session keys are derived from the NwkKey:
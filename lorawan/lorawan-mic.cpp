@@ -1,9 +1,7 @@
 #include "lorawan/lorawan-mic.h"
 
 #include <cstring>
-#include "system/crypto/aes.h"
-#include "system/crypto/cmac.h"
-#include "lorawan/helper/aes-const.h"
+#include "lorawan/helper/aes-accel.h"
 
 static uint32_t calculateMICRev103(
 	const unsigned char *data,
@@ -11,7 +9,7 @@ static uint32_t calculateMICRev103(
 	const unsigned int frameCounter,
 	const unsigned char direction,
 	const DEVADDR &devAddr,
-	const KEY128 &key
+	const AesKey &key
 )
 {
 	unsigned char blockB[16];
@@ -41,17 +39,11 @@ static uint32_t calculateMICRev103(
 	blockB[14] = 0x00;
 	blockB[15] = size;
 
-	aes_context aesContext;
-	memset(aesContext.ksch, '\0', KSCH_SIZE);
-    aes_set_key(key.c, sizeof(KEY128), &aesContext);
-
-    AES_CMAC_CTX aesCmacCtx;
-    AES_CMAC_Init(&aesCmacCtx);
-	AES_CMAC_SetKey(&aesCmacCtx, key.c);
-	AES_CMAC_Update(&aesCmacCtx, blockB, sizeof(blockB));
-	AES_CMAC_Update(&aesCmacCtx, data, size);
+	AesCmac cmac(key);
+	cmac.update(blockB, sizeof(blockB));
+	cmac.update(data, size);
 	uint8_t mic[16];
-	AES_CMAC_Final(mic, &aesCmacCtx);
+	cmac.final(mic);
     return (uint32_t) ((uint32_t) mic[3] << 24 | (uint32_t)mic[2] << 16 | (uint32_t)mic[1] << 8 | (uint32_t)mic[0] );
 }
 
@@ -83,6 +75,26 @@ uint32_t calculateMICFrmPayload(
 	const DEVADDR &devAddr,
 	const KEY128 &key
 )
+{
+	AesKey aesKey(key);
+	return calculateMICRev103(
+		data,
+		size,
+		frameCounter,
+		direction,
+		devAddr,
+		aesKey
+	);
+}
+
+uint32_t calculateMICFrmPayload(
+	const unsigned char *data,
+	unsigned char size,
+	unsigned int frameCounter,
+	unsigned char direction,
+	const DEVADDR &devAddr,
+	const AesKey &key
+)
 {
 	return calculateMICRev103(
 		data,
@@ -103,16 +115,11 @@ uint32_t calculateMICReJoinRequest(
     const KEY128 &key,
     uint8_t rejoinType
 ) {
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', KSCH_SIZE);
-    aes_set_key(key.c, sizeof(KEY128), &aesContext);
-
-    AES_CMAC_CTX aesCmacCtx;
-    AES_CMAC_Init(&aesCmacCtx);
-    AES_CMAC_SetKey(&aesCmacCtx, key.c);
-    AES_CMAC_Update(&aesCmacCtx, (const uint8_t *) header, 1 + sizeof(JOIN_REQUEST_FRAME));
+    AesKey aesKey(key);
+    AesCmac cmac(aesKey);
+    cmac.update((const uint8_t *) header, 1 + sizeof(JOIN_REQUEST_FRAME));
     uint8_t mic[16];
-    AES_CMAC_Final(mic, &aesCmacCtx);
+    cmac.final(mic);
     return (uint32_t) ((uint32_t)mic[3] << 24 | (uint32_t)mic[2] << 16 | (uint32_t)mic[1] << 8 | (uint32_t)mic[0] );
 }
 
@@ -134,16 +141,11 @@ uint32_t calculateMICJoinResponse(
     const JOIN_ACCEPT_FRAME &frame,
     const KEY128 &key
 ) {
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', KSCH_SIZE);
-    aes_set_key(key.c, sizeof(KEY128), &aesContext);
-
-    AES_CMAC_CTX aesCmacCtx;
-    AES_CMAC_Init(&aesCmacCtx);
-    AES_CMAC_SetKey(&aesCmacCtx, key.c);
-    AES_CMAC_Update(&aesCmacCtx, (const uint8_t *) &frame, 1 + sizeof(JOIN_ACCEPT_FRAME_HEADER));
+    AesKey aesKey(key);
+    AesCmac cmac(aesKey);
+    cmac.update((const uint8_t *) &frame, 1 + sizeof(JOIN_ACCEPT_FRAME_HEADER));
     uint8_t mic[16];
-    AES_CMAC_Final(mic, &aesCmacCtx);
+    cmac.final(mic);
     return (uint32_t) ((uint32_t)mic[3] << 24 | (uint32_t)mic[2] << 16 | (uint32_t)mic[1] << 8 | (uint32_t)mic[0] );
 }
 
@@ -176,15 +178,10 @@ uint32_t calculateOptNegMICJoinResponse(
     // same as OptNeg unset (version 1.0)
     memmove(&(d[10]), &frame.hdr.joinNonce, 1 + sizeof(JOIN_ACCEPT_FRAME_HEADER));
 
-    aes_context aesContext;
-    memset(aesContext.ksch, '\0', KSCH_SIZE);
-    aes_set_key(key.c, sizeof(KEY128), &aesContext);
-
-    AES_CMAC_CTX aesCmacCtx;
-    AES_CMAC_Init(&aesCmacCtx);
-    AES_CMAC_SetKey(&aesCmacCtx, key.c);
-    AES_CMAC_Update(&aesCmacCtx, (const uint8_t *) &d, 1 + sizeof(d));
+    AesKey aesKey(key);
+    AesCmac cmac(aesKey);
+    cmac.update((const uint8_t *) &d, 1 + sizeof(d));
     uint8_t mic[16];
-    AES_CMAC_Final(mic, &aesCmacCtx);
+    cmac.final(mic);
     return (uint32_t) ((uint32_t)mic[3] << 24 | (uint32_t)mic[2] << 16 | (uint32_t)mic[1] << 8 | (uint32_t)mic[0] );
 }
@@ -3,6 +3,8 @@
 
 #include "lorawan/lorawan-types.h"
 
+class AesKey;
+
 /**
  * Calculate MAC Frame Payload Encryption message integrity code
  * @see 4.3.3 MAC Frame Payload Encryption (FRMPayload)
@@ -39,6 +41,18 @@ uint32_t calculateMICFrmPayload(
 	const KEY128 &key
 );
 
+/**
+ * Same as calculateMICFrmPayload() with already expanded network session key
+ */
+uint32_t calculateMICFrmPayload(
+	const unsigned char *data,
+	unsigned char size,
+	unsigned int frameCounter,
+	unsigned char direction,
+	const DEVADDR &devAddr,
+	const AesKey &key
+);
+
 /**
  * Calculate ReJoin Request MIC
  * @see 6.2.5 Join-request frame
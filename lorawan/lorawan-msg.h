@@ -246,6 +246,13 @@
 #define ERR_LORA_GATEWAY_SPECTRAL_SCAN_RESULT           "Spectral scan request results failed"
 #define ERR_STOPPED                                     "Stopped"
 #define ERR_ACCESS_DENIED                               "Access denied"
+#define ERR_IO_URING_INIT                               "io_uring initialization failed, kernel 6.0 or newer required"
+#define ERR_REPLICA_SNAPSHOT                            "Replica is too far behind the primary, snapshot required"
+#define ERR_THROTTLED                                   "Request rate limit exceeded, throttled"
+#define ERR_REQUEST_TRUNCATED                           "Request is larger than the receive buffer, truncated"
+#define ERR_NO_CHANGE_FEED                              "Change feed is not available, run with --journal over the libuv TCP listener"
+#define ERR_REPLICA_TCP                                 "Replica requires TCP listener, build with libuv or run with --io-uring"
+#define ERR_WORKERS_LIBUV                               "Background workers require libuv listener, build with libuv and run without --io-uring"
 
 // Message en-us locale strings
 #define MSG_COLON_N_SPACE               ": "
@@ -299,6 +306,7 @@
 #define MSG_SEND_JOIN_REQUEST_REPLY     "Sent join request response "
 #define MSG_GATEWAY_LIST                "Gateways: "
 #define MSG_INIT_UDP_LISTENER           "Initialize UDP listener.."
+#define MSG_IO_URING_FALLBACK           "io_uring is not available, fall back to the default listener"
 #define MSG_LISTEN_IP_ADDRESSES         "Listen IP addresses: "
 #define MSG_TO_REQUEST                   "to request "
 #define MSG_JOIN_REQUEST			    "Join request"
@@ -382,6 +390,8 @@
 #define MSG_LMDB_INCREASE_MAP_SIZE      "map full, increase map size"
 #define MSG_CHECK_SYSLOG 	            "Check syslog."
 #define MSG_QUERY                       "Query"
+#define MSG_WORKERS_SERIALIZED          "Storage is not thread safe, queries are serialized, one background worker is started"
+#define MSG_COALESCE_SERIALIZED         "Storage is not thread safe, lookups never overlap, --coalesce is ignored"
 
 const char *strerror_lorawan_ns(int errcode);
 
@@ -0,0 +1,287 @@
+#include <cstring>
+
+#include "lorawan/lorawan-packet-batch.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/helper/aes-helper.h"
+#include "lorawan/helper/aes-key-cache.h"
+
+#include "lorawan-conv.h"
+
+// B0 block and MHDR..FRMPayload
+#define MIC_MESSAGE_SIZE    (AES_BLOCK_SIZE + 256)
+
+static bool isDataFrame(
+    const LORAWAN_MESSAGE_STORAGE *m
+)
+{
+    switch ((MTYPE) m->mhdr.f.mtype) {
+        case MTYPE_UNCONFIRMED_DATA_UP:
+        case MTYPE_CONFIRMED_DATA_UP:
+        case MTYPE_UNCONFIRMED_DATA_DOWN:
+        case MTYPE_CONFIRMED_DATA_DOWN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * B0 | msg as calculateMICFrmPayload() authenticates it
+ * @return size
+ */
+static size_t micMessage(
+    uint8_t *retVal,
+    const LORAWAN_MESSAGE_STORAGE *m
+)
+{
+    auto size = (unsigned char) (m->payloadSize ? m->payloadSize + 9 : 8);
+    unsigned int frameCounter = m->data.uplink.fcnt;
+    retVal[0] = 0x49;
+    retVal[1] = 0;
+    retVal[2] = 0;
+    retVal[3] = 0;
+    retVal[4] = 0;
+    retVal[5] = m->mhdr.f.mtype & 1;
+    memmove(retVal + 6, m->data.uplink.devaddr.c, 4);
+    retVal[10] = (frameCounter & 0x00FF);
+    retVal[11] = ((frameCounter >> 8) & 0x00FF);
+    retVal[12] = 0;
+    retVal[13] = 0;
+    retVal[14] = 0;
+    retVal[15] = size;
+    memmove(retVal + AES_BLOCK_SIZE, &m->mhdr.i, size);
+    return AES_BLOCK_SIZE + size;
+}
+
+static size_t decodeWindow(
+    PacketBatchItem *items,
+    size_t count
+)
+{
+    uint8_t buf[PACKET_BATCH_WINDOW][MIC_MESSAGE_SIZE];
+    AesKey nwkSKeys[PACKET_BATCH_WINDOW];
+    AesKey appSKeys[PACKET_BATCH_WINDOW];
+    AesCmacJob macs[PACKET_BATCH_WINDOW];
+    size_t macItems[PACKET_BATCH_WINDOW];
+    PayloadCryptJob crypts[PACKET_BATCH_WINDOW];
+    size_t macCount = 0;
+    size_t cryptCount = 0;
+    size_t r = 0;
+    AesKeyCache &cache = aesKeyCache();
+
+    for (size_t i = 0; i < count; i++) {
+        PacketBatchItem &item = items[i];
+        item.micMatched = false;
+        item.decoded = false;
+        if (!item.message || !item.identity)
+            continue;
+        if (!isDataFrame(item.message)) {
+            // join frames are rare, go the usual way
+            item.micMatched = item.message->matchMic(item.identity->nwkSKey);
+            if (item.micMatched) {
+                item.decoded = item.message->decode(item.identity);
+                r++;
+            }
+            continue;
+        }
+        cache.get(nwkSKeys[macCount], item.message->data.uplink.devaddr, AES_KEY_NWKSKEY, item.identity->nwkSKey);
+        AesCmacJob &job = macs[macCount];
+        job.key = &nwkSKeys[macCount];
+        job.data = buf[macCount];
+        job.size = micMessage(buf[macCount], item.message);
+        macItems[macCount] = i;
+        macCount++;
+    }
+    aesCmacBatch(macs, macCount);
+
+    for (size_t j = 0; j < macCount; j++) {
+        PacketBatchItem &item = items[macItems[j]];
+        LORAWAN_MESSAGE_STORAGE *m = item.message;
+        const uint8_t *mac = macs[j].mac;
+        auto mic = (uint32_t) ((uint32_t) mac[3] << 24 | (uint32_t) mac[2] << 16 | (uint32_t) mac[1] << 8 | (uint32_t) mac[0]);
+        if (m->mic() != mic)
+            continue;
+        item.micMatched = true;
+        r++;
+        // reapply network to host byte order as decode() does
+        applyHostByteOrder(&m->mhdr, sizeof(LORAWAN_MESSAGE_STORAGE));
+        if (m->payloadSize <= 0)
+            continue;
+        cache.get(appSKeys[cryptCount], item.identity->devaddr, AES_KEY_APPSKEY, item.identity->appSKey);
+        PayloadCryptJob &job = crypts[cryptCount];
+        bool up = (m->mhdr.f.mtype & 1) == 0;
+        job.payload = (void *) (up ? m->data.uplink.payload() : m->data.downlink.payload());
+        job.size = m->payloadSize;
+        job.frameCounter = m->data.uplink.fcnt;
+        job.direction = up ? LORAWAN_UPLINK : LORAWAN_DOWNLINK;
+        job.devAddr = item.identity->devaddr;
+        job.appSKey = &appSKeys[cryptCount];
+        cryptCount++;
+        item.decoded = true;
+    }
+    encryptPayloadBatch(crypts, cryptCount);
+    return r;
+}
+
+size_t decodePacketBatch(
+    PacketBatchItem *items,
+    size_t count
+)
+{
+    size_t r = 0;
+    for (size_t i = 0; i < count; i += PACKET_BATCH_WINDOW) {
+        size_t c = count - i < PACKET_BATCH_WINDOW ? count - i : PACKET_BATCH_WINDOW;
+        r += decodeWindow(items + i, c);
+    }
+    return r;
+}
+
+int matchMicCandidate(
+    const LORAWAN_MESSAGE_STORAGE &message,
+    const DEVICEID *candidates,
+    size_t count
+)
+{
+    if (!isDataFrame(&message))
+        return -1;
+    uint8_t buf[MIC_MESSAGE_SIZE];
+    size_t size = micMessage(buf, &message);
+    uint32_t received = message.mic();
+    // keys of devices sharing the address are not cached, they would replace each other
+    AesKey keys[PACKET_BATCH_WINDOW];
+    AesCmacJob jobs[PACKET_BATCH_WINDOW];
+    for (size_t i = 0; i < count; i += PACKET_BATCH_WINDOW) {
+        size_t c = count - i < PACKET_BATCH_WINDOW ? count - i : PACKET_BATCH_WINDOW;
+        for (size_t j = 0; j < c; j++) {
+            keys[j].set(candidates[i + j].id.nwkSKey.c);
+            jobs[j].key = &keys[j];
+            jobs[j].data = buf;
+            jobs[j].size = size;
+        }
+        aesCmacBatch(jobs, c);
+        for (size_t j = 0; j < c; j++) {
+            const uint8_t *mac = jobs[j].mac;
+            auto mic = (uint32_t) ((uint32_t) mac[3] << 24 | (uint32_t) mac[2] << 16 | (uint32_t) mac[1] << 8 | (uint32_t) mac[0]);
+            if (mic == received)
+                return (int) (i + j);
+        }
+    }
+    return -1;
+}
+
+int resolveIdentity(
+    NetworkIdentity &retVal,
+    IdentityService &service,
+    const LORAWAN_MESSAGE_STORAGE &message
+)
+{
+    if (!isDataFrame(&message))
+        return ERR_CODE_INVALID_PACKET;
+    const DEVADDR *addr = message.getAddr();
+    std::vector<DEVICEID> candidates;
+    int r = service.getCandidates(candidates, *addr);
+    if (r != CODE_OK)
+        return r;
+    int idx = matchMicCandidate(message, candidates.data(), candidates.size());
+    if (idx < 0)
+        return ERR_CODE_INVALID_MIC;
+    retVal.set(*addr, candidates[idx]);
+    return CODE_OK;
+}
+
+PacketBatchDecoder::PacketBatchDecoder(
+    size_t aThreadCount,
+    size_t aFramesPerThread
+)
+    : stopped(true), generation(0), pending(0), items(nullptr), count(0), next(0), matched(0),
+    threadCount(aThreadCount ? aThreadCount : std::thread::hardware_concurrency()),
+    framesPerThread(aFramesPerThread ? aFramesPerThread : DEF_BATCH_FRAMES_PER_THREAD)
+{
+    if (threadCount == 0)
+        threadCount = 1;
+}
+
+PacketBatchDecoder::~PacketBatchDecoder()
+{
+    stop();
+}
+
+void PacketBatchDecoder::runChunks()
+{
+    size_t r = 0;
+    while (true) {
+        size_t start = next.fetch_add(framesPerThread);
+        if (start >= count)
+            break;
+        size_t c = count - start < framesPerThread ? count - start : framesPerThread;
+        r += decodePacketBatch(items + start, c);
+    }
+    matched += r;
+}
+
+void PacketBatchDecoder::work()
+{
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            started.wait(guard, [this, seen] { return stopped || generation != seen; });
+            if (stopped)
+                return;
+            seen = generation;
+        }
+        runChunks();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending--;
+        }
+        finished.notify_one();
+    }
+}
+
+size_t PacketBatchDecoder::decode(
+    PacketBatchItem *aItems,
+    size_t aCount
+)
+{
+    if (threadCount <= 1 || aCount <= framesPerThread)
+        return decodePacketBatch(aItems, aCount);
+    std::lock_guard<std::mutex> call(callLock);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopped) {
+            stopped = false;
+            for (size_t i = 1; i < threadCount; i++) {
+                workers.emplace_back(&PacketBatchDecoder::work, this);
+            }
+        }
+        items = aItems;
+        count = aCount;
+        next = 0;
+        matched = 0;
+        pending = workers.size();
+        generation++;
+    }
+    started.notify_all();
+    runChunks();
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [this] { return pending == 0; });
+    return matched;
+}
+
+void PacketBatchDecoder::stop()
+{
+    std::lock_guard<std::mutex> call(callLock);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopped)
+            return;
+        stopped = true;
+    }
+    started.notify_all();
+    for (auto &w : workers) {
+        if (w.joinable())
+            w.join();
+    }
+    workers.clear();
+}
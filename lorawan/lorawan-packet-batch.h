@@ -0,0 +1,116 @@
+#ifndef LORAWAN_PACKET_BATCH_H_
+#define LORAWAN_PACKET_BATCH_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "lorawan/lorawan-packet-storage.h"
+#include "lorawan/storage/service/identity-service.h"
+
+// frames of a batch verified side by side
+#define PACKET_BATCH_WINDOW             16
+// smaller batches are decoded in the caller thread
+#define DEF_BATCH_FRAMES_PER_THREAD     256
+
+/**
+ * Received frame with the identity resolved by its address
+ */
+class PacketBatchItem {
+public:
+    LORAWAN_MESSAGE_STORAGE *message;
+    const NetworkIdentity *identity;    ///< nullptr- unknown device, frame is skipped
+    bool micMatched;                    ///< result
+    bool decoded;                       ///< result, payload is decrypted
+};
+
+/**
+ * Verify MIC and decrypt payload of each frame, same as
+ *  if (message->matchMic(identity->nwkSKey)) decoded = message->decode(identity);
+ * AES chains of PACKET_BATCH_WINDOW frames run side by side. Frame with wrong MIC is left untouched.
+ * @param items frames
+ * @param count frames count
+ * @return count of frames with matched MIC
+ */
+size_t decodePacketBatch(
+    PacketBatchItem *items,
+    size_t count
+);
+
+/**
+ * Pick the device whose NwkSKey validates MIC of the data frame.
+ * MICs of PACKET_BATCH_WINDOW candidates are computed side by side.
+ * @param message received data frame, not decoded yet
+ * @param candidates devices sharing the frame address
+ * @param count candidates count
+ * @return index of the candidate, -1 if none matches or frame is not a data frame
+ */
+int matchMicCandidate(
+    const LORAWAN_MESSAGE_STORAGE &message,
+    const DEVICEID *candidates,
+    size_t count
+);
+
+/**
+ * Resolve identity of the received data frame by its address.
+ * If several devices share the address (IDENTITY_OPTION_MULTI_CANDIDATE) one is picked by MIC.
+ * @param retVal identity of the device
+ * @param service identity service
+ * @param message received data frame, not decoded yet
+ * @return CODE_OK- success, ERR_CODE_INVALID_MIC- no device matches, or getCandidates() error
+ */
+int resolveIdentity(
+    NetworkIdentity &retVal,
+    IdentityService &service,
+    const LORAWAN_MESSAGE_STORAGE &message
+);
+
+/**
+ * Splits large batch across worker threads, small batch is decoded in the caller thread.
+ * Workers are started by the first large batch and wait for the next one.
+ * One batch at a time, concurrent decode() calls wait.
+ */
+class PacketBatchDecoder {
+private:
+    std::mutex callLock;
+    std::mutex lock;
+    std::condition_variable started;
+    std::condition_variable finished;
+    std::vector<std::thread> workers;
+    bool stopped;
+    uint64_t generation;
+    size_t pending;             ///< workers running the current batch
+    PacketBatchItem *items;
+    size_t count;
+    std::atomic<size_t> next;
+    std::atomic<size_t> matched;
+
+    void work();
+    void runChunks();
+public:
+    size_t threadCount;         ///< including the caller thread
+    size_t framesPerThread;
+
+    explicit PacketBatchDecoder(
+        size_t threadCount = 0,     ///< 0- hardware concurrency
+        size_t framesPerThread = DEF_BATCH_FRAMES_PER_THREAD
+    );
+    virtual ~PacketBatchDecoder();
+    /**
+     * @see decodePacketBatch()
+     * @return count of frames with matched MIC
+     */
+    size_t decode(
+        PacketBatchItem *items,
+        size_t count
+    );
+    /**
+     * Join workers
+     */
+    void stop();
+};
+
+#endif
@@ -5,8 +5,9 @@
 #include "lorawan/lorawan-packet-storage.h"
 #include "lorawan/lorawan-string.h"
 #include "lorawan/helper/aes-helper.h"
+#include "lorawan/helper/aes-key-cache.h"
+#include "lorawan/helper/codec-helper.h"
 
-#include "base64/base64.h"
 #include "lorawan-conv.h"
 #include "lorawan-mic.h"
 
@@ -60,7 +61,7 @@ bool base64SetToLORAWAN_MESSAGE_STORAGE(
 )
 {
     try {
-        std::string s = base64_decode(base64string);
+        std::string s = base64Decode(base64string.c_str(), base64string.size());
         setLORAWAN_MESSAGE_STORAGE(retVal, (void *) s.c_str(), s.size());
     } catch (std::runtime_error &) {
         return false;
@@ -251,14 +252,22 @@ bool LORAWAN_MESSAGE_STORAGE::decode(
                 break;
             case MTYPE_UNCONFIRMED_DATA_UP:
             case MTYPE_CONFIRMED_DATA_UP:
+            {
+                AesKey key;
+                aesKeyCache().get(key, devAddr, AES_KEY_APPSKEY, appSKey);
                 decryptPayload((void *) data.uplink.payload(), payloadSize,
-                    data.uplink.fcnt, LORAWAN_UPLINK, devAddr, appSKey);
+                    data.uplink.fcnt, LORAWAN_UPLINK, devAddr, key);
                 return true;
+            }
             case MTYPE_UNCONFIRMED_DATA_DOWN:
             case MTYPE_CONFIRMED_DATA_DOWN:
+            {
+                AesKey key;
+                aesKeyCache().get(key, devAddr, AES_KEY_APPSKEY, appSKey);
                 decryptPayload((void *) data.downlink.payload(), payloadSize,
-                    data.uplink.fcnt, LORAWAN_DOWNLINK, devAddr, appSKey);
+                    data.uplink.fcnt, LORAWAN_DOWNLINK, devAddr, key);
                 return true;
+            }
             default:
                 // case MTYPE_PROPRIETARYRADIO:
                 break;
@@ -386,7 +395,21 @@ uint32_t LORAWAN_MESSAGE_STORAGE::mic(
 bool LORAWAN_MESSAGE_STORAGE::matchMic(
     const KEY128 &key
 ) const {
-    return mic() == mic(key);
+    switch ((MTYPE) mhdr.f.mtype) {
+        case MTYPE_UNCONFIRMED_DATA_UP:
+        case MTYPE_CONFIRMED_DATA_UP:
+        case MTYPE_UNCONFIRMED_DATA_DOWN:
+        case MTYPE_CONFIRMED_DATA_DOWN:
+        {
+            AesKey aesKey;
+            aesKeyCache().get(aesKey, data.uplink.devaddr, AES_KEY_NWKSKEY, key);
+            return mic() == calculateMICFrmPayload(&mhdr.i, payloadSize ? payloadSize + 9 : 8, data.uplink.fcnt,
+                mhdr.f.mtype & 1, data.uplink.devaddr, aesKey);
+        }
+        default:
+            break;
+    }
+    return mic() == 0;
 }
 
 /**
@@ -429,10 +452,10 @@ std::string LORAWAN_MESSAGE_STORAGE::payloadBase64() const
     switch ((MTYPE) mhdr.f.mtype) {
         case MTYPE_UNCONFIRMED_DATA_UP:
         case MTYPE_CONFIRMED_DATA_UP:
-            return base64_encode(std::string((char *) data.uplink.payload(), payloadSize));
+            return base64Encode(data.uplink.payload(), payloadSize);
         case MTYPE_UNCONFIRMED_DATA_DOWN:
         case MTYPE_CONFIRMED_DATA_DOWN:
-            return base64_encode(std::string((char *) data.downlink.payload(), payloadSize));
+            return base64Encode(data.downlink.payload(), payloadSize);
         default:
             break;
     }
@@ -9,6 +9,7 @@
 #include "lorawan/lorawan-string.h"
 #include "lorawan/lorawan-date.h"
 #include "lorawan/lorawan-mac.h"
+#include "lorawan/helper/codec-helper.h"
 #ifdef ENABLE_UNICODE
 #include <unicode/unistr.h>
 #endif
@@ -98,48 +99,16 @@ bool isDec(
     ) == value.end();
 }
 
-// http://stackoverflow.com/questions/673240/how-do-i-print-an-unsigned-char-as-hex-in-c-using-ostream
-struct HexCharStruct
-{
-    unsigned char c;
-    explicit HexCharStruct(unsigned char _c) : c(_c) { }
-};
-
-inline std::ostream& operator<<(std::ostream& o, const HexCharStruct& hs)
-{
-    return (o << std::setfill('0') << std::setw(2) << std::hex << (int) hs.c);
-}
-
-inline HexCharStruct hex(
-        unsigned char c
-)
-{
-    return HexCharStruct(c);
-}
-
-static void bufferPrintHex(
-        std::ostream &ostream,
-        const void* value, size_t size
-)
-{
-    if (!value)
-        return;
-    auto *p = (unsigned char*) value;
-    for (size_t i = 0; i < size; i++)
-    {
-        ostream << hex(*p);
-        p++;
-    }
-}
-
 std::string hexString(
     const void *buffer,
     size_t size
 )
 {
-    std::stringstream r;
-    bufferPrintHex(r, buffer, size);
-    return r.str();
+    if (!buffer)
+        return "";
+    std::string r(size * 2, '\0');
+    hexEncode(&r[0], buffer, size);
+    return r;
 }
 
 /**
@@ -154,28 +123,13 @@ std::string hexString(
     return hexString((void *) data.c_str(), data.size());
 }
 
-static std::string readHex(
-    std::istream &s
-)
-{
-    std::stringstream r;
-    s >> std::noskipws;
-    char c[3] = {0, 0, 0};
-    while (s >> c[0]) {
-        if (!(s >> c[1]))
-            break;
-        auto x = (unsigned char) strtol(c, nullptr, 16);
-        r << x;
-    }
-    return r.str();
-}
-
 std::string hex2string(
     const std::string &hex
 )
 {
-    std::stringstream ss(hex);
-    return readHex(ss);
+    std::string r(hex.size() / 2, '\0');
+    hexDecode(&r[0], hex.c_str(), hex.size());
+    return r;
 }
 
 std::string toUpperCase(
@@ -806,12 +760,63 @@ DEVICECLASS string2deviceclass(
             return CLASS_C;
 }
 
+static bool isHexDigits(
+    const char *value,
+    size_t len
+)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (!std::isxdigit((unsigned char) value[i]))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Decode exactly sizeof(uint32_t) * 2 hex digits MSB first
+ * @return false if value has other length or not hex digits, use strtoul() then
+ */
+static bool hex2DEVADDR(
+    DEVADDR &retVal,
+    const char *value,
+    size_t len
+)
+{
+    if (len != sizeof(uint32_t) * 2 || !isHexDigits(value, len))
+        return false;
+    uint32_t v;
+    hexDecode(&v, value, len);
+    // hex string is MSB first, swap if need it
+    retVal.u = NTOH4(v);
+    return true;
+}
+
+/**
+ * Decode exactly sizeof(uint64_t) * 2 hex digits MSB first
+ * @return false if value has other length or not hex digits, use strtoull() then
+ */
+static bool hex2DEVEUI(
+    DEVEUI &retVal,
+    const char *value,
+    size_t len
+)
+{
+    if (len != sizeof(uint64_t) * 2 || !isHexDigits(value, len))
+        return false;
+    uint64_t v;
+    hexDecode(&v, value, len);
+    // hex string is MSB first, swap if need it
+    retVal.u = NTOH8(v);
+    return true;
+}
+
 void string2DEVADDR(
     DEVADDR &retVal,
     const char *value
 )
 {
-    retVal.u = strtoul(value, nullptr, 16);
+    if (!hex2DEVADDR(retVal, value, strlen(value)))
+        retVal.u = strtoul(value, nullptr, 16);
 }
 
 void string2DEVADDR(
@@ -819,7 +824,8 @@ void string2DEVADDR(
     const std::string &value
 )
 {
-    retVal.u = strtoul(value.c_str(), nullptr, 16);
+    if (!hex2DEVADDR(retVal, value.c_str(), value.size()))
+        retVal.u = strtoul(value.c_str(), nullptr, 16);
 }
 
 void string2DEVEUI(
@@ -827,7 +833,8 @@ void string2DEVEUI(
     const std::string &value
 )
 {
-    retval.u = strtoull(value.c_str(), nullptr, 16);
+    if (!hex2DEVEUI(retval, value.c_str(), value.size()))
+        retval.u = strtoull(value.c_str(), nullptr, 16);
 }
 
 void string2DEVEUI(
@@ -837,7 +844,8 @@ void string2DEVEUI(
 {
     if (!value)
         return;
-    retval.u = strtoull(value, nullptr, 16);
+    if (!hex2DEVEUI(retval, value, strlen(value)))
+        retval.u = strtoull(value, nullptr, 16);
 }
 
 void string2KEY(
@@ -847,20 +855,8 @@ void string2KEY(
 {
     if (!str)
         return;
-    char c[3] = {0, 0, 0};
-    int i = 0;
-    while (*str) {
-        c[0] = *str;
-        str++;
-        if (!*str)
-            break;
-        c[1] = *str;
-        retVal.c[i] = (unsigned char) strtol(c, nullptr, 16);
-        i++;
-        if (i > 15)
-            break;
-        str++;
-    }
+    size_t len = strnlen(str, sizeof(KEY128) * 2);
+    hexDecode(&retVal.c, str, len);
 }
 
 void string2KEY(
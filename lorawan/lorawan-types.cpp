@@ -4,6 +4,7 @@
 #include "lorawan-string.h"
 #include "lorawan-conv.h"
 #include "lorawan-error.h"
+#include "lorawan/helper/json-writer.h"
 
 const char *LIST_SEPARATOR = ",";
 
@@ -1645,26 +1646,41 @@ std::string DEVICEID::toJsonString(
     const DEVADDR &addr
 ) const
 {
-    std::stringstream ss;
-    ss << "{";
-    if (!addr.empty())
-        ss << R"("addr":")" << DEVADDR2string(addr) << "\",";
-    ss << R"("activation":")" << activation2string(id.activation)
-       << R"(","class":")" << deviceclass2string(id.deviceclass)
-       << R"(","deveui":")" << DEVEUI2string(id.devEUI)
-       << R"(","nwkSKey":")" << KEY2string(id.nwkSKey)
-       << R"(","appSKey":")" << KEY2string(id.appSKey)
-       << R"(","version":")" << LORAWAN_VERSION2string(id.version)
-
-       << R"(","appeui":")" << DEVEUI2string(id.appEUI)
-       << R"(","appKey":")" << KEY2string(id.appKey)
-       << R"(","nwkKey":")" << KEY2string(id.nwkKey)
-       << R"(","devNonce":")" << DEVNONCE2string(id.devNonce)
-       << R"(","joinNonce":")" << JOINNONCE2string(id.joinNonce)
-
-       << R"(","name":")" << id.name.toString()
-       << "\"}";
-    return ss.str();
+    std::string r;
+    JsonWriter writer(r);
+    toJson(writer, addr);
+    return r;
+}
+
+void DEVICEID::toJson(
+    JsonWriter &writer,
+    const DEVADDR &addr
+) const
+{
+    // hex strings are MSB first
+    writer.raw('{');
+    if (!addr.empty()) {
+        uint32_t a = SWAP_BYTES_4(addr.u);
+        writer.raw(R"("addr":")").hex(&a, sizeof(a)).raw("\",");
+    }
+    uint64_t devEUI = SWAP_BYTES_8(id.devEUI.u);
+    uint64_t appEUI = SWAP_BYTES_8(id.appEUI.u);
+    writer.raw(R"("activation":")").raw(id.activation == OTAA ? "OTAA" : "ABP")
+        .raw(R"(","class":")").raw(id.deviceclass == CLASS_A ? 'A' : (id.deviceclass == CLASS_B ? 'B' : 'C'))
+        .raw(R"(","deveui":")").hex(&devEUI, sizeof(devEUI))
+        .raw(R"(","nwkSKey":")").hex(&id.nwkSKey, sizeof(KEY128))
+        .raw(R"(","appSKey":")").hex(&id.appSKey, sizeof(KEY128))
+        .raw(R"(","version":")").dec((uint64_t) id.version.major).raw('.')
+            .dec((uint64_t) id.version.minor).raw('.').dec((uint64_t) id.version.release)
+
+        .raw(R"(","appeui":")").hex(&appEUI, sizeof(appEUI))
+        .raw(R"(","appKey":")").hex(&id.appKey, sizeof(KEY128))
+        .raw(R"(","nwkKey":")").hex(&id.nwkKey, sizeof(KEY128))
+        .raw(R"(","devNonce":")").hex(&id.devNonce, sizeof(DEVNONCE))
+        .raw(R"(","joinNonce":")").hex(&id.joinNonce, sizeof(JOINNONCE))
+
+        .raw(R"(","name":")").str(id.name.c, strnlen(id.name.c, sizeof(DEVICENAME::c)))
+        .raw("\"}");
 }
 
 void DEVICEID::toArray(
@@ -1814,6 +1830,13 @@ std::string NETWORKIDENTITY::toJsonString() const
 	return value.devid.toJsonString(value.devaddr);
 }
 
+void NETWORKIDENTITY::toJson(
+    JsonWriter &writer
+) const
+{
+    value.devid.toJson(writer, value.devaddr);
+}
+
 bool JOIN_REQUEST_FRAME::operator==(const JOIN_REQUEST_FRAME &rhs) const
 {
     return rhs.joinEUI.u == joinEUI.u && rhs.devEUI.u == devEUI.u;
@@ -625,6 +625,7 @@ typedef PACK( struct {
 } ) NETWORK_IDENTITY_FILTERS;   // 21, 41, .. 5101
 
 class NETWORKIDENTITY;
+class JsonWriter;
 
 typedef PACK( struct {
     // value, no key
@@ -710,6 +711,10 @@ public:
     std::string toString(const DEVADDR &addr) const;
 	std::string toJsonString() const;
     std::string toJsonString(const DEVADDR &addr) const;
+    /**
+     * Append JSON object, "addr" is written if address is not empty
+     */
+    void toJson(JsonWriter &writer, const DEVADDR &addr) const;
     void toArray(void *buffer, size_t size) const;
     void fromArray(const void *buffer, size_t size);
 	void setProperties(std::map<std::string, std::string> &retval) const;
@@ -736,6 +741,7 @@ public:
 	void set(const DEVADDR &addr, const DEVICEID &value);
 	std::string toString() const;
     std::string toJsonString() const;
+    void toJson(JsonWriter &writer) const;
 };  // 100 bytes
 
 #define SIZE_NETWORKIDENTITY 100
@@ -0,0 +1,33 @@
+#ifndef ASYNC_QUERY_CLIENT_H_
+#define ASYNC_QUERY_CLIENT_H_	1
+
+#include "lorawan/storage/client/query-client.h"
+
+/**
+ * Client driven by the caller: request() queues the request, process() does network I/O.
+ * Replies are matched by the request identifier.
+ * Failed request is reported by onError() with the request identifier in errorCode.
+ */
+class AsyncQueryClient : public QueryClient {
+public:
+    explicit AsyncQueryClient(
+        ResponseClient *aOnResponse
+    )
+        : QueryClient(aOnResponse)
+    {
+    }
+    /**
+     * Send queued requests, wait for replies up to timeout
+     * @param timeoutMillis max wait time
+     * @return count of pending requests, <0- error code
+     */
+    virtual int process(
+        int timeoutMillis
+    ) = 0;
+    /**
+     * @return count of requests waiting for the reply
+     */
+    virtual size_t pending() const = 0;
+};
+
+#endif
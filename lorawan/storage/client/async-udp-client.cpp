@@ -0,0 +1,262 @@
+#include "async-udp-client.h"
+
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <WS2tcpip.h>
+
+#define close closesocket
+#define poll WSAPoll
+#define SOCKET_ERRNO WSAGetLastError()
+#else
+#define INVALID_SOCKET  (-1)
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#define SOCKET_ERRNO errno
+#endif
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+
+// max UDP payload
+#define RECEIVE_BUFFER_SIZE 65536
+// batch frame with one request: filter request with MAX_IDENTITY_FILTERS filters is the longest one
+#define SEND_FRAME_SIZE     MAX_BATCH_FRAME_SIZE
+
+AsyncUDPClient::AsyncUDPClient(
+    const std::string &aHost,
+    uint16_t aPort,
+    ResponseClient *aOnResponse,
+    size_t aWindow
+)
+    : AsyncQueryClient(aOnResponse), sock(INVALID_SOCKET), addr{}, addrLen(0), nextRequestId(1), status(CODE_OK),
+    window(aWindow ? aWindow : 1), retransmitMillis(DEF_UDP_RETRANSMIT_MILLIS), maxRetries(DEF_UDP_MAX_RETRIES),
+    sent(0), retransmits(0), duplicates(0), timeouts(0)
+{
+    struct addrinfo hints {};
+    struct addrinfo *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    std::string port = std::to_string(aPort);
+    if (getaddrinfo(aHost.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        status = ERR_CODE_SOCKET_ADDRESS;
+        return;
+    }
+    memmove(&addr, res->ai_addr, res->ai_addrlen);
+    addrLen = (int) res->ai_addrlen;
+    freeaddrinfo(res);
+    status = openSocket();
+}
+
+AsyncUDPClient::~AsyncUDPClient()
+{
+    if (sock != INVALID_SOCKET) {
+        close(sock);
+        sock = INVALID_SOCKET;
+    }
+}
+
+int AsyncUDPClient::openSocket()
+{
+    sock = socket(addr.ss_family, SOCK_DGRAM, 0);
+    if (sock == INVALID_SOCKET)
+        return ERR_CODE_SOCKET_CREATE;
+    // kernel drops datagrams from other hosts
+    if (connect(sock, (const struct sockaddr *) &addr, addrLen) < 0) {
+        close(sock);
+        sock = INVALID_SOCKET;
+        return ERR_CODE_SOCKET_CONNECT;
+    }
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    u_long nonBlocking = 1;
+    ioctlsocket(sock, FIONBIO, &nonBlocking);
+#else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    return CODE_OK;
+}
+
+void AsyncUDPClient::stop()
+{
+    status = ERR_CODE_STOPPED;
+}
+
+size_t AsyncUDPClient::pending() const
+{
+    return queue.size() + inFlight.size();
+}
+
+ServiceMessage* AsyncUDPClient::request(
+    ServiceMessage* value
+)
+{
+    if (!value)
+        return nullptr;
+    if (!value->requestId) {
+        value->requestId = nextRequestId++;
+        if (!nextRequestId)
+            nextRequestId = 1;
+    }
+    unsigned char buf[SEND_FRAME_SIZE];
+    BatchWriter writer(buf, sizeof(buf));
+    value->ntoh();
+    writer.add(*value);
+    value->ntoh();  // restore host byte order
+    PendingRequest p;
+    p.requestId = value->requestId;
+    p.frame.assign((const char *) buf, writer.size());
+    p.retries = 0;
+    queue.push_back(p);
+    sendQueued();
+    return value;
+}
+
+int AsyncUDPClient::send(
+    PendingRequest &value
+)
+{
+    ssize_t r = ::send(sock, value.frame.c_str(), (int) value.frame.size(), 0);
+    sent++;
+    return r < 0 ? ERR_CODE_SOCKET_WRITE : CODE_OK;
+}
+
+/**
+ * Send queued requests while window is not full
+ */
+void AsyncUDPClient::sendQueued()
+{
+    if (sock == INVALID_SOCKET)
+        return;
+    auto now = std::chrono::steady_clock::now();
+    while (!queue.empty() && inFlight.size() < window) {
+        PendingRequest &p = inFlight[queue.front().requestId];
+        p = queue.front();
+        queue.pop_front();
+        p.deadline = now + std::chrono::milliseconds(retransmitMillis);
+        // transient send error (e.g. ENOBUFS, ECONNREFUSED of the connected socket) is handled as lost datagram
+        send(p);
+    }
+}
+
+void AsyncUDPClient::receive(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    if (!isBatchMessage(buf, sz)) {
+        // version 1 server does not return request identifier, it is unambiguous with one request in flight only
+        if (inFlight.size() != 1) {
+            duplicates++;
+            return;
+        }
+        uint32_t id = inFlight.begin()->first;
+        inFlight.erase(inFlight.begin());
+        dispatchResponse(buf, sz, id);
+        return;
+    }
+    std::vector<BatchItem> items;
+    parseBatch(items, buf, sz);
+    for (auto &item : items) {
+        auto it = inFlight.find(item.requestId);
+        if (it == inFlight.end()) {
+            // reply to retransmitted request is already received or request is timed out
+            duplicates++;
+            continue;
+        }
+        inFlight.erase(it);
+        if (item.size == 0) {
+            if (onResponse)
+                onResponse->onError(this, ERR_CODE_INVALID_PACKET, (int) item.requestId);
+            continue;
+        }
+        dispatchResponse(item.data, item.size, item.requestId);
+    }
+}
+
+/**
+ * Retransmit expired requests with exponential backoff, drop requests with exhausted retries
+ */
+void AsyncUDPClient::checkDeadlines()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::vector<uint32_t> expired;
+    for (auto &it : inFlight) {
+        PendingRequest &p = it.second;
+        if (p.deadline > now)
+            continue;
+        if (p.retries >= maxRetries) {
+            expired.push_back(p.requestId);
+            continue;
+        }
+        p.retries++;
+        p.deadline = now + std::chrono::milliseconds(((uint64_t) retransmitMillis) << p.retries);
+        retransmits++;
+        send(p);
+    }
+    for (auto id : expired) {
+        inFlight.erase(id);
+        timeouts++;
+        if (onResponse)
+            onResponse->onError(this, ERR_CODE_TIMEOUT, (int) id);
+    }
+}
+
+int AsyncUDPClient::process(
+    int timeoutMillis
+)
+{
+    if (sock == INVALID_SOCKET)
+        return status;
+    sendQueued();
+    if (inFlight.empty())
+        return (int) pending();
+    // wait until nearest deadline
+    auto now = std::chrono::steady_clock::now();
+    for (auto &it : inFlight) {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(it.second.deadline - now).count();
+        if (ms < 0)
+            ms = 0;
+        if (ms < timeoutMillis)
+            timeoutMillis = (int) ms;
+    }
+    struct pollfd fds {};
+    fds.fd = sock;
+    fds.events = POLLIN;
+    int r = poll(&fds, 1, timeoutMillis);
+    if (r < 0) {
+#if !(defined(_MSC_VER) || defined(__MINGW32__))
+        if (errno == EINTR)
+            return (int) pending();
+#endif
+        return ERR_CODE_SOCKET_READ;
+    }
+    if (r > 0) {
+        static thread_local unsigned char rxBuf[RECEIVE_BUFFER_SIZE];
+        while (true) {
+            ssize_t len = recv(sock, (char *) rxBuf, (int) sizeof(rxBuf), 0);
+            if (len <= 0)
+                break;  // EAGAIN, all datagrams are read
+            receive(rxBuf, (size_t) len);
+        }
+    }
+    checkDeadlines();
+    sendQueued();
+    return (int) pending();
+}
+
+void AsyncUDPClient::start()
+{
+    if (status == ERR_CODE_STOPPED)
+        status = CODE_OK;
+    while (status != ERR_CODE_STOPPED) {
+        if (process(1000) <= 0)
+            break;
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef ASYNC_UDP_CLIENT_H_
+#define ASYNC_UDP_CLIENT_H_	1
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <BaseTsd.h>
+#include <Winsock2.h>
+typedef SSIZE_T ssize_t;
+#else
+#include <netinet/in.h>
+typedef int SOCKET;
+#endif
+
+#include <string>
+#include <deque>
+#include <map>
+#include <chrono>
+
+#include "lorawan/storage/client/async-query-client.h"
+
+// requests sent but not answered yet
+#define DEF_UDP_WINDOW              64
+// first retransmit timeout, doubled on each retransmit
+#define DEF_UDP_RETRANSMIT_MILLIS   200
+#define DEF_UDP_MAX_RETRIES         4
+
+/**
+ * Asynchronous UDP client.
+ * Requests are sent over one long-lived socket in the batch frames (protocol version 2) with request identifiers.
+ * Socket is connected to the server, datagrams from other hosts are dropped by the kernel.
+ * Up to window requests are in flight, the rest are queued.
+ * Request is retransmitted with exponential backoff until reply is received or retries exhausted
+ * (onError with ERR_CODE_TIMEOUT and request identifier as error code).
+ * Late replies to the retransmitted requests are suppressed.
+ * Call start() to run until all requests are answered or process() to run one iteration.
+ */
+class AsyncUDPClient : public AsyncQueryClient {
+private:
+    class PendingRequest {
+    public:
+        uint32_t requestId;
+        std::string frame;  ///< serialized batch frame
+        std::chrono::steady_clock::time_point deadline;
+        unsigned int retries;
+    };
+    SOCKET sock;
+    struct sockaddr_storage addr;
+    int addrLen;
+    uint32_t nextRequestId;
+    std::deque<PendingRequest> queue;
+    std::map<uint32_t, PendingRequest> inFlight;
+    int status;
+
+    int openSocket();
+    int send(PendingRequest &value);
+    void sendQueued();
+    void receive(const unsigned char *buf, size_t sz);
+    void checkDeadlines();
+public:
+    size_t window;
+    unsigned int retransmitMillis;
+    unsigned int maxRetries;
+    // counters
+    uint64_t sent;
+    uint64_t retransmits;
+    uint64_t duplicates;
+    uint64_t timeouts;
+
+    AsyncUDPClient(
+        const std::string &host,
+        uint16_t port,
+        ResponseClient *onResponse,
+        size_t window = DEF_UDP_WINDOW
+    );
+    ~AsyncUDPClient() override;
+
+    /**
+     * Queue request. Message is serialized immediately, the value is not retained.
+     * If value requestId is 0, it is assigned.
+     * @param value request
+     * @return value, caller can delete it
+     */
+    ServiceMessage* request(
+        ServiceMessage* value
+    ) override;
+    /**
+     * Run until all requests are answered, timed out or stop() is called
+     */
+    void start() override;
+    void stop() override;
+    /**
+     * Send queued requests, wait for replies up to timeout, retransmit expired requests
+     * @param timeoutMillis max wait time
+     * @return count of pending requests, <0- error code
+     */
+    int process(
+        int timeoutMillis
+    ) override;
+    /**
+     * @return count of queued and in flight requests
+     */
+    size_t pending() const override;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "lorawan/storage/client/change-feed-client.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <WS2tcpip.h>
+
+#define close closesocket
+#define SHUT_RDWR SD_BOTH
+#else
+#define INVALID_SOCKET  (-1)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/helper/ip-address.h"
+
+/**
+ * Read exactly sz bytes
+ */
+static int receiveAll(
+    SOCKET sock,
+    unsigned char *buf,
+    size_t sz
+)
+{
+    while (sz) {
+        ssize_t r = recv(sock, (char *) buf, (int) sz, 0);
+        if (r <= 0)
+            return ERR_CODE_SOCKET_READ;
+        buf += r;
+        sz -= (size_t) r;
+    }
+    return CODE_OK;
+}
+
+ChangeFeedClient::ChangeFeedClient(
+    ChangeFeedListener *aListener,
+    const std::string &aService,
+    int32_t aCode,
+    uint64_t aAccessCode,
+    uint64_t aSeq
+)
+    : listener(aListener), service(aService), code(aCode), accessCode(aAccessCode), stopRequested(false),
+    sock(INVALID_SOCKET), seq(aSeq), events(0), resets(0), reconnects(0), lastError(CODE_OK)
+{
+}
+
+ChangeFeedClient::~ChangeFeedClient()
+{
+    stop();
+}
+
+void ChangeFeedClient::start()
+{
+    if (thread.joinable())
+        return;
+    stopRequested = false;
+    thread = std::thread(&ChangeFeedClient::run, this);
+}
+
+void ChangeFeedClient::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(stopLock);
+        stopRequested = true;
+        // unblock recv()
+        SOCKET s = sock;
+        if (s != INVALID_SOCKET)
+            shutdown(s, SHUT_RDWR);
+    }
+    stopSignal.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+bool ChangeFeedClient::pause(
+    unsigned int millis
+)
+{
+    std::unique_lock<std::mutex> guard(stopLock);
+    return !stopSignal.wait_for(guard, std::chrono::milliseconds(millis), [this] {
+        return stopRequested.load();
+    });
+}
+
+int ChangeFeedClient::connectService(
+    SOCKET &retSock
+)
+{
+    std::string host;
+    uint16_t port;
+    if (!splitAddress(host, port, service))
+        return ERR_CODE_SOCKET_ADDRESS;
+    struct addrinfo hints {};
+    struct addrinfo *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    std::string portString = std::to_string(port);
+    if (getaddrinfo(host.c_str(), portString.c_str(), &hints, &res) != 0 || !res)
+        return ERR_CODE_SOCKET_ADDRESS;
+    SOCKET s = socket(res->ai_family, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) {
+        freeaddrinfo(res);
+        return ERR_CODE_SOCKET_CREATE;
+    }
+    int r = connect(s, res->ai_addr, (int) res->ai_addrlen);
+    freeaddrinfo(res);
+    if (r) {
+        close(s);
+        return ERR_CODE_SOCKET_CONNECT;
+    }
+    retSock = s;
+    return CODE_OK;
+}
+
+/**
+ * Subscribe and pass events to the listener until connection is lost
+ */
+int ChangeFeedClient::receive(
+    SOCKET s
+)
+{
+    unsigned char buf[SIZE_WATCH_REQUEST];
+    WatchRequest req(seq, code, accessCode);
+    req.ntoh();
+    size_t sz = req.serialize(buf);
+    if (send(s, (const char *) buf, (int) sz, 0) != (ssize_t) sz)
+        return ERR_CODE_SOCKET_WRITE;
+    bool subscribed = false;
+    while (!stopRequested) {
+        int r = receiveAll(s, buf, 1);
+        if (r)
+            return r;
+        if (buf[0] == QUERY_IDENTITY_WATCH) {
+            r = receiveAll(s, buf + 1, SIZE_WATCH_RESPONSE - 1);
+            if (r)
+                return r;
+            WatchResponse resp(buf, SIZE_WATCH_RESPONSE);
+            resp.ntoh();
+            if (resp.code == ERR_CODE_REPLICA_SNAPSHOT) {
+                seq = resp.seq;
+                resets++;
+                if (listener)
+                    listener->onReset(resp.seq);
+            } else if (resp.code != CODE_OK) {
+                return resp.code;
+            } else if (!subscribed && seq == 0) {
+                seq = resp.seq;     // new changes only, resume from here after reconnect
+            }
+            subscribed = true;
+            continue;
+        }
+        if (buf[0] != CHANGE_EVENT_TAG)
+            return ERR_CODE_INVALID_PACKET;
+        r = receiveAll(s, buf + 1, SIZE_CHANGE_EVENT - 1);
+        if (r)
+            return r;
+        ChangeEvent event(buf, SIZE_CHANGE_EVENT);
+        seq = event.seq;
+        events++;
+        if (listener)
+            listener->onChange(event);
+    }
+    return CODE_OK;
+}
+
+void ChangeFeedClient::run()
+{
+    unsigned int reconnectMillis = DEF_FEED_RECONNECT_MILLIS;
+    while (!stopRequested) {
+        SOCKET s = INVALID_SOCKET;
+        int r = connectService(s);
+        if (r == CODE_OK) {
+            {
+                std::lock_guard<std::mutex> guard(stopLock);
+                if (stopRequested) {
+                    close(s);
+                    break;
+                }
+                sock = s;
+            }
+            reconnectMillis = DEF_FEED_RECONNECT_MILLIS;
+            r = receive(s);
+            {
+                std::lock_guard<std::mutex> guard(stopLock);
+                sock = INVALID_SOCKET;
+            }
+            close(s);
+        }
+        if (stopRequested)
+            break;
+        lastError = r;
+        if (!pause(reconnectMillis))
+            break;
+        reconnectMillis = std::min<unsigned int>(reconnectMillis * 2, DEF_FEED_MAX_RECONNECT_MILLIS);
+        reconnects++;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef CHANGE_FEED_CLIENT_H_
+#define CHANGE_FEED_CLIENT_H_	1
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <BaseTsd.h>
+#include <Winsock2.h>
+typedef SSIZE_T ssize_t;
+#else
+typedef int SOCKET;
+#endif
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "lorawan/storage/serialization/change-feed-serialization.h"
+
+// first reconnect delay, doubled on each failed attempt up to DEF_FEED_MAX_RECONNECT_MILLIS
+#define DEF_FEED_RECONNECT_MILLIS       100
+#define DEF_FEED_MAX_RECONNECT_MILLIS   10000
+
+/**
+ * Change events receiver, called from the client thread
+ */
+class ChangeFeedListener {
+public:
+    /**
+     * Identity is changed or removed, drop cached entry
+     */
+    virtual void onChange(
+        const ChangeEvent &event
+    ) = 0;
+    /**
+     * Changes are lost (service is restarted, client was too slow or too long disconnected), drop all cached entries
+     * @param lastSeq service sequence number next events follow
+     */
+    virtual void onReset(
+        uint64_t lastSeq
+    ) = 0;
+    virtual ~ChangeFeedListener() = default;
+};
+
+/**
+ * Subscribe to the storage service change feed over TCP and pass events to the listener.
+ * After reconnect subscription resumes from the last received sequence number, events are not lost or repeated.
+ */
+class ChangeFeedClient {
+private:
+    ChangeFeedListener *listener;
+    std::string service;
+    int32_t code;
+    uint64_t accessCode;
+    std::thread thread;
+    std::atomic<bool> stopRequested;
+    std::atomic<SOCKET> sock;
+    std::mutex stopLock;
+    std::condition_variable stopSignal;
+
+    void run();
+    bool pause(unsigned int millis);
+    int connectService(SOCKET &retSock);
+    int receive(SOCKET s);
+public:
+    std::atomic<uint64_t> seq;  ///< last received sequence number
+    // counters
+    std::atomic<uint64_t> events;
+    std::atomic<uint64_t> resets;
+    std::atomic<uint64_t> reconnects;
+    std::atomic<int> lastError;
+
+    /**
+     * @param listener events receiver
+     * @param service storage service TCP address "host:port"
+     * @param code account code
+     * @param accessCode access code
+     * @param seq last sequence number the client has, 0- new changes only
+     */
+    ChangeFeedClient(
+        ChangeFeedListener *listener,
+        const std::string &service,
+        int32_t code,
+        uint64_t accessCode,
+        uint64_t seq = 0
+    );
+    virtual ~ChangeFeedClient();
+    void start();
+    void stop();
+};
+
+#endif
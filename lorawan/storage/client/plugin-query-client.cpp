@@ -41,6 +41,7 @@ static void parseResponse(
             }
                 break;
             case QUERY_IDENTITY_LIST:   // List entries
+            case QUERY_IDENTITY_FILTER: // filtered entries, list reply
             {
                 IdentityListResponse gr(buf, nRead);
                 gr.response = NTOH4(gr.response);
@@ -188,6 +189,7 @@ void PluginQueryClient::start() {
                 }
                     break;
                 case QUERY_IDENTITY_LIST:   // List entries
+                case QUERY_IDENTITY_FILTER: // filtered entries, list reply
                 {
                     IdentityListResponse gr(rBuf, sz);
                     gr.response = NTOH4(gr.response);
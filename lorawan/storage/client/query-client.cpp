@@ -1,5 +1,9 @@
 #include "query-client.h"
 
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/gateway-binary-serialization.h"
+
 QueryClient::QueryClient(
     ResponseClient *aOnResponse
 )
@@ -8,3 +12,74 @@ QueryClient::QueryClient(
 }
 
 QueryClient::~QueryClient() = default;
+
+void QueryClient::dispatchResponse(
+    const unsigned char *buf,
+    size_t sz,
+    uint32_t requestId
+)
+{
+    if (!onResponse)
+        return;
+    if (isIdentityTag(buf, sz)) {
+        enum IdentityQueryTag tag = validateIdentityQuery(buf, sz);
+        switch (tag) {
+            case QUERY_IDENTITY_EUI:   // request gateway identifier(with address) by network address.
+            case QUERY_IDENTITY_ADDR:   // request gateway address (with identifier) by identifier.
+            case QUERY_IDENTITY_NEXT:   // next reply has the same layout
+            {
+                IdentityGetResponse gr(buf, sz);
+                gr.ntoh();
+                gr.requestId = requestId;
+                onResponse->onIdentityGet(this, &gr);
+            }
+                break;
+            case QUERY_IDENTITY_LIST:   // List entries
+            case QUERY_IDENTITY_FILTER: // filtered entries, list reply
+            {
+                IdentityListResponse gr(buf, sz);
+                gr.response = NTOH4(gr.response);
+                gr.ntoh();
+                gr.requestId = requestId;
+                onResponse->onIdentityList(this, &gr);
+            }
+                break;
+            default: {
+                IdentityOperationResponse gr(buf, sz);
+                gr.ntoh();
+                gr.requestId = requestId;
+                onResponse->onIdentityOperation(this, &gr);
+            }
+                break;
+        }
+    } else {
+        enum GatewayQueryTag tag = validateGatewayQuery(buf, sz);
+        switch (tag) {
+            case QUERY_GATEWAY_ADDR:   // request gateway identifier(with address) by network address.
+            case QUERY_GATEWAY_ID:   // request gateway address (with identifier) by identifier.
+            {
+                GatewayGetResponse gr(buf, sz);
+                gr.ntoh();
+                gr.requestId = requestId;
+                onResponse->onGatewayGet(this, &gr);
+            }
+                break;
+            case QUERY_GATEWAY_LIST:   // List entries
+            {
+                GatewayListResponse gr(buf, sz);
+                gr.response = NTOH4(gr.response);
+                gr.ntoh();
+                gr.requestId = requestId;
+                onResponse->onGatewayList(this, &gr);
+            }
+                break;
+            default: {
+                GatewayOperationResponse gr(buf, sz);
+                gr.ntoh();
+                gr.requestId = requestId;
+                onResponse->onGatewayOperation(this, &gr);
+            }
+                break;
+        }
+    }
+}
@@ -28,6 +28,18 @@ public:
     ) = 0;
     virtual void start() = 0;
     virtual void stop() = 0;
+
+    /**
+     * Deserialize version 1 response and call onResponse
+     * @param buf serialized response
+     * @param sz response size
+     * @param requestId request identifier (protocol version 2), 0- version 1
+     */
+    void dispatchResponse(
+        const unsigned char *buf,
+        size_t sz,
+        uint32_t requestId = 0
+    );
 };
 
 #endif
@@ -0,0 +1,313 @@
+#include "lorawan/storage/client/replica-client.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <WS2tcpip.h>
+
+#define close closesocket
+#else
+#define INVALID_SOCKET  (-1)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/helper/ip-address.h"
+#include "lorawan/storage/serialization/journal-serialization.h"
+#include "lorawan/storage/serialization/list-stream.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+// journal reply: header and up to 255 assign records
+#define RECEIVE_BUFFER_SIZE 65536
+
+/**
+ * Write all bytes
+ */
+static int sendAll(
+    SOCKET sock,
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    while (sz) {
+        ssize_t r = send(sock, (const char *) buf, (int) sz, 0);
+        if (r <= 0)
+            return ERR_CODE_SOCKET_WRITE;
+        buf += r;
+        sz -= (size_t) r;
+    }
+    return CODE_OK;
+}
+
+/**
+ * Read exactly sz bytes
+ */
+static int receiveAll(
+    SOCKET sock,
+    unsigned char *buf,
+    size_t sz
+)
+{
+    while (sz) {
+        ssize_t r = recv(sock, (char *) buf, (int) sz, 0);
+        if (r <= 0)
+            return ERR_CODE_SOCKET_READ;
+        buf += r;
+        sz -= (size_t) r;
+    }
+    return CODE_OK;
+}
+
+Replicator::Replicator(
+    JournalIdentityService *aTarget,
+    const std::string &aPrimary,
+    int32_t aCode,
+    uint64_t aAccessCode
+)
+    : target(aTarget), primary(aPrimary), code(aCode), accessCode(aAccessCode), stopRequested(false), promoteRequested(false), synced(false),
+    pollMillis(DEF_REPLICA_POLL_MILLIS), timeoutMillis(DEF_REPLICA_TIMEOUT_MILLIS),
+    applied(0), snapshots(0), reconnects(0), lastError(CODE_OK)
+{
+}
+
+Replicator::~Replicator()
+{
+    stop();
+}
+
+void Replicator::start()
+{
+    if (thread.joinable())
+        return;
+    target->setReadOnly(true);
+    stopRequested = false;
+    synced = false;
+    thread = std::thread(&Replicator::run, this);
+}
+
+void Replicator::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(stopLock);
+        stopRequested = true;
+    }
+    stopSignal.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+void Replicator::promote()
+{
+    stop();
+    target->setReadOnly(false);
+}
+
+void Replicator::requestPromote()
+{
+    promoteRequested = true;
+}
+
+bool Replicator::isRunning() const
+{
+    return thread.joinable() && !stopRequested && !promoteRequested;
+}
+
+bool Replicator::pause(
+    unsigned int millis
+)
+{
+    std::unique_lock<std::mutex> guard(stopLock);
+    // promote request is not notified, check it each poll interval
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(millis);
+    while (!stopRequested && !promoteRequested) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= until)
+            return true;
+        auto slice = std::min<std::chrono::steady_clock::duration>(until - now, std::chrono::milliseconds(pollMillis));
+        stopSignal.wait_for(guard, slice);
+    }
+    return false;
+}
+
+int Replicator::connectPrimary(
+    SOCKET &retSock
+)
+{
+    std::string host;
+    uint16_t port;
+    if (!splitAddress(host, port, primary))
+        return ERR_CODE_SOCKET_ADDRESS;
+    struct addrinfo hints {};
+    struct addrinfo *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    std::string portString = std::to_string(port);
+    if (getaddrinfo(host.c_str(), portString.c_str(), &hints, &res) != 0 || !res)
+        return ERR_CODE_SOCKET_ADDRESS;
+    SOCKET sock = socket(res->ai_family, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) {
+        freeaddrinfo(res);
+        return ERR_CODE_SOCKET_CREATE;
+    }
+    int r = connect(sock, res->ai_addr, (int) res->ai_addrlen);
+    freeaddrinfo(res);
+    if (r) {
+        close(sock);
+        return ERR_CODE_SOCKET_CONNECT;
+    }
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    DWORD tv = timeoutMillis;
+#else
+    struct timeval tv {};
+    tv.tv_sec = timeoutMillis / 1000;
+    tv.tv_usec = (timeoutMillis % 1000) * 1000;
+#endif
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *) &tv, sizeof(tv));
+    retSock = sock;
+    return CODE_OK;
+}
+
+/**
+ * Request changes after the last applied one and apply them
+ * @param sock connected socket
+ * @param retMore true- reply is full, primary can have more changes
+ * @return CODE_OK, ERR_CODE_REPLICA_SNAPSHOT- snapshot is loaded, error code
+ */
+int Replicator::pull(
+    SOCKET sock,
+    bool &retMore
+)
+{
+    retMore = false;
+    uint64_t seq = target->log.last();
+    JournalRequest req(seq, 0, code, accessCode);
+    unsigned char buf[RECEIVE_BUFFER_SIZE];
+    req.ntoh();
+    int r = sendAll(sock, buf, req.serialize(buf));
+    if (r)
+        return r;
+    r = receiveAll(sock, buf, SIZE_JOURNAL_RESPONSE);
+    if (r)
+        return r;
+    if (buf[0] != QUERY_IDENTITY_JOURNAL)
+        return ERR_CODE_INVALID_PACKET;
+    // read records one by one, each record size depends on its tag
+    size_t len = SIZE_JOURNAL_RESPONSE;
+    uint8_t count = buf[21];
+    for (uint8_t i = 0; i < count; i++) {
+        r = receiveAll(sock, buf + len, SIZE_JOURNAL_RECORD_HEADER + 1);
+        if (r)
+            return r;
+        len += SIZE_JOURNAL_RECORD_HEADER + 1;
+        size_t rest = (buf[len - 1] == QUERY_IDENTITY_RM ? SIZE_DEVICE_ADDR_REQUEST : SIZE_ASSIGN_REQUEST) - 1;
+        r = receiveAll(sock, buf + len, rest);
+        if (r)
+            return r;
+        len += rest;
+    }
+    JournalResponse resp(buf, len);
+    resp.ntoh();
+    if (resp.code == ERR_CODE_REPLICA_SNAPSHOT || !synced) {
+        r = loadSnapshot(sock, resp.lastSeq);
+        return r ? r : ERR_CODE_REPLICA_SNAPSHOT;
+    }
+    if (resp.code)
+        return resp.code;
+    for (auto &rec : resp.records) {
+        r = target->applyChange(rec);
+        if (r)
+            return r;
+        applied++;
+    }
+    retMore = count > 0 && resp.records.back().seq < resp.lastSeq;
+    return CODE_OK;
+}
+
+/**
+ * Load all primary entries by the streaming list request.
+ * Primary streams entries by key, entries added or removed during the snapshot do not shift the chunks,
+ * they are replayed from the journal after the snapshot.
+ * @param sock connected socket
+ * @param seq primary sequence number read before the snapshot
+ * @return CODE_OK or error code
+ */
+int Replicator::loadSnapshot(
+    SOCKET sock,
+    uint64_t seq
+)
+{
+    ListStreamRequest req(QUERY_IDENTITY_LIST_STREAM, 0, 0, "", code, accessCode);
+    unsigned char buf[RECEIVE_BUFFER_SIZE];
+    req.ntoh();
+    int r = sendAll(sock, buf, req.serialize(buf));
+    if (r)
+        return r;
+    std::vector<NETWORKIDENTITY> entries;
+    while (true) {
+        r = receiveAll(sock, buf, SIZE_LIST_STREAM_CHUNK_HEADER);
+        if (r)
+            return r;
+        if (!isListStreamChunk(buf, SIZE_LIST_STREAM_CHUNK_HEADER))
+            return ERR_CODE_INVALID_PACKET;
+        size_t len = listStreamChunkSize(buf);
+        if (len < SIZE_OPERATION_RESPONSE || len > sizeof(buf))
+            return ERR_CODE_INVALID_PACKET;
+        r = receiveAll(sock, buf, len);
+        if (r)
+            return r;
+        IdentityListResponse resp(buf, len);
+        resp.ntoh();
+        if (resp.code)
+            return resp.code;
+        if (resp.identities.empty())
+            break;
+        entries.insert(entries.end(), resp.identities.begin(), resp.identities.end());
+    }
+    r = target->applySnapshot(entries, seq);
+    if (r == CODE_OK) {
+        synced = true;
+        snapshots++;
+    }
+    return r;
+}
+
+void Replicator::run()
+{
+    unsigned int reconnectMillis = DEF_REPLICA_RECONNECT_MILLIS;
+    while (!stopRequested && !promoteRequested) {
+        SOCKET sock = INVALID_SOCKET;
+        int r = connectPrimary(sock);
+        if (r) {
+            lastError = r;
+            if (!pause(reconnectMillis))
+                break;
+            reconnectMillis = std::min<unsigned int>(reconnectMillis * 2, DEF_REPLICA_MAX_RECONNECT_MILLIS);
+            reconnects++;
+            continue;
+        }
+        reconnectMillis = DEF_REPLICA_RECONNECT_MILLIS;
+        while (!stopRequested && !promoteRequested) {
+            bool more;
+            r = pull(sock, more);
+            if (r == ERR_CODE_REPLICA_SNAPSHOT)
+                continue;   // continue from the snapshot sequence number
+            if (r) {
+                lastError = r;
+                break;
+            }
+            lastError = CODE_OK;
+            if (!more && !pause(pollMillis))
+                break;
+        }
+        close(sock);
+        if (r && !pause(reconnectMillis))
+            break;
+    }
+    if (promoteRequested)
+        target->setReadOnly(false);
+}
@@ -0,0 +1,102 @@
+#ifndef REPLICA_CLIENT_H_
+#define REPLICA_CLIENT_H_	1
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <BaseTsd.h>
+#include <Winsock2.h>
+typedef SSIZE_T ssize_t;
+#else
+typedef int SOCKET;
+#endif
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "lorawan/storage/service/identity-service-journal.h"
+
+// pause between polls when the replica has caught up
+#define DEF_REPLICA_POLL_MILLIS             100
+// socket read timeout
+#define DEF_REPLICA_TIMEOUT_MILLIS          5000
+// first reconnect delay, doubled on each failed attempt up to DEF_REPLICA_MAX_RECONNECT_MILLIS
+#define DEF_REPLICA_RECONNECT_MILLIS        100
+#define DEF_REPLICA_MAX_RECONNECT_MILLIS    10000
+
+/**
+ * Replica side of the primary/replica replication.
+ * Thread connects to the primary storage service over TCP, pulls committed changes by the journal requests
+ * and applies them to the read-only journal identity service in the primary order.
+ * Replica loads the snapshot by the streaming list request on start and when it misses changes
+ * (primary restarted or log records are dropped), then continues from the snapshot sequence number.
+ * Snapshot is taken after the primary sequence number is read, changes made during the snapshot are replayed,
+ * put and rm are idempotent, replica converges to the primary.
+ */
+class Replicator {
+private:
+    JournalIdentityService *target;
+    std::string primary;
+    int32_t code;
+    uint64_t accessCode;
+    std::thread thread;
+    std::atomic<bool> stopRequested;
+    std::atomic<bool> promoteRequested;
+    std::mutex stopLock;
+    std::condition_variable stopSignal;
+    bool synced;    ///< snapshot is loaded since start()
+
+    void run();
+    /**
+     * Wait or return early if stop() is called
+     * @return false if stop is requested
+     */
+    bool pause(unsigned int millis);
+    int connectPrimary(SOCKET &retSock);
+    int pull(SOCKET sock, bool &retMore);
+    int loadSnapshot(SOCKET sock, uint64_t seq);
+public:
+    unsigned int pollMillis;
+    unsigned int timeoutMillis;
+    // counters
+    std::atomic<uint64_t> applied;
+    std::atomic<uint64_t> snapshots;
+    std::atomic<uint64_t> reconnects;
+    std::atomic<int> lastError;
+
+    /**
+     * @param target replica identity service, set to read-only
+     * @param primary primary storage service TCP address "host:port"
+     * @param code account code
+     * @param accessCode access code
+     */
+    Replicator(
+        JournalIdentityService *target,
+        const std::string &primary,
+        int32_t code,
+        uint64_t accessCode
+    );
+    virtual ~Replicator();
+
+    /**
+     * Start replication thread
+     */
+    void start();
+    /**
+     * Stop replication thread, replica stays read-only
+     */
+    void stop();
+    /**
+     * Stop replication and accept writes. Promoted replica keeps the primary sequence numbers,
+     * other replicas can continue from it.
+     */
+    void promote();
+    /**
+     * Ask replication thread to promote the replica and exit. Safe to call from the signal handler.
+     */
+    void requestPromote();
+    bool isRunning() const;
+};
+
+#endif
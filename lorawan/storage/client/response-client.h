@@ -16,6 +16,7 @@ class GatewayListResponse;
  */
 class ResponseClient {
 public:
+    virtual ~ResponseClient() = default;
     virtual void onIdentityGet(
         QueryClient* client,
         const IdentityGetResponse *response
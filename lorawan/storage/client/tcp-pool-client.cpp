@@ -0,0 +1,563 @@
+#include "tcp-pool-client.h"
+
+#include <cstring>
+#include <thread>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <WS2tcpip.h>
+
+#define close closesocket
+#define poll WSAPoll
+#define CONNECT_IN_PROGRESS(e) ((e) == WSAEWOULDBLOCK)
+#define WOULD_BLOCK(e) ((e) == WSAEWOULDBLOCK)
+#define SOCKET_ERRNO WSAGetLastError()
+#else
+#define INVALID_SOCKET  (-1)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#define CONNECT_IN_PROGRESS(e) ((e) == EINPROGRESS)
+#define WOULD_BLOCK(e) ((e) == EAGAIN || (e) == EWOULDBLOCK)
+#define SOCKET_ERRNO errno
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/helper/ip-address.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+
+// the longest request is 154 bytes (assign)
+#define MAX_REQUEST_SIZE    256
+// listener reply buffer is 1432 bytes, each item reply is up to 6 + 154 bytes
+#define MAX_FRAME_ITEMS     8
+#define RECEIVE_BUFFER_SIZE 4096
+// drop connection sending garbage
+#define MAX_FRAME_SIZE      65536
+
+size_t TCPPoolClient::Connection::outstanding() const
+{
+    return queue.size() + inFlight.size();
+}
+
+bool TCPPoolClient::Connection::isBusy() const
+{
+    return ping || !inFlight.empty();
+}
+
+TCPPoolClient::TCPPoolClient(
+    const std::vector<std::string> &aEndpoints,
+    size_t connectionsPerEndpoint,
+    ResponseClient *aOnResponse
+)
+    : AsyncQueryClient(aOnResponse), nextConnection(0), nextRequestId(1), status(CODE_OK),
+    requestTimeoutMillis(DEF_POOL_REQUEST_TIMEOUT_MILLIS), healthCheckMillis(DEF_POOL_HEALTH_CHECK_MILLIS),
+    maxRetries(DEF_POOL_MAX_RETRIES), reconnects(0), failovers(0), healthChecks(0)
+{
+    for (auto &e : aEndpoints) {
+        std::string host;
+        uint16_t port;
+        if (!splitAddress(host, port, e))
+            continue;
+        struct addrinfo hints {};
+        struct addrinfo *res = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        std::string portString = std::to_string(port);
+        if (getaddrinfo(host.c_str(), portString.c_str(), &hints, &res) != 0 || !res)
+            continue;
+        Endpoint ep {};
+        memmove(&ep.addr, res->ai_addr, res->ai_addrlen);
+        ep.addrLen = (int) res->ai_addrlen;
+        freeaddrinfo(res);
+        endpoints.push_back(ep);
+    }
+    if (endpoints.empty()) {
+        status = ERR_CODE_SOCKET_ADDRESS;
+        return;
+    }
+    if (!connectionsPerEndpoint)
+        connectionsPerEndpoint = 1;
+    // interleave endpoints, so the first connections go to the different services
+    connections.resize(connectionsPerEndpoint * endpoints.size());
+    for (size_t i = 0; i < connections.size(); i++) {
+        Connection &c = connections[i];
+        c.endpoint = i % endpoints.size();
+        c.sock = INVALID_SOCKET;
+        c.state = CONNECTION_DOWN;
+        c.ping = false;
+        c.txPos = 0;
+        c.reconnectMillis = DEF_POOL_RECONNECT_MILLIS;
+        connect(c);
+    }
+}
+
+TCPPoolClient::~TCPPoolClient()
+{
+    for (auto &c : connections) {
+        if (c.sock != INVALID_SOCKET) {
+            close(c.sock);
+            c.sock = INVALID_SOCKET;
+        }
+    }
+}
+
+void TCPPoolClient::stop()
+{
+    status = ERR_CODE_STOPPED;
+}
+
+size_t TCPPoolClient::pending() const
+{
+    size_t r = backlog.size();
+    for (auto &c : connections) {
+        r += c.outstanding();
+    }
+    return r;
+}
+
+size_t TCPPoolClient::connected() const
+{
+    size_t r = 0;
+    for (auto &c : connections) {
+        if (c.state == CONNECTION_UP)
+            r++;
+    }
+    return r;
+}
+
+/**
+ * @return established connection with the least outstanding requests, connecting one if none is established
+ */
+TCPPoolClient::Connection *TCPPoolClient::leastOutstanding()
+{
+    Connection *r = nullptr;
+    size_t idx = 0;
+    // start from the next connection to spread ties
+    for (size_t i = 0; i < connections.size(); i++) {
+        size_t j = (nextConnection + i) % connections.size();
+        Connection &c = connections[j];
+        if (c.state == CONNECTION_DOWN)
+            continue;
+        if (!r || (c.state == CONNECTION_UP && r->state != CONNECTION_UP)
+            || (c.state == r->state && c.outstanding() < r->outstanding())) {
+            r = &c;
+            idx = j;
+        }
+    }
+    if (r)
+        nextConnection = (idx + 1) % connections.size();
+    return r;
+}
+
+void TCPPoolClient::assign(
+    const PendingRequest &value
+)
+{
+    Connection *c = leastOutstanding();
+    if (!c) {
+        backlog.push_back(value);
+        return;
+    }
+    c->queue.push_back(value);
+    sendFrame(*c);
+}
+
+void TCPPoolClient::assignBacklog()
+{
+    while (!backlog.empty()) {
+        Connection *c = leastOutstanding();
+        if (!c)
+            break;
+        c->queue.push_back(backlog.front());
+        backlog.pop_front();
+        sendFrame(*c);
+    }
+}
+
+ServiceMessage* TCPPoolClient::request(
+    ServiceMessage* value
+)
+{
+    if (!value)
+        return nullptr;
+    if (!value->requestId) {
+        value->requestId = nextRequestId++;
+        if (!nextRequestId)
+            nextRequestId = 1;
+    }
+    unsigned char buf[MAX_REQUEST_SIZE];
+    value->ntoh();
+    size_t sz = value->serialize(buf);
+    value->ntoh();  // restore host byte order
+    PendingRequest p;
+    p.requestId = value->requestId;
+    p.message.assign((const char *) buf, sz);
+    p.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(requestTimeoutMillis);
+    p.retries = 0;
+    assign(p);
+    return value;
+}
+
+void TCPPoolClient::connect(
+    Connection &c
+)
+{
+    const Endpoint &ep = endpoints[c.endpoint];
+    c.sock = socket(ep.addr.ss_family, SOCK_STREAM, 0);
+    if (c.sock == INVALID_SOCKET) {
+        disconnect(c, ERR_CODE_SOCKET_CREATE);
+        return;
+    }
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    u_long nonBlocking = 1;
+    ioctlsocket(c.sock, FIONBIO, &nonBlocking);
+#else
+    fcntl(c.sock, F_SETFL, fcntl(c.sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    int noDelay = 1;
+    setsockopt(c.sock, IPPROTO_TCP, TCP_NODELAY, (const char *) &noDelay, sizeof(noDelay));
+    if (::connect(c.sock, (const struct sockaddr *) &ep.addr, ep.addrLen) == 0) {
+        onConnected(c);
+        return;
+    }
+    if (CONNECT_IN_PROGRESS(SOCKET_ERRNO)) {
+        c.state = CONNECTION_CONNECTING;
+        c.lastActivity = std::chrono::steady_clock::now();
+        return;
+    }
+    disconnect(c, ERR_CODE_SOCKET_CONNECT);
+}
+
+void TCPPoolClient::onConnected(
+    Connection &c
+)
+{
+    c.state = CONNECTION_UP;
+    c.reconnectMillis = DEF_POOL_RECONNECT_MILLIS;
+    c.lastActivity = std::chrono::steady_clock::now();
+    assignBacklog();
+    sendFrame(c);
+}
+
+/**
+ * Close broken connection, schedule reconnect, resend its requests over other connections
+ */
+void TCPPoolClient::disconnect(
+    Connection &c,
+    int code
+)
+{
+    bool wasUp = c.state == CONNECTION_UP;
+    if (c.sock != INVALID_SOCKET) {
+        close(c.sock);
+        c.sock = INVALID_SOCKET;
+    }
+    c.state = CONNECTION_DOWN;
+    c.reconnectAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(c.reconnectMillis);
+    c.reconnectMillis *= 2;
+    if (c.reconnectMillis > DEF_POOL_MAX_RECONNECT_MILLIS)
+        c.reconnectMillis = DEF_POOL_MAX_RECONNECT_MILLIS;
+    c.ping = false;
+    c.tx.clear();
+    c.txPos = 0;
+    c.rx.clear();
+    std::vector<PendingRequest> requeue;
+    requeue.swap(c.inFlight);
+    for (auto &p : requeue) {
+        // server may have received the request, resend it a limited number of times
+        if (++p.retries > maxRetries) {
+            fail(p, code);
+            continue;
+        }
+        failovers++;
+        assign(p);
+    }
+    while (!c.queue.empty()) {
+        PendingRequest p = c.queue.front();
+        c.queue.pop_front();
+        assign(p);
+    }
+    if (wasUp && onResponse)
+        onResponse->onDisconnected(this);
+}
+
+void TCPPoolClient::fail(
+    const PendingRequest &value,
+    int code
+)
+{
+    if (onResponse)
+        onResponse->onError(this, code, (int) value.requestId);
+}
+
+/**
+ * Send queued requests in one frame if the connection has no frame in flight
+ */
+void TCPPoolClient::sendFrame(
+    Connection &c
+)
+{
+    if (c.state != CONNECTION_UP || c.isBusy() || c.queue.empty())
+        return;
+    unsigned char buf[SIZE_BATCH_HEADER + MAX_FRAME_ITEMS * (SIZE_BATCH_ITEM_HEADER + MAX_REQUEST_SIZE)];
+    BatchWriter writer(buf, sizeof(buf));
+    while (!c.queue.empty() && c.inFlight.size() < MAX_FRAME_ITEMS) {
+        PendingRequest &p = c.queue.front();
+        if (!writer.add(p.requestId, (const unsigned char *) p.message.c_str(), p.message.size()))
+            break;
+        c.inFlight.push_back(p);
+        c.queue.pop_front();
+    }
+    c.tx.assign((const char *) buf, writer.size());
+    c.txPos = 0;
+    c.frameSent = std::chrono::steady_clock::now();
+    writeTx(c);
+}
+
+void TCPPoolClient::writeTx(
+    Connection &c
+)
+{
+    while (c.txPos < c.tx.size()) {
+        ssize_t r = send(c.sock, c.tx.c_str() + c.txPos, (int) (c.tx.size() - c.txPos), MSG_NOSIGNAL);
+        if (r <= 0) {
+            if (r < 0 && WOULD_BLOCK(SOCKET_ERRNO))
+                return; // wait for POLLOUT
+            disconnect(c, ERR_CODE_SOCKET_WRITE);
+            return;
+        }
+        c.txPos += (size_t) r;
+    }
+    c.tx.clear();
+    c.txPos = 0;
+}
+
+void TCPPoolClient::readRx(
+    Connection &c
+)
+{
+    unsigned char buf[RECEIVE_BUFFER_SIZE];
+    while (c.state == CONNECTION_UP) {
+        ssize_t r = recv(c.sock, (char *) buf, (int) sizeof(buf), 0);
+        if (r < 0 && WOULD_BLOCK(SOCKET_ERRNO))
+            break;
+        if (r <= 0) {
+            disconnect(c, ERR_CODE_SOCKET_READ);
+            return;
+        }
+        receive(c, buf, (size_t) r);
+    }
+}
+
+/**
+ * Reassemble reply frame, dispatch replies, send next frame
+ */
+void TCPPoolClient::receive(
+    Connection &c,
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    c.rx.append((const char *) buf, sz);
+    while (!c.rx.empty() && c.state == CONNECTION_UP) {
+        auto frame = (const unsigned char *) c.rx.c_str();
+        if (frame[0] != QUERY_BATCH || c.rx.size() > MAX_FRAME_SIZE) {
+            disconnect(c, ERR_CODE_INVALID_PACKET);
+            return;
+        }
+        size_t frameSize = batchMessageSize(frame, c.rx.size());
+        if (frameSize == 0)
+            return; // wait for the rest of the frame
+        std::vector<BatchItem> items;
+        parseBatch(items, frame, frameSize);
+        std::vector<PendingRequest> sent;
+        sent.swap(c.inFlight);
+        c.ping = false;
+        c.lastActivity = std::chrono::steady_clock::now();
+        for (auto &item : items) {
+            bool found = false;
+            for (auto it = sent.begin(); it != sent.end(); ++it) {
+                if (it->requestId == item.requestId) {
+                    sent.erase(it);
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+                continue;
+            if (item.size == 0) {
+                if (onResponse)
+                    onResponse->onError(this, ERR_CODE_INVALID_PACKET, (int) item.requestId);
+                continue;
+            }
+            dispatchResponse(item.data, item.size, item.requestId);
+        }
+        // requests without reply are sent again in the next frame
+        c.queue.insert(c.queue.begin(), sent.begin(), sent.end());
+        c.rx.erase(0, frameSize);
+        sendFrame(c);
+    }
+}
+
+/**
+ * Reconnect, check health of the idle connections, drop hung connections and expired requests
+ */
+void TCPPoolClient::checkTimers()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto &c : connections) {
+        switch (c.state) {
+            case CONNECTION_DOWN:
+                if (c.reconnectAt <= now) {
+                    reconnects++;
+                    connect(c);
+                }
+                break;
+            case CONNECTION_CONNECTING:
+                if (now - c.lastActivity >= std::chrono::milliseconds(requestTimeoutMillis))
+                    disconnect(c, ERR_CODE_SOCKET_CONNECT);
+                break;
+            default:
+                if (c.isBusy()) {
+                    if (now - c.frameSent >= std::chrono::milliseconds(requestTimeoutMillis))
+                        disconnect(c, ERR_CODE_TIMEOUT);
+                } else if (c.queue.empty() && now - c.lastActivity >= std::chrono::milliseconds(healthCheckMillis)) {
+                    // empty batch frame, the service replies with empty batch frame
+                    unsigned char buf[SIZE_BATCH_HEADER];
+                    BatchWriter writer(buf, sizeof(buf));
+                    c.tx.assign((const char *) buf, writer.size());
+                    c.txPos = 0;
+                    c.ping = true;
+                    c.frameSent = now;
+                    healthChecks++;
+                    writeTx(c);
+                }
+                break;
+        }
+    }
+    for (auto &c : connections) {
+        // connection can not send queued requests in time
+        for (auto it = c.queue.begin(); it != c.queue.end();) {
+            if (it->deadline <= now) {
+                fail(*it, ERR_CODE_TIMEOUT);
+                it = c.queue.erase(it);
+            } else
+                ++it;
+        }
+    }
+    while (!backlog.empty() && backlog.front().deadline <= now) {
+        fail(backlog.front(), ERR_CODE_TIMEOUT);
+        backlog.pop_front();
+    }
+}
+
+/**
+ * @return time to the nearest timer, up to timeoutMillis
+ */
+int TCPPoolClient::waitMillis(
+    int timeoutMillis
+) const
+{
+    auto now = std::chrono::steady_clock::now();
+    auto nearest = now + std::chrono::milliseconds(timeoutMillis);
+    for (auto &c : connections) {
+        std::chrono::steady_clock::time_point t;
+        switch (c.state) {
+            case CONNECTION_DOWN:
+                t = c.reconnectAt;
+                break;
+            case CONNECTION_CONNECTING:
+                t = c.lastActivity + std::chrono::milliseconds(requestTimeoutMillis);
+                break;
+            default:
+                if (c.isBusy())
+                    t = c.frameSent + std::chrono::milliseconds(requestTimeoutMillis);
+                else
+                    t = c.lastActivity + std::chrono::milliseconds(healthCheckMillis);
+                break;
+        }
+        if (t < nearest)
+            nearest = t;
+    }
+    if (!backlog.empty() && backlog.front().deadline < nearest)
+        nearest = backlog.front().deadline;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(nearest - now).count();
+    return ms < 0 ? 0 : (int) ms;
+}
+
+int TCPPoolClient::process(
+    int timeoutMillis
+)
+{
+    if (endpoints.empty())
+        return status;
+    std::vector<struct pollfd> fds;
+    std::vector<size_t> index;
+    for (size_t i = 0; i < connections.size(); i++) {
+        Connection &c = connections[i];
+        if (c.state == CONNECTION_DOWN)
+            continue;
+        struct pollfd fd {};
+        fd.fd = c.sock;
+        if (c.state == CONNECTION_CONNECTING)
+            fd.events = POLLOUT;
+        else
+            fd.events = POLLIN | (c.tx.empty() ? 0 : POLLOUT);
+        fds.push_back(fd);
+        index.push_back(i);
+    }
+    int wait = waitMillis(timeoutMillis);
+    if (fds.empty()) {
+        // all connections are down, wait for reconnect
+        std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+    } else {
+        int r = poll(fds.data(), (unsigned long) fds.size(), wait);
+        if (r < 0) {
+#if !(defined(_MSC_VER) || defined(__MINGW32__))
+            if (errno == EINTR)
+                return (int) pending();
+#endif
+            return ERR_CODE_SOCKET_READ;
+        }
+        for (size_t i = 0; r > 0 && i < fds.size(); i++) {
+            if (!fds[i].revents)
+                continue;
+            Connection &c = connections[index[i]];
+            if (c.state == CONNECTION_CONNECTING) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c.sock, SOL_SOCKET, SO_ERROR, (char *) &err, &len);
+                if (err)
+                    disconnect(c, ERR_CODE_SOCKET_CONNECT);
+                else
+                    onConnected(c);
+                continue;
+            }
+            if (fds[i].revents & POLLOUT)
+                writeTx(c);
+            if (c.state == CONNECTION_UP && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                readRx(c);
+        }
+    }
+    checkTimers();
+    return (int) pending();
+}
+
+void TCPPoolClient::start()
+{
+    if (status == ERR_CODE_STOPPED)
+        status = CODE_OK;
+    while (status != ERR_CODE_STOPPED) {
+        if (process(1000) <= 0)
+            break;
+    }
+}
@@ -0,0 +1,142 @@
+#ifndef TCP_POOL_CLIENT_H_
+#define TCP_POOL_CLIENT_H_	1
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <BaseTsd.h>
+#include <Winsock2.h>
+typedef SSIZE_T ssize_t;
+#else
+#include <netinet/in.h>
+typedef int SOCKET;
+#endif
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+
+#include "lorawan/storage/client/async-query-client.h"
+
+// persistent connections to each storage service
+#define DEF_POOL_CONNECTIONS                2
+// request is failed with ERR_CODE_TIMEOUT if it is not answered in time
+#define DEF_POOL_REQUEST_TIMEOUT_MILLIS     5000
+// idle connection is checked by the empty batch frame
+#define DEF_POOL_HEALTH_CHECK_MILLIS        5000
+// first reconnect delay, doubled on each failed attempt up to DEF_POOL_MAX_RECONNECT_MILLIS
+#define DEF_POOL_RECONNECT_MILLIS           100
+#define DEF_POOL_MAX_RECONNECT_MILLIS       10000
+// requests of the broken connection are resent over another connection
+#define DEF_POOL_MAX_RETRIES                2
+
+/**
+ * Pool of persistent TCP connections to one or more storage services.
+ * Requests are sent in the batch frames (protocol version 2) with request identifiers.
+ * Each connection has one frame in flight, requests queued while the frame is in flight are sent in the next frame.
+ * New request goes to the connection with the least outstanding requests.
+ * Idle connections are checked by the empty batch frame, broken connections are reconnected with exponential backoff,
+ * their requests are resent over other connections.
+ */
+class TCPPoolClient : public AsyncQueryClient {
+private:
+    class PendingRequest {
+    public:
+        uint32_t requestId;
+        std::string message;    ///< serialized version 1 request
+        std::chrono::steady_clock::time_point deadline;
+        unsigned int retries;
+    };
+    class Endpoint {
+    public:
+        struct sockaddr_storage addr;
+        int addrLen;
+    };
+    enum ConnectionState {
+        CONNECTION_DOWN = 0,
+        CONNECTION_CONNECTING,
+        CONNECTION_UP
+    };
+    class Connection {
+    public:
+        size_t endpoint;
+        SOCKET sock;
+        ConnectionState state;
+        std::deque<PendingRequest> queue;       ///< assigned to the connection, not sent yet
+        std::vector<PendingRequest> inFlight;   ///< sent in the frame, waiting for the reply
+        bool ping;                              ///< health check frame is in flight
+        std::string tx;                         ///< frame being written
+        size_t txPos;
+        std::string rx;                         ///< received bytes of the reply frame
+        std::chrono::steady_clock::time_point frameSent;
+        std::chrono::steady_clock::time_point lastActivity;
+        std::chrono::steady_clock::time_point reconnectAt;
+        unsigned int reconnectMillis;
+        size_t outstanding() const;
+        bool isBusy() const;
+    };
+    std::vector<Endpoint> endpoints;
+    std::vector<Connection> connections;
+    std::deque<PendingRequest> backlog;     ///< no connection is available
+    size_t nextConnection;
+    uint32_t nextRequestId;
+    int status;
+
+    Connection *leastOutstanding();
+    void assign(const PendingRequest &value);
+    void assignBacklog();
+    void connect(Connection &c);
+    void onConnected(Connection &c);
+    void disconnect(Connection &c, int code);
+    void fail(const PendingRequest &value, int code);
+    void sendFrame(Connection &c);
+    void writeTx(Connection &c);
+    void readRx(Connection &c);
+    void receive(Connection &c, const unsigned char *buf, size_t sz);
+    void checkTimers();
+    int waitMillis(int timeoutMillis) const;
+public:
+    unsigned int requestTimeoutMillis;
+    unsigned int healthCheckMillis;
+    unsigned int maxRetries;
+    // counters
+    uint64_t reconnects;
+    uint64_t failovers;
+    uint64_t healthChecks;
+
+    /**
+     * @param endpoints storage service addresses "host:port"
+     * @param connectionsPerEndpoint persistent connections to each service
+     * @param onResponse replies and errors
+     */
+    TCPPoolClient(
+        const std::vector<std::string> &endpoints,
+        size_t connectionsPerEndpoint,
+        ResponseClient *onResponse
+    );
+    ~TCPPoolClient() override;
+
+    /**
+     * Queue request. Message is serialized immediately, the value is not retained.
+     * If value requestId is 0, it is assigned.
+     * @param value request
+     * @return value, caller can delete it
+     */
+    ServiceMessage* request(
+        ServiceMessage* value
+    ) override;
+    /**
+     * Run until all requests are answered, timed out or stop() is called
+     */
+    void start() override;
+    void stop() override;
+    int process(
+        int timeoutMillis
+    ) override;
+    size_t pending() const override;
+    /**
+     * @return count of established connections
+     */
+    size_t connected() const;
+};
+
+#endif
@@ -160,60 +160,7 @@ void UDPClient::start() {
                 << MSG_COLON_N_SPACE << hexString(rxBuf, len)
                 << std::endl;
 #endif
-                if (isIdentityTag(rxBuf, len)) {
-                    enum IdentityQueryTag tag = validateIdentityQuery(rxBuf, len);
-                    switch (tag) {
-                        case QUERY_IDENTITY_EUI:   // request gateway identifier(with address) by network address.
-                        case QUERY_IDENTITY_ADDR:   // request gateway address (with identifier) by identifier.
-                        {
-                            IdentityGetResponse gr(rxBuf, len);
-                            gr.ntoh();
-                            onResponse->onIdentityGet(this, &gr);
-                        }
-                            break;
-                        case QUERY_IDENTITY_LIST:   // List entries
-                        {
-                            IdentityListResponse gr(rxBuf, len);
-                            gr.response = NTOH4(gr.response);
-                            gr.ntoh();
-                            onResponse->onIdentityList(this, &gr);
-                        }
-                            break;
-                        default: {
-                            IdentityOperationResponse gr(rxBuf, len);
-                            gr.ntoh();
-                            onResponse->onIdentityOperation(this, &gr);
-                        }
-                            break;
-                    }
-
-                } else {
-                    enum GatewayQueryTag tag = validateGatewayQuery(rxBuf, len);
-                    switch (tag) {
-                        case QUERY_GATEWAY_ADDR:   // request gateway identifier(with address) by network address.
-                        case QUERY_GATEWAY_ID:   // request gateway address (with identifier) by identifier.
-                        {
-                            GatewayGetResponse gr(rxBuf, len);
-                            gr.ntoh();
-                            onResponse->onGatewayGet(this, &gr);
-                        }
-                            break;
-                        case QUERY_GATEWAY_LIST:   // List entries
-                        {
-                            GatewayListResponse gr(rxBuf, len);
-                            gr.response = NTOH4(gr.response);
-                            gr.ntoh();
-                            onResponse->onGatewayList(this, &gr);
-                        }
-                            break;
-                        default: {
-                            GatewayOperationResponse gr(rxBuf, len);
-                            gr.ntoh();
-                            onResponse->onGatewayOperation(this, &gr);
-                        }
-                            break;
-                    }
-                }
+                dispatchResponse(rxBuf, len);
                 free(rxBuf);
             }
         }
@@ -23,6 +23,8 @@
 #include "lorawan/lorawan-error.h"
 #include "lorawan/lorawan-conv.h"
 #include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+#include "lorawan/storage/serialization/list-stream.h"
 
 #ifdef ENABLE_DEBUG
 #include <iostream>
@@ -35,63 +37,54 @@
 static void parseResponse(
     UvClient *client,
     const unsigned char *buf,
-    ssize_t nRead
+    ssize_t nRead,
+    uint32_t requestId = 0
 ) {
     if (!client)
         return;
-    if (isIdentityTag(buf, nRead)) {
-        enum IdentityQueryTag tag = validateIdentityQuery(buf, nRead);
-        switch (tag) {
-            case QUERY_IDENTITY_EUI:   // request gateway identifier(with address) by network address.
-            case QUERY_IDENTITY_ADDR:   // request gateway address (with identifier) by identifier.
-            {
-                IdentityGetResponse gr(buf, nRead);
-                gr.ntoh();
-                client->onResponse->onIdentityGet(client, &gr);
-            }
-                break;
-            case QUERY_IDENTITY_LIST:   // List entries
-            {
-                IdentityListResponse gr(buf, nRead);
-                gr.response = NTOH4(gr.response);
-                gr.ntoh();
-                client->onResponse->onIdentityList(client, &gr);
+    if (isBatchMessage(buf, nRead)) {
+        std::vector<BatchItem> items;
+        parseBatch(items, buf, nRead);
+        for (auto &item : items) {
+            if (item.size == 0) {
+                client->onResponse->onError(client, ERR_CODE_INVALID_PACKET, (int) item.requestId);
+                continue;
             }
-                break;
-            default: {
-                IdentityOperationResponse gr(buf, nRead);
-                gr.ntoh();
-                client->onResponse->onIdentityOperation(client, &gr);
-            }
-                break;
+            parseResponse(client, item.data, (ssize_t) item.size, item.requestId);
         }
+        return;
+    }
+    client->dispatchResponse(buf, (size_t) nRead, requestId);
+}
 
-    } else {
-        enum GatewayQueryTag tag = validateGatewayQuery(buf, nRead);
-        switch (tag) {
-            case QUERY_GATEWAY_ADDR:   // request gateway identifier(with address) by network address.
-            case QUERY_GATEWAY_ID:   // request gateway address (with identifier) by identifier.
-            {
-                GatewayGetResponse gr(buf, nRead);
-                gr.ntoh();
-                client->onResponse->onGatewayGet(client, &gr);
-            }
-                break;
-            case QUERY_GATEWAY_LIST:   // List entries
-            {
-                GatewayListResponse gr(buf, nRead);
-                gr.response = NTOH4(gr.response);
-                gr.ntoh();
-                client->onResponse->onGatewayList(client, &gr);
-            }
-                break;
-            default: {
-                GatewayOperationResponse gr(buf, nRead);
-                gr.ntoh();
-                client->onResponse->onGatewayOperation(client, &gr);
-            }
-                break;
+/**
+ * Streaming list chunks can be split or merged by TCP, collect them in the buffer
+ */
+static void parseTCPResponse(
+    UvClient *client,
+    const unsigned char *buf,
+    ssize_t nRead
+) {
+    if (client->streamBuffer.empty() && !isListStreamChunk(buf, nRead)) {
+        parseResponse(client, buf, nRead);
+        return;
+    }
+    client->streamBuffer.append((const char *) buf, nRead);
+    while (client->streamBuffer.size() >= SIZE_LIST_STREAM_CHUNK_HEADER) {
+        auto b = (const unsigned char *) client->streamBuffer.c_str();
+        if (!isListStreamChunk(b, client->streamBuffer.size())) {
+            // reply to the other request
+            parseResponse(client, b, (ssize_t) client->streamBuffer.size());
+            client->streamBuffer.clear();
+            break;
         }
+        size_t sz = listStreamChunkSize(b);
+        if (client->streamBuffer.size() < SIZE_LIST_STREAM_CHUNK_HEADER + sz)
+            break;
+        // copy chunk, callback can send next request
+        std::string chunk = client->streamBuffer.substr(SIZE_LIST_STREAM_CHUNK_HEADER, sz);
+        client->streamBuffer.erase(0, SIZE_LIST_STREAM_CHUNK_HEADER + sz);
+        parseResponse(client, (const unsigned char *) chunk.c_str(), (ssize_t) chunk.size());
     }
 }
 
@@ -117,7 +110,7 @@ static void onTCPRead(
 #ifdef ENABLE_DEBUG
         std::cerr << MSG_READ_BYTES << hexString(buf->base, nRead) << MSG_OPAREN << nRead << MSG_BYTES << MSG_CPAREN << std::endl;
 #endif
-        parseResponse(client, (const unsigned char *) buf->base, nRead);
+        parseTCPResponse(client, (const unsigned char *) buf->base, nRead);
     }
     freeBuffer(buf);
 }
@@ -295,7 +288,21 @@ UvClient::UvClient(
 void UvClient::initiateQuery()
 {
     query->ntoh();
-    size_t sz = query->serialize((unsigned char *) sendBuffer);
+    size_t sz;
+    if (query->requestId) {
+        // version 2, batch of one request
+        BatchWriter writer((unsigned char *) sendBuffer, sizeof(sendBuffer));
+        writer.add(*query);
+        sz = writer.size();
+    } else
+        sz = query->serialize((unsigned char *) sendBuffer);
+    send(sz);
+}
+
+void UvClient::send(
+    size_t sz
+)
+{
 #ifdef ENABLE_DEBUG
     std::cerr << MSG_QUERY << MSG_SPACE << sz << MSG_SPACE << MSG_BYTES;
     if (sz > 0)
@@ -350,6 +357,26 @@ ServiceMessage* UvClient::request(
     return r;
 }
 
+size_t UvClient::request(
+    const std::vector<ServiceMessage*> &values
+)
+{
+    BatchWriter writer((unsigned char *) sendBuffer, sizeof(sendBuffer));
+    size_t r = 0;
+    for (auto v : values) {
+        v->ntoh();
+        if (!writer.add(*v)) {
+            v->ntoh();  // restore host byte order
+            break;
+        }
+        query = v;
+        r++;
+    }
+    if (r)
+        send(writer.size());
+    return r;
+}
+
 void UvClient::start() {
     uv_run(loop, UV_RUN_DEFAULT);
     finish();
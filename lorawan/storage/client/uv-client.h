@@ -7,14 +7,16 @@ typedef SSIZE_T ssize_t;
 #endif
 
 #include <string>
+#include <vector>
 #include <uv.h>
 #include "query-client.h"
 
-#define SEND_BUFFER_SIZE 155
+// up to 9 assign requests in one batch frame
+#define SEND_BUFFER_SIZE 1432
 
 class UvClient : public QueryClient {
 private:
-    char sendBuffer[SEND_BUFFER_SIZE];    // max request size is 40 bytes
+    char sendBuffer[SEND_BUFFER_SIZE];    // max request size is 154 bytes
     bool useTcp;
     struct sockaddr serverAddress;
     uv_udp_t udpSocket;
@@ -29,9 +31,11 @@ private:
 
     void init();
     void initiateQuery();
+    void send(size_t sz);
 
 public:
     bool tcpConnected;
+    std::string streamBuffer;   ///< incomplete streaming list chunk received over TCP
     void *dataBuf;
     size_t dataSize;
 
@@ -51,6 +55,15 @@ public:
     ServiceMessage* request(
         ServiceMessage* value
     ) override;
+    /**
+     * Send requests in one batch frame (protocol version 2).
+     * Each request must have unique requestId, replies are returned with the same requestId.
+     * @param values requests
+     * @return count of requests sent, rest does not fit the buffer
+     */
+    size_t request(
+        const std::vector<ServiceMessage*> &values
+    );
     void start() override;
     void stop() override;
     void finish();
@@ -4,6 +4,7 @@
 
 #include "lorawan/lorawan-date.h"
 #include "lorawan/helper/ip-address.h"
+#include "lorawan/helper/json-writer.h"
 
 #if !defined(_MSC_VER) && !defined(__MINGW32__)
 #include "sys/un.h"
@@ -132,12 +133,20 @@ std::string GatewayIdentity::toString() const
  */
 std::string GatewayIdentity::toJsonString() const
 {
-    std::stringstream ss;
-    ss << "{"
-       << R"("gwid": ")" << std::hex << gatewayId
-       << R"(", "addr": ")" << sockaddr2string(&sockaddr)
-       << "\"}";
-    return ss.str();
+    std::string r;
+    JsonWriter writer(r);
+    toJson(writer);
+    return r;
+}
+
+void GatewayIdentity::toJson(
+    JsonWriter &writer
+) const
+{
+    char addr[SOCKADDR_STRLEN];
+    writer.raw(R"({"gwid": ")").hex(gatewayId)
+        .raw(R"(", "addr": ")").raw(addr, sockaddr2chars(addr, &sockaddr))
+        .raw("\"}");
 }
 
 /**
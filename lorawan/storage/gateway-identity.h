@@ -13,6 +13,8 @@ typedef int SOCKET;
 #include <netinet/in.h>
 #endif
 
+class JsonWriter;
+
 /** 
  * Gateway identity keep current gateway address got from the last PULL request.
  * There are also addr member to keep gateway address read from configuration file. This addr must never used.
@@ -36,6 +38,7 @@ public:
     GatewayIdentity& operator=(const GatewayIdentity &value);
 	std::string toString() const;
     std::string toJsonString() const;
+    void toJson(JsonWriter &writer) const;
 };
 
 class GatewayStatistic : public GatewayIdentity {
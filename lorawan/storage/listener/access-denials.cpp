@@ -0,0 +1,125 @@
+#include "lorawan/storage/listener/access-denials.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <WS2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+AccessDenialSource::AccessDenialSource()
+    : family(0), addr{}, count(0)
+{
+}
+
+bool AccessDenialSource::same(
+    uint16_t aFamily,
+    const unsigned char *aAddr
+) const
+{
+    return family == aFamily && memcmp(addr, aAddr, aFamily == AF_INET6 ? 16 : 4) == 0;
+}
+
+std::string AccessDenialSource::toString() const
+{
+    char s[64];
+    if (!inet_ntop(family, addr, s, sizeof(s)))
+        return "";
+    return s;
+}
+
+/**
+ * Client address without port
+ * @return false if address family is unknown
+ */
+static bool addressOf(
+    uint16_t &retFamily,
+    const unsigned char *&retAddr,
+    const struct sockaddr *source
+)
+{
+    if (!source)
+        return false;
+    retFamily = source->sa_family;
+    if (source->sa_family == AF_INET6)
+        retAddr = (const unsigned char *) &((const struct sockaddr_in6 *) source)->sin6_addr;
+    else if (source->sa_family == AF_INET)
+        retAddr = (const unsigned char *) &((const struct sockaddr_in *) source)->sin_addr;
+    else
+        return false;
+    return true;
+}
+
+AccessDenials::AccessDenials()
+    : denied(0)
+{
+}
+
+void AccessDenials::count(
+    const struct sockaddr *source
+)
+{
+    uint16_t family;
+    const unsigned char *addr;
+    bool known = addressOf(family, addr, source);
+    std::lock_guard<std::mutex> guard(lock);
+    denied++;
+    if (!known)
+        return;
+    AccessDenialSource *least = &sources[0];
+    for (auto &s : sources) {
+        if (s.same(family, addr)) {
+            s.count++;
+            return;
+        }
+        if (s.count < least->count)
+            least = &s;
+    }
+    least->family = family;
+    memmove(least->addr, addr, family == AF_INET6 ? 16 : 4);
+    least->count = 1;
+}
+
+uint64_t AccessDenials::denials(
+    const struct sockaddr *source
+)
+{
+    uint16_t family;
+    const unsigned char *addr;
+    if (!addressOf(family, addr, source))
+        return 0;
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &s : sources) {
+        if (s.same(family, addr))
+            return s.count;
+    }
+    return 0;
+}
+
+std::string AccessDenials::toString()
+{
+    std::vector<AccessDenialSource> top;
+    uint64_t total;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        total = denied;
+        for (auto &s : sources) {
+            if (s.count)
+                top.push_back(s);
+        }
+    }
+    std::sort(top.begin(), top.end(), [](const AccessDenialSource &a, const AccessDenialSource &b) {
+        return a.count > b.count;
+    });
+    std::stringstream ss;
+    ss << "access denied: " << total;
+    for (auto &s : top) {
+        ss << ", " << s.toString() << " " << s.count;
+    }
+    return ss.str();
+}
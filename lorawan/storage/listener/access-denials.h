@@ -0,0 +1,62 @@
+#ifndef ACCESS_DENIALS_H_
+#define ACCESS_DENIALS_H_	1
+
+#include <mutex>
+#include <string>
+#include <cinttypes>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <Winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+// client addresses with wrong credentials kept in the table
+#define DEF_ACCESS_DENIAL_SOURCES  64
+
+/**
+ * Client address without port and count of the denied requests
+ */
+class AccessDenialSource {
+public:
+    uint16_t family;            ///< AF_INET, AF_INET6, 0- empty slot
+    unsigned char addr[16];
+    uint64_t count;
+    AccessDenialSource();
+    bool same(uint16_t family, const unsigned char *addr) const;
+    std::string toString() const;
+};
+
+/**
+ * Requests denied by the header only credential check, counted for each client address.
+ * Table has fixed size, nothing is allocated when the request is denied.
+ * When the table is full the address with the least denials is replaced, flooding clients stay in the table.
+ */
+class AccessDenials {
+private:
+    AccessDenialSource sources[DEF_ACCESS_DENIAL_SOURCES];
+    std::mutex lock;
+public:
+    uint64_t denied;            ///< total
+
+    AccessDenials();
+    /**
+     * Count denied request
+     * @param source client address, NULL- unknown
+     */
+    void count(
+        const struct sockaddr *source
+    );
+    /**
+     * @return denied requests of the client address, 0- not in the table
+     */
+    uint64_t denials(
+        const struct sockaddr *source
+    );
+    /**
+     * @return total and client addresses with most denials first
+     */
+    std::string toString();
+};
+
+#endif
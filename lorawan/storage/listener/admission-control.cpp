@@ -0,0 +1,274 @@
+#include "lorawan/storage/listener/admission-control.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <WS2tcpip.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/gateway-binary-serialization.h"
+#include "lorawan/storage/serialization/list-stream.h"
+
+AdmissionLimit::AdmissionLimit()
+    : rate(0), burst(0)
+{
+}
+
+AdmissionLimit::AdmissionLimit(
+    double aRate,
+    double aBurst
+)
+    : rate(aRate), burst(aBurst < 1 ? 1 : aBurst)
+{
+}
+
+bool AdmissionLimit::unlimited() const
+{
+    return rate <= 0;
+}
+
+TokenBucket::TokenBucket()
+    : started(false), tokens(0)
+{
+}
+
+void TokenBucket::refill(
+    const AdmissionLimit &limit,
+    std::chrono::steady_clock::time_point now
+)
+{
+    if (!started) {
+        // new client starts with the full bucket
+        started = true;
+        tokens = limit.burst;
+        last = now;
+        return;
+    }
+    double seconds = std::chrono::duration<double>(now - last).count();
+    tokens = std::min(limit.burst, tokens + seconds * limit.rate);
+    last = now;
+}
+
+AdmissionClass admissionClass(
+    char tag
+)
+{
+    switch (tag) {
+        case QUERY_IDENTITY_LIST:
+        case QUERY_IDENTITY_FILTER:
+        case QUERY_IDENTITY_FORCE_SAVE:
+        case QUERY_IDENTITY_LIST_STREAM:
+        case QUERY_GATEWAY_LIST:
+        case QUERY_GATEWAY_FORCE_SAVE:
+        case QUERY_GATEWAY_LIST_STREAM:
+            return ADMISSION_SCAN;
+        default:
+            return ADMISSION_LOOKUP;
+    }
+}
+
+AdmissionControl::AdmissionControl()
+    : admitted(0), throttled(0)
+{
+}
+
+/**
+ * @return true if any request class is limited
+ */
+static bool isLimited(
+    const AdmissionLimit *limits
+)
+{
+    for (int c = 0; c < ADMISSION_CLASS_COUNT; c++) {
+        if (!limits[c].unlimited())
+            return true;
+    }
+    return false;
+}
+
+bool AdmissionControl::enabled() const
+{
+    return isLimited(addressLimit) || isLimited(accountLimit);
+}
+
+template <class K>
+AdmissionControl::BucketTable<K>::BucketTable()
+    : maxSize(DEF_ADMISSION_MAX_CLIENTS)
+{
+}
+
+template <class K>
+AdmissionControl::Buckets &AdmissionControl::BucketTable<K>::get(
+    const K &key
+)
+{
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        recent.splice(recent.begin(), recent, it->second.second);
+        return it->second.first;
+    }
+    if (entries.size() >= maxSize && !recent.empty()) {
+        // least recently seen client starts with the full bucket if it comes back
+        entries.erase(recent.back());
+        recent.pop_back();
+    }
+    recent.push_front(key);
+    auto &r = entries[key];
+    r.second = recent.begin();
+    return r.first;
+}
+
+void AdmissionControl::setMaxClients(
+    size_t maxClients
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    addresses.maxSize = maxClients < 1 ? 1 : maxClients;
+    accounts.maxSize = addresses.maxSize;
+}
+
+/**
+ * Client address without port
+ */
+static std::string addressKey(
+    const struct sockaddr *source
+)
+{
+    if (source->sa_family == AF_INET6)
+        return std::string((const char *) &((const struct sockaddr_in6 *) source)->sin6_addr, 16);
+    if (source->sa_family == AF_INET)
+        return std::string((const char *) &((const struct sockaddr_in *) source)->sin_addr, 4);
+    return "";
+}
+
+int AdmissionControl::admit(
+    const struct sockaddr *source,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (sz < SIZE_SERVICE_MESSAGE && !isBatchMessage(request, sz))
+        return CODE_OK; // invalid request is not answered anyway
+    double cost[ADMISSION_CLASS_COUNT] = { 0, 0 };
+    std::pair<int32_t, uint64_t> account(0, 0);
+    const unsigned char *header = request;
+    if (isBatchMessage(request, sz)) {
+        std::vector<BatchItem> items;
+        // items parsed before the end of the truncated frame are kept
+        parseBatch(items, request, sz);
+        for (auto &item : items) {
+            if (item.size)
+                cost[admissionClass((char) item.data[0])]++;
+        }
+        // account of the frame is the account of the first request
+        header = (!items.empty() && items[0].size >= SIZE_SERVICE_MESSAGE) ? items[0].data : nullptr;
+    } else
+        cost[admissionClass((char) request[0])]++;
+    if (header) {
+        memmove(&account.first, &header[1], sizeof(account.first));
+        memmove(&account.second, &header[1 + sizeof(account.first)], sizeof(account.second));
+        account.first = NTOH4(account.first);
+        account.second = NTOH8(account.second);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> guard(lock);
+    Buckets *b[2] = {
+        source && isLimited(addressLimit) ? &addresses.get(addressKey(source)) : nullptr,
+        isLimited(accountLimit) ? &accounts.get(account) : nullptr
+    };
+    AdmissionLimit *limits[2] = { addressLimit, accountLimit };
+    // check all buckets first, throttled request does not take tokens
+    for (int i = 0; i < 2; i++) {
+        if (!b[i])
+            continue;
+        for (int c = 0; c < ADMISSION_CLASS_COUNT; c++) {
+            if (cost[c] == 0 || limits[i][c].unlimited())
+                continue;
+            b[i]->bucket[c].refill(limits[i][c], now);
+            // batch costing more than the bucket size waits for the full bucket
+            if (b[i]->bucket[c].tokens < std::min(cost[c], limits[i][c].burst)) {
+                throttled++;
+                return ERR_CODE_THROTTLED;
+            }
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        if (!b[i])
+            continue;
+        for (int c = 0; c < ADMISSION_CLASS_COUNT; c++) {
+            if (cost[c] > 0 && !limits[i][c].unlimited())
+                b[i]->bucket[c].tokens -= cost[c];
+        }
+    }
+    admitted++;
+    return CODE_OK;
+}
+
+/**
+ * Serialize operation response with the error code
+ */
+static size_t errorOperationResponse(
+    unsigned char *retBuf,
+    char tag,
+    int code
+)
+{
+    IdentityOperationResponse r;
+    r.tag = tag;
+    r.code = code;
+    r.ntoh();
+    return r.serialize(retBuf);
+}
+
+size_t errorResponse(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz,
+    int code
+)
+{
+    if (isBatchMessage(request, sz)) {
+        std::vector<BatchItem> items;
+        parseBatch(items, request, sz);
+        BatchWriter writer(retBuf, retSize);
+        for (auto &item : items) {
+            unsigned char reply[SIZE_OPERATION_RESPONSE];
+            size_t rsz = item.size ? errorOperationResponse(reply, (char) item.data[0], code) : 0;
+            if (!writer.add(item.requestId, reply, rsz))
+                break;
+        }
+        return writer.size();
+    }
+    if (sz == 0 || retSize < SIZE_LIST_STREAM_CHUNK_HEADER + SIZE_OPERATION_RESPONSE)
+        return 0;
+    if (isListStreamRequest(request, sz)) {
+        // the only chunk with error code in the list reply
+        char listTag = request[0] == QUERY_IDENTITY_LIST_STREAM ? (char) QUERY_IDENTITY_LIST : (char) QUERY_GATEWAY_LIST;
+        size_t rsz = errorOperationResponse(retBuf + SIZE_LIST_STREAM_CHUNK_HEADER, listTag, code);
+        uint32_t len = HTON4((uint32_t) rsz);
+        retBuf[0] = request[0];
+        memmove(&retBuf[1], &len, sizeof(len));
+        return SIZE_LIST_STREAM_CHUNK_HEADER + rsz;
+    }
+    return errorOperationResponse(retBuf, (char) request[0], code);
+}
+
+size_t throttledResponse(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    return errorResponse(retBuf, retSize, request, sz, ERR_CODE_THROTTLED);
+}
@@ -0,0 +1,159 @@
+#ifndef ADMISSION_CONTROL_H_
+#define ADMISSION_CONTROL_H_	1
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <cinttypes>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <Winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+// least recently seen client buckets are removed when the table is full
+#define DEF_ADMISSION_MAX_CLIENTS   65536
+
+enum AdmissionClass {
+    ADMISSION_LOOKUP = 0,   ///< get, put, rm, count, next, journal, change feed
+    ADMISSION_SCAN = 1      ///< list, filter, streaming list, force save
+};
+#define ADMISSION_CLASS_COUNT   2
+
+/**
+ * Requests per second, 0- unlimited
+ */
+class AdmissionLimit {
+public:
+    double rate;
+    double burst;   ///< bucket size, requests admitted at once after idle period
+    AdmissionLimit();
+    AdmissionLimit(double rate, double burst);
+    bool unlimited() const;
+};
+
+/**
+ * Tokens can go below zero: request costing more than the bucket size is admitted with the full bucket,
+ * next requests wait until the debt is paid
+ */
+class TokenBucket {
+public:
+    bool started;
+    double tokens;
+    std::chrono::steady_clock::time_point last;
+    TokenBucket();
+    /**
+     * Add tokens accumulated since the last call
+     */
+    void refill(
+        const AdmissionLimit &limit,
+        std::chrono::steady_clock::time_point now
+    );
+};
+
+/**
+ * Token buckets for the lookups and scans of each client address and of each account
+ * (ServiceMessage code and access code of the request header).
+ * Request is admitted if both client address and account buckets have tokens,
+ * scans can not starve lookups because they are counted separately.
+ * Table is not used if there are no limits of its kind.
+ * Each table keeps at most DEF_ADMISSION_MAX_CLIENTS keys, new key replaces the least recently seen one.
+ */
+class AdmissionControl {
+private:
+    class Buckets {
+    public:
+        TokenBucket bucket[ADMISSION_CLASS_COUNT];
+    };
+    /**
+     * Buckets by key in the least recently seen order
+     */
+    template <class K>
+    class BucketTable {
+    public:
+        std::map<K, std::pair<Buckets, typename std::list<K>::iterator> > entries;
+        std::list<K> recent;    ///< most recently seen first
+        size_t maxSize;
+        BucketTable();
+        Buckets &get(const K &key);
+    };
+    BucketTable<std::string> addresses;
+    BucketTable<std::pair<int32_t, uint64_t> > accounts;   ///< code, access code
+    std::mutex lock;
+public:
+    AdmissionLimit addressLimit[ADMISSION_CLASS_COUNT];
+    AdmissionLimit accountLimit[ADMISSION_CLASS_COUNT];
+    // counters
+    uint64_t admitted;
+    uint64_t throttled;
+
+    AdmissionControl();
+    /**
+     * @return true if there are limits to check
+     */
+    bool enabled() const;
+    /**
+     * @param maxClients maximum count of client addresses (accounts) to keep buckets of
+     */
+    void setMaxClients(
+        size_t maxClients
+    );
+    /**
+     * Take tokens for the request (each item of the batch frame)
+     * @param source client address
+     * @param request serialized request
+     * @param sz request size
+     * @return CODE_OK- admitted, ERR_CODE_THROTTLED- rate limit exceeded
+     */
+    int admit(
+        const struct sockaddr *source,
+        const unsigned char *request,
+        size_t sz
+    );
+};
+
+/**
+ * @return request class of the request tag
+ */
+AdmissionClass admissionClass(
+    char tag
+);
+
+/**
+ * Serialize response with the error code to the request.
+ * Batch frame gets response for each item header received, streaming list gets one chunk with an error code.
+ * @param retBuf buffer to return serialized response
+ * @param retSize buffer size
+ * @param request serialized request, can be truncated
+ * @param sz request size
+ * @param code error code
+ * @return response size
+ */
+size_t errorResponse(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz,
+    int code
+);
+
+/**
+ * Serialize ERR_CODE_THROTTLED response to the request.
+ * Batch frame gets throttled response for each item, streaming list gets one chunk with an error code.
+ * @param retBuf buffer to return serialized response
+ * @param retSize buffer size
+ * @param request serialized request
+ * @param sz request size
+ * @return response size
+ */
+size_t throttledResponse(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+);
+
+#endif
@@ -0,0 +1,169 @@
+#include "http-cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#pragma warning(disable: 4996)
+#endif
+
+HTTPCachedFile::HTTPCachedFile()
+    : gzipped(false), loaded(false), modified(0), size(0)
+{
+
+}
+
+/**
+ * Entity tag is built from the file modification time and size
+ */
+static std::string mkETag(
+    time_t modified,
+    uint64_t size
+)
+{
+    std::stringstream ss;
+    ss << "\"" << std::hex << size << "-" << (uint64_t) modified << "\"";
+    return ss.str();
+}
+
+HTTPFileCache::HTTPFileCache(
+    size_t aMaxSize,
+    size_t aMaxFileSize
+)
+    : totalSize(0), maxSize(aMaxSize), maxFileSize(aMaxFileSize)
+{
+
+}
+
+std::shared_ptr<HTTPCachedFile> HTTPFileCache::get(
+    const std::string &fileName
+)
+{
+    struct stat st {};
+    bool gzipped = false;
+    std::string localFileName(fileName);
+    if (stat(localFileName.c_str(), &st) != 0) {
+        localFileName += ".gz";
+        if (stat(localFileName.c_str(), &st) != 0)
+            return nullptr;
+        gzipped = true;
+    }
+    if ((st.st_mode & S_IFMT) != S_IFREG)
+        return nullptr;
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = files.find(fileName);
+    if (it != files.end()) {
+        if (it->second->fileName == localFileName && it->second->modified == st.st_mtime
+            && it->second->size == (uint64_t) st.st_size)
+            return it->second;
+        // file changed
+        if (it->second->loaded)
+            totalSize -= it->second->content.size();
+        files.erase(it);
+    }
+
+    auto f = std::make_shared<HTTPCachedFile>();
+    f->fileName = localFileName;
+    f->gzipped = gzipped;
+    f->modified = st.st_mtime;
+    f->size = (uint64_t) st.st_size;
+    f->etag = mkETag(f->modified, f->size);
+    if (f->size <= maxFileSize && totalSize + f->size <= maxSize) {
+        std::ifstream strm(localFileName, std::ios::in | std::ios::binary);
+        if (strm.is_open()) {
+            f->content.resize((size_t) f->size);
+            strm.read(&f->content[0], (std::streamsize) f->size);
+            f->loaded = strm.gcount() == (std::streamsize) f->size;
+            if (!f->loaded)
+                f->content.clear();
+        }
+    }
+    if (f->loaded)
+        totalSize += f->content.size();
+    files[fileName] = f;
+    return f;
+}
+
+void HTTPFileCache::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    files.clear();
+    totalSize = 0;
+}
+
+HTTPResponseCache::HTTPResponseCache(
+    unsigned int aTtlMillis,
+    size_t aMaxEntries
+)
+    : gen(0), ttlMillis(aTtlMillis), maxEntries(aMaxEntries), hits(0), misses(0)
+{
+
+}
+
+bool HTTPResponseCache::get(
+    std::string &retValue,
+    const std::string &key
+)
+{
+    if (ttlMillis == 0)
+        return false;
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.expires < std::chrono::steady_clock::now()) {
+        misses++;
+        return false;
+    }
+    hits++;
+    retValue = it->second.value;
+    return true;
+}
+
+void HTTPResponseCache::removeExpired(
+    const std::chrono::steady_clock::time_point &now
+)
+{
+    for (auto it = entries.begin(); it != entries.end(); ) {
+        if (it->second.expires < now)
+            it = entries.erase(it);
+        else
+            it++;
+    }
+}
+
+uint64_t HTTPResponseCache::generation()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return gen;
+}
+
+void HTTPResponseCache::put(
+    const std::string &key,
+    const std::string &value,
+    uint64_t generation
+)
+{
+    if (ttlMillis == 0)
+        return;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> guard(lock);
+    // write is completed after the response was read, response may be stale
+    if (generation != gen)
+        return;
+    if (entries.size() >= maxEntries) {
+        removeExpired(now);
+        if (entries.size() >= maxEntries)
+            entries.clear();
+    }
+    Entry &e = entries[key];
+    e.value = value;
+    e.expires = now + std::chrono::milliseconds(ttlMillis);
+}
+
+void HTTPResponseCache::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+    gen++;
+}
@@ -0,0 +1,118 @@
+/*
+ * @file http-cache.h
+ */
+
+#ifndef HTTP_CACHE_H_
+#define HTTP_CACHE_H_	1
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <ctime>
+#include <cinttypes>
+
+/**
+ * Static web asset loaded in memory
+ */
+class HTTPCachedFile {
+public:
+    std::string fileName;   ///< local file name, ".gz" suffixed if gzipped
+    bool gzipped;           ///< file name has ".gz" suffix, send Content-Encoding header
+    bool loaded;            ///< false- file is too big, content is empty, read file from disk
+    std::string content;
+    std::string etag;       ///< quoted entity tag
+    time_t modified;
+    uint64_t size;
+    HTTPCachedFile();
+};
+
+/**
+ * In-memory cache of the static and gzipped web assets.
+ * File is re-validated by stat(2): modified or resized file is reloaded.
+ * Files bigger than maxFileSize are not loaded, just ETag is returned.
+ * Thread safe.
+ */
+class HTTPFileCache {
+private:
+    std::mutex lock;
+    std::map<std::string, std::shared_ptr<HTTPCachedFile>> files;
+    size_t totalSize;
+public:
+    size_t maxSize;         ///< 0- do not cache content
+    size_t maxFileSize;
+    explicit HTTPFileCache(
+        size_t maxSize = 16 * 1024 * 1024,
+        size_t maxFileSize = 1024 * 1024
+    );
+    /**
+     * Get file from the cache or load it from the disk.
+     * If file does not exist, try file with ".gz" suffix.
+     * @param fileName file name
+     * @return nullptr if file not found
+     */
+    std::shared_ptr<HTTPCachedFile> get(
+        const std::string &fileName
+    );
+    void clear();
+};
+
+/**
+ * Short-TTL cache of the read-only responses of one service keyed by request.
+ * clear() starts new generation, response read before clear() is not put.
+ * Thread safe.
+ */
+class HTTPResponseCache {
+private:
+    class Entry {
+    public:
+        std::string value;
+        std::chrono::steady_clock::time_point expires;
+    };
+    std::mutex lock;
+    std::map<std::string, Entry> entries;
+    uint64_t gen;
+    void removeExpired(
+        const std::chrono::steady_clock::time_point &now
+    );
+public:
+    unsigned int ttlMillis;    ///< 0- cache disabled
+    size_t maxEntries;
+    size_t hits;
+    size_t misses;
+    explicit HTTPResponseCache(
+        unsigned int ttlMillis = 1000,
+        size_t maxEntries = 4096
+    );
+    /**
+     * @param retValue cached response
+     * @param key request
+     * @return true if cached response is not expired
+     */
+    bool get(
+        std::string &retValue,
+        const std::string &key
+    );
+    /**
+     * Take generation before the service is queried
+     * @return current generation
+     */
+    uint64_t generation();
+    /**
+     * @param key request
+     * @param value response
+     * @param generation generation taken before the service is queried, response is dropped if cache is cleared since
+     */
+    void put(
+        const std::string &key,
+        const std::string &value,
+        uint64_t generation
+    );
+    /**
+     * Invalidate all responses e.g. after assign, remove
+     */
+    void clear();
+};
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "lorawan/lorawan-string.h"
 #include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/ndjson-stream.h"
 
 #include <sys/stat.h>
 #include <sstream>
@@ -23,9 +24,13 @@
 #endif
 
 #define MHD_START_FLAGS 	(MHD_USE_POLL | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_SUPPRESS_DATE_NO_CLOCK | MHD_USE_TCP_FASTOPEN | MHD_USE_TURBO)
+// thread pool requires select or epoll, let microhttpd choose the best one
+#define MHD_START_FLAGS_POOL 	(MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_SUPPRESS_DATE_NO_CLOCK | MHD_USE_TCP_FASTOPEN | MHD_USE_TURBO)
 #define DEF_HTML_INDEX_FILE_NAME "index.html"
 
 const static char *CE_GZIP = "gzip";
+// export credentials scheme of the Authorization header
+const static char *AUTH_SCHEME_CODE = "Code ";
 const static char *CT_HTML = "text/html;charset=UTF-8";
 const static char *CT_JSON = "text/javascript;charset=UTF-8";
 const static char *CT_KML = "application/vnd.google-earth.kml+xml";
@@ -36,6 +41,7 @@ const static char *CT_CSS = "text/css";
 const static char *CT_TEXT = "text/plain;charset=UTF-8";
 const static char *CT_TTF = "font/ttf";
 const static char *CT_BIN = "application/octet";
+const static char *CT_NDJSON = "application/x-ndjson";
 
 // Caution: version may be different, if microhttpd dependency not compiled, revise version humber
 #if MHD_VERSION <= 0x00096600
@@ -55,6 +61,8 @@ const static char *CT_BIN = "application/octet";
 #endif
 
 #define DEF_HTTP_PORT 4248
+// idle keep-alive connection timeout, seconds
+#define DEF_CONNECTION_TIMEOUT 30
 
 HTTPListener::HTTPListener(
     IdentitySerialization* aIdentitySerialization,
@@ -63,7 +71,8 @@ HTTPListener::HTTPListener(
 )
     : StorageListener(aIdentitySerialization, aSerializationWrapper),
       port(DEF_HTTP_PORT), log(nullptr), verbose(0), flags(MHD_START_FLAGS),
-      threadCount(1), connectionLimit(32768), descriptor(nullptr),
+      threadCount(1), connectionLimit(32768), connectionTimeout(DEF_CONNECTION_TIMEOUT), concurrentService(false),
+      descriptor(nullptr),
       mimeType(aIdentitySerialization ? aIdentitySerialization->mimeType() : serializationKnownType2MimeType(SKT_BINARY)),
       htmlRootDir(aHTMLRootDir)
 {
@@ -112,6 +121,7 @@ const static char* HDR_CORS_METHODS = "GET,HEAD,OPTIONS,POST,PUT,DELETE";
 const static char* HDR_CORS_HEADERS = "Authorization, Access-Control-Allow-Headers, Access-Control-Allow-Origin, "
 "Origin, Accept, X-Requested-With, Content-Type, Access-Control-Request-Method, Access-Control-Request-Headers";
 
+const static char* HTTP_ERROR_403 = "Forbidden";
 const static char* HTTP_ERROR_404 = "Not found";
 const static char* HTTP_ERROR_501 = "Not implemented";
 
@@ -197,50 +207,155 @@ static std::string buildFileName(
     return r.str();
 }
 
+/**
+ * Read cached file content. Cached file is kept alive until response is destroyed
+ */
+static ssize_t cached_file_reader_callback(
+    void *cls,
+    uint64_t pos,
+    char *buf,
+    size_t max
+)
+{
+    auto f = (std::shared_ptr<HTTPCachedFile> *) cls;
+    const std::string &content = (*f)->content;
+    if (pos >= content.size())
+        return MHD_CONTENT_READER_END_OF_STREAM;
+    size_t sz = std::min(max, (size_t) (content.size() - pos));
+    memmove(buf, content.c_str() + pos, sz);
+    return (ssize_t) sz;
+}
+
+static void free_cached_file_reader_callback(
+    void *cls
+)
+{
+    delete (std::shared_ptr<HTTPCachedFile> *) cls;
+}
+
 static MHD_Result processFile(
     struct MHD_Connection *connection,
+    HTTPFileCache &cache,
     const std::string &filename
 )
 {
     struct MHD_Response *response;
     MHD_Result ret;
-    FILE *file;
-    struct stat buf {};
-
-    const char *localFileName = filename.c_str();
-    bool gzipped = false;
-    if (stat(localFileName, &buf) == 0)
-        file = fopen(localFileName, "rb");
-    else {
-        std::string fnGzip(filename);
-        fnGzip += ".gz";
-        localFileName = fnGzip.c_str();
-        if (stat(localFileName, &buf) == 0) {
-            file = fopen(localFileName, "rb");
-            gzipped = true;
-        } else
-            file = nullptr;
-    }
-    if (file == nullptr) {
+
+    std::shared_ptr<HTTPCachedFile> f = cache.get(filename);
+    if (!f) {
         response = MHD_create_response_from_buffer(strlen(HTTP_ERROR_404), (void *) HTTP_ERROR_404, MHD_RESPMEM_PERSISTENT);
         ret = MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, response);
         MHD_destroy_response (response);
+        return ret;
+    }
+    // browser already has actual copy
+    const char *ifNoneMatch = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_NONE_MATCH);
+    if (ifNoneMatch && f->etag == ifNoneMatch) {
+        response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, f->etag.c_str());
+        ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+    if (f->loaded) {
+        auto cls = new std::shared_ptr<HTTPCachedFile>(f);
+        response = MHD_create_response_from_callback(f->size, 32 * 1024,
+            &cached_file_reader_callback, cls, &free_cached_file_reader_callback);
+        if (nullptr == response) {
+            delete cls;
+            return MHD_NO;
+        }
     } else {
-        response = MHD_create_response_from_callback(buf.st_size, 32 * 1024,
+        // too big to keep in memory
+        FILE *file = fopen(f->fileName.c_str(), "rb");
+        if (file == nullptr) {
+            response = MHD_create_response_from_buffer(strlen(HTTP_ERROR_404), (void *) HTTP_ERROR_404, MHD_RESPMEM_PERSISTENT);
+            ret = MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, response);
+            MHD_destroy_response (response);
+            return ret;
+        }
+        response = MHD_create_response_from_callback(f->size, 32 * 1024,
             &file_reader_callback, file, &free_file_reader_callback);
         if (nullptr == response) {
             fclose (file);
             return MHD_NO;
         }
-        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, mimeTypeByFileExtension(filename));
-        if (gzipped)
-            MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, CE_GZIP);
-        ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-        MHD_destroy_response(response);
     }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, mimeTypeByFileExtension(filename));
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, f->etag.c_str());
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-cache");
+    if (f->gzipped)
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, CE_GZIP);
+    ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
     return ret;
 }
 
+/**
+ * Return first letter of the "tag" value of the JSON request without parsing whole JSON
+ * @return 0 if "tag" not found
+ */
+static char jsonRequestTag(
+    const std::string &request
+)
+{
+    size_t p = request.find("\"tag\"");
+    if (p == std::string::npos)
+        return 0;
+    p += 5;
+    while (p < request.size() && (request[p] == ' ' || request[p] == '\t' || request[p] == '\r' || request[p] == '\n' || request[p] == ':'))
+        p++;
+    if (p + 1 >= request.size() || request[p] != '"')
+        return 0;
+    return request[p + 1];
+}
+
+/**
+ * Identity requests which responses can be cached for a short time: address, EUI, list, count, filter
+ */
+static bool isReadOnlyIdentityTag(
+    char tag
+)
+{
+    return tag == 'a' || tag == 'i' || tag == 'l' || tag == 'c' || tag == 'f';
+}
+
+/**
+ * Gateway requests which responses can be cached for a short time: address, identifier, list, count
+ */
+static bool isReadOnlyGatewayTag(
+    char tag
+)
+{
+    return tag == 'A' || tag == 'I' || tag == 'L' || tag == 'C';
+}
+
+/**
+ * Query identity service, then gateway service
+ * @param retIsGateway true if response is returned by the gateway service
+ * @return response size, 0- unknown request
+ */
+static size_t queryServices(
+    HTTPListener *l,
+    unsigned char *retBuf,
+    size_t retSize,
+    const std::string &request,
+    bool &retIsGateway
+)
+{
+    std::unique_lock<std::mutex> guard(l->serviceLock, std::defer_lock);
+    if (!l->concurrentService)
+        guard.lock();
+    retIsGateway = false;
+    size_t sz = l->identitySerialization->query(retBuf, retSize, (const unsigned char *) request.c_str(), request.size());
+    if (sz == 0 && l->gatewaySerialization) {
+        sz = l->gatewaySerialization->query(retBuf, retSize, (const unsigned char *) request.c_str(), request.size());
+        retIsGateway = sz > 0;
+    }
+    return sz;
+}
+
 static enum MHD_Result getAllQueryString(
     void *cls,
     enum MHD_ValueKind kind,
@@ -258,6 +373,135 @@ static enum MHD_Result getAllQueryString(
     return MHD_YES;
 }
 
+/**
+ * Export stream reads service from the pool thread
+ */
+class HTTPExportContext {
+public:
+    NDJSONStream *strm;
+    HTTPListener *listener;
+    ~HTTPExportContext() {
+        delete strm;
+    }
+};
+
+static ssize_t ndjson_reader_callback(
+    void *cls,
+    uint64_t pos,
+    char *buf,
+    size_t max
+)
+{
+    auto ctx = (HTTPExportContext *) cls;
+    std::unique_lock<std::mutex> guard(ctx->listener->serviceLock, std::defer_lock);
+    if (!ctx->listener->concurrentService)
+        guard.lock();
+    ssize_t r = ctx->strm->read(buf, max);
+    if (r == NDJSON_STREAM_END)
+        return MHD_CONTENT_READER_END_OF_STREAM;
+    if (r < 0)
+        return MHD_CONTENT_READER_END_WITH_ERROR;
+    return r;
+}
+
+static void free_ndjson_reader_callback(
+    void *cls
+)
+{
+    delete (HTTPExportContext *) cls;
+}
+
+/**
+ * Compare credentials of the "Authorization: Code <code>:<accessCode>" header with the service ones.
+ * Both values are hexadecimal, as the service prints them, e.g. "Authorization: Code 2a:2a"
+ */
+static bool checkHeaderCredentials(
+    struct MHD_Connection *connection,
+    int32_t code,
+    uint64_t accessCode
+)
+{
+    const char *h = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_AUTHORIZATION);
+    if (!h || strncmp(h, AUTH_SCHEME_CODE, strlen(AUTH_SCHEME_CODE)) != 0)
+        return false;
+    char *e;
+    const char *c = h + strlen(AUTH_SCHEME_CODE);
+    auto rCode = (int32_t) strtoll(c, &e, 16);
+    if (e == c || *e != ':')
+        return false;
+    const char *a = e + 1;
+    auto rAccessCode = (uint64_t) strtoull(a, &e, 16);
+    if (e == a || *e != '\0')
+        return false;
+    return code == rCode && accessCode == rAccessCode;
+}
+
+/**
+ * Stream all identities (/export/identity) or gateways (/export/gateway) as newline-delimited JSON.
+ * Chunked transfer encoding, optionally gzipped if client accepts gzip.
+ * Credentials of the exported service are passed in the header: "Authorization: Code 2a:2a"
+ * @return MHD_NO if URL is not export one
+ */
+static MHD_Result processExport(
+    struct MHD_Connection *connection,
+    HTTPListener *l,
+    const char *url,
+    bool &retProcessed
+)
+{
+    NDJSONStream *strm = nullptr;
+    bool isIdentity = strcmp(url, "/export/identity") == 0;
+    bool isGateway = strcmp(url, "/export/gateway") == 0;
+    retProcessed = isIdentity || isGateway;
+    if (!retProcessed)
+        return MHD_NO;
+
+    struct MHD_Response *response;
+    MHD_Result ret;
+    // each export is protected by credentials of its own service
+    bool allowed = isIdentity
+        ? l->identitySerialization
+            && checkHeaderCredentials(connection, l->identitySerialization->code, l->identitySerialization->accessCode)
+        : l->gatewaySerialization
+            && checkHeaderCredentials(connection, l->gatewaySerialization->code, l->gatewaySerialization->accessCode);
+    if (!allowed) {
+        response = MHD_create_response_from_buffer(strlen(HTTP_ERROR_403), (void *) HTTP_ERROR_403, MHD_RESPMEM_PERSISTENT);
+        ret = MHD_queue_response(connection, MHD_HTTP_FORBIDDEN, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+    const char *acceptEncoding = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+    bool gzip = acceptEncoding && strstr(acceptEncoding, CE_GZIP);
+    if (isIdentity && l->identitySerialization->svc)
+        strm = new IdentityNDJSONStream(l->identitySerialization->svc, gzip);
+    if (isGateway && l->gatewaySerialization && l->gatewaySerialization->svc)
+        strm = new GatewayNDJSONStream(l->gatewaySerialization->svc, gzip);
+    if (!strm) {
+        response = MHD_create_response_from_buffer(strlen(HTTP_ERROR_404), (void *) HTTP_ERROR_404, MHD_RESPMEM_PERSISTENT);
+        ret = MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+    bool gzipped = strm->gzipped();
+    auto ctx = new HTTPExportContext;
+    ctx->strm = strm;
+    ctx->listener = l;
+    // unknown size: chunked transfer encoding
+    response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 32 * 1024,
+        &ndjson_reader_callback, ctx, &free_ndjson_reader_callback);
+    if (!response) {
+        delete ctx;
+        return MHD_NO;
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, CT_NDJSON);
+    if (gzipped)
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, CE_GZIP);
+    addCORS(response);
+    ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
 #ifdef ENABLE_QRCODE
 typedef enum URN_TYPE {
     URN_TYPE_NONE = 0,
@@ -313,6 +557,16 @@ static MHD_Result cbRequest(
 
     int hc;
     auto *l = (HTTPListener *) cls;
+
+    if (strcmp(method, "GET") == 0) {
+        bool processed;
+        MHD_Result r = processExport(connection, l, url, processed);
+        if (processed) {
+            delete requestCtx;
+            *ptr = nullptr;
+            return r;
+        }
+    }
 #ifdef ENABLE_QRCODE
     URN_TYPE retSVG = URN_TYPE_NONE;
     if (strstr(url, "/qr")) {
@@ -345,23 +599,48 @@ static MHD_Result cbRequest(
             }
             std::cout << std::endl;
         }
-        if (l->identitySerialization) {
-            sz = l->identitySerialization->query(&rb[0], sizeof(rb),
-            (const unsigned char *) requestCtx->postData.c_str(), requestCtx->postData.size());
-            if (sz == 0) {
-                if (l->gatewaySerialization) {
-                    sz = l->gatewaySerialization->query(&rb[0], sizeof(rb),
-                        (const unsigned char *) requestCtx->postData.c_str(), requestCtx->postData.size());
-                }
-            }
+        std::string cachedResponse;
+        bool cached = false;
+        char tag = 0;
+        bool jsonIdentity = l->identitySerialization && l->identitySerialization->serializationType == SKT_TEXT_JSON;
+        if (jsonIdentity) {
+            tag = jsonRequestTag(requestCtx->postData);
+            if (isReadOnlyIdentityTag(tag))
+                cached = l->responseCache.get(cachedResponse, requestCtx->postData);
+            else if (isReadOnlyGatewayTag(tag))
+                cached = l->gatewayResponseCache.get(cachedResponse, requestCtx->postData);
+        }
+        if (cached) {
+            sz = std::min(cachedResponse.size(), sizeof(rb));
+            memmove(rb, cachedResponse.c_str(), sz);
+        } else if (l->identitySerialization) {
+            // responses read before the write are not cached after it
+            uint64_t identityGeneration = l->responseCache.generation();
+            uint64_t gatewayGeneration = l->gatewayResponseCache.generation();
+            bool isGateway;
+            sz = queryServices(l, &rb[0], sizeof(rb), requestCtx->postData, isGateway);
             if (sz == 0) {
                 if (!l->htmlRootDir.empty()) {
-                    MHD_Result r = processFile(connection, buildFileName(l->htmlRootDir.c_str(), url));
+                    MHD_Result r = processFile(connection, l->fileCache, buildFileName(l->htmlRootDir.c_str(), url));
                     delete requestCtx;
                     *ptr = nullptr;
                     return r;
                 }
             }
+            // writes invalidate cached responses of the service which processed the request only
+            if (jsonIdentity && sz > 0) {
+                if (isGateway) {
+                    if (isReadOnlyGatewayTag(tag))
+                        l->gatewayResponseCache.put(requestCtx->postData, std::string((const char *) rb, sz), gatewayGeneration);
+                    else
+                        l->gatewayResponseCache.clear();
+                } else {
+                    if (isReadOnlyIdentityTag(tag))
+                        l->responseCache.put(requestCtx->postData, std::string((const char *) rb, sz), identityGeneration);
+                    else
+                        l->responseCache.clear();   // assign, remove, force save: cached responses are stale
+                }
+            }
         }
         if (sz == 0) {
             hc = MHD_HTTP_NOT_FOUND;
@@ -403,17 +682,38 @@ static MHD_Result cbRequest(
 	return ret;
 }
 
+/**
+ * Free request context if request is aborted or connection closed before response
+ */
+static void cbRequestCompleted(
+    void *cls,
+    struct MHD_Connection *connection,
+    void **ptr,
+    enum MHD_RequestTerminationCode toe
+)
+{
+    auto *requestCtx = (RequestContext *) *ptr;
+    if (requestCtx) {
+        delete requestCtx;
+        *ptr = nullptr;
+    }
+}
+
 int HTTPListener::run()
 {
+    unsigned int f = flags;
+    if (threadCount > 1 && f == MHD_START_FLAGS)
+        f = MHD_START_FLAGS_POOL;
     struct MHD_Daemon *d = MHD_start_daemon(
-        flags, port, nullptr, nullptr,
+        f, port, nullptr, nullptr,
         &cbRequest, this,
-        MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int) 30,  // 30s timeout
+        MHD_OPTION_CONNECTION_TIMEOUT, connectionTimeout,   // idle keep-alive timeout
         MHD_OPTION_THREAD_POOL_SIZE, threadCount,
+        MHD_OPTION_NOTIFY_COMPLETED, &cbRequestCompleted, nullptr,
         // MHD_OPTION_URI_LOG_CALLBACK, &cbUriLogger, this,
         MHD_OPTION_CONNECTION_LIMIT, connectionLimit,
         MHD_OPTION_END
     );
     descriptor = (void *) d;
-    return CODE_OK;
+    return d ? CODE_OK : ERR_CODE_SOCKET_LISTEN;
 }
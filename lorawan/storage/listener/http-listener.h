@@ -6,6 +6,7 @@
 #define HTTP_LISTENER_H_	1
 
 #include <string>
+#include <mutex>
 #if defined(_MSC_VER) || defined(__MINGW32__)
 #include <WinSock2.h>
 #else
@@ -13,6 +14,7 @@
 #endif
 
 #include "storage-listener.h"
+#include "http-cache.h"
 
 class HTTPListener : public StorageListener {
 private:
@@ -21,8 +23,14 @@ private:
 public:
     int verbose;
     unsigned int flags;
-    unsigned int threadCount;
+    unsigned int threadCount;           ///< 1- one internal polling thread, >1- thread pool
     unsigned int connectionLimit;
+    unsigned int connectionTimeout;     ///< idle keep-alive connection timeout, seconds
+    HTTPFileCache fileCache;            ///< static web assets
+    HTTPResponseCache responseCache;    ///< read-only identity responses
+    HTTPResponseCache gatewayResponseCache; ///< read-only gateway responses
+    bool concurrentService;             ///< services are thread safe, false- pool threads query services one by one
+    std::mutex serviceLock;             ///< held by the query if services are not thread safe
     void *descriptor;   // HTTP daemon
     const char* mimeType;
     std::string htmlRootDir;
@@ -0,0 +1,852 @@
+#include "io-uring-listener.h"
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+#include <liburing.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include "lorawan/lorawan-string.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/lorawan-msg.h"
+#include "lorawan/helper/ip-address.h"
+#include "lorawan/storage/serialization/list-stream.h"
+#ifdef ENABLE_LIBUV
+#include "lorawan/storage/listener/uv-listener.h"
+#else
+#include "lorawan/storage/listener/udp-listener.h"
+#endif
+
+// submission/completion queue size
+#define RING_ENTRIES        1024
+// provided buffer ring, must be power of 2
+#define RECV_BUFFER_COUNT   1024
+#define RECV_BUFFER_SIZE    2048
+#define RECV_BUFFER_GROUP   1
+// registered send buffers. 307 bytes for IPv4 up to 18, IPv6 up to 10
+#define SEND_BUFFER_COUNT   512
+#define SEND_BUFFER_SIZE    1432
+#define LISTEN_BACKLOG      128
+// received bytes of the TCP connection waiting for processing, connection is closed if exceeded
+#define MAX_TCP_PENDING     (64 * 1024)
+
+// user_data: operation in the high byte, socket or send slot in the low 32 bits
+#define OP_UDP_RECV         1
+#define OP_TCP_ACCEPT       2
+#define OP_TCP_RECV         3
+#define OP_UDP_SEND         4
+#define OP_TCP_SEND         5
+#define OP_TCP_STREAM_SEND  6
+
+#define USER_DATA(op, v)    ((((uint64_t) (op)) << 56) | (uint32_t) (v))
+#define USER_DATA_OP(d)     ((int) ((d) >> 56))
+#define USER_DATA_VAL(d)    ((int) ((d) & 0xffffffff))
+
+/**
+ * Reply is in flight until completion: kernel reads message header, address and registered buffer
+ */
+struct IoUringSendSlot {
+    struct sockaddr_storage addr;
+    struct iovec iov;
+    struct msghdr msg;
+};
+
+#define RING ((struct io_uring *) ring)
+#define BUF_RING ((struct io_uring_buf_ring *) bufRing)
+
+/**
+ * Return SQE, flush submission queue if it is full
+ */
+static struct io_uring_sqe *getSQE(
+    struct io_uring *ring
+)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    if (!sqe) {
+        io_uring_submit(ring);
+        sqe = io_uring_get_sqe(ring);
+    }
+    return sqe;
+}
+
+IoUringConnection::IoUringConnection()
+    : slot(-1), size(0), sent(0), receiving(true), closing(false), peer {}
+{
+}
+
+IoUringListener::IoUringListener(
+    IdentitySerialization *aIdentitySerialization,
+    GatewaySerialization *aSerializationWrapper
+)
+    : StorageListener(aIdentitySerialization, aSerializationWrapper), destAddr({}), log(nullptr), verbose(0),
+    ring(nullptr), bufRing(nullptr), recvBuffers(nullptr), sendBuffers(nullptr), sendSlots(nullptr), recvMsg({}),
+    fallback(nullptr), udpSocket(-1), tcpSocket(-1), status(CODE_OK)
+{
+}
+
+IoUringListener::~IoUringListener()
+{
+    stop();
+    if (fallback)
+        delete fallback;
+}
+
+void IoUringListener::setLog(
+    int aVerbose,
+    Log *aLog
+)
+{
+    verbose = aVerbose;
+    log = aLog;
+}
+
+void IoUringListener::stop()
+{
+    status = ERR_CODE_STOPPED;
+    if (fallback)
+        fallback->stop();
+}
+
+void IoUringListener::setAddress(
+    const std::string &host,
+    uint16_t port
+)
+{
+    if (isAddrStringIPv6(host.c_str())) {
+        auto *a = (struct sockaddr_in6 *) &destAddr;
+        memset(&a->sin6_addr, 0, sizeof(a->sin6_addr));
+        a->sin6_family = AF_INET6;
+        a->sin6_port = htons(port);
+    } else {
+        auto *a = (struct sockaddr_in *) &destAddr;
+        a->sin_addr.s_addr = htonl(INADDR_ANY);
+        a->sin_family = AF_INET;
+        a->sin_port = htons(port);
+    }
+}
+
+void IoUringListener::setAddress(
+    uint32_t &ipv4,
+    uint16_t port
+)
+{
+    auto *a = (struct sockaddr_in *) &destAddr;
+    a->sin_family = AF_INET;
+    a->sin_addr.s_addr = ipv4;
+    a->sin_port = htons(port);
+}
+
+int IoUringListener::openSockets()
+{
+    int af = destAddr.ss_family == AF_INET6 ? AF_INET6 : AF_INET;
+    socklen_t addrLen = af == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    int opt = 1;
+
+    udpSocket = socket(af, SOCK_DGRAM, 0);
+    tcpSocket = socket(af, SOCK_STREAM, 0);
+    if (udpSocket < 0 || tcpSocket < 0) {
+        if (log) {
+            log->strm(LOG_ERR) << ERR_SOCKET_CREATE << MSG_SPACE << ERR_MESSAGE << errno;
+            log->flush();
+        }
+        return ERR_CODE_SOCKET_CREATE;
+    }
+    setsockopt(udpSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(tcpSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(tcpSocket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    if (af == AF_INET6) {
+        setsockopt(udpSocket, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
+        setsockopt(tcpSocket, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
+    }
+    if (bind(udpSocket, (struct sockaddr *) &destAddr, addrLen) < 0
+        || bind(tcpSocket, (struct sockaddr *) &destAddr, addrLen) < 0) {
+        if (log) {
+            log->strm(LOG_ERR) << ERR_SOCKET_BIND << MSG_SPACE << ERR_MESSAGE << errno;
+            log->flush();
+        }
+        return ERR_CODE_SOCKET_BIND;
+    }
+    if (listen(tcpSocket, LISTEN_BACKLOG) < 0) {
+        if (log) {
+            log->strm(LOG_ERR) << ERR_SOCKET_LISTEN << MSG_SPACE << ERR_MESSAGE << errno;
+            log->flush();
+        }
+        return ERR_CODE_SOCKET_LISTEN;
+    }
+    return CODE_OK;
+}
+
+void IoUringListener::closeSockets()
+{
+    if (udpSocket >= 0) {
+        close(udpSocket);
+        udpSocket = -1;
+    }
+    if (tcpSocket >= 0) {
+        shutdown(tcpSocket, SHUT_RDWR);
+        close(tcpSocket);
+        tcpSocket = -1;
+    }
+}
+
+int IoUringListener::initRing()
+{
+    auto r = new struct io_uring;
+    struct io_uring_params params {};
+    // single issuer: only run() thread submits, defer task work up to io_uring_wait_cqe (6.1)
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_COOP_TASKRUN;
+    int ret = io_uring_queue_init_params(RING_ENTRIES, r, &params);
+    if (ret < 0) {
+        // kernel 6.0 accepts single issuer, it has multishot recv and recvmsg too.
+        // Older kernel rejects it, io_uring disabled by sysctl or seccomp fails too
+        params = {};
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+        ret = io_uring_queue_init_params(RING_ENTRIES, r, &params);
+    }
+    if (ret < 0) {
+        delete r;
+        return ERR_CODE_IO_URING_INIT;
+    }
+    ring = r;
+    // socket operations must be poll driven, not punted to io workers
+    if (!(params.features & IORING_FEAT_FAST_POLL)) {
+        doneRing();
+        return ERR_CODE_IO_URING_INIT;
+    }
+
+    // provided buffer ring for all receive operations
+    bufRing = io_uring_setup_buf_ring(r, RECV_BUFFER_COUNT, RECV_BUFFER_GROUP, 0, &ret);
+    if (!bufRing) {
+        doneRing();
+        return ERR_CODE_IO_URING_INIT;
+    }
+    recvBuffers = (unsigned char *) malloc(RECV_BUFFER_COUNT * RECV_BUFFER_SIZE);
+    sendBuffers = (unsigned char *) malloc(SEND_BUFFER_COUNT * SEND_BUFFER_SIZE);
+    sendSlots = new IoUringSendSlot[SEND_BUFFER_COUNT];
+    if (!recvBuffers || !sendBuffers) {
+        doneRing();
+        return ERR_CODE_IO_URING_INIT;
+    }
+    int mask = io_uring_buf_ring_mask(RECV_BUFFER_COUNT);
+    for (int i = 0; i < RECV_BUFFER_COUNT; i++) {
+        io_uring_buf_ring_add(BUF_RING, recvBuffers + i * RECV_BUFFER_SIZE, RECV_BUFFER_SIZE, i, mask, i);
+    }
+    io_uring_buf_ring_advance(BUF_RING, RECV_BUFFER_COUNT);
+
+    // register send buffers, kernel does not map pages on each reply
+    struct iovec iovs[SEND_BUFFER_COUNT];
+    freeSendSlots.clear();
+    freeSendSlots.reserve(SEND_BUFFER_COUNT);
+    for (int i = 0; i < SEND_BUFFER_COUNT; i++) {
+        iovs[i].iov_base = sendBuffers + i * SEND_BUFFER_SIZE;
+        iovs[i].iov_len = SEND_BUFFER_SIZE;
+        freeSendSlots.push_back(i);
+    }
+    if (io_uring_register_buffers(r, iovs, SEND_BUFFER_COUNT) < 0) {
+        doneRing();
+        return ERR_CODE_IO_URING_INIT;
+    }
+
+    // multishot recvmsg reserves space for the source address in each provided buffer
+    recvMsg = {};
+    recvMsg.msg_namelen = sizeof(struct sockaddr_storage);
+    return CODE_OK;
+}
+
+void IoUringListener::doneRing()
+{
+    if (ring) {
+        if (bufRing)
+            io_uring_free_buf_ring(RING, BUF_RING, RECV_BUFFER_COUNT, RECV_BUFFER_GROUP);
+        io_uring_queue_exit(RING);
+        delete RING;
+    }
+    ring = nullptr;
+    bufRing = nullptr;
+    if (recvBuffers)
+        free(recvBuffers);
+    recvBuffers = nullptr;
+    if (sendBuffers)
+        free(sendBuffers);
+    sendBuffers = nullptr;
+    if (sendSlots)
+        delete[] sendSlots;
+    sendSlots = nullptr;
+    freeSendSlots.clear();
+}
+
+void IoUringListener::armUDPRecv()
+{
+    struct io_uring_sqe *sqe = getSQE(RING);
+    if (!sqe)
+        return;
+    io_uring_prep_recvmsg_multishot(sqe, udpSocket, &recvMsg, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    io_uring_sqe_set_data64(sqe, USER_DATA(OP_UDP_RECV, udpSocket));
+}
+
+void IoUringListener::armTCPAccept()
+{
+    struct io_uring_sqe *sqe = getSQE(RING);
+    if (!sqe)
+        return;
+    io_uring_prep_multishot_accept(sqe, tcpSocket, nullptr, nullptr, 0);
+    io_uring_sqe_set_data64(sqe, USER_DATA(OP_TCP_ACCEPT, tcpSocket));
+}
+
+void IoUringListener::armTCPRecv(
+    int fd
+)
+{
+    struct io_uring_sqe *sqe = getSQE(RING);
+    if (!sqe)
+        return;
+    io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    io_uring_sqe_set_data64(sqe, USER_DATA(OP_TCP_RECV, fd));
+}
+
+/**
+ * Give provided buffer back to the kernel
+ * @param bufferId buffer index
+ */
+void IoUringListener::recycleBuffer(
+    int bufferId
+)
+{
+    io_uring_buf_ring_add(BUF_RING, recvBuffers + bufferId * RECV_BUFFER_SIZE, RECV_BUFFER_SIZE, bufferId,
+        io_uring_buf_ring_mask(RECV_BUFFER_COUNT), 0);
+    io_uring_buf_ring_advance(BUF_RING, 1);
+}
+
+/**
+ * @return send slot index, -1 if all replies are in flight
+ */
+int IoUringListener::allocSendSlot()
+{
+    if (freeSendSlots.empty())
+        return -1;
+    int r = freeSendSlots.back();
+    freeSendSlots.pop_back();
+    return r;
+}
+
+void IoUringListener::onUDPRecv(
+    int res,
+    unsigned int flags
+)
+{
+    if (!(flags & IORING_CQE_F_MORE))
+        armUDPRecv();   // multishot terminated e.g. no provided buffers left (-ENOBUFS), re-arm
+    if (res < 0 || !(flags & IORING_CQE_F_BUFFER)) {
+        if (res != -ENOBUFS && log) {
+            log->strm(LOG_ERR) << ERR_SOCKET_READ << MSG_SPACE << ERR_MESSAGE << -res;
+            log->flush();
+        }
+        return;
+    }
+    int bid = (int) (flags >> IORING_CQE_BUFFER_SHIFT);
+    unsigned char *buf = recvBuffers + bid * RECV_BUFFER_SIZE;
+    struct io_uring_recvmsg_out *o = io_uring_recvmsg_validate(buf, res, &recvMsg);
+    if (!o || (o->flags & MSG_TRUNC)) {
+        recycleBuffer(bid);
+        return;
+    }
+    auto payload = (const unsigned char *) io_uring_recvmsg_payload(o, &recvMsg);
+    unsigned int len = io_uring_recvmsg_payload_length(o, res, &recvMsg);
+    if (log && verbose > 1) {
+        log->strm(LOG_INFO) << MSG_RECEIVED << len << MSG_SPACE << MSG_BYTES << MSG_COLON_N_SPACE << hexString(payload, len);
+        log->flush();
+    }
+    int slot = allocSendSlot();
+    if (slot < 0) {
+        // all send buffers are in flight, drop datagram, client retransmits
+        recycleBuffer(bid);
+        return;
+    }
+    unsigned char *sendBuf = sendBuffers + slot * SEND_BUFFER_SIZE;
+    size_t sz = len > 0 ? query(sendBuf, SEND_BUFFER_SIZE, payload, len,
+        (const struct sockaddr *) io_uring_recvmsg_name(o)) : 0;
+    if (sz == 0) {
+        if (log && verbose) {
+            log->strm(LOG_ERR) << ERR_INVALID_PACKET << ": " << hexString(payload, len)
+                << " (" << len << MSG_SPACE << MSG_BYTES << ")";
+            log->flush();
+        }
+        recycleBuffer(bid);
+        freeSendSlots.push_back(slot);
+        return;
+    }
+    IoUringSendSlot &s = sendSlots[slot];
+    memmove(&s.addr, io_uring_recvmsg_name(o), o->namelen < sizeof(s.addr) ? o->namelen : sizeof(s.addr));
+    recycleBuffer(bid);
+
+    s.iov.iov_base = sendBuf;
+    s.iov.iov_len = sz;
+    s.msg = {};
+    s.msg.msg_name = &s.addr;
+    s.msg.msg_namelen = o->namelen < sizeof(s.addr) ? o->namelen : sizeof(s.addr);
+    s.msg.msg_iov = &s.iov;
+    s.msg.msg_iovlen = 1;
+
+    struct io_uring_sqe *sqe = getSQE(RING);
+    if (!sqe) {
+        freeSendSlots.push_back(slot);
+        return;
+    }
+    io_uring_prep_sendmsg(sqe, udpSocket, &s.msg, 0);
+    io_uring_sqe_set_data64(sqe, USER_DATA(OP_UDP_SEND, slot));
+}
+
+void IoUringListener::onTCPAccept(
+    int res,
+    unsigned int flags
+)
+{
+    if (!(flags & IORING_CQE_F_MORE) && status != ERR_CODE_STOPPED)
+        armTCPAccept();
+    if (res < 0) {
+        if (log && verbose) {
+            log->strm(LOG_ERR) << ERR_SOCKET_CREATE << MSG_SPACE << ERR_MESSAGE << -res;
+            log->flush();
+        }
+        return;
+    }
+    int opt = 1;
+    setsockopt(res, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    if (log && verbose > 1) {
+        log->strm(LOG_INFO) << MSG_CONNECTED;
+        log->flush();
+    }
+    IoUringConnection &c = connections[res];
+    c = IoUringConnection();
+    // multishot accept does not return the address, it is read once for the client limits and denials
+    socklen_t peerSize = sizeof(c.peer);
+    getpeername(res, (struct sockaddr *) &c.peer, &peerSize);
+    armTCPRecv(res);
+}
+
+void IoUringListener::onTCPRecv(
+    int fd,
+    int res,
+    unsigned int flags
+)
+{
+    auto it = connections.find(fd);
+    if (res <= 0) {
+        // -ENOBUFS: all provided buffers are in use, re-arm
+        if (res == -ENOBUFS) {
+            armTCPRecv(fd);
+            return;
+        }
+        // client disconnected or socket is shut down
+        if (it != connections.end()) {
+            it->second.receiving = false;
+            closeConnection(fd);
+        }
+        return;
+    }
+    if (!(flags & IORING_CQE_F_MORE))
+        armTCPRecv(fd);
+    if (!(flags & IORING_CQE_F_BUFFER))
+        return;
+    int bid = (int) (flags >> IORING_CQE_BUFFER_SHIFT);
+    const unsigned char *buf = recvBuffers + bid * RECV_BUFFER_SIZE;
+    if (it == connections.end() || it->second.closing) {
+        recycleBuffer(bid);
+        return;
+    }
+    if (log && verbose > 1) {
+        log->strm(LOG_INFO) << MSG_RECEIVED << res << MSG_SPACE << MSG_BYTES << MSG_COLON_N_SPACE << hexString(buf, res);
+        log->flush();
+    }
+    IoUringConnection &c = it->second;
+    if (c.rx.size() + res > MAX_TCP_PENDING) {
+        // client does not read replies or sends garbage
+        recycleBuffer(bid);
+        if (log && verbose) {
+            log->strm(LOG_ERR) << ERR_INVALID_PACKET << " (" << c.rx.size() + res << MSG_SPACE << MSG_BYTES << ")";
+            log->flush();
+        }
+        c.rx.clear();
+        closeConnection(fd);
+        return;
+    }
+    // TCP segment may contain a part of the request or several requests
+    c.rx.append((const char *) buf, res);
+    recycleBuffer(bid);
+    processRequests(fd);
+}
+
+/**
+ * Process complete requests received from the client one by one.
+ * Stop when the reply is in flight, streaming list is running or the rest of request is not received yet.
+ */
+void IoUringListener::processRequests(
+    int fd
+)
+{
+    auto it = connections.find(fd);
+    if (it == connections.end())
+        return;
+    IoUringConnection &c = it->second;
+    while (c.slot < 0 && !c.closing && !c.rx.empty() && streams.find(fd) == streams.end()) {
+        auto request = (const unsigned char *) c.rx.data();
+        size_t sz = requestFrameSize(request, c.rx.size());
+        if (sz == 0)
+            return;
+        int slot = allocSendSlot();
+        if (slot < 0) {
+            // all send buffers are in flight, wait for any completion
+            stalled.push_back(fd);
+            return;
+        }
+        unsigned char *sendBuf = sendBuffers + slot * SEND_BUFFER_SIZE;
+        auto peer = (const struct sockaddr *) &c.peer;
+        size_t r;
+        if (isListStreamRequest(request, sz) && !isAccessDenied(request, sz)) {
+            r = 0;
+            ListStream *cursor = nullptr;
+            if (admit(request, sz, peer))
+                cursor = createListStream(identitySerialization, gatewaySerialization, request, sz);
+            else
+                r = throttledResponse(sendBuf, SEND_BUFFER_SIZE, request, sz);
+            if (cursor) {
+                // chunks are written from the slots taken by the stream
+                freeSendSlots.push_back(slot);
+                c.rx.erase(0, sz);
+                IoUringListStream &stream = streams[fd];
+                stream.cursor = cursor;
+                stream.slot = -1;
+                stream.size = 0;
+                stream.sent = 0;
+                stream.failed = false;
+                pumpStream(fd);
+                return;
+            }
+        } else
+            r = query(sendBuf, SEND_BUFFER_SIZE, request, sz, peer);
+        c.rx.erase(0, sz);
+        if (r == 0) {
+            freeSendSlots.push_back(slot);
+            continue;
+        }
+        c.slot = slot;
+        c.size = r;
+        c.sent = 0;
+        writeReply(fd, c);
+    }
+}
+
+/**
+ * Submit write of the rest of reply
+ */
+void IoUringListener::writeReply(
+    int fd,
+    IoUringConnection &connection
+)
+{
+    struct io_uring_sqe *sqe = getSQE(RING);
+    if (!sqe) {
+        freeSendSlots.push_back(connection.slot);
+        connection.slot = -1;
+        return;
+    }
+    unsigned char *sendBuf = sendBuffers + connection.slot * SEND_BUFFER_SIZE;
+    io_uring_prep_write_fixed(sqe, fd, sendBuf + connection.sent, (unsigned int) (connection.size - connection.sent),
+        0, connection.slot);
+    io_uring_sqe_set_data64(sqe, USER_DATA(OP_TCP_SEND, fd));
+}
+
+void IoUringListener::onReplySent(
+    int fd,
+    int res
+)
+{
+    auto it = connections.find(fd);
+    if (it == connections.end())
+        return;
+    IoUringConnection &c = it->second;
+    if (res > 0 && c.sent + res < c.size) {
+        // short write, send the rest from the same slot
+        c.sent += res;
+        writeReply(fd, c);
+        return;
+    }
+    freeSendSlots.push_back(c.slot);
+    c.slot = -1;
+    if (res < 0) {
+        if (log && verbose) {
+            log->strm(LOG_ERR) << ERR_SOCKET_WRITE << MSG_SPACE << ERR_MESSAGE << -res;
+            log->flush();
+        }
+        closeConnection(fd);
+        return;
+    }
+    if (c.closing)
+        closeConnection(fd);
+    else
+        processRequests(fd);
+}
+
+/**
+ * Shut down the connection and close socket when receive, reply and stream chunk are completed,
+ * socket number is not reused while its completions are pending
+ */
+void IoUringListener::closeConnection(
+    int fd
+)
+{
+    auto it = connections.find(fd);
+    if (it == connections.end())
+        return;
+    IoUringConnection &c = it->second;
+    c.closing = true;
+    if (c.receiving) {
+        // recv completes with 0 and calls it again
+        shutdown(fd, SHUT_RDWR);
+        return;
+    }
+    if (c.slot >= 0)
+        return;
+    auto s = streams.find(fd);
+    if (s != streams.end()) {
+        if (s->second.slot >= 0)
+            return;
+        endStream(fd);
+    }
+    connections.erase(it);
+    close(fd);
+}
+
+/**
+ * Submit write of the rest of chunk
+ */
+void IoUringListener::writeStreamChunk(
+    int fd,
+    IoUringListStream &stream
+)
+{
+    struct io_uring_sqe *sqe = getSQE(RING);
+    if (!sqe) {
+        freeSendSlots.push_back(stream.slot);
+        stream.slot = -1;
+        stream.failed = true;
+        return;
+    }
+    unsigned char *sendBuf = sendBuffers + stream.slot * SEND_BUFFER_SIZE;
+    io_uring_prep_write_fixed(sqe, fd, sendBuf + stream.sent, (unsigned int) (stream.size - stream.sent), 0, stream.slot);
+    io_uring_sqe_set_data64(sqe, USER_DATA(OP_TCP_STREAM_SEND, fd));
+}
+
+/**
+ * Produce and write next chunk if previous one is sent
+ */
+void IoUringListener::pumpStream(
+    int fd
+)
+{
+    auto it = streams.find(fd);
+    if (it == streams.end())
+        return;
+    IoUringListStream &stream = it->second;
+    auto c = connections.find(fd);
+    bool closing = c == connections.end() || c->second.closing;
+    if (stream.slot < 0 && !stream.failed && !closing && !stream.cursor->isFinished()) {
+        int slot = allocSendSlot();
+        if (slot < 0) {
+            // all send buffers are in flight, wait for any completion
+            stalled.push_back(fd);
+            return;
+        }
+        size_t sz = stream.cursor->next(sendBuffers + slot * SEND_BUFFER_SIZE, SEND_BUFFER_SIZE);
+        if (sz == 0) {
+            freeSendSlots.push_back(slot);
+            stream.failed = true;
+        } else {
+            stream.slot = slot;
+            stream.size = sz;
+            stream.sent = 0;
+            writeStreamChunk(fd, stream);
+        }
+    }
+    if (stream.slot < 0 && (stream.failed || closing || stream.cursor->isFinished())) {
+        endStream(fd);
+        // requests received after the stream request
+        if (closing)
+            closeConnection(fd);
+        else
+            processRequests(fd);
+    }
+}
+
+void IoUringListener::onStreamSent(
+    int fd,
+    int res
+)
+{
+    auto it = streams.find(fd);
+    if (it == streams.end())
+        return;
+    IoUringListStream &stream = it->second;
+    if (res > 0 && stream.sent + res < stream.size) {
+        // short write, send the rest from the same slot
+        stream.sent += res;
+        writeStreamChunk(fd, stream);
+        return;
+    }
+    if (res < 0) {
+        if (log && verbose) {
+            log->strm(LOG_ERR) << ERR_SOCKET_WRITE << MSG_SPACE << ERR_MESSAGE << -res;
+            log->flush();
+        }
+        stream.failed = true;
+    }
+    freeSendSlots.push_back(stream.slot);
+    stream.slot = -1;
+    pumpStream(fd);
+}
+
+void IoUringListener::endStream(
+    int fd
+)
+{
+    auto it = streams.find(fd);
+    if (it == streams.end())
+        return;
+    delete it->second.cursor;
+    streams.erase(it);
+}
+
+int IoUringListener::run()
+{
+    status = CODE_OK;
+    int r = openSockets();
+    if (r) {
+        closeSockets();
+        status = r;
+        return r;
+    }
+    r = initRing();
+    if (r) {
+        if (log) {
+            log->strm(LOG_ERR) << ERR_IO_URING_INIT;
+            log->flush();
+        }
+        closeSockets();
+        return runFallback();
+    }
+    armUDPRecv();
+    armTCPAccept();
+
+    while (status != ERR_CODE_STOPPED) {
+        struct io_uring_cqe *cqe;
+        // check stop request each second
+        struct __kernel_timespec ts { 1, 0 };
+        int ret = io_uring_submit_and_wait_timeout(RING, &cqe, 1, &ts, nullptr);
+        if (ret < 0 && ret != -ETIME && ret != -EINTR) {
+            if (log) {
+                log->strm(LOG_ERR) << ERR_SOCKET_READ << MSG_SPACE << ERR_MESSAGE << -ret;
+                log->flush();
+            }
+            r = ERR_CODE_SOCKET_READ;
+            break;
+        }
+        unsigned int head;
+        unsigned int count = 0;
+        io_uring_for_each_cqe(RING, head, cqe) {
+            count++;
+            uint64_t d = io_uring_cqe_get_data64(cqe);
+            switch (USER_DATA_OP(d)) {
+                case OP_UDP_RECV:
+                    onUDPRecv(cqe->res, cqe->flags);
+                    break;
+                case OP_TCP_ACCEPT:
+                    onTCPAccept(cqe->res, cqe->flags);
+                    break;
+                case OP_TCP_RECV:
+                    onTCPRecv(USER_DATA_VAL(d), cqe->res, cqe->flags);
+                    break;
+                case OP_TCP_SEND:
+                    onReplySent(USER_DATA_VAL(d), cqe->res);
+                    break;
+                case OP_UDP_SEND:
+                    if (cqe->res < 0 && log && verbose) {
+                        log->strm(LOG_ERR) << ERR_SOCKET_WRITE << MSG_SPACE << ERR_MESSAGE << -cqe->res;
+                        log->flush();
+                    }
+                    freeSendSlots.push_back(USER_DATA_VAL(d));
+                    break;
+                case OP_TCP_STREAM_SEND:
+                    onStreamSent(USER_DATA_VAL(d), cqe->res);
+                    break;
+                default:
+                    break;
+            }
+        }
+        io_uring_cq_advance(RING, count);
+        // resume connections and streams waiting for a send slot
+        while (!stalled.empty() && !freeSendSlots.empty()) {
+            int fd = stalled.back();
+            stalled.pop_back();
+            if (streams.find(fd) != streams.end())
+                pumpStream(fd);
+            else
+                processRequests(fd);
+        }
+    }
+    for (auto &stream : streams) {
+        delete stream.second.cursor;
+    }
+    streams.clear();
+    stalled.clear();
+    // pending operations are cancelled by io_uring_queue_exit()
+    for (auto &c : connections) {
+        shutdown(c.first, SHUT_RDWR);
+        close(c.first);
+    }
+    connections.clear();
+    closeSockets();
+    doneRing();
+    return r;
+}
+
+/**
+ * Serve by the default listener on the same address
+ */
+int IoUringListener::runFallback()
+{
+    if (log) {
+        log->strm(LOG_ERR) << MSG_IO_URING_FALLBACK;
+        log->flush();
+    }
+#ifdef ENABLE_LIBUV
+    fallback = new UVListener(identitySerialization, gatewaySerialization);
+#else
+    fallback = new UDPListener(identitySerialization, gatewaySerialization);
+#endif
+    fallback->changeLog = changeLog;
+    fallback->admission = admission;
+    fallback->denials = denials;
+    fallback->scheduler = scheduler;
+    fallback->setLog(verbose, log);
+    uint16_t port;
+    if (destAddr.ss_family == AF_INET6) {
+        port = ntohs(((struct sockaddr_in6 *) &destAddr)->sin6_port);
+        fallback->setAddress("::", port);
+    } else {
+        auto *a = (struct sockaddr_in *) &destAddr;
+        uint32_t ipv4 = a->sin_addr.s_addr;
+        port = ntohs(a->sin_port);
+        fallback->setAddress(ipv4, port);
+    }
+    if (status == ERR_CODE_STOPPED)
+        return CODE_OK;
+    return fallback->run();
+}
@@ -0,0 +1,112 @@
+#ifndef IO_URING_LISTENER_H_
+#define IO_URING_LISTENER_H_	1
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/socket.h>
+
+#include "lorawan/storage/listener/storage-listener.h"
+
+struct IoUringSendSlot;
+class ListStream;
+
+/**
+ * Streaming list on the TCP connection. One chunk is in flight, TCP writes are not reordered,
+ * next chunk is produced when previous one is sent.
+ */
+class IoUringListStream {
+public:
+    ListStream *cursor;
+    int slot;           ///< send slot in flight, -1- none
+    size_t size;        ///< chunk size
+    size_t sent;        ///< bytes sent (short write)
+    bool failed;
+};
+
+/**
+ * Accepted TCP connection. Requests are split by size from the received bytes and answered one by one,
+ * next request is processed when reply to the previous one is sent, so replies are not reordered.
+ */
+class IoUringConnection {
+public:
+    std::string rx;     ///< received bytes of the requests not processed yet
+    int slot;           ///< send slot of the reply in flight, -1- none
+    size_t size;        ///< reply size
+    size_t sent;        ///< bytes sent (short write)
+    bool receiving;     ///< multishot recv is armed
+    bool closing;       ///< close socket when nothing is in flight
+    struct sockaddr_storage peer;   ///< client address, read once on accept
+    IoUringConnection();
+};
+
+/**
+ * Linux io_uring UDP/TCP listener.
+ * UDP datagrams are received by one multishot recvmsg, TCP connections by multishot accept and
+ * multishot recv, all of them pick up buffers from the kernel provided buffer ring.
+ * Replies are written from the registered (fixed) send buffers.
+ * Requires Linux kernel 6.0 or newer, on older kernels or if io_uring is disabled run() falls back
+ * to the default listener.
+ */
+class IoUringListener : public StorageListener {
+private:
+    struct sockaddr_storage destAddr;
+    Log *log;
+    int verbose;
+    // liburing ring, provided buffer ring and buffers
+    void *ring;
+    void *bufRing;
+    unsigned char *recvBuffers;
+    unsigned char *sendBuffers;
+    IoUringSendSlot *sendSlots;
+    struct msghdr recvMsg;
+    std::vector<int> freeSendSlots;
+    std::map<int, IoUringConnection> connections;   ///< accepted sockets
+    std::map<int, IoUringListStream> streams;   ///< streaming lists by socket
+    std::vector<int> stalled;                   ///< sockets waiting for a free send slot
+    StorageListener *fallback;                  ///< default listener if io_uring is not available
+    int udpSocket;
+    int tcpSocket;
+
+    int openSockets();
+    void closeSockets();
+    int initRing();
+    void doneRing();
+    void armUDPRecv();
+    void armTCPAccept();
+    void armTCPRecv(int fd);
+    void recycleBuffer(int bufferId);
+    int allocSendSlot();
+    void onUDPRecv(int res, unsigned int flags);
+    void onTCPAccept(int res, unsigned int flags);
+    void onTCPRecv(int fd, int res, unsigned int flags);
+    void processRequests(int fd);
+    void writeReply(int fd, IoUringConnection &connection);
+    void onReplySent(int fd, int res);
+    void closeConnection(int fd);
+    int runFallback();
+    void pumpStream(int fd);
+    void writeStreamChunk(int fd, IoUringListStream &stream);
+    void onStreamSent(int fd, int res);
+    void endStream(int fd);
+public:
+    int status; // ERR_CODE_STOPPED - stop request
+    explicit IoUringListener(
+        IdentitySerialization *aIdentitySerialization,
+        GatewaySerialization *aSerializationWrapper
+    );
+    ~IoUringListener() override;
+    void setAddress(
+        const std::string &host,
+        uint16_t port
+    ) override;
+    void setAddress(
+        uint32_t &ipv4,
+        uint16_t port
+    ) override;
+    int run() override;
+    void stop() override;
+    void setLog(int verbose, Log *log) override;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include "lorawan/storage/listener/query-scheduler.h"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "lorawan/storage/listener/storage-listener.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/gateway-binary-serialization.h"
+
+QueryLaneStat::QueryLaneStat()
+    : depth(0), maxDepth(0), count(0), rejected(0), waitMicros(0), maxWaitMicros(0)
+{
+}
+
+std::string QueryLaneStat::toString() const
+{
+    std::stringstream ss;
+    ss << "depth " << depth << ", max depth " << maxDepth
+        << ", queries " << count << ", rejected " << rejected
+        << ", wait avg " << (count ? waitMicros / count : 0) << "us, max " << maxWaitMicros << "us";
+    return ss.str();
+}
+
+QueryTask::QueryTask(
+    const unsigned char *aRequest,
+    size_t sz,
+    size_t aResponseSize,
+    void *aClient
+)
+    : request((const char *) aRequest, sz), responseSize(aResponseSize), client(aClient), peer{},
+    arrived(std::chrono::steady_clock::now())
+{
+}
+
+QueryScheduler::QueryScheduler(
+    StorageListener *aListener,
+    size_t aWorkerCount,
+    size_t aMaxQueued
+)
+    : listener(aListener), handler(nullptr), running(0), stopped(true),
+    workerCount(aWorkerCount ? aWorkerCount : 1), maxQueued(aMaxQueued), concurrentService(false)
+{
+}
+
+QueryScheduler::~QueryScheduler()
+{
+    stop();
+}
+
+static bool isBackgroundTag(
+    char tag
+)
+{
+    switch (tag) {
+        case QUERY_IDENTITY_LIST:
+        case QUERY_IDENTITY_FILTER:
+        case QUERY_IDENTITY_FORCE_SAVE:
+        case QUERY_IDENTITY_CLOSE_RESOURCES:
+        case QUERY_GATEWAY_LIST:
+        case QUERY_GATEWAY_FORCE_SAVE:
+        case QUERY_GATEWAY_CLOSE_RESOURCES:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool isWriteTag(
+    char tag
+)
+{
+    return tag == QUERY_IDENTITY_ASSIGN || tag == QUERY_IDENTITY_RM
+        || tag == QUERY_GATEWAY_ASSIGN || tag == QUERY_GATEWAY_RM;
+}
+
+QueryLane QueryScheduler::lane(
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (sz == 0)
+        return LANE_LOOKUP;
+    if (!isBatchMessage(request, sz))
+        return isBackgroundTag((char) request[0]) ? LANE_BACKGROUND : LANE_LOOKUP;
+    std::vector<BatchItem> items;
+    parseBatch(items, request, sz);
+    size_t writes = 0;
+    for (auto &item : items) {
+        if (item.size == 0)
+            continue;
+        if (isBackgroundTag((char) item.data[0]))
+            return LANE_BACKGROUND;
+        if (isWriteTag((char) item.data[0]))
+            writes++;
+    }
+    return writes > SCHEDULER_BULK_WRITES ? LANE_BACKGROUND : LANE_LOOKUP;
+}
+
+void QueryScheduler::start(
+    QueryTaskHandler *aHandler
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!stopped)
+        return;
+    handler = aHandler;
+    stopped = false;
+    // queries are serialized, more workers would wait for each other
+    size_t n = concurrentService ? workerCount : 1;
+    for (size_t i = 0; i < n; i++) {
+        workers.emplace_back(&QueryScheduler::work, this);
+    }
+}
+
+void QueryScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopped)
+            return;
+        stopped = true;
+    }
+    queued.notify_all();
+    gate.notify_all();
+    for (auto &w : workers) {
+        if (w.joinable())
+            w.join();
+    }
+    workers.clear();
+    std::lock_guard<std::mutex> guard(lock);
+    for (int l = 0; l < QUERY_LANE_COUNT; l++) {
+        for (auto t : queue[l]) {
+            delete t;
+        }
+        stat[l].depth -= queue[l].size();
+        queue[l].clear();
+    }
+}
+
+/**
+ * Call with the lock held
+ */
+void QueryScheduler::count(
+    QueryLane lane,
+    std::chrono::steady_clock::time_point arrived
+)
+{
+    auto wait = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - arrived).count();
+    QueryLaneStat &s = stat[lane];
+    s.count++;
+    s.waitMicros += wait;
+    if (wait > s.maxWaitMicros)
+        s.maxWaitMicros = wait;
+}
+
+/**
+ * Call with the lock held
+ * @return true if the listener thread can query the storage service now, queued lookups go first
+ */
+bool QueryScheduler::isFree() const
+{
+    return concurrentService || (running == 0 && queue[LANE_LOOKUP].empty());
+}
+
+bool QueryScheduler::tryEnter()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!isFree())
+        return false;
+    running++;
+    return true;
+}
+
+void QueryScheduler::leave()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running--;
+    }
+    gate.notify_all();
+}
+
+bool QueryScheduler::tryQuery(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz,
+    size_t &retLen
+)
+{
+    auto arrived = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!isFree())
+            return false;
+        running++;
+        count(LANE_LOOKUP, arrived);
+    }
+    retLen = listener->query(retBuf, retSize, request, sz);
+    leave();
+    return true;
+}
+
+bool QueryScheduler::schedule(
+    QueryTask *task,
+    QueryLane lane
+)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        QueryLaneStat &s = stat[lane];
+        if (stopped || s.depth >= maxQueued) {
+            s.rejected++;
+            return false;
+        }
+        queue[lane].push_back(task);
+        s.depth++;
+        if (s.depth > s.maxDepth)
+            s.maxDepth = s.depth;
+    }
+    queued.notify_one();
+    return true;
+}
+
+void QueryScheduler::work()
+{
+    while (true) {
+        QueryTask *task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            queued.wait(guard, [this] {
+                return stopped || !queue[LANE_LOOKUP].empty() || !queue[LANE_BACKGROUND].empty();
+            });
+            gate.wait(guard, [this] { return stopped || concurrentService || running == 0; });
+            if (stopped)
+                break;
+            // lookups go first, the query can be taken by another worker while waiting for the gate
+            QueryLane lane = queue[LANE_LOOKUP].empty() ? LANE_BACKGROUND : LANE_LOOKUP;
+            if (queue[lane].empty())
+                continue;
+            task = queue[lane].front();
+            queue[lane].pop_front();
+            running++;
+            stat[lane].depth--;
+            count(lane, task->arrived);
+        }
+        task->response.resize(task->responseSize);
+        size_t sz = listener->query((unsigned char *) &task->response[0], task->responseSize,
+            (const unsigned char *) task->request.c_str(), task->request.size());
+        task->response.resize(sz);
+        leave();
+        if (handler)
+            handler->onQueryDone(task);
+        else
+            delete task;
+    }
+}
+
+QueryLaneStat QueryScheduler::stats(
+    QueryLane lane
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return stat[lane];
+}
+
+std::string QueryScheduler::toString()
+{
+    std::stringstream ss;
+    ss << "lookup lane: " << stats(LANE_LOOKUP).toString()
+        << "\nbackground lane: " << stats(LANE_BACKGROUND).toString();
+    return ss.str();
+}
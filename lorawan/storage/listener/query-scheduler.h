@@ -0,0 +1,170 @@
+#ifndef QUERY_SCHEDULER_H_
+#define QUERY_SCHEDULER_H_	1
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <cinttypes>
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <Winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+// background worker threads
+#define DEF_SCHEDULER_WORKERS       1
+// background queries waiting for a worker, next one is rejected with ERR_CODE_THROTTLED
+#define DEF_SCHEDULER_MAX_QUEUED    1024
+// batch frame with more put/rm requests is a bulk write
+#define SCHEDULER_BULK_WRITES       8
+
+enum QueryLane {
+    LANE_LOOKUP = 0,        ///< get, count, next, single writes; run on the listener thread if storage service is free
+    LANE_BACKGROUND = 1     ///< list, filter, force save, close resources, bulk writes; run on the worker threads
+};
+#define QUERY_LANE_COUNT    2
+
+/**
+ * Lane counters. Wait time is the time from the arrival to the start of the query.
+ */
+class QueryLaneStat {
+public:
+    size_t depth;               ///< queries waiting now
+    size_t maxDepth;
+    uint64_t count;             ///< started queries
+    uint64_t rejected;          ///< queue is full
+    uint64_t waitMicros;        ///< total
+    uint64_t maxWaitMicros;
+    QueryLaneStat();
+    std::string toString() const;
+};
+
+/**
+ * Background query. Listener fills request, response size and reply destination.
+ */
+class QueryTask {
+public:
+    std::string request;
+    std::string response;       ///< empty- unknown request
+    size_t responseSize;        ///< response buffer size
+    void *client;               ///< listener defined reply destination
+    struct sockaddr_storage peer;
+    std::chrono::steady_clock::time_point arrived;
+    QueryTask(
+        const unsigned char *request,
+        size_t sz,
+        size_t responseSize,
+        void *client
+    );
+};
+
+class QueryTaskHandler {
+public:
+    virtual ~QueryTaskHandler() = default;
+    /**
+     * Called in the worker thread, handler deletes the task
+     */
+    virtual void onQueryDone(QueryTask *task) = 0;
+};
+
+class StorageListener;
+
+/**
+ * Runs queries of the listener in two lanes.
+ * Point lookups run on the listener thread, scans, bulk writes and flushes run on the background worker pool.
+ * If the storage service is not thread safe, one query runs at a time and one worker is started.
+ * Listener thread never waits for the running query:
+ * lookup arriving while the storage service is busy is queued in the lookup lane,
+ * the worker runs queued lookups before the queued background queries.
+ * Thread safe storage service (concurrentService) runs queries of all workers and lookups of the listener
+ * thread side by side, lookups are not queued behind the running scans.
+ */
+class QueryScheduler {
+private:
+    StorageListener *listener;
+    QueryTaskHandler *handler;
+    std::mutex lock;
+    std::condition_variable queued;
+    std::condition_variable gate;
+    std::deque<QueryTask *> queue[QUERY_LANE_COUNT];
+    std::vector<std::thread> workers;
+    size_t running;             ///< queries holding the storage service
+    bool stopped;
+    QueryLaneStat stat[QUERY_LANE_COUNT];
+
+    void work();
+    void count(QueryLane lane, std::chrono::steady_clock::time_point arrived);
+    bool isFree() const;
+public:
+    size_t workerCount;         ///< workers started if the storage service is thread safe
+    size_t maxQueued;           ///< of each lane
+    bool concurrentService;     ///< storage service is thread safe, set before start()
+
+    QueryScheduler(
+        StorageListener *listener,
+        size_t workerCount = DEF_SCHEDULER_WORKERS,
+        size_t maxQueued = DEF_SCHEDULER_MAX_QUEUED
+    );
+    virtual ~QueryScheduler();
+
+    /**
+     * Start worker threads, one if the storage service is not thread safe
+     * @param handler receives completed queued queries
+     */
+    void start(QueryTaskHandler *handler);
+    /**
+     * Finish running queries, drop queued ones and join workers
+     */
+    void stop();
+    /**
+     * @return lane of the version 1 request or batch frame
+     */
+    static QueryLane lane(
+        const unsigned char *request,
+        size_t sz
+    );
+    /**
+     * Run lookup in the caller thread if the storage service is free and no lookup is queued, never waits.
+     * Otherwise caller queues the lookup by schedule()
+     * @param retBuf buffer to return serialized response
+     * @param retSize buffer size
+     * @param request serialized request
+     * @param sz serialized request size
+     * @param retLen return response size, 0- unknown request
+     * @return false- storage service is busy, lookup is not run
+     */
+    bool tryQuery(
+        unsigned char *retBuf,
+        size_t retSize,
+        const unsigned char *request,
+        size_t sz,
+        size_t &retLen
+    );
+    /**
+     * Queue query
+     * @param task query, scheduler owns it until it is passed to the handler
+     * @param lane LANE_LOOKUP- run before background queries
+     * @return false if queue is full or scheduler is stopped, task is not owned
+     */
+    bool schedule(
+        QueryTask *task,
+        QueryLane lane = LANE_BACKGROUND
+    );
+    /**
+     * Hold storage service if it is free and no lookup is queued, never waits,
+     * e.g. to read the list stream chunk in the listener thread.
+     * If storage service is busy, handler is called when the running query is done, try again then.
+     * @return false- storage service is busy
+     */
+    bool tryEnter();
+    void leave();
+    QueryLaneStat stats(QueryLane lane);
+    std::string toString();
+};
+
+#endif
@@ -1,3 +1,149 @@
 #include "storage-listener.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/gateway-binary-serialization.h"
+#include "lorawan/storage/serialization/journal-serialization.h"
+#include "lorawan/storage/serialization/change-feed-serialization.h"
+#include "lorawan/storage/serialization/list-stream.h"
+
+size_t StorageListener::query(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (isBatchMessage(request, sz))
+        return queryBatch(identitySerialization, gatewaySerialization, retBuf, retSize, request, sz);
+    if (changeLog && isJournalRequest(request, sz))
+        return queryJournal(identitySerialization, changeLog, retBuf, retSize, request, sz);
+    if (isWatchRequest(request, sz) && retSize >= SIZE_WATCH_RESPONSE) {
+        // listener with the change feed subscribes the client before the query, others have no feed
+        uint64_t seq;
+        subscribeChangeFeed(identitySerialization, nullptr, seq, retBuf, request, sz);
+        return SIZE_WATCH_RESPONSE;
+    }
+    size_t r = 0;
+    if (identitySerialization)
+        r = identitySerialization->query(retBuf, retSize, request, sz);
+    if (r == 0 && gatewaySerialization)
+        r = gatewaySerialization->query(retBuf, retSize, request, sz);
+    return r;
+}
+
+size_t StorageListener::query(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz,
+    const struct sockaddr *source
+)
+{
+    if (isAccessDenied(request, sz))
+        return accessDenied(retBuf, retSize, request, sz, source);
+    countBatchDenials(request, sz, source);
+    if (!admit(request, sz, source))
+        return throttledResponse(retBuf, retSize, request, sz);
+    return query(retBuf, retSize, request, sz);
+}
+
+bool StorageListener::isAccessDenied(
+    const unsigned char *request,
+    size_t sz
+) const
+{
+    if (sz < SIZE_SERVICE_MESSAGE)
+        return false;
+    if (identitySerialization && identityRequestSize((char) request[0]))
+        return isIdentityAccessDenied(request, sz, identitySerialization->code, identitySerialization->accessCode);
+    if (gatewaySerialization && gatewayRequestSize((char) request[0]))
+        return isGatewayAccessDenied(request, sz, gatewaySerialization->code, gatewaySerialization->accessCode);
+    return false;
+}
+
+size_t StorageListener::accessDenied(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz,
+    const struct sockaddr *source
+)
+{
+    if (denials)
+        denials->count(source);
+    if (sz && identityRequestSize((char) request[0]))
+        return accessDeniedIdentityResponse(retBuf, retSize);
+    return accessDeniedGatewayResponse(retBuf, retSize);
+}
+
+void StorageListener::countBatchDenials(
+    const unsigned char *request,
+    size_t sz,
+    const struct sockaddr *source
+)
+{
+    if (!denials || !isBatchMessage(request, sz))
+        return;
+    std::vector<BatchItem> items;
+    parseBatch(items, request, sz);
+    // each item is denied by the serialization, count it as a separate request
+    for (auto &item : items) {
+        if (isAccessDenied(item.data, item.size))
+            denials->count(source);
+    }
+}
+
+bool StorageListener::admit(
+    const unsigned char *request,
+    size_t sz,
+    const struct sockaddr *source
+)
+{
+    return !admission || admission->admit(source, request, sz) == CODE_OK;
+}
 
 StorageListener::~StorageListener() = default;
+
+size_t requestFrameSize(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    if (sz == 0)
+        return 0;
+    size_t r;
+    switch (buf[0]) {
+        case QUERY_BATCH:
+            if (sz < SIZE_BATCH_HEADER)
+                return 0;
+            if (buf[1] != BATCH_PROTOCOL_VERSION)
+                return sz;
+            return batchMessageSize(buf, sz);
+        case QUERY_IDENTITY_LIST_STREAM:
+        case QUERY_GATEWAY_LIST_STREAM:
+            if (sz < SIZE_LIST_STREAM_REQUEST)
+                return 0;
+            // filter expression follows the fixed part
+            r = SIZE_LIST_STREAM_REQUEST + buf[SIZE_LIST_STREAM_REQUEST - 1];
+            break;
+        case QUERY_IDENTITY_JOURNAL:
+            r = SIZE_JOURNAL_REQUEST;
+            break;
+        case QUERY_IDENTITY_WATCH:
+            r = SIZE_WATCH_REQUEST;
+            break;
+        case QUERY_IDENTITY_FILTER:
+            r = identityFilterRequestSize(buf, sz);
+            if (r == 0)
+                return 0;
+            break;
+        default:
+            r = identityRequestSize((char) buf[0]);
+            if (r == 0)
+                r = gatewayRequestSize((char) buf[0]);
+            if (r == 0)
+                return sz;
+    }
+    return sz < r ? 0 : r;
+}
@@ -3,6 +3,10 @@
 
 #include "lorawan/storage/serialization/identity-serialization.h"
 #include "lorawan/storage/serialization/gateway-serialization.h"
+#include "lorawan/storage/service/change-log.h"
+#include "lorawan/storage/listener/access-denials.h"
+#include "lorawan/storage/listener/admission-control.h"
+#include "lorawan/storage/listener/query-scheduler.h"
 
 class Log {
 public:
@@ -14,11 +18,16 @@ class StorageListener {
 public:
     IdentitySerialization *identitySerialization;
     GatewaySerialization *gatewaySerialization;
+    ChangeLog *changeLog;   ///< primary serves journal requests to the replicas, NULL- replication is disabled
+    AdmissionControl *admission;    ///< per client rate limits, NULL- no limits
+    AccessDenials *denials;         ///< requests with wrong credentials of each client, NULL- not counted
+    QueryScheduler *scheduler;      ///< lookups first, scans on the worker threads, NULL- all queries run on the listener thread
 
     explicit StorageListener(
         IdentitySerialization *aIdentitySerialization,
         GatewaySerialization *aSerializationWrapper
-    ) : identitySerialization(aIdentitySerialization), gatewaySerialization(aSerializationWrapper)
+    ) : identitySerialization(aIdentitySerialization), gatewaySerialization(aSerializationWrapper),
+        changeLog(nullptr), admission(nullptr), denials(nullptr), scheduler(nullptr)
     {
 
     }
@@ -39,8 +48,101 @@ public:
 
     virtual void setLog(int verbose, Log *log) = 0;
 
+    /**
+     * Process version 1 request, version 2 batch frame or journal request.
+     * Subscribe request is answered with ERR_CODE_NO_CHANGE_FEED, listener serving the feed handles it before
+     * @param retBuf buffer to return serialized response
+     * @param retSize buffer size
+     * @param request serialized request
+     * @param sz serialized request size
+     * @return response size, 0- unknown request
+     */
+    size_t query(
+        unsigned char *retBuf,
+        size_t retSize,
+        const unsigned char *request,
+        size_t sz
+    );
+
+    /**
+     * Check credentials, then client rate limits, then process request
+     * @param retBuf buffer to return serialized response
+     * @param retSize buffer size
+     * @param request serialized request
+     * @param sz serialized request size
+     * @param source client address
+     * @return response size, 0- unknown request
+     */
+    size_t query(
+        unsigned char *retBuf,
+        size_t retSize,
+        const unsigned char *request,
+        size_t sz,
+        const struct sockaddr *source
+    );
+
+    /**
+     * Check tag, size and credentials of the version 1 request from the 13 bytes header, request is not decoded
+     * @return true if request is denied
+     */
+    bool isAccessDenied(
+        const unsigned char *request,
+        size_t sz
+    ) const;
+
+    /**
+     * Count denied request of the client and copy preformatted ERR_CODE_ACCESS_DENIED response
+     * @param retBuf buffer to return response
+     * @param retSize buffer size
+     * @param request denied request
+     * @param sz request size
+     * @param source client address, NULL- unknown
+     * @return response size
+     */
+    size_t accessDenied(
+        unsigned char *retBuf,
+        size_t retSize,
+        const unsigned char *request,
+        size_t sz,
+        const struct sockaddr *source
+    );
+
+    /**
+     * Count items of the batch frame with wrong credentials, the frame itself has no credentials.
+     * Does nothing if denials are not counted or request is not a batch frame
+     * @param request serialized request
+     * @param sz request size
+     * @param source client address, NULL- unknown
+     */
+    void countBatchDenials(
+        const unsigned char *request,
+        size_t sz,
+        const struct sockaddr *source
+    );
+
+    /**
+     * @return true if request is admitted
+     */
+    bool admit(
+        const unsigned char *request,
+        size_t sz,
+        const struct sockaddr *source
+    );
+
     virtual ~StorageListener();
 };
 
+/**
+ * Size of the first request in the stream buffer, TCP listeners split received bytes to requests.
+ * Batch frame, list stream and filter request sizes are read from the request, other requests have fixed size by tag.
+ * @param buf received bytes
+ * @param sz received bytes count
+ * @return request size, 0- request is incomplete, sz- unknown tag, whole buffer is one request
+ */
+size_t requestFrameSize(
+    const unsigned char *buf,
+    size_t sz
+);
+
 
 #endif
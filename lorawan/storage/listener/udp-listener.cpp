@@ -37,6 +37,7 @@
 #include "lorawan/lorawan-error.h"
 #include "lorawan/lorawan-msg.h"
 #include "lorawan/helper/ip-address.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
 
 #define DEF_KEEPALIVE_SECS 60
 
@@ -48,6 +49,13 @@
 #define SOCKET_ERROR_TIMEOUT EAGAIN
 #endif
 
+#ifdef MSG_TRUNC
+// recvfrom() returns the datagram size even if it does not fit the buffer
+#define RECV_FLAGS MSG_TRUNC
+#else
+#define RECV_FLAGS 0
+#endif
+
 /**
  * @see https://habr.com/ru/post/340758/
  * @see https://github.com/Mityuha/grpc_async/blob/master/grpc_async_server.cc
@@ -107,7 +115,8 @@ void UDPListener::setAddress(
 
 int UDPListener::run()
 {
-    unsigned char rxBuf[307];
+    // one byte more than the largest batch frame: full buffer means the datagram is truncated
+    unsigned char rxBuf[MAX_BATCH_FRAME_SIZE + 1];
 
     int proto = isIPv6(&destAddr) ? IPPROTO_IPV6 : IPPROTO_IP;
     int af = isIPv6(&destAddr) ? AF_INET6 : AF_INET;
@@ -174,10 +183,13 @@ int UDPListener::run()
         struct sockaddr_storage source_addr{}; // Large enough for both IPv4 or IPv6
         socklen_t socklen = sizeof(source_addr);
 
-        // 307 bytes for IPv4 up to 18, IPv6 up to 10
         unsigned char rBuf[2048];
         while (status != ERR_CODE_STOPPED) {
-            ssize_t len = recvfrom(sock, (char*) rxBuf, sizeof(rxBuf) - 1, 0, (struct sockaddr*)&source_addr, & socklen);
+            ssize_t len = recvfrom(sock, (char*) rxBuf, sizeof(rxBuf), RECV_FLAGS, (struct sockaddr*)&source_addr, & socklen);
+#ifdef _MSC_VER
+            if (len < 0 && SOCKET_ERRNO == WSAEMSGSIZE)
+                len = sizeof(rxBuf);
+#endif
             // Error occurred during receiving
             if (len < 0) {
                 if (SOCKET_ERRNO == SOCKET_ERROR_TIMEOUT) {    // timeout occurs
@@ -191,18 +203,23 @@ int UDPListener::run()
                 continue;
             } else {
                 // Data received
+                bool truncated = len >= (ssize_t) sizeof(rxBuf);
+                if (truncated)
+                    len = sizeof(rxBuf);
                 if (log && verbose > 1) {
                     log->strm(LOG_INFO) << MSG_RECEIVED << len << MSG_SPACE << MSG_BYTES << MSG_COLON_N_SPACE << hexString(rxBuf, len);
                     log->flush();
                 }
                 size_t sz;
-                if (len > 0) {
-                    sz = identitySerialization->query(rBuf, sizeof(rBuf), rxBuf, len);
-                    if (sz == 0) {
-                        sz = gatewaySerialization->query(rBuf, sizeof(rBuf), rxBuf, len);
+                if (truncated) {
+                    // reply with an error to the items received instead of dropping the whole batch silently
+                    if (log && verbose) {
+                        log->strm(LOG_ERR) << ERR_REQUEST_TRUNCATED;
+                        log->flush();
                     }
+                    sz = errorResponse(rBuf, sizeof(rBuf), rxBuf, len, ERR_CODE_REQUEST_TRUNCATED);
                 } else
-                    sz = 0;
+                    sz = len > 0 ? query(rBuf, sizeof(rBuf), rxBuf, len, (const struct sockaddr *) &source_addr) : 0;
                 if (sz > 0) {
                     if (sendto(sock, (const char *) rBuf, (int) sz, 0, (struct sockaddr *) &source_addr, sizeof(source_addr)) < 0) {
                         if (log) {
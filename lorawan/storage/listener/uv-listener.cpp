@@ -1,8 +1,14 @@
 #include "uv-listener.h"
 
 #include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <mutex>
+#include <vector>
 
 #include <uv.h>
+#include "lorawan/helper/ip-address.h"
 #ifdef ENABLE_DEBUG
 #include <iostream>
 #include "lorawan-msg.h"
@@ -23,12 +29,414 @@
 #include "lorawan/helper/ip-helper.h"
 #include "lorawan/lorawan-string.h"
 #include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/list-stream.h"
+#include "lorawan/storage/serialization/change-feed-serialization.h"
 
 #define DEF_KEEPALIVE_SECS 60
 
 // 307 bytes for IPv4 up to 18, IPv6 up to 10
 #define WRITE_BUFFER_SIZE 1432
 
+// streaming list: chunk up to 116 identities
+#define STREAM_CHUNK_SIZE   16384
+// chunks written but not sent yet. Next chunk is produced when previous one is sent, slow client does not
+// pile up writes in the loop
+#define STREAM_WINDOW       2
+
+// change events written but not sent yet. Slow subscriber gets next events when it drains,
+// subscriber missing changes dropped from the change log gets ERR_CODE_REPLICA_SNAPSHOT
+#define FEED_MAX_QUEUED_BYTES   65536
+// events read from the change log at once
+#define FEED_BATCH_EVENTS       64
+
+/**
+ * Streaming list state, deleted when the last chunk is sent or connection is lost
+ */
+class UVListStream {
+public:
+    ListStream *cursor;
+    uv_stream_t *client;
+    int inFlight;
+    bool failed;
+};
+
+class UVListStreamChunk {
+public:
+    uv_write_t req;
+    UVListStream *stream;
+    unsigned char buf[STREAM_CHUNK_SIZE];
+};
+
+static void pumpListStream(UVListStream *stream);
+static void waitForStorage(UVListener *listener, UVListStream *stream);
+static void dropListStream(UVListener *listener, UVListStream *stream);
+
+static void onListStreamChunkWritten(
+    uv_write_t *req,
+    int status
+)
+{
+    auto chunk = (UVListStreamChunk *) req->data;
+    UVListStream *stream = chunk->stream;
+    delete chunk;
+    stream->inFlight--;
+    if (status < 0) {
+#ifdef ENABLE_DEBUG
+        std::cerr << ERR_SOCKET_WRITE << status << MSG_COLON_N_SPACE << uv_strerror(status) << std::endl;
+#endif
+        // connection lost or closed, UV_ECANCELED
+        stream->failed = true;
+    }
+    pumpListStream(stream);
+}
+
+/**
+ * Write next chunks up to the window
+ */
+static void pumpListStream(
+    UVListStream *stream
+)
+{
+    auto listener = (UVListener*) stream->client->loop->data;
+    QueryScheduler *scheduler = listener->scheduled ? listener->scheduler : nullptr;
+    while (!stream->failed && stream->inFlight < STREAM_WINDOW && !stream->cursor->isFinished()) {
+        // chunk is short, it is read on the loop thread when the storage service is free
+        if (scheduler && !scheduler->tryEnter()) {
+            waitForStorage(listener, stream);
+            break;
+        }
+        auto chunk = new UVListStreamChunk;
+        size_t sz = stream->cursor->next(chunk->buf, sizeof(chunk->buf));
+        if (scheduler)
+            scheduler->leave();
+        if (sz == 0) {
+            delete chunk;
+            break;
+        }
+        chunk->stream = stream;
+        chunk->req.data = chunk;
+        uv_buf_t writeBuf = uv_buf_init((char *) chunk->buf, (unsigned int) sz);
+        stream->inFlight++;
+        if (uv_write(&chunk->req, stream->client, &writeBuf, 1, onListStreamChunkWritten) < 0) {
+            stream->inFlight--;
+            stream->failed = true;
+            delete chunk;
+        }
+    }
+    if (stream->inFlight == 0 && (stream->failed || stream->cursor->isFinished()))
+        dropListStream(listener, stream);
+}
+
+/**
+ * Change feed subscribers. Change log notifies from any thread, events are written in the loop thread.
+ */
+class UVChangeFeed : public ChangeLogObserver {
+public:
+    uv_async_t async;
+    ChangeFeed subscribers;
+
+    UVChangeFeed(
+        IdentitySerialization *identitySerialization,
+        const ChangeLog *log
+    )
+        : async{}, subscribers(identitySerialization, log)
+    {
+    }
+
+    void onChangeLogUpdated(
+        uint64_t
+    ) override {
+        uv_async_send(&async);
+    }
+
+    void pump(uv_stream_t *client);
+};
+
+class UVChangeFeedWrite {
+public:
+    uv_write_t req;
+    UVChangeFeed *feed;
+    unsigned char buf[SIZE_CHANGE_EVENT * FEED_BATCH_EVENTS];
+};
+
+static void onChangeFeedWritten(
+    uv_write_t *req,
+    int status
+)
+{
+    auto w = (UVChangeFeedWrite *) req->data;
+    UVChangeFeed *feed = w->feed;
+    uv_stream_t *client = req->handle;
+    delete w;
+    // on error connection is closed by the read callback
+    if (status == 0)
+        feed->pump(client);
+}
+
+static void onChangeLogAsync(
+    uv_async_t *handle
+)
+{
+    auto feed = (UVChangeFeed *) handle->data;
+    for (auto client : feed->subscribers.clients()) {
+        feed->pump((uv_stream_t *) client);
+    }
+}
+
+/**
+ * Write events after the last sent one until the client write queue is full
+ */
+void UVChangeFeed::pump(
+    uv_stream_t *client
+)
+{
+    while (client->write_queue_size < FEED_MAX_QUEUED_BYTES) {
+        auto w = new UVChangeFeedWrite;
+        size_t sz = subscribers.next(client, w->buf, sizeof(w->buf));
+        if (sz == 0) {
+            delete w;
+            break;
+        }
+        w->feed = this;
+        w->req.data = w;
+        uv_buf_t writeBuf = uv_buf_init((char *) w->buf, (unsigned int) sz);
+        if (uv_write(&w->req, client, &writeBuf, 1, onChangeFeedWritten) < 0) {
+            delete w;
+            break;
+        }
+    }
+}
+
+/**
+ * Reply to the subscribe request and start sending events
+ */
+static void subscribe(
+    UVListener *listener,
+    uv_stream_t *client,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    auto feed = (UVChangeFeed *) listener->feed;
+    auto w = new UVChangeFeedWrite;
+    feed->subscribers.subscribe(client, w->buf, request, sz);
+    w->feed = feed;
+    w->req.data = w;
+    uv_buf_t writeBuf = uv_buf_init((char *) w->buf, SIZE_WATCH_RESPONSE);
+    if (uv_write(&w->req, client, &writeBuf, 1, onChangeFeedWritten) < 0) {
+        delete w;
+        feed->subscribers.unsubscribe(client);
+        return;
+    }
+    feed->pump(client);
+}
+
+/**
+ * Queries queued in the scheduler. Workers complete queries, replies are written in the loop thread.
+ */
+class UVScheduled : public QueryTaskHandler {
+public:
+    uv_async_t async;
+    std::mutex lock;
+    std::vector<QueryTask *> done;      ///< completed by the workers
+    std::set<QueryTask *> pending;      ///< loop thread only
+    std::set<UVListStream *> streams;   ///< list streams waiting for the storage service, loop thread only
+
+    UVScheduled()
+        : async{}
+    {
+    }
+
+    ~UVScheduled() override {
+        for (auto t : done) {
+            delete t;
+        }
+        for (auto s : streams) {
+            delete s->cursor;
+            delete s;
+        }
+    }
+
+    void onQueryDone(
+        QueryTask *task
+    ) override {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done.push_back(task);
+        }
+        uv_async_send(&async);
+    }
+
+    /**
+     * Connection is closed, drop replies
+     */
+    void forget(
+        uv_stream_t *client
+    ) {
+        for (auto t : pending) {
+            if (t->client == client)
+                t->client = nullptr;
+        }
+        // streams with chunks in flight are dropped when the writes are cancelled
+        for (auto it = streams.begin(); it != streams.end(); ) {
+            if ((*it)->client == client && (*it)->inFlight == 0) {
+                delete (*it)->cursor;
+                delete *it;
+                it = streams.erase(it);
+            } else
+                it++;
+        }
+    }
+};
+
+/**
+ * Storage service is busy, continue the list stream when the running query is done
+ */
+static void waitForStorage(
+    UVListener *listener,
+    UVListStream *stream
+)
+{
+    ((UVScheduled *) listener->scheduled)->streams.insert(stream);
+}
+
+static void dropListStream(
+    UVListener *listener,
+    UVListStream *stream
+)
+{
+    auto scheduled = (UVScheduled *) listener->scheduled;
+    if (scheduled)
+        scheduled->streams.erase(stream);
+    delete stream->cursor;
+    delete stream;
+}
+
+class UVScheduledReply {
+public:
+    uv_write_t req;
+    uv_udp_send_t send;
+    QueryTask *task;
+    explicit UVScheduledReply(QueryTask *aTask)
+        : req{}, send{}, task(aTask)
+    {
+    }
+    ~UVScheduledReply() {
+        delete task;
+    }
+};
+
+static void onScheduledAsync(
+    uv_async_t *handle
+)
+{
+    auto scheduled = (UVScheduled *) handle->data;
+    std::vector<QueryTask *> done;
+    {
+        std::lock_guard<std::mutex> guard(scheduled->lock);
+        done.swap(scheduled->done);
+    }
+    for (auto task : done) {
+        scheduled->pending.erase(task);
+        if (!task->client || task->response.empty()) {
+            delete task;
+            continue;
+        }
+        auto reply = new UVScheduledReply(task);
+        uv_buf_t writeBuf = uv_buf_init((char *) task->response.c_str(), (unsigned int) task->response.size());
+        int r;
+        if (task->peer.ss_family) {
+            // UDP
+            reply->send.data = reply;
+            r = uv_udp_send(&reply->send, (uv_udp_t *) task->client, &writeBuf, 1, (const struct sockaddr *) &task->peer,
+                [](uv_udp_send_t *req, int) {
+                    delete (UVScheduledReply *) req->data;
+                });
+        } else {
+            reply->req.data = reply;
+            r = uv_write(&reply->req, (uv_stream_t *) task->client, &writeBuf, 1,
+                [](uv_write_t *req, int) {
+                    delete (UVScheduledReply *) req->data;
+                });
+        }
+        if (r < 0)
+            delete reply;
+    }
+    // storage service is free now
+    std::set<UVListStream *> streams;
+    streams.swap(scheduled->streams);
+    for (auto stream : streams) {
+        pumpListStream(stream);
+    }
+}
+
+/**
+ * Pass query to the workers, reply is written by onScheduledAsync()
+ */
+static void queueQuery(
+    UVListener *listener,
+    void *client,
+    const struct sockaddr *peer,
+    const unsigned char *request,
+    size_t sz,
+    QueryLane lane
+)
+{
+    auto scheduled = (UVScheduled *) listener->scheduled;
+    auto task = new QueryTask(request, sz, WRITE_BUFFER_SIZE, client);
+    if (peer)
+        memmove(&task->peer, peer, peer->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+    scheduled->pending.insert(task);
+    if (!listener->scheduler->schedule(task, lane)) {
+        // queue is full
+        scheduled->pending.erase(task);
+        task->response.resize(WRITE_BUFFER_SIZE);
+        task->response.resize(throttledResponse((unsigned char *) &task->response[0], WRITE_BUFFER_SIZE, request, sz));
+        scheduled->onQueryDone(task);
+    }
+}
+
+/**
+ * Pass scan, bulk write or flush to the background workers
+ * @return false if it is a lookup or scheduler is not used
+ */
+static bool scheduleBackground(
+    UVListener *listener,
+    void *client,
+    const struct sockaddr *peer,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (!listener->scheduled || QueryScheduler::lane(request, sz) != LANE_BACKGROUND)
+        return false;
+    queueQuery(listener, client, peer, request, sz, LANE_BACKGROUND);
+    return true;
+}
+
+/**
+ * Run lookup on the loop thread. If the storage service is busy, lookup is queued before the background queries,
+ * loop thread does not wait.
+ * @return response size, 0- unknown request or lookup is queued
+ */
+static size_t queryLookup(
+    UVListener *listener,
+    void *client,
+    const struct sockaddr *peer,
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (!listener->scheduled)
+        return listener->query(retBuf, retSize, request, sz);
+    size_t r = 0;
+    if (!listener->scheduler->tryQuery(retBuf, retSize, request, sz, r))
+        queueQuery(listener, client, peer, request, sz, LANE_LOOKUP);
+    return r;
+}
+
 static void getAddrNPort(
 	uv_tcp_t *stream,
 	std::string &retName,
@@ -78,6 +486,27 @@ static bool getSocketAddrNPort(
 	return true;
 }
 
+static void sendUDP(
+    uv_udp_t *handle,
+    const struct sockaddr *addr,
+    unsigned char *writeBuffer,
+    size_t sz
+)
+{
+    if (sz > 0) {
+        uv_buf_t wrBuf = uv_buf_init((char *) writeBuffer, (unsigned int) sz);
+        auto req = (uv_udp_send_t *) malloc(sizeof(uv_udp_send_t));
+        if (req) {
+            req->data = writeBuffer; // to free up if need it
+            uv_udp_send(req, handle, &wrBuf, 1, addr,
+                [](uv_udp_send_t* req, int status) {
+                    if (req)
+                        free(req);
+                });
+        }
+    }
+}
+
 static void onUDPRead(
 	uv_udp_t *handle,
 	ssize_t bytesRead,
@@ -105,25 +534,21 @@ static void onUDPRead(
                   << MSG_SPACE << MSG_OPAREN << host << ":" << port
                   << MSG_SPACE << bytesRead << MSG_SPACE << MSG_BYTES << MSG_CPAREN << std::endl;
 #endif
-            // 307 bytes for IPv4 up to 18, IPv6 up to 10
-            unsigned char writeBuffer[WRITE_BUFFER_SIZE];
-            size_t sz = ((UVListener*) handle->loop->data)->identitySerialization->query(writeBuffer,
-                sizeof(writeBuffer), (const unsigned char *) buf->base, bytesRead);
-            if (sz == 0) {
-                sz = ((UVListener*) handle->loop->data)->gatewaySerialization->query(writeBuffer,
-                    sizeof(writeBuffer), (const unsigned char *) buf->base, bytesRead);
-            }
-            if (sz > 0) {
-                uv_buf_t wrBuf = uv_buf_init((char *) writeBuffer, (unsigned int) sz);
-                auto req = (uv_udp_send_t *) malloc(sizeof(uv_udp_send_t));
-                if (req) {
-                    req->data = writeBuffer; // to free up if need it
-                    uv_udp_send(req, handle, &wrBuf, 1, addr,
-                        [](uv_udp_send_t* req, int status) {
-                            if (req)
-                                free(req);
-                        });
-                }
+            auto listener = (UVListener*) handle->loop->data;
+            listener->countBatchDenials((const unsigned char *) buf->base, bytesRead, addr);
+            if (listener->isAccessDenied((const unsigned char *) buf->base, bytesRead)) {
+                unsigned char writeBuffer[WRITE_BUFFER_SIZE];
+                size_t sz = listener->accessDenied(writeBuffer, sizeof(writeBuffer), (const unsigned char *) buf->base, bytesRead, addr);
+                sendUDP(handle, addr, writeBuffer, sz);
+            } else if (!listener->admit((const unsigned char *) buf->base, bytesRead, addr)) {
+                unsigned char writeBuffer[WRITE_BUFFER_SIZE];
+                size_t sz = throttledResponse(writeBuffer, sizeof(writeBuffer), (const unsigned char *) buf->base, bytesRead);
+                sendUDP(handle, addr, writeBuffer, sz);
+            } else if (!scheduleBackground(listener, handle, addr, (const unsigned char *) buf->base, bytesRead)) {
+                // 307 bytes for IPv4 up to 18, IPv6 up to 10
+                unsigned char writeBuffer[WRITE_BUFFER_SIZE];
+                size_t sz = queryLookup(listener, handle, addr, writeBuffer, sizeof(writeBuffer), (const unsigned char *) buf->base, bytesRead);
+                sendUDP(handle, addr, writeBuffer, sz);
             }
         }
     }
@@ -144,6 +569,12 @@ static void onReadTCP(
 #endif			
 		}
 		// client disconnected, close socket
+        auto feed = (UVChangeFeed *) ((UVListener*) client->loop->data)->feed;
+        if (feed)
+            feed->subscribers.unsubscribe(client);
+        auto scheduled = (UVScheduled *) ((UVListener*) client->loop->data)->scheduled;
+        if (scheduled)
+            scheduled->forget(client);
 		uv_close((uv_handle_t *)client, onCloseClient);
 	} else {
 #ifdef ENABLE_DEBUG
@@ -155,13 +586,50 @@ static void onReadTCP(
             << MSG_SPACE << MSG_OPAREN << "TCP " << addr << ":" << port << MSG_SPACE << readCount
             << MSG_SPACE << MSG_BYTES << MSG_CPAREN << std::endl;
 #endif
-        unsigned char writeBuffer[WRITE_BUFFER_SIZE];
-        size_t sz = ((UVListener*) client->loop->data)->identitySerialization->query(writeBuffer,
-            sizeof(writeBuffer), (const unsigned char *) buf->base, readCount);
-        if (sz == 0) {
-            sz = ((UVListener*) client->loop->data)->gatewaySerialization->query(writeBuffer,
-                sizeof(writeBuffer), (const unsigned char *) buf->base, readCount);
+        auto listener = (UVListener*) client->loop->data;
+        bool denied = listener->isAccessDenied((const unsigned char *) buf->base, readCount);
+        bool admitted = !denied;
+        if (denied || listener->admission || listener->denials) {
+            struct sockaddr_storage peer {};
+            int peerSize = sizeof(peer);
+            uv_tcp_getpeername((uv_tcp_t *) client, (struct sockaddr *) &peer, &peerSize);
+            if (denied) {
+                unsigned char writeBuffer[WRITE_BUFFER_SIZE];
+                size_t sz = listener->accessDenied(writeBuffer, sizeof(writeBuffer), (const unsigned char *) buf->base,
+                    readCount, (const struct sockaddr *) &peer);
+                // no write request is allocated, reply is dropped if the socket buffer is full
+                uv_buf_t writeBuf = uv_buf_init((char *) writeBuffer, (unsigned int) sz);
+                uv_try_write(client, &writeBuf, 1);
+                freeBuffer(buf);
+                return;
+            }
+            listener->countBatchDenials((const unsigned char *) buf->base, readCount, (const struct sockaddr *) &peer);
+            admitted = listener->admit((const unsigned char *) buf->base, readCount, (const struct sockaddr *) &peer);
+        }
+        if (admitted && listener->feed && isWatchRequest((const unsigned char *) buf->base, readCount)) {
+            subscribe(listener, client, (const unsigned char *) buf->base, readCount);
+            freeBuffer(buf);
+            return;
+        }
+        ListStream *cursor = admitted ? createListStream(listener->identitySerialization, listener->gatewaySerialization,
+            (const unsigned char *) buf->base, readCount) : nullptr;
+        if (cursor) {
+            auto stream = new UVListStream;
+            stream->cursor = cursor;
+            stream->client = client;
+            stream->inFlight = 0;
+            stream->failed = false;
+            pumpListStream(stream);
+            freeBuffer(buf);
+            return;
         }
+        if (admitted && scheduleBackground(listener, client, nullptr, (const unsigned char *) buf->base, readCount)) {
+            freeBuffer(buf);
+            return;
+        }
+        unsigned char writeBuffer[WRITE_BUFFER_SIZE];
+        size_t sz = admitted ? queryLookup(listener, client, nullptr, writeBuffer, sizeof(writeBuffer), (const unsigned char *) buf->base, readCount)
+            : throttledResponse(writeBuffer, sizeof(writeBuffer), (const unsigned char *) buf->base, readCount);
         if (sz > 0) {
 			uv_write_t *req = allocReq();
 			uv_buf_t writeBuf = uv_buf_init((char *) writeBuffer, (unsigned int) sz);
@@ -211,7 +679,8 @@ UVListener::UVListener(
     IdentitySerialization *aIdentitySerialization,
     GatewaySerialization *aSerializationWrapper
 )
-	: StorageListener(aIdentitySerialization, aSerializationWrapper), status(CODE_OK), log(nullptr), verbose(0)
+	: StorageListener(aIdentitySerialization, aSerializationWrapper), status(CODE_OK), log(nullptr), verbose(0),
+    feed(nullptr), scheduled(nullptr)
 {
 	uv_loop_t *loop = uv_default_loop();
     loop->data = this;
@@ -225,6 +694,13 @@ void UVListener::stop()
     if (!uvLoop || status == ERR_CODE_STOPPED)
         return;
     status = ERR_CODE_STOPPED;
+    auto changeFeed = (UVChangeFeed *) feed;
+    if (changeFeed)
+        changeLog->removeObserver(changeFeed);
+    // running background queries are completed before the loop is closed
+    auto backgroundQueries = (UVScheduled *) scheduled;
+    if (backgroundQueries)
+        scheduler->stop();
     uv_stop(uvLoop);
     int result = uv_loop_close(uvLoop);
 
@@ -239,6 +715,10 @@ void UVListener::stop()
 		} while (r != 0);
         uv_loop_close(uvLoop);
 	}
+    delete changeFeed;
+    feed = nullptr;
+    delete backgroundQueries;
+    scheduled = nullptr;
 }
 
 void UVListener::setAddress(
@@ -300,6 +780,22 @@ int UVListener::run()
 		status = ERR_CODE_SOCKET_LISTEN;
 		return ERR_CODE_SOCKET_LISTEN;
 	}
+    // change feed
+    if (changeLog && !feed) {
+        auto changeFeed = new UVChangeFeed(identitySerialization, changeLog);
+        uv_async_init(loop, &changeFeed->async, onChangeLogAsync);
+        changeFeed->async.data = changeFeed;
+        feed = changeFeed;
+        changeLog->addObserver(changeFeed);
+    }
+    // background queries
+    if (scheduler && !scheduled) {
+        auto backgroundQueries = new UVScheduled;
+        uv_async_init(loop, &backgroundQueries->async, onScheduledAsync);
+        backgroundQueries->async.data = backgroundQueries;
+        scheduled = backgroundQueries;
+        scheduler->start(backgroundQueries);
+    }
 	status = CODE_OK;
 	uv_run(loop, UV_RUN_DEFAULT);
     return status;
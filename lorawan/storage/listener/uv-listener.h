@@ -24,6 +24,8 @@ private:
     int verbose;
 public:
     int status;
+    void *feed;     ///< change feed subscribers, created by run() if change log is set
+    void *scheduled;    ///< background query replies, created by run() if scheduler is set
     explicit UVListener(
             IdentitySerialization *aIdentitySerialization,
             GatewaySerialization *aSerializationWrapper
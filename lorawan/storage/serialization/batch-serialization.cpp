@@ -0,0 +1,168 @@
+#include "lorawan/storage/serialization/batch-serialization.h"
+
+#include <cstring>
+
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+BatchItem::BatchItem()
+    : requestId(0), data(nullptr), size(0)
+{
+
+}
+
+BatchItem::BatchItem(
+    uint32_t aRequestId,
+    const unsigned char *aData,
+    size_t aSize
+)
+    : requestId(aRequestId), data(aData), size(aSize)
+{
+
+}
+
+BatchWriter::BatchWriter(
+    unsigned char *aBuf,
+    size_t aSize
+)
+    : buf(aBuf), bufSize(aSize), pos(SIZE_BATCH_HEADER), count(0)
+{
+    if (buf && bufSize >= SIZE_BATCH_HEADER) {
+        buf[0] = QUERY_BATCH;
+        buf[1] = BATCH_PROTOCOL_VERSION;
+        buf[2] = 0;
+    }
+}
+
+bool BatchWriter::add(
+    uint32_t requestId,
+    const unsigned char *data,
+    size_t size
+)
+{
+    if (!buf || count >= MAX_BATCH_ITEMS || size > 0xffff
+        || pos + SIZE_BATCH_ITEM_HEADER + size > bufSize)
+        return false;
+    uint32_t id = HTON4(requestId);
+    uint16_t len = HTON2((uint16_t) size);
+    memmove(&buf[pos], &id, sizeof(id));            // 4
+    memmove(&buf[pos + 4], &len, sizeof(len));      // 2
+    if (size && data && data != &buf[pos + SIZE_BATCH_ITEM_HEADER])
+        memmove(&buf[pos + SIZE_BATCH_ITEM_HEADER], data, size);
+    pos += SIZE_BATCH_ITEM_HEADER + size;
+    count++;
+    buf[2] = count;
+    return true;
+}
+
+bool BatchWriter::add(
+    const ServiceMessage &value
+)
+{
+    if (!buf || pos + SIZE_BATCH_ITEM_HEADER + SIZE_GET_RESPONSE > bufSize)
+        return false;
+    // serialize in place, then write item header
+    size_t sz = value.serialize(&buf[pos + SIZE_BATCH_ITEM_HEADER]);
+    return add(value.requestId, &buf[pos + SIZE_BATCH_ITEM_HEADER], sz);
+}
+
+size_t BatchWriter::available() const
+{
+    if (pos + SIZE_BATCH_ITEM_HEADER >= bufSize)
+        return 0;
+    return bufSize - pos - SIZE_BATCH_ITEM_HEADER;
+}
+
+size_t BatchWriter::size() const
+{
+    return pos;
+}
+
+bool isBatchMessage(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    return buf && sz >= SIZE_BATCH_HEADER && buf[0] == QUERY_BATCH && buf[1] == BATCH_PROTOCOL_VERSION;
+}
+
+size_t batchMessageSize(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    if (!isBatchMessage(buf, sz))
+        return 0;
+    uint8_t count = buf[2];
+    size_t pos = SIZE_BATCH_HEADER;
+    for (uint8_t i = 0; i < count; i++) {
+        if (pos + SIZE_BATCH_ITEM_HEADER > sz)
+            return 0;
+        uint16_t len;
+        memmove(&len, &buf[pos + 4], sizeof(len));
+        pos += SIZE_BATCH_ITEM_HEADER + NTOH2(len);
+        if (pos > sz)
+            return 0;
+    }
+    return pos;
+}
+
+int parseBatch(
+    std::vector<BatchItem> &retVal,
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    if (!isBatchMessage(buf, sz))
+        return ERR_CODE_INVALID_PACKET;
+    uint8_t count = buf[2];
+    size_t pos = SIZE_BATCH_HEADER;
+    for (uint8_t i = 0; i < count; i++) {
+        if (pos + SIZE_BATCH_ITEM_HEADER > sz)
+            return ERR_CODE_INVALID_PACKET;
+        uint32_t id;
+        uint16_t len;
+        memmove(&id, &buf[pos], sizeof(id));
+        memmove(&len, &buf[pos + 4], sizeof(len));
+        len = NTOH2(len);
+        pos += SIZE_BATCH_ITEM_HEADER;
+        if (pos + len > sz)
+            return ERR_CODE_INVALID_PACKET;
+        retVal.emplace_back(NTOH4(id), len ? &buf[pos] : nullptr, len);
+        pos += len;
+    }
+    return CODE_OK;
+}
+
+size_t queryBatch(
+    IdentitySerialization *identitySerialization,
+    GatewaySerialization *gatewaySerialization,
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    std::vector<BatchItem> items;
+    if (parseBatch(items, request, sz) != CODE_OK)
+        return 0;
+    BatchWriter writer(retBuf, retSize);
+    for (auto &item : items) {
+        size_t space = writer.available();
+        size_t r = 0;
+        // fixed size replies (up to SIZE_GET_RESPONSE) do not check buffer size, lists are shortened to fit
+        if (item.size && space >= SIZE_GET_RESPONSE) {
+            unsigned char *reply = retBuf + writer.size() + SIZE_BATCH_ITEM_HEADER;
+            if (identitySerialization)
+                r = identitySerialization->query(reply, space, item.data, item.size);
+            if (r == 0 && gatewaySerialization)
+                r = gatewaySerialization->query(reply, space, item.data, item.size);
+            if (r > space)
+                r = 0;
+        }
+        if (!writer.add(item.requestId, retBuf + writer.size() + SIZE_BATCH_ITEM_HEADER, r))
+            break;
+    }
+    return writer.size();
+}
@@ -0,0 +1,143 @@
+#ifndef BATCH_SERIALIZATION_H_
+#define BATCH_SERIALIZATION_H_	1
+
+#include <vector>
+#include <cinttypes>
+#include <cstddef>
+
+#include "lorawan/storage/serialization/identity-serialization.h"
+#include "lorawan/storage/serialization/gateway-serialization.h"
+
+/**
+ * Protocol version 2: several requests (replies) in one UDP datagram or TCP frame,
+ * each one with the client assigned 32-bit request identifier.
+ * Version 1 messages (13-byte ServiceMessage header without identifier) are not changed.
+ *
+ * Frame:
+ *  0   'm'
+ *  1   version (2)
+ *  2   count of items
+ *  3   items:
+ *      0   request identifier, 4 bytes, network byte order
+ *      4   message size, 2 bytes, network byte order. 0- request is not recognized
+ *      6   version 1 message (request or reply)
+ */
+#define QUERY_BATCH             'm'
+#define BATCH_PROTOCOL_VERSION  2
+#define SIZE_BATCH_HEADER       3
+#define SIZE_BATCH_ITEM_HEADER  6
+#define MAX_BATCH_ITEMS         255
+// largest batch frame in one datagram, clients fill the Ethernet MTU (UvClient SEND_BUFFER_SIZE)
+#define MAX_BATCH_FRAME_SIZE    1432
+
+/**
+ * Item of the batch frame, data points to the frame buffer
+ */
+class BatchItem {
+public:
+    uint32_t requestId;
+    const unsigned char *data;
+    size_t size;
+    BatchItem();
+    BatchItem(uint32_t requestId, const unsigned char *data, size_t size);
+};
+
+/**
+ * Write batch frame to the buffer
+ */
+class BatchWriter {
+private:
+    unsigned char *buf;
+    size_t bufSize;
+    size_t pos;
+public:
+    uint8_t count;
+    BatchWriter(
+        unsigned char *buf,
+        size_t size
+    );
+    /**
+     * Append serialized message
+     * @param requestId request identifier
+     * @param data message, can be NULL if size is 0
+     * @param size message size
+     * @return false if buffer is too small
+     */
+    bool add(
+        uint32_t requestId,
+        const unsigned char *data,
+        size_t size
+    );
+    /**
+     * Append request. Message must be already in network byte order.
+     * Message requestId is used as item identifier.
+     * @param value request
+     * @return false if buffer is too small
+     */
+    bool add(
+        const ServiceMessage &value
+    );
+    /**
+     * Buffer space left for the next item (excluding item header)
+     */
+    size_t available() const;
+    /**
+     * @return frame size
+     */
+    size_t size() const;
+};
+
+/**
+ * @return true if buffer starts with batch frame header
+ */
+bool isBatchMessage(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * TCP stream does not preserve frame boundaries, use it to find out is frame received completely
+ * @param buf received bytes, starting with batch frame header
+ * @param sz received bytes count
+ * @return frame size, 0- frame is incomplete or it is not a batch frame
+ */
+size_t batchMessageSize(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * Parse batch frame
+ * @param retVal items pointed to the buf
+ * @param buf frame
+ * @param sz frame size
+ * @return CODE_OK, ERR_CODE_INVALID_PACKET
+ */
+int parseBatch(
+    std::vector<BatchItem> &retVal,
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * Call identity then gateway serialization for each request of the batch frame
+ * and put replies with the same request identifiers to the retBuf.
+ * Requests that do not fit the reply buffer are answered with the empty item.
+ * @param identitySerialization identity serialization, can be NULL
+ * @param gatewaySerialization gateway serialization, can be NULL
+ * @param retBuf reply buffer
+ * @param retSize reply buffer size
+ * @param request batch frame
+ * @param sz batch frame size
+ * @return reply size, 0 if request is not a valid batch frame
+ */
+size_t queryBatch(
+    IdentitySerialization *identitySerialization,
+    GatewaySerialization *gatewaySerialization,
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+);
+
+#endif
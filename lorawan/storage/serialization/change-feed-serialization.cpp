@@ -0,0 +1,247 @@
+#include "lorawan/storage/serialization/change-feed-serialization.h"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/lorawan-string.h"
+
+WatchRequest::WatchRequest()
+    : ServiceMessage(QUERY_IDENTITY_WATCH, 0, 0), seq(0)
+{
+
+}
+
+WatchRequest::WatchRequest(
+    uint64_t aSeq,
+    int32_t code,
+    uint64_t accessCode
+)
+    : ServiceMessage(QUERY_IDENTITY_WATCH, code, accessCode), seq(aSeq)
+{
+
+}
+
+WatchRequest::WatchRequest(
+    const unsigned char *buf,
+    size_t sz
+)
+    : ServiceMessage(buf, sz), seq(0)   // 13
+{
+    if (sz >= SIZE_WATCH_REQUEST)
+        memmove(&seq, &buf[13], sizeof(seq));   // 8
+}
+
+void WatchRequest::ntoh()
+{
+    ServiceMessage::ntoh();
+    seq = NTOH8(seq);
+}
+
+size_t WatchRequest::serialize(
+    unsigned char *retBuf
+) const
+{
+    ServiceMessage::serialize(retBuf);          // 13
+    if (retBuf)
+        memmove(&retBuf[13], &seq, sizeof(seq));    // 8
+    return SIZE_WATCH_REQUEST;                  // 21
+}
+
+std::string WatchRequest::toJsonString() const
+{
+    std::stringstream ss;
+    ss << R"({"seq": )" << seq << "}";
+    return ss.str();
+}
+
+WatchResponse::WatchResponse()
+    : WatchRequest()
+{
+
+}
+
+WatchResponse::WatchResponse(
+    int32_t code,
+    uint64_t lastSeq
+)
+    : WatchRequest(lastSeq, code, 0)
+{
+
+}
+
+WatchResponse::WatchResponse(
+    const unsigned char *buf,
+    size_t sz
+)
+    : WatchRequest(buf, sz)
+{
+
+}
+
+ChangeEvent::ChangeEvent()
+    : op(0), seq(0), addr(0)
+{
+
+}
+
+ChangeEvent::ChangeEvent(
+    const ChangeRecord &record
+)
+    : op(record.op), seq(record.seq), addr(record.identity.value.devaddr)
+{
+
+}
+
+ChangeEvent::ChangeEvent(
+    const unsigned char *buf,
+    size_t sz
+)
+    : op(0), seq(0), addr(0)
+{
+    if (sz < SIZE_CHANGE_EVENT || buf[0] != CHANGE_EVENT_TAG)
+        return;
+    op = (char) buf[1];                             // 1
+    memmove(&seq, &buf[2], sizeof(seq));            // 8
+    memmove(&addr.u, &buf[10], sizeof(addr.u));     // 4
+    seq = NTOH8(seq);
+    addr.u = NTOH4(addr.u);
+}
+
+size_t ChangeEvent::serialize(
+    unsigned char *retBuf
+) const
+{
+    if (retBuf) {
+        uint64_t s = HTON8(seq);
+        uint32_t a = HTON4(addr.u);
+        retBuf[0] = CHANGE_EVENT_TAG;               // 1
+        retBuf[1] = (unsigned char) op;             // 1
+        memmove(&retBuf[2], &s, sizeof(s));         // 8
+        memmove(&retBuf[10], &a, sizeof(a));        // 4
+    }
+    return SIZE_CHANGE_EVENT;                       // 14
+}
+
+std::string ChangeEvent::toJsonString() const
+{
+    std::stringstream ss;
+    ss << R"({"op": ")" << op << R"(", "seq": )" << seq << R"(, "addr": ")" << DEVADDR2string(addr) << "\"}";
+    return ss.str();
+}
+
+bool isWatchRequest(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    return sz >= SIZE_WATCH_REQUEST && buf[0] == QUERY_IDENTITY_WATCH;
+}
+
+int subscribeChangeFeed(
+    IdentitySerialization *identitySerialization,
+    const ChangeLog *log,
+    uint64_t &retSeq,
+    unsigned char *retBuf,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    WatchRequest req(request, sz);
+    req.ntoh();
+    uint64_t last = log ? log->last() : 0;
+    int r = CODE_OK;
+    if (!identitySerialization
+        || req.code != identitySerialization->code || req.accessCode != identitySerialization->accessCode)
+        r = ERR_CODE_ACCESS_DENIED;
+    else if (!log)
+        r = ERR_CODE_NO_CHANGE_FEED;
+    else if (req.seq == 0)
+        retSeq = last;
+    else {
+        // resume: check are changes after the requested sequence number still in the log
+        std::vector<ChangeRecord> records;
+        r = log->since(records, req.seq, 1);
+        retSeq = r == CODE_OK ? req.seq : last;
+    }
+    WatchResponse resp(r, last);
+    resp.accessCode = req.accessCode;
+    resp.ntoh();
+    resp.serialize(retBuf);
+    return r;
+}
+
+ChangeFeed::ChangeFeed(
+    IdentitySerialization *aIdentitySerialization,
+    const ChangeLog *aLog
+)
+    : identitySerialization(aIdentitySerialization), log(aLog)
+{
+
+}
+
+int ChangeFeed::subscribe(
+    const void *client,
+    unsigned char *retBuf,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    uint64_t seq = 0;
+    int r = subscribeChangeFeed(identitySerialization, log, seq, retBuf, request, sz);
+    if (r == CODE_OK || r == ERR_CODE_REPLICA_SNAPSHOT)
+        subscribers[client] = seq;
+    return r;
+}
+
+void ChangeFeed::unsubscribe(
+    const void *client
+)
+{
+    subscribers.erase(client);
+}
+
+bool ChangeFeed::isSubscribed(
+    const void *client
+) const
+{
+    return subscribers.find(client) != subscribers.end();
+}
+
+std::vector<const void *> ChangeFeed::clients() const
+{
+    std::vector<const void *> r;
+    r.reserve(subscribers.size());
+    for (auto &s : subscribers) {
+        r.push_back(s.first);
+    }
+    return r;
+}
+
+size_t ChangeFeed::next(
+    const void *client,
+    unsigned char *retBuf,
+    size_t retSize
+)
+{
+    auto it = subscribers.find(client);
+    if (it == subscribers.end() || retSize < SIZE_WATCH_RESPONSE)
+        return 0;
+    std::vector<ChangeRecord> records;
+    if (log->since(records, it->second, retSize / SIZE_CHANGE_EVENT) != CODE_OK) {
+        // changes are lost, subscriber drops cached entries and continues from the last one
+        it->second = log->last();
+        WatchResponse resp(ERR_CODE_REPLICA_SNAPSHOT, it->second);
+        resp.ntoh();
+        return resp.serialize(retBuf);
+    }
+    size_t sz = 0;
+    for (auto &r : records) {
+        sz += ChangeEvent(r).serialize(retBuf + sz);
+    }
+    if (!records.empty())
+        it->second = records.back().seq;
+    return sz;
+}
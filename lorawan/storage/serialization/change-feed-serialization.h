@@ -0,0 +1,173 @@
+#ifndef CHANGE_FEED_SERIALIZATION_H_
+#define CHANGE_FEED_SERIALIZATION_H_	1
+
+#include <cinttypes>
+#include <map>
+#include <vector>
+
+#include "lorawan/storage/serialization/service-serialization.h"
+#include "lorawan/storage/serialization/identity-serialization.h"
+#include "lorawan/storage/service/change-log.h"
+
+/**
+ * Change feed: TCP client subscribes to the identity changes, service pushes change events as they are committed.
+ * Client caching identities drops the cached entry on the event.
+ * Feed is served by the libuv TCP listener of the service with the change log (--journal),
+ * other listeners reply to the subscribe request with ERR_CODE_NO_CHANGE_FEED.
+ *
+ * Subscribe request:
+ *  0   tag 'w'
+ *  1   code, 4 bytes
+ *  5   access code, 8 bytes
+ *  13  last sequence number the client has received, 8 bytes. 0- new changes only
+ *
+ * Subscribe reply (also sent when the subscriber has missed changes):
+ *  0   tag 'w'
+ *  1   code, 4 bytes: CODE_OK, ERR_CODE_REPLICA_SNAPSHOT- changes are lost, client must drop all cached entries,
+ *      ERR_CODE_ACCESS_DENIED, ERR_CODE_NO_CHANGE_FEED- service has no change log (--journal) or listener has no change feed
+ *  5   access code, 8 bytes
+ *  13  service last sequence number, 8 bytes
+ * Events follow the requested sequence number. If it is 0 or changes are lost, events follow the last one.
+ *
+ * Change event:
+ *  0   tag 'u'
+ *  1   operation: 'p'- assigned (changed), 'r'- removed
+ *  2   sequence number, 8 bytes
+ *  10  network address, 4 bytes
+ * Numbers are in network byte order.
+ */
+#define QUERY_IDENTITY_WATCH        'w'
+#define CHANGE_EVENT_TAG            'u'
+#define SIZE_WATCH_REQUEST          21
+#define SIZE_WATCH_RESPONSE         21
+#define SIZE_CHANGE_EVENT           14
+
+class WatchRequest : public ServiceMessage {
+public:
+    uint64_t seq;
+    WatchRequest();
+    WatchRequest(
+        uint64_t seq,
+        int32_t code,
+        uint64_t accessCode
+    );
+    WatchRequest(const unsigned char *buf, size_t sz);
+    ~WatchRequest() override = default;
+    void ntoh() override;
+    size_t serialize(unsigned char *retBuf) const override;
+    std::string toJsonString() const override;
+};
+
+/**
+ * Subscribe reply, code field contains the result
+ */
+class WatchResponse : public WatchRequest {
+public:
+    WatchResponse();
+    WatchResponse(
+        int32_t code,
+        uint64_t lastSeq
+    );
+    WatchResponse(const unsigned char *buf, size_t sz);
+    ~WatchResponse() override = default;
+};
+
+class ChangeEvent {
+public:
+    char op;
+    uint64_t seq;
+    DEVADDR addr;
+    ChangeEvent();
+    explicit ChangeEvent(const ChangeRecord &record);
+    ChangeEvent(const unsigned char *buf, size_t sz);
+    /**
+     * Serialize in network byte order
+     * @return SIZE_CHANGE_EVENT
+     */
+    size_t serialize(unsigned char *retBuf) const;
+    std::string toJsonString() const;
+};
+
+/**
+ * @return true if buffer contains subscribe request
+ */
+bool isWatchRequest(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * Check subscribe request and return the reply
+ * @param identitySerialization identity serialization, access code is checked
+ * @param log change log, NULL- feed is not available
+ * @param retSeq return sequence number to send events after
+ * @param retBuf buffer to return serialized subscribe reply, at least SIZE_WATCH_RESPONSE bytes
+ * @param request serialized request
+ * @param sz serialized request size
+ * @return CODE_OK, ERR_CODE_REPLICA_SNAPSHOT- subscribed from the last sequence number,
+ *  ERR_CODE_ACCESS_DENIED or ERR_CODE_NO_CHANGE_FEED- not subscribed
+ */
+int subscribeChangeFeed(
+    IdentitySerialization *identitySerialization,
+    const ChangeLog *log,
+    uint64_t &retSeq,
+    unsigned char *retBuf,
+    const unsigned char *request,
+    size_t sz
+);
+
+/**
+ * Change feed subscribers and the last sequence number sent to each one, independent of the listener.
+ * Listener subscribes the client on the subscribe request, writes next() bytes while the client takes them
+ * and unsubscribes the disconnected client. Not thread safe, listener calls it from one thread.
+ */
+class ChangeFeed {
+private:
+    IdentitySerialization *identitySerialization;
+    const ChangeLog *log;
+    std::map<const void *, uint64_t> subscribers;   ///< client -> last sent sequence number
+public:
+    /**
+     * @param identitySerialization access code is checked against it
+     * @param log change log
+     */
+    ChangeFeed(
+        IdentitySerialization *identitySerialization,
+        const ChangeLog *log
+    );
+    /**
+     * Check subscribe request, subscribe client if access is granted
+     * @param client client handle
+     * @param retBuf buffer to return serialized subscribe reply, at least SIZE_WATCH_RESPONSE bytes
+     * @param request serialized request
+     * @param sz serialized request size
+     * @return subscribeChangeFeed() result
+     */
+    int subscribe(
+        const void *client,
+        unsigned char *retBuf,
+        const unsigned char *request,
+        size_t sz
+    );
+    void unsubscribe(
+        const void *client
+    );
+    bool isSubscribed(
+        const void *client
+    ) const;
+    std::vector<const void *> clients() const;
+    /**
+     * Serialize events after the last sent one, or subscribe reply with ERR_CODE_REPLICA_SNAPSHOT if they are lost
+     * @param client subscribed client
+     * @param retBuf buffer, at least SIZE_WATCH_RESPONSE bytes
+     * @param retSize buffer size
+     * @return size, 0- no new events or client is not subscribed
+     */
+    size_t next(
+        const void *client,
+        unsigned char *retBuf,
+        size_t retSize
+    );
+};
+
+#endif
@@ -556,7 +556,7 @@ static size_t getListResponseSize(
     return r;
 }
 
-size_t GatewayBinarySerialization::query(
+size_t GatewaySerialization::query(
     unsigned char *retBuf,
     size_t retSize,
     const unsigned char *request,
@@ -666,6 +666,196 @@ size_t GatewayBinarySerialization::query(
     return rsize;
 }
 
+size_t gatewayRequestSize(
+    char tag
+)
+{
+    switch (tag) {
+        case QUERY_GATEWAY_ADDR:
+        case QUERY_GATEWAY_RM:
+            return SIZE_GATEWAY_ID_REQUEST;
+        case QUERY_GATEWAY_ID:
+            return SIZE_DEVICE_ADDR_REQUEST;
+        case QUERY_GATEWAY_ASSIGN:
+            return SIZE_DEVICE_EUI_ADDR_REQUEST;
+        case QUERY_GATEWAY_LIST:
+        case QUERY_GATEWAY_COUNT:
+        case QUERY_GATEWAY_FORCE_SAVE:
+        case QUERY_GATEWAY_CLOSE_RESOURCES:
+            return SIZE_OPERATION_REQUEST;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Write GatewayOperationResponse in place
+ * @return SIZE_OPERATION_RESPONSE
+ */
+static size_t serializeOperationResponse(
+    unsigned char *retBuf,
+    char tag,
+    int32_t code,
+    uint64_t accessCode,
+    uint32_t offset,
+    uint8_t size,
+    int32_t response
+)
+{
+    serializeServiceHeader(retBuf, tag, code, accessCode);      // 13
+    offset = NTOH4(offset);
+    memmove(&retBuf[13], &offset, sizeof(offset));              // 4
+    retBuf[17] = size;                                          // 1
+    uint32_t r = NTOH4((uint32_t) response);
+    memmove(&retBuf[SIZE_OPERATION_REQUEST], &r, sizeof(r));    // 4
+    return SIZE_OPERATION_RESPONSE;                             // 22
+}
+
+/**
+ * Write GatewayGetResponse in place
+ * @return IPv4 28 IPv6 40
+ */
+static size_t serializeGetResponse(
+    unsigned char *retBuf,
+    char tag,
+    int32_t code,
+    uint64_t accessCode,
+    const GatewayIdentity &value
+)
+{
+    serializeServiceHeader(retBuf, tag, code, accessCode);      // 13
+    uint64_t id = NTOH8(value.gatewayId);
+    memmove(retBuf + SIZE_SERVICE_MESSAGE, &id, sizeof(id));    // 8
+    struct sockaddr_storage addr {};
+    memmove(&addr, &value.sockaddr, sizeof(value.sockaddr));
+    sockaddrNtoh((struct sockaddr *) &addr);
+    return serializeSocketAddress(retBuf + SIZE_SERVICE_MESSAGE + 8, (struct sockaddr *) &addr)     // 0, 7, 19
+        + SIZE_SERVICE_MESSAGE + 8;
+}
+
+/**
+ * Read socket address of the request. Gateway identity keeps struct sockaddr only, longer address is cut.
+ */
+static void deserializeGatewayAddress(
+    struct sockaddr &retVal,
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    struct sockaddr_storage addr {};
+    deserializeSocketAddress((struct sockaddr *) &addr, buf, sz);   // 0, 7, 19
+    sockaddrNtoh((struct sockaddr *) &addr);
+    memmove(&retVal, &addr, sizeof(retVal));
+}
+
+/**
+ * Access denied response does not depend on the request, it is formatted once
+ */
+class GatewayAccessDeniedResponse {
+public:
+    unsigned char response[SIZE_OPERATION_RESPONSE];
+    GatewayAccessDeniedResponse() {
+        serializeOperationResponse(response, QUERY_GATEWAY_LIST, ERR_CODE_ACCESS_DENIED, 0, 0, 0, 0);
+    }
+};
+
+static const GatewayAccessDeniedResponse gatewayAccessDeniedResponse;
+
+bool isGatewayAccessDenied(
+    const unsigned char *request,
+    size_t sz,
+    int32_t code,
+    uint64_t accessCode
+)
+{
+    if (sz < SIZE_SERVICE_MESSAGE)
+        return false;
+    size_t requestSize = gatewayRequestSize((char) request[0]);
+    return requestSize && sz >= requestSize && !hasServiceHeaderCredentials(request, code, accessCode);
+}
+
+size_t accessDeniedGatewayResponse(
+    unsigned char *retBuf,
+    size_t retSize
+)
+{
+    if (retSize < SIZE_OPERATION_RESPONSE)
+        return 0;
+    memmove(retBuf, gatewayAccessDeniedResponse.response, SIZE_OPERATION_RESPONSE);
+    return SIZE_OPERATION_RESPONSE;
+}
+
+/**
+ * Point requests are decoded in place and the response is written straight into the retBuf,
+ * no request and response objects are created. List and other requests go the object based path
+ * GatewaySerialization::query().
+ */
+size_t GatewayBinarySerialization::query(
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (!svc)
+        return 0;
+    if (sz < SIZE_SERVICE_MESSAGE)
+        return 0;
+    size_t requestSize = gatewayRequestSize((char) request[0]);
+    if (requestSize == 0 || sz < requestSize)
+        return 0;   // unknown request
+    if (!hasServiceHeaderCredentials(request, code, accessCode)) {
+#ifdef ENABLE_DEBUG
+        std::cerr << ERR_ACCESS_DENIED << std::endl;
+#endif
+        return accessDeniedGatewayResponse(retBuf, retSize);
+    }
+    char tag;
+    int32_t c;
+    uint64_t ac;
+    deserializeServiceHeader(tag, c, ac, request);
+
+    const unsigned char *body = request + SIZE_SERVICE_MESSAGE;
+    switch (tag) {
+        case QUERY_GATEWAY_ADDR:   // request gateway address (with identifier) by identifier. Return 0 if success
+        {
+            uint64_t id;
+            memmove(&id, body, sizeof(id));         // 8
+            GatewayIdentity gi(NTOH8(id));
+            svc->get(gi, gi);
+            return serializeGetResponse(retBuf, tag, c, ac, gi);
+        }
+        case QUERY_GATEWAY_ID:   // request gateway identifier(with address) by address. Return 0 if success
+        {
+            GatewayIdentity gi;
+            deserializeGatewayAddress(gi.sockaddr, body, sz - SIZE_SERVICE_MESSAGE);
+            int r = svc->get(gi, gi);
+            return serializeGetResponse(retBuf, tag, r, ac, gi);
+        }
+        case QUERY_GATEWAY_ASSIGN:   // assign (put) gateway address to the gateway by identifier
+        case QUERY_GATEWAY_RM:   // Remove entry
+        {
+            GatewayIdentity gi;
+            memmove(&gi.gatewayId, body, sizeof(gi.gatewayId));   // 8
+            gi.gatewayId = NTOH8(gi.gatewayId);
+            deserializeGatewayAddress(gi.sockaddr, &request[SIZE_GATEWAY_ID_REQUEST], sz - SIZE_GATEWAY_ID_REQUEST);
+            int r = tag == QUERY_GATEWAY_ASSIGN ? svc->put(gi) : svc->rm(gi);
+            // size is count of placed or deleted entries
+            return serializeOperationResponse(retBuf, tag, c, ac, 0, r == 0 ? 1 : 0, r);
+        }
+        case QUERY_GATEWAY_COUNT:   // count
+        {
+            uint32_t offset;
+            memmove(&offset, body, sizeof(offset)); // 4
+            return serializeOperationResponse(retBuf, tag, CODE_OK, ac, NTOH4(offset), body[4],
+                (int32_t) svc->size());
+        }
+        default:
+            break;
+    }
+    return GatewaySerialization::query(retBuf, retSize, request, sz);
+}
+
 /**
  * Check does it serialized query in the buffer
  * @param buffer buffer to check
@@ -120,6 +120,41 @@ public:
     size_t shortenList2Fit(size_t serializedSize);
 };
 
+/**
+ * Minimal size of the request, the same sizes are checked by deserializeGateway()
+ * @param tag request tag
+ * @return minimal request size, 0- unknown request
+ */
+size_t gatewayRequestSize(
+    char tag
+);
+
+/**
+ * Check tag, size and credentials from the 13 bytes header, request is not decoded
+ * @param request serialized request
+ * @param sz request size
+ * @param code expected code
+ * @param accessCode expected access code
+ * @return true if it is gateway request with the other code or access code
+ */
+bool isGatewayAccessDenied(
+    const unsigned char *request,
+    size_t sz,
+    int32_t code,
+    uint64_t accessCode
+);
+
+/**
+ * Copy preformatted ERR_CODE_ACCESS_DENIED response
+ * @param retBuf buffer to return response
+ * @param retSize buffer size
+ * @return 22, 0- buffer is too small
+ */
+size_t accessDeniedGatewayResponse(
+    unsigned char *retBuf,
+    size_t retSize
+);
+
 class GatewayBinarySerialization : public GatewaySerialization {
 public:
     explicit GatewayBinarySerialization(
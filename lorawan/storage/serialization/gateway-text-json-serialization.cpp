@@ -1,11 +1,10 @@
-#include <sstream>
-
 #include "lorawan/storage/serialization/gateway-text-json-serialization.h"
 #include "lorawan/helper/ip-address.h"
 #include "lorawan/lorawan-string.h"
 #include "lorawan/lorawan-conv.h"
 #include "lorawan/lorawan-error.h"
 #include "lorawan/storage/serialization/json-helper.h"
+#include "lorawan/helper/json-writer.h"
 
 #ifdef ESP_PLATFORM
 #include "platform-defs.h"
@@ -74,7 +73,9 @@ size_t GatewayTextJSONSerialization::query(
             int r = svc->get(gi, gi);
             if (r)
                 return retStatusCode(retBuf, retSize, r);
-            return retStr(retBuf, retSize, gi.toJsonString());
+            JsonWriter writer(jsonResponseBuffer());
+            gi.toJson(writer);
+            return retStr(retBuf, retSize, writer.buffer);
         }
             break;
         case 'I':
@@ -91,7 +92,9 @@ size_t GatewayTextJSONSerialization::query(
             int r = svc->get(gi, gi);
             if (r)
                 return retStatusCode(retBuf, retSize, r);
-            return retStr(retBuf, retSize, gi.toJsonString());
+            JsonWriter writer(jsonResponseBuffer());
+            gi.toJson(writer);
+            return retStr(retBuf, retSize, writer.buffer);
         }
             break;
         case 'L': {
@@ -110,28 +113,32 @@ size_t GatewayTextJSONSerialization::query(
                     size = jSize;
                 }
             }
-            std::vector<GatewayIdentity> nis;
+            // list buffer of the thread keeps capacity between the requests
+            static thread_local std::vector<GatewayIdentity> nis;
+            nis.clear();
             int r = svc->list(nis, offset, size);
             if (r == CODE_OK) {
-                std::stringstream ss;
+                JsonWriter writer(jsonResponseBuffer());
                 bool isFirst = true;
-                ss << "[";
+                writer.raw('[');
                 for (auto &ni: nis) {
                     if (isFirst)
                         isFirst = false;
                     else
-                        ss << ", ";
-                    ss << ni.toJsonString();
+                        writer.raw(", ", 2);
+                    ni.toJson(writer);
                 }
-                ss << "]";
-                return retStr(retBuf, retSize, ss.str());
+                writer.raw(']');
+                return retStr(retBuf, retSize, writer.buffer);
             } else
                 return retStatusCode(retBuf, retSize, r);
         }
         case 'C': {
             // count
             auto r = svc->size();
-            return retStr(retBuf, retSize, std::to_string(r));
+            JsonWriter writer(jsonResponseBuffer());
+            writer.dec((uint64_t) r);
+            return retStr(retBuf, retSize, writer.buffer);
         }
         case 'P':
             // assign
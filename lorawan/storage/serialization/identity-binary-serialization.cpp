@@ -289,6 +289,130 @@ std::string IdentityOperationRequest::toJsonString() const {
     return ss.str();
 }
 
+/**
+ * Swap integer values of the filter, keys and names are byte arrays
+ */
+static void ntohNETWORK_IDENTITY_FILTER(
+    NETWORK_IDENTITY_FILTER &value
+)
+{
+    switch (value.property) {
+        case NIP_ADDRESS:
+        {
+            uint32_t v;
+            memmove(&v, value.filterData, sizeof(v));
+            v = NTOH4(v);
+            memmove(value.filterData, &v, sizeof(v));
+            break;
+        }
+        case NIP_DEVEUI:
+        case NIP_APPEUI:
+        {
+            uint64_t v;
+            memmove(&v, value.filterData, sizeof(v));
+            v = NTOH8(v);
+            memmove(value.filterData, &v, sizeof(v));
+            break;
+        }
+        case NIP_DEVNONCE:
+        {
+            uint16_t v;
+            memmove(&v, value.filterData, sizeof(v));
+            v = NTOH2(v);
+            memmove(value.filterData, &v, sizeof(v));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+IdentityFilterRequest::IdentityFilterRequest()
+    : IdentityOperationRequest(QUERY_IDENTITY_FILTER, 0, 0, 0, 0)
+{
+}
+
+IdentityFilterRequest::IdentityFilterRequest(
+    uint32_t aOffset,
+    uint8_t aSize,
+    const std::vector<NETWORK_IDENTITY_FILTER> &aFilters,
+    int32_t code,
+    uint64_t accessCode
+)
+    : IdentityOperationRequest(QUERY_IDENTITY_FILTER, aOffset, aSize, code, accessCode),
+    filters(aFilters.begin(), aFilters.size() > MAX_IDENTITY_FILTERS ? aFilters.begin() + MAX_IDENTITY_FILTERS : aFilters.end())
+{
+}
+
+IdentityFilterRequest::IdentityFilterRequest(
+    const unsigned char *buf,
+    size_t sz
+)
+    : IdentityOperationRequest(buf, sz)                 // 18
+{
+    if (sz < SIZE_FILTER_REQUEST)
+        return;
+    uint8_t count = buf[18];                            // 1
+    const unsigned char *p = buf + SIZE_FILTER_REQUEST;
+    for (uint8_t i = 0; i < count && p + SIZE_NETWORK_IDENTITY_FILTER <= buf + sz; i++) {
+        NETWORK_IDENTITY_FILTER f {};
+        f.pre = (NETWORK_IDENTITY_LOGICAL_PRE_OPERATOR) p[0];
+        f.property = (NETWORK_IDENTITY_PROPERTY) p[1];
+        f.comparisonOperator = (NETWORK_IDENTITY_COMPARISON_OPERATOR) p[2];
+        f.length = p[3] <= sizeof(f.filterData) ? p[3] : (uint8_t) sizeof(f.filterData);
+        memmove(f.filterData, p + 4, sizeof(f.filterData));
+        filters.push_back(f);
+        p += SIZE_NETWORK_IDENTITY_FILTER;
+    }
+}
+
+void IdentityFilterRequest::ntoh()
+{
+    IdentityOperationRequest::ntoh();
+    for (auto &f : filters) {
+        ntohNETWORK_IDENTITY_FILTER(f);
+    }
+}
+
+size_t IdentityFilterRequest::serialize(
+    unsigned char *retBuf
+) const
+{
+    IdentityOperationRequest::serialize(retBuf);        // 18
+    if (retBuf) {
+        retBuf[18] = (uint8_t) filters.size();          // 1
+        unsigned char *p = retBuf + SIZE_FILTER_REQUEST;
+        for (auto &f : filters) {
+            p[0] = (uint8_t) f.pre;
+            p[1] = (uint8_t) f.property;
+            p[2] = (uint8_t) f.comparisonOperator;
+            p[3] = f.length;
+            memmove(p + 4, f.filterData, sizeof(f.filterData));
+            p += SIZE_NETWORK_IDENTITY_FILTER;
+        }
+    }
+    return SIZE_FILTER_REQUEST + filters.size() * SIZE_NETWORK_IDENTITY_FILTER;
+}
+
+std::string IdentityFilterRequest::toJsonString() const {
+    std::stringstream ss;
+    ss << R"({"offset": )" << offset
+        << ", \"size\": " << (int) size
+        << ", \"filter\": \"" << NETWORK_IDENTITY_FILTERS2string(filters)
+        << "\"}";
+    return ss.str();
+}
+
+size_t identityFilterRequestSize(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    if (sz < SIZE_FILTER_REQUEST)
+        return 0;
+    return SIZE_FILTER_REQUEST + buf[18] * SIZE_NETWORK_IDENTITY_FILTER;
+}
+
 IdentityGetResponse::IdentityGetResponse(
     const IdentityAddrRequest& req
 )
@@ -317,6 +441,15 @@ static void ntohNETWORKIDENTITY(
     value.value.devid.id.devNonce.u = NTOH2(value.value.devid.id.devNonce.u);
 }
 
+void deserializeNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const unsigned char *buf
+)
+{
+    deserializeNETWORKIDENTITY(retVal, buf);
+    ntohNETWORKIDENTITY(retVal);
+}
+
 IdentityGetResponse::IdentityGetResponse(
     const unsigned char* buf,
     size_t sz
@@ -642,6 +775,19 @@ size_t IdentitySerialization::query(
                 break;
             }
             break;        }
+        case QUERY_IDENTITY_FILTER:   // List filtered entries
+        {
+            auto gr = (IdentityFilterRequest *) pMsg;
+            r = new IdentityListResponse(*gr);
+            ((IdentityOperationResponse*) r)->response = svc->filter(((IdentityListResponse *) r)->identities,
+                gr->filters, gr->offset, gr->size);
+            size_t serSize = ((IdentityListResponse *) r)->serialize(nullptr);
+            if (serSize > retSize && ((IdentityListResponse *) r)->shortenList2Fit(retSize) > retSize) {
+                delete r;
+                r = nullptr;
+            }
+            break;
+        }
         case QUERY_IDENTITY_COUNT:   // count
         {
             auto gr = (IdentityOperationRequest *) pMsg;
@@ -731,6 +877,10 @@ enum IdentityQueryTag validateIdentityQuery(
             if (size < SIZE_OPERATION_REQUEST)
                 return QUERY_IDENTITY_NONE;
             return QUERY_IDENTITY_CLOSE_RESOURCES;
+        case QUERY_IDENTITY_FILTER:   // filter, reply is the list reply
+            if (size < SIZE_FILTER_REQUEST)
+                return QUERY_IDENTITY_NONE;
+            return QUERY_IDENTITY_FILTER;
     default:
             break;
     }
@@ -787,6 +937,10 @@ enum IdentityQueryTag validateIdentityResponse(
             if (size < SIZE_OPERATION_RESPONSE)
                 return QUERY_IDENTITY_NONE;
             return QUERY_IDENTITY_CLOSE_RESOURCES;
+        case QUERY_IDENTITY_FILTER:   // filtered entries
+            if (size < SIZE_OPERATION_RESPONSE)
+                return QUERY_IDENTITY_NONE;
+            return QUERY_IDENTITY_FILTER;
         default:
             break;
     }
@@ -810,6 +964,7 @@ size_t responseSizeForIdentityRequest(
         case QUERY_IDENTITY_EUI:        // request gateway address (with identifier) by identifier.
             return SIZE_GET_RESPONSE;   //
         case QUERY_IDENTITY_LIST:       // List entries
+        case QUERY_IDENTITY_FILTER:
             {
                 IdentityOperationRequest lr(buffer, size);
                 return getMaxIdentityListResponseSize(lr.size);
@@ -880,6 +1035,11 @@ ServiceMessage* deserializeIdentity(
                 return nullptr;
             r = new IdentityOperationRequest(buf, sz);
             break;
+        case QUERY_IDENTITY_FILTER:   // filter
+            if (sz < identityFilterRequestSize(buf, sz) || sz < SIZE_FILTER_REQUEST)
+                return nullptr;
+            r = new IdentityFilterRequest(buf, sz);
+            break;
         default:
             r = nullptr;
     }
@@ -911,6 +1071,8 @@ const char* identityTag2string(
             return "save";
         case QUERY_IDENTITY_CLOSE_RESOURCES:
             return "close";
+        case QUERY_IDENTITY_FILTER:
+            return "filter";
         default:
             return "";
     }
@@ -944,6 +1106,7 @@ bool isIdentityTag(
         case QUERY_IDENTITY_RM:
         case QUERY_IDENTITY_FORCE_SAVE:
         case QUERY_IDENTITY_CLOSE_RESOURCES:
+        case QUERY_IDENTITY_FILTER:
             return true;
         default:
             return false;
@@ -961,6 +1124,125 @@ IdentityBinarySerialization::IdentityBinarySerialization(
 
 }
 
+size_t identityRequestSize(
+    char tag
+)
+{
+    switch (tag) {
+        case QUERY_IDENTITY_ADDR:
+            return SIZE_DEVICE_EUI_REQUEST;
+        case QUERY_IDENTITY_EUI:
+        case QUERY_IDENTITY_RM:
+            return SIZE_DEVICE_ADDR_REQUEST;
+        case QUERY_IDENTITY_ASSIGN:
+            return SIZE_ASSIGN_REQUEST;
+        case QUERY_IDENTITY_LIST:
+        case QUERY_IDENTITY_COUNT:
+        case QUERY_IDENTITY_NEXT:
+        case QUERY_IDENTITY_FORCE_SAVE:
+        case QUERY_IDENTITY_CLOSE_RESOURCES:
+            return SIZE_OPERATION_REQUEST;
+        case QUERY_IDENTITY_FILTER:
+            return SIZE_FILTER_REQUEST;     // and filters, see identityFilterRequestSize()
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Write identity in the network byte order
+ */
+static void serializeNETWORKIDENTITYNtoh(
+    unsigned char *retBuf,
+    const NETWORKIDENTITY &value
+)
+{
+    NETWORKIDENTITY v(value);
+    ntohNETWORKIDENTITY(v);
+    serializeNETWORKIDENTITY(retBuf, v);
+}
+
+/**
+ * Write IdentityOperationResponse in place
+ * @return SIZE_OPERATION_RESPONSE
+ */
+static size_t serializeOperationResponse(
+    unsigned char *retBuf,
+    char tag,
+    int32_t code,
+    uint64_t accessCode,
+    uint32_t offset,
+    uint8_t size,
+    int32_t response
+)
+{
+    serializeServiceHeader(retBuf, tag, code, accessCode);      // 13
+    offset = NTOH4(offset);
+    memmove(&retBuf[13], &offset, sizeof(offset));              // 4
+    retBuf[17] = size;                                          // 1
+    uint32_t r = NTOH4((uint32_t) response);
+    memmove(&retBuf[SIZE_OPERATION_REQUEST], &r, sizeof(r));    // 4
+    return SIZE_OPERATION_RESPONSE;                             // 22
+}
+
+/**
+ * Write IdentityGetResponse in place
+ * @return SIZE_GET_RESPONSE
+ */
+static size_t serializeGetResponse(
+    unsigned char *retBuf,
+    char tag,
+    int32_t code,
+    uint64_t accessCode,
+    const NETWORKIDENTITY &value
+)
+{
+    serializeServiceHeader(retBuf, tag, code, accessCode);      // 13
+    serializeNETWORKIDENTITYNtoh(retBuf + SIZE_SERVICE_MESSAGE, value);
+    return SIZE_GET_RESPONSE;
+}
+
+/**
+ * Access denied response does not depend on the request, it is formatted once
+ */
+class IdentityAccessDeniedResponse {
+public:
+    unsigned char response[SIZE_OPERATION_RESPONSE];
+    IdentityAccessDeniedResponse() {
+        serializeOperationResponse(response, QUERY_IDENTITY_LIST, ERR_CODE_ACCESS_DENIED, 0, 0, 0, 0);
+    }
+};
+
+static const IdentityAccessDeniedResponse identityAccessDeniedResponse;
+
+bool isIdentityAccessDenied(
+    const unsigned char *request,
+    size_t sz,
+    int32_t code,
+    uint64_t accessCode
+)
+{
+    if (sz < SIZE_SERVICE_MESSAGE)
+        return false;
+    size_t requestSize = identityRequestSize((char) request[0]);
+    return requestSize && sz >= requestSize && !hasServiceHeaderCredentials(request, code, accessCode);
+}
+
+size_t accessDeniedIdentityResponse(
+    unsigned char *retBuf,
+    size_t retSize
+)
+{
+    if (retSize < SIZE_OPERATION_RESPONSE)
+        return 0;
+    memmove(retBuf, identityAccessDeniedResponse.response, SIZE_OPERATION_RESPONSE);
+    return SIZE_OPERATION_RESPONSE;
+}
+
+/**
+ * Request is decoded in place and the response is written straight into the retBuf,
+ * no request and response objects are created. The object based path is IdentitySerialization::query().
+ */
 size_t IdentityBinarySerialization::query(
     unsigned char* retBuf,
     size_t retSize,
@@ -972,124 +1254,124 @@ size_t IdentityBinarySerialization::query(
         return 0;
     if (sz < SIZE_SERVICE_MESSAGE)
         return 0;
-    ServiceMessage* pMsg = deserializeIdentity((const unsigned char*)request, sz);
-    if (!pMsg)
+    size_t requestSize = identityRequestSize((char) request[0]);
+    if (requestSize == 0 || sz < requestSize)
         return 0;   // unknown request
-    if ((pMsg->code != code) || (pMsg->accessCode != accessCode)) {
+    if (!hasServiceHeaderCredentials(request, code, accessCode)) {
 #ifdef ENABLE_DEBUG
-        std::cerr << ERR_ACCESS_DENIED
-            << ": " << pMsg->code
-            << "," << pMsg->accessCode
-            << std::endl;
+        std::cerr << ERR_ACCESS_DENIED << std::endl;
 #endif
-        auto r = new IdentityOperationResponse;
-        r->code = ERR_CODE_ACCESS_DENIED;
-        r->ntoh();
-        size_t sz = r->serialize(retBuf);
-        delete pMsg;
-        return sz;
+        return accessDeniedIdentityResponse(retBuf, retSize);
     }
+    char tag;
+    int32_t c;
+    uint64_t ac;
+    deserializeServiceHeader(tag, c, ac, request);
 
-    ServiceMessage* r = nullptr;
-    switch (request[0]) {
-    case QUERY_IDENTITY_ADDR:   // request gateway identifier(with address) by network address. Return 0 if success
-    {
-        auto gr = (IdentityEUIRequest*)pMsg;
-        r = new IdentityGetResponse(*gr);
-        ((IdentityGetResponse*)r)->response.value.devid.id.devEUI.u = gr->eui.u;
-        int errCode;
-        if (((IdentityGetResponse*)r)->response.value.devaddr.empty())
-            errCode = svc->getNetworkIdentity(((IdentityGetResponse*)r)->response,
-                ((IdentityGetResponse*)r)->response.value.devid.id.devEUI);
-        else
-            errCode = svc->get(((IdentityGetResponse*)r)->response.value.devid, ((IdentityGetResponse*)r)->response.value.devaddr);
-
-        if (errCode) {
-            // indicate nothing there
-            ((IdentityGetResponse*)r)->response.value.devid.id.devEUI.u = 0;
+    const unsigned char *body = request + SIZE_SERVICE_MESSAGE;
+    switch (tag) {
+        case QUERY_IDENTITY_ADDR:   // request device identifier(with address) by EUI. Return 0 if success
+        {
+            DEVEUI eui;
+            memmove(&eui.u, body, sizeof(eui.u));   // 8
+            eui.u = NTOH8(eui.u);
+            NETWORKIDENTITY ni((DEVICEID(eui)));
+            if (svc->getNetworkIdentity(ni, eui))
+                ni.value.devid.id.devEUI.u = 0;     // indicate nothing there
+            return serializeGetResponse(retBuf, tag, c, ac, ni);
         }
-        break;
-    }
-    case QUERY_IDENTITY_EUI:   // request gateway address (with identifier) by identifier. Return 0 if success
-    {
-        auto gr = (IdentityAddrRequest*)pMsg;
-        r = new IdentityGetResponse(*gr);
-        ((IdentityGetResponse*)r)->response.value.devaddr.u = gr->addr.u;
-        svc->get(((IdentityGetResponse*)r)->response.value.devid, ((IdentityGetResponse*)r)->response.value.devaddr);
-        break;
-    }
-    case QUERY_IDENTITY_ASSIGN:   // assign (put) gateway address to the gateway by identifier
-    {
-        auto gr = (IdentityAssignRequest*)pMsg;
-        r = new IdentityOperationResponse(*gr);
-        ((IdentityOperationResponse*)r)->response = svc->put(gr->identity.value.devaddr, gr->identity.value.devid);
-        if (((IdentityOperationResponse*)r)->response == 0)
-            ((IdentityOperationResponse*)r)->size = 1;    // count of placed entries
-        break;
-    }
-    case QUERY_IDENTITY_RM:   // Remove entry
-    {
-        auto gr = (IdentityAddrRequest*)pMsg;
-        r = new IdentityOperationResponse(*gr);
-        ((IdentityOperationResponse*)r)->response = svc->rm(gr->addr);
-        if (((IdentityOperationResponse*)r)->response == 0)
-            ((IdentityOperationResponse*)r)->size = 1;    // count of deleted entries
-        break;
-    }
-    case QUERY_IDENTITY_LIST:   // List entries
-    {
-        auto gr = (IdentityOperationRequest*)pMsg;
-        r = new IdentityListResponse(*gr);
-        ((IdentityOperationResponse*)r)->response = svc->list(((IdentityListResponse*)r)->identities, gr->offset, gr->size);
-        size_t idSize = ((IdentityListResponse*)r)->identities.size();
-        size_t serSize = SIZE_OPERATION_RESPONSE + (idSize * SIZE_NETWORK_IDENTITY);
-        if (serSize > retSize) {
-            serSize = ((IdentityListResponse*)r)->shortenList2Fit(retSize);
-            if (serSize > retSize) {
-                delete r;
-                r = nullptr;
+        case QUERY_IDENTITY_EUI:   // request device address (with identifier) by network address. Return 0 if success
+        {
+            DEVADDR addr;
+            memmove(&addr.u, body, sizeof(addr.u)); // 4
+            addr.u = NTOH4(addr.u);
+            NETWORKIDENTITY ni(addr);
+            svc->get(ni.value.devid, addr);
+            return serializeGetResponse(retBuf, tag, c, ac, ni);
+        }
+        case QUERY_IDENTITY_ASSIGN:   // assign (put) device address by identifier
+        {
+            NETWORKIDENTITY ni;
+            deserializeNETWORKIDENTITY(ni, body);
+            ni.value.devaddr.u = NTOH4(ni.value.devaddr.u);
+            ni.value.devid.id.devEUI.u = NTOH8(ni.value.devid.id.devEUI.u);
+            int r = svc->put(ni.value.devaddr, ni.value.devid);
+            // size is count of placed entries
+            return serializeOperationResponse(retBuf, tag, c, ac, 0, r == 0 ? 1 : 0, r);
+        }
+        case QUERY_IDENTITY_RM:   // Remove entry
+        {
+            DEVADDR addr;
+            memmove(&addr.u, body, sizeof(addr.u)); // 4
+            addr.u = NTOH4(addr.u);
+            int r = svc->rm(addr);
+            // size is count of deleted entries
+            return serializeOperationResponse(retBuf, tag, c, ac, 0, r == 0 ? 1 : 0, r);
+        }
+        case QUERY_IDENTITY_LIST:   // List entries
+        {
+            if (retSize < SIZE_OPERATION_RESPONSE)
+                return 0;
+            uint32_t offset;
+            memmove(&offset, body, sizeof(offset)); // 4
+            offset = NTOH4(offset);
+            uint8_t size = body[4];                 // 1
+            // keep capacity between queries
+            static thread_local std::vector<NETWORKIDENTITY> identities;
+            identities.clear();
+            int r = svc->list(identities, offset, size);
+            size_t cnt = identities.size();
+            size_t fit = (retSize - SIZE_OPERATION_RESPONSE) / SIZE_NETWORK_IDENTITY;
+            if (cnt > fit)
+                cnt = fit;
+            size_t ofs = serializeOperationResponse(retBuf, tag, c, ac, offset, size, r);
+            for (size_t i = 0; i < cnt; i++) {
+                serializeNETWORKIDENTITYNtoh(retBuf + ofs, identities[i]);
+                ofs += SIZE_NETWORK_IDENTITY;
             }
-            break;
+            return ofs;
         }
-        break;
-    }
-    case QUERY_IDENTITY_COUNT:   // count
-    {
-        auto gr = (IdentityOperationRequest*)pMsg;
-        r = new IdentityOperationResponse(*gr);
-        r->tag = gr->tag;
-        r->code = CODE_OK;
-        r->accessCode = gr->accessCode;
-        ((IdentityOperationResponse*)r)->response = (uint8_t)svc->size();
-        break;
-    }
-    case QUERY_IDENTITY_NEXT:   // next
-    {
-        auto gr = (IdentityOperationRequest*)pMsg;
-        r = new IdentityNextResponse;
-        r->tag = gr->tag;
-        r->code = CODE_OK;
-        r->accessCode = gr->accessCode;
-        NETWORKIDENTITY ni;
-        svc->next(ni);
-        ((IdentityNextResponse*)r)->response = ni;
-        break;
-    }
-    case QUERY_IDENTITY_FORCE_SAVE:   // force save
-        break;
-    case QUERY_IDENTITY_CLOSE_RESOURCES:   // close resources
-        break;
-    default:
-        break;
-    }
-    delete pMsg;
-    size_t rsize = 0;
-    if (r) {
-        r->ntoh();
-        rsize = r->serialize(retBuf);
-        delete r;
+        case QUERY_IDENTITY_FILTER:   // List filtered entries
+        {
+            if (retSize < SIZE_OPERATION_RESPONSE || sz < identityFilterRequestSize(request, sz))
+                return 0;
+            IdentityFilterRequest fr(request, sz);
+            fr.ntoh();
+            static thread_local std::vector<NETWORKIDENTITY> identities;
+            identities.clear();
+            int r = svc->filter(identities, fr.filters, fr.offset, fr.size);
+            size_t cnt = identities.size();
+            size_t fit = (retSize - SIZE_OPERATION_RESPONSE) / SIZE_NETWORK_IDENTITY;
+            if (cnt > fit)
+                cnt = fit;
+            size_t ofs = serializeOperationResponse(retBuf, tag, c, ac, fr.offset, fr.size, r);
+            for (size_t i = 0; i < cnt; i++) {
+                serializeNETWORKIDENTITYNtoh(retBuf + ofs, identities[i]);
+                ofs += SIZE_NETWORK_IDENTITY;
+            }
+            return ofs;
+        }
+        case QUERY_IDENTITY_COUNT:   // count
+        {
+            uint32_t offset;
+            memmove(&offset, body, sizeof(offset)); // 4
+            return serializeOperationResponse(retBuf, tag, CODE_OK, ac, NTOH4(offset), body[4],
+                (int32_t) svc->size());
+        }
+        case QUERY_IDENTITY_NEXT:   // next
+        {
+            NETWORKIDENTITY ni;
+            svc->next(ni);
+            return serializeGetResponse(retBuf, tag, CODE_OK, ac, ni);
+        }
+        case QUERY_IDENTITY_FORCE_SAVE:   // force save
+            break;
+        case QUERY_IDENTITY_CLOSE_RESOURCES:   // close resources
+            break;
+        default:
+            break;
     }
-    return rsize;
+    return 0;
 }
 
 IdentityQueryTag isIdentityTag(const char *tag) {
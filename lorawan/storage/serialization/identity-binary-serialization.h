@@ -34,6 +34,11 @@ enum IdentityQueryTag {
 #define SIZE_NETWORK_IDENTITY 141
 #define SIZE_ASSIGN_REQUEST 154
 #define SIZE_GET_RESPONSE 154
+// 18 + 1 filters count
+#define SIZE_FILTER_REQUEST 19
+#define SIZE_NETWORK_IDENTITY_FILTER 20
+// filter request with a batch item header fits MAX_BATCH_FRAME_SIZE
+#define MAX_IDENTITY_FILTERS 64
 
 class IdentityEUIRequest : public ServiceMessage {
 public:
@@ -85,6 +90,34 @@ public:
     std::string toJsonString() const override;
 };
 
+/**
+ * List entries matched by filters. Reply is the list reply with the 'f' tag.
+ *  18  filters count, 1 byte
+ *  19  filters, SIZE_NETWORK_IDENTITY_FILTER bytes each:
+ *      0   logical operator to the previous filter
+ *      1   property
+ *      2   comparison operator
+ *      3   value length
+ *      4   value, 16 bytes, addresses, EUIs and nonce in network byte order
+ */
+class IdentityFilterRequest : public IdentityOperationRequest {
+public:
+    std::vector<NETWORK_IDENTITY_FILTER> filters;
+    IdentityFilterRequest();
+    IdentityFilterRequest(
+        uint32_t aOffset,
+        uint8_t aSize,
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        int32_t code,
+        uint64_t accessCode
+    );
+    IdentityFilterRequest(const unsigned char *buf, size_t sz);
+    ~IdentityFilterRequest() override = default;
+    void ntoh() override;
+    size_t serialize(unsigned char *retBuf) const override;
+    std::string toJsonString() const override;
+};
+
 class IdentityGetResponse : public ServiceMessage {
 public:
     NETWORKIDENTITY response;
@@ -195,6 +228,63 @@ size_t responseSizeForIdentityRequest(
     size_t size
 );
 
+/**
+ * Minimal size of the request, the same sizes are checked by deserializeIdentity()
+ * @param tag request tag
+ * @return minimal request size, 0- unknown request
+ */
+size_t identityRequestSize(
+    char tag
+);
+
+/**
+ * Size of the filter request read from the filters count
+ * @param buf serialized filter request
+ * @param sz bytes received
+ * @return request size, 0- filters count is not received yet
+ */
+size_t identityFilterRequestSize(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * Check tag, size and credentials from the 13 bytes header, request is not decoded
+ * @param request serialized request
+ * @param sz request size
+ * @param code expected code
+ * @param accessCode expected access code
+ * @return true if it is identity request with the other code or access code
+ */
+bool isIdentityAccessDenied(
+    const unsigned char *request,
+    size_t sz,
+    int32_t code,
+    uint64_t accessCode
+);
+
+/**
+ * Copy preformatted ERR_CODE_ACCESS_DENIED response
+ * @param retBuf buffer to return response
+ * @param retSize buffer size
+ * @return SIZE_OPERATION_RESPONSE, 0- buffer is too small
+ */
+size_t accessDeniedIdentityResponse(
+    unsigned char *retBuf,
+    size_t retSize
+);
+
+/**
+ * Decode SIZE_NETWORK_IDENTITY bytes of the identity record and convert it to the host byte order.
+ * Nothing is allocated, use it to walk over the list response records in place.
+ * @param retVal decoded identity
+ * @param buf serialized identity record
+ */
+void deserializeNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const unsigned char *buf
+);
+
 const char* identityTag2string(
     enum IdentityQueryTag value
 );
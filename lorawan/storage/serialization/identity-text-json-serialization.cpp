@@ -1,9 +1,8 @@
-#include <sstream>
-
 #include "nlohmann/json.hpp"
 
 #include "lorawan/storage/serialization/identity-text-json-serialization.h"
 #include "lorawan/storage/serialization/json-helper.h"
+#include "lorawan/helper/json-writer.h"
 #include "lorawan/lorawan-conv.h"
 
 #include "lorawan/lorawan-error.h"
@@ -87,7 +86,9 @@ size_t IdentityTextJSONSerialization::query(
                 NETWORKIDENTITY nid;
                 int r = svc->getNetworkIdentity(nid, devEUI);
                 if (r == CODE_OK) {
-                    return retStr(retBuf, retSize, nid.toJsonString());
+                    JsonWriter writer(jsonResponseBuffer());
+                    nid.toJson(writer);
+                    return retStr(retBuf, retSize, writer.buffer);
                 } else {
                     return retStatusCode(retBuf, retSize, r);
                 }
@@ -97,9 +98,11 @@ size_t IdentityTextJSONSerialization::query(
                 string2DEVADDR(a, addr);
                 DEVICEID did;
                 int r = svc->get(did, a);
-                if (r == CODE_OK)
-                    return retStr(retBuf, retSize, did.toJsonString());
-                else
+                if (r == CODE_OK) {
+                    JsonWriter writer(jsonResponseBuffer());
+                    did.toJson(writer, DEVADDR());
+                    return retStr(retBuf, retSize, writer.buffer);
+                } else
                     return retStatusCode(retBuf, retSize, r);
             }
         }
@@ -118,9 +121,11 @@ size_t IdentityTextJSONSerialization::query(
             string2DEVADDR(a, addr);
             DEVICEID did;
             int r = svc->get(did, a);
-            if (r == CODE_OK)
-                return retStr(retBuf, retSize, did.toJsonString());
-            else
+            if (r == CODE_OK) {
+                JsonWriter writer(jsonResponseBuffer());
+                did.toJson(writer, DEVADDR());
+                return retStr(retBuf, retSize, writer.buffer);
+            } else
                 return retStatusCode(retBuf, retSize, r);
         }
             break;
@@ -140,28 +145,32 @@ size_t IdentityTextJSONSerialization::query(
                     size = jSize;
                 }
             }
-            std::vector<NETWORKIDENTITY> nis;
+            // list buffer of the thread keeps capacity between the requests
+            static thread_local std::vector<NETWORKIDENTITY> nis;
+            nis.clear();
             int r = svc->list(nis, offset, size);
             if (r == CODE_OK) {
-                std::stringstream ss;
+                JsonWriter writer(jsonResponseBuffer());
                 bool isFirst = true;
-                ss << "[";
+                writer.raw('[');
                 for (auto &ni: nis) {
                     if (isFirst)
                         isFirst = false;
                     else
-                        ss << ", ";
-                    ss << ni.toJsonString();
+                        writer.raw(", ", 2);
+                    ni.toJson(writer);
                 }
-                ss << "]";
-                return retStr(retBuf, retSize, ss.str());
+                writer.raw(']');
+                return retStr(retBuf, retSize, writer.buffer);
             } else
                 return retStatusCode(retBuf, retSize, r);
         }
         case 'c': {
             // count
             auto r = svc->size();
-            return retStr(retBuf, retSize, std::to_string(r));
+            JsonWriter writer(jsonResponseBuffer());
+            writer.dec((uint64_t) r);
+            return retStr(retBuf, retSize, writer.buffer);
         }
         case 'n':
             // next
@@ -170,8 +179,9 @@ size_t IdentityTextJSONSerialization::query(
             auto r = svc->next(ni);
             if (r)
                 return retStatusCode(retBuf, retSize, r);
-            else
-                return retStr(retBuf, retSize, ni.toJsonString());
+            JsonWriter writer(jsonResponseBuffer());
+            ni.toJson(writer);
+            return retStr(retBuf, retSize, writer.buffer);
         }
         case 'p':
             // assign
@@ -0,0 +1,214 @@
+#include "lorawan/storage/serialization/journal-serialization.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+JournalRequest::JournalRequest()
+    : ServiceMessage(QUERY_IDENTITY_JOURNAL, 0, 0), seq(0), maxCount(0)
+{
+
+}
+
+JournalRequest::JournalRequest(
+    uint64_t aSeq,
+    uint8_t aMaxCount,
+    int32_t code,
+    uint64_t accessCode
+)
+    : ServiceMessage(QUERY_IDENTITY_JOURNAL, code, accessCode), seq(aSeq), maxCount(aMaxCount)
+{
+
+}
+
+JournalRequest::JournalRequest(
+    const unsigned char *buf,
+    size_t sz
+)
+    : ServiceMessage(buf, sz), seq(0), maxCount(0)   // 13
+{
+    if (sz >= SIZE_JOURNAL_REQUEST) {
+        memmove(&seq, &buf[13], sizeof(seq));   // 8
+        maxCount = buf[21];                     // 1
+    }   // 22
+}
+
+void JournalRequest::ntoh()
+{
+    ServiceMessage::ntoh();
+    seq = NTOH8(seq);
+}
+
+size_t JournalRequest::serialize(
+    unsigned char *retBuf
+) const
+{
+    ServiceMessage::serialize(retBuf);              // 13
+    if (retBuf) {
+        memmove(&retBuf[13], &seq, sizeof(seq));    // 8
+        retBuf[21] = maxCount;                      // 1
+    }
+    return SIZE_JOURNAL_REQUEST;                    // 22
+}
+
+std::string JournalRequest::toJsonString() const
+{
+    std::stringstream ss;
+    ss << R"({"seq": )" << seq << R"(, "max": )" << (int) maxCount << "}";
+    return ss.str();
+}
+
+/**
+ * @return serialized record size
+ */
+static size_t recordSize(
+    char op
+)
+{
+    return SIZE_JOURNAL_RECORD_HEADER + (op == QUERY_IDENTITY_RM ? SIZE_DEVICE_ADDR_REQUEST : SIZE_ASSIGN_REQUEST);
+}
+
+JournalResponse::JournalResponse()
+    : ServiceMessage(QUERY_IDENTITY_JOURNAL, 0, 0), lastSeq(0)
+{
+
+}
+
+JournalResponse::JournalResponse(
+    const unsigned char *buf,
+    size_t sz
+)
+    : ServiceMessage(buf, sz), lastSeq(0)   // 13
+{
+    if (sz < SIZE_JOURNAL_RESPONSE)
+        return;
+    memmove(&lastSeq, &buf[13], sizeof(lastSeq));  // 8
+    uint8_t count = buf[21];                        // 1
+    size_t ofs = SIZE_JOURNAL_RESPONSE;
+    for (uint8_t i = 0; i < count; i++) {
+        if (ofs + SIZE_JOURNAL_RECORD_HEADER + SIZE_SERVICE_MESSAGE > sz)
+            break;
+        ChangeRecord r;
+        memmove(&r.seq, &buf[ofs], sizeof(r.seq));
+        const unsigned char *m = &buf[ofs + SIZE_JOURNAL_RECORD_HEADER];
+        r.op = (char) m[0];
+        size_t rsz = recordSize(r.op);
+        if (ofs + rsz > sz)
+            break;
+        if (r.op == QUERY_IDENTITY_RM) {
+            IdentityAddrRequest req(m, SIZE_DEVICE_ADDR_REQUEST);
+            r.identity.value.devaddr = req.addr;
+        } else {
+            IdentityAssignRequest req(m, SIZE_ASSIGN_REQUEST);
+            r.identity.set(req.identity);
+        }
+        records.push_back(r);
+        ofs += rsz;
+    }
+}
+
+void JournalResponse::ntoh()
+{
+    ServiceMessage::ntoh();
+    lastSeq = NTOH8(lastSeq);
+    for (auto &r : records) {
+        r.seq = NTOH8(r.seq);
+        r.identity.value.devaddr.u = NTOH4(r.identity.value.devaddr.u);
+        r.identity.value.devid.id.devEUI.u = NTOH8(r.identity.value.devid.id.devEUI.u);
+    }
+}
+
+size_t JournalResponse::serialize(
+    unsigned char *retBuf
+) const
+{
+    size_t ofs = ServiceMessage::serialize(retBuf);    // 13
+    if (retBuf) {
+        memmove(&retBuf[13], &lastSeq, sizeof(lastSeq));  // 8
+        retBuf[21] = (uint8_t) records.size();          // 1
+    }
+    ofs = SIZE_JOURNAL_RESPONSE;
+    for (auto &r : records) {
+        if (retBuf) {
+            memmove(&retBuf[ofs], &r.seq, sizeof(r.seq));
+            unsigned char *m = &retBuf[ofs + SIZE_JOURNAL_RECORD_HEADER];
+            if (r.op == QUERY_IDENTITY_RM)
+                IdentityAddrRequest(QUERY_IDENTITY_RM, r.identity.value.devaddr, 0, 0).serialize(m);
+            else
+                IdentityAssignRequest(QUERY_IDENTITY_ASSIGN, r.identity, 0, 0).serialize(m);
+        }
+        ofs += recordSize(r.op);
+    }
+    return ofs;
+}
+
+std::string JournalResponse::toJsonString() const
+{
+    std::stringstream ss;
+    ss << R"({"lastSeq": )" << lastSeq << R"(, "count": )" << records.size() << "}";
+    return ss.str();
+}
+
+bool isJournalRequest(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    return sz >= SIZE_JOURNAL_REQUEST && buf[0] == QUERY_IDENTITY_JOURNAL;
+}
+
+size_t journalResponseSize(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    if (sz < SIZE_JOURNAL_RESPONSE || buf[0] != QUERY_IDENTITY_JOURNAL)
+        return 0;
+    uint8_t count = buf[21];
+    size_t ofs = SIZE_JOURNAL_RESPONSE;
+    for (uint8_t i = 0; i < count; i++) {
+        if (ofs + SIZE_JOURNAL_RECORD_HEADER + 1 > sz)
+            return 0;
+        ofs += recordSize((char) buf[ofs + SIZE_JOURNAL_RECORD_HEADER]);
+    }
+    return ofs <= sz ? ofs : 0;
+}
+
+size_t queryJournal(
+    IdentitySerialization *identitySerialization,
+    const ChangeLog *log,
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (!identitySerialization || !log || !isJournalRequest(request, sz) || retSize < SIZE_JOURNAL_RESPONSE)
+        return 0;
+    JournalRequest req(request, sz);
+    req.ntoh();
+    JournalResponse resp;
+    resp.accessCode = req.accessCode;
+    resp.lastSeq = log->last();
+    if (req.code != identitySerialization->code || req.accessCode != identitySerialization->accessCode) {
+        resp.code = ERR_CODE_ACCESS_DENIED;
+    } else {
+        // records fit the reply buffer
+        size_t maxCount = (retSize - SIZE_JOURNAL_RESPONSE) / recordSize(QUERY_IDENTITY_ASSIGN);
+        if (req.maxCount && req.maxCount < maxCount)
+            maxCount = req.maxCount;
+        if (maxCount > 255)
+            maxCount = 255;
+        resp.code = log->since(resp.records, req.seq, maxCount);
+        if (resp.code != CODE_OK)
+            resp.records.clear();
+        else if (!resp.records.empty())
+            resp.lastSeq = std::max(resp.lastSeq, resp.records.back().seq);
+    }
+    resp.ntoh();
+    return resp.serialize(retBuf);
+}
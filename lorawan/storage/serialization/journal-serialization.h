@@ -0,0 +1,103 @@
+#ifndef JOURNAL_SERIALIZATION_H_
+#define JOURNAL_SERIALIZATION_H_	1
+
+#include <vector>
+#include <cinttypes>
+
+#include "lorawan/storage/serialization/service-serialization.h"
+#include "lorawan/storage/serialization/identity-serialization.h"
+#include "lorawan/storage/service/change-log.h"
+
+/**
+ * Replication: replica pulls committed changes from the primary change log.
+ *
+ * Request:
+ *  0   tag 'j'
+ *  1   code, 4 bytes
+ *  5   access code, 8 bytes
+ *  13  last sequence number the replica has, 8 bytes
+ *  21  max records, 1 byte, 0- as many as fit the reply
+ *
+ * Reply:
+ *  0   tag 'j'
+ *  1   code, 4 bytes: CODE_OK, ERR_CODE_REPLICA_SNAPSHOT- replica must load the snapshot, ERR_CODE_ACCESS_DENIED
+ *  5   access code, 8 bytes
+ *  13  primary last sequence number, 8 bytes
+ *  21  count of records, 1 byte
+ *  22  records:
+ *      0   sequence number, 8 bytes
+ *      8   version 1 request: assign 'p' (154 bytes) or remove 'r' (17 bytes)
+ * Numbers are in network byte order.
+ */
+#define QUERY_IDENTITY_JOURNAL      'j'
+#define SIZE_JOURNAL_REQUEST        22
+#define SIZE_JOURNAL_RESPONSE       22
+#define SIZE_JOURNAL_RECORD_HEADER  8
+
+class JournalRequest : public ServiceMessage {
+public:
+    uint64_t seq;
+    uint8_t maxCount;
+    JournalRequest();
+    JournalRequest(
+        uint64_t seq,
+        uint8_t maxCount,
+        int32_t code,
+        uint64_t accessCode
+    );
+    JournalRequest(const unsigned char *buf, size_t sz);
+    ~JournalRequest() override = default;
+    void ntoh() override;
+    size_t serialize(unsigned char *retBuf) const override;
+    std::string toJsonString() const override;
+};
+
+class JournalResponse : public ServiceMessage {
+public:
+    uint64_t lastSeq;
+    std::vector<ChangeRecord> records;
+    JournalResponse();
+    JournalResponse(const unsigned char *buf, size_t sz);
+    ~JournalResponse() override = default;
+    void ntoh() override;
+    size_t serialize(unsigned char *retBuf) const override;
+    std::string toJsonString() const override;
+};
+
+/**
+ * @return true if buffer contains journal request
+ */
+bool isJournalRequest(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * @return size of the journal reply in the buffer, 0- reply is incomplete or it is not a journal reply
+ */
+size_t journalResponseSize(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * Return change log records after the replica sequence number.
+ * Access code is checked against identity serialization.
+ * @param identitySerialization identity serialization
+ * @param log primary change log
+ * @param retBuf buffer to return serialized response
+ * @param retSize buffer size
+ * @param request serialized request
+ * @param sz serialized request size
+ * @return response size, 0- not a journal request or buffer is too small
+ */
+size_t queryJournal(
+    IdentitySerialization *identitySerialization,
+    const ChangeLog *log,
+    unsigned char *retBuf,
+    size_t retSize,
+    const unsigned char *request,
+    size_t sz
+);
+
+#endif
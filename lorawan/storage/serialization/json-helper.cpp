@@ -1,4 +1,5 @@
 #include "lorawan/storage/serialization/json-helper.h"
+#include "lorawan/helper/json-writer.h"
 
 size_t retJs(
     unsigned char* retBuf,
@@ -29,15 +30,22 @@ size_t retJs(
     return r;
 }
 
+std::string &jsonResponseBuffer()
+{
+    static thread_local std::string r;
+    r.clear();
+    return r;
+}
+
 size_t retStatusCode(
     unsigned char* retBuf,
     size_t retSize,
     int errCode
 )
 {
-    nlohmann::json js;
-    js["code"] = errCode;
-    return retJs(retBuf, retSize, js);
+    JsonWriter writer(jsonResponseBuffer());
+    writer.raw(R"({"code":)").dec((int64_t) errCode).raw('}');
+    return retStr(retBuf, retSize, writer.buffer);
 }
 
 bool checkCredentials(
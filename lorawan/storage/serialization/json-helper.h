@@ -15,6 +15,11 @@ size_t retStr(
     const std::string &s
 );
 
+/**
+ * Response buffer of the calling thread, cleared. Capacity is kept between the requests.
+ */
+std::string &jsonResponseBuffer();
+
 size_t retStatusCode(
     unsigned char* retBuf,
     size_t retSize,
@@ -0,0 +1,359 @@
+#include "lorawan/storage/serialization/list-stream.h"
+
+#include <cstring>
+#include <sstream>
+
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-string.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/gateway-binary-serialization.h"
+
+// list request size is uint8_t
+#define MAX_CHUNK_ENTRIES   255
+// gateway identifier 8 bytes + IPv6 address 19 bytes
+#define MAX_GATEWAY_ENTRY_SIZE  27
+
+ListStreamRequest::ListStreamRequest()
+    : ServiceMessage(QUERY_IDENTITY_LIST_STREAM, 0, 0), offset(0), limit(0)
+{
+
+}
+
+ListStreamRequest::ListStreamRequest(
+    char tag,
+    uint32_t aOffset,
+    uint32_t aLimit,
+    const std::string &aFilter,
+    int32_t code,
+    uint64_t accessCode
+)
+    : ServiceMessage(tag, code, accessCode), offset(aOffset), limit(aLimit),
+    filter(aFilter.size() > 255 ? aFilter.substr(0, 255) : aFilter)
+{
+
+}
+
+ListStreamRequest::ListStreamRequest(
+    const unsigned char *buf,
+    size_t sz
+)
+    : ServiceMessage(buf, sz), offset(0), limit(0)   // 13
+{
+    if (sz >= SIZE_LIST_STREAM_REQUEST) {
+        memmove(&offset, &buf[13], sizeof(offset));     // 4
+        memmove(&limit, &buf[17], sizeof(limit));       // 4
+        uint8_t filterSize = buf[21];                   // 1
+        if (SIZE_LIST_STREAM_REQUEST + (size_t) filterSize <= sz)
+            filter = std::string((const char *) &buf[22], filterSize);
+    }   // 22
+}
+
+void ListStreamRequest::ntoh()
+{
+    ServiceMessage::ntoh();
+    offset = NTOH4(offset);
+    limit = NTOH4(limit);
+}
+
+size_t ListStreamRequest::serialize(
+    unsigned char *retBuf
+) const
+{
+    ServiceMessage::serialize(retBuf);                  // 13
+    if (retBuf) {
+        memmove(&retBuf[13], &offset, sizeof(offset));  // 4
+        memmove(&retBuf[17], &limit, sizeof(limit));    // 4
+        retBuf[21] = (uint8_t) filter.size();           // 1
+        memmove(&retBuf[22], filter.c_str(), filter.size());
+    }
+    return SIZE_LIST_STREAM_REQUEST + filter.size();    // 22 + filter
+}
+
+std::string ListStreamRequest::toJsonString() const
+{
+    std::stringstream ss;
+    ss << R"({"offset": )" << offset
+        << R"(, "limit": )" << limit
+        << R"(, "filter": ")" << filter << "\"}";
+    return ss.str();
+}
+
+ListStream::ListStream(
+    const ListStreamRequest &aRequest
+)
+    : request(aRequest), offset(aRequest.offset), remaining(aRequest.limit ? aRequest.limit : UINT32_MAX),
+    exhausted(false), finished(false), errorCode(CODE_OK)
+{
+
+}
+
+ListStream::~ListStream() = default;
+
+size_t ListStream::next(
+    unsigned char *retBuf,
+    size_t retSize
+)
+{
+    if (finished || retSize < SIZE_LIST_STREAM_CHUNK_HEADER + SIZE_OPERATION_RESPONSE)
+        return 0;
+    size_t sz = fetch(retBuf + SIZE_LIST_STREAM_CHUNK_HEADER, retSize - SIZE_LIST_STREAM_CHUNK_HEADER);
+    if (sz == 0)
+        return 0;
+    retBuf[0] = request.tag;
+    uint32_t len = HTON4((uint32_t) sz);
+    memmove(&retBuf[1], &len, sizeof(len));
+    return SIZE_LIST_STREAM_CHUNK_HEADER + sz;
+}
+
+bool ListStream::isFinished() const
+{
+    return finished;
+}
+
+/**
+ * @return entries to request from the backend
+ */
+static size_t chunkEntries(
+    size_t retSize,
+    size_t entrySize,
+    uint32_t remaining
+)
+{
+    size_t r = (retSize - SIZE_OPERATION_RESPONSE) / entrySize;
+    if (r > MAX_CHUNK_ENTRIES)
+        r = MAX_CHUNK_ENTRIES;
+    if (r > remaining)
+        r = remaining;
+    return r;
+}
+
+IdentityListStream::IdentityListStream(
+    IdentityService *aSvc,
+    const ListStreamRequest &aRequest,
+    int32_t aErrorCode
+)
+    : ListStream(aRequest), svc(aSvc), started(false)
+{
+    errorCode = aErrorCode;
+    if (errorCode == CODE_OK && !request.filter.empty()) {
+        if (string2NETWORK_IDENTITY_FILTERS(filters, request.filter.c_str(), request.filter.size()) < 0 || filters.empty())
+            errorCode = ERR_CODE_PARAM_INVALID;
+    }
+}
+
+/**
+ * Next entries after the last key, request offset is skipped first
+ */
+int IdentityListStream::listNext(
+    std::vector<NETWORKIDENTITY> &retVal,
+    uint8_t size
+)
+{
+    if (!started) {
+        // skip offset entries once
+        uint32_t skip = offset;
+        while (skip) {
+            std::vector<NETWORKIDENTITY> skipped;
+            auto n = (uint8_t) (skip < MAX_CHUNK_ENTRIES ? skip : MAX_CHUNK_ENTRIES);
+            int r = svc->listAfter(skipped, started ? &last : nullptr, n);
+            if (r < 0)
+                return r;
+            if (skipped.empty())
+                return CODE_OK; // less entries than offset
+            last.u = skipped.back().value.devaddr.u;
+            started = true;
+            skip -= (uint32_t) skipped.size();
+        }
+    }
+    int r = svc->listAfter(retVal, started ? &last : nullptr, size);
+    if (r == CODE_OK && !retVal.empty()) {
+        last.u = retVal.back().value.devaddr.u;
+        started = true;
+    }
+    return r;
+}
+
+size_t IdentityListStream::fetch(
+    unsigned char *retBuf,
+    size_t retSize
+)
+{
+    IdentityListResponse resp;
+    resp.tag = QUERY_IDENTITY_LIST;
+    resp.code = CODE_OK;
+    resp.accessCode = request.accessCode;
+    resp.offset = offset;
+    resp.size = 0;
+    resp.response = 0;
+    if (errorCode != CODE_OK) {
+        resp.code = errorCode;
+        resp.response = errorCode;
+        finished = true;
+    } else if (exhausted || remaining == 0) {
+        finished = true;
+    } else {
+        size_t cnt = chunkEntries(retSize, SIZE_NETWORK_IDENTITY, remaining);
+        if (cnt == 0)
+            return 0;
+        int r = filters.empty() ? listNext(resp.identities, (uint8_t) cnt)
+            : svc->filter(resp.identities, filters, offset, (uint8_t) cnt);
+        if (r < 0) {
+            resp.identities.clear();
+            resp.code = r;
+            resp.response = r;
+            finished = true;
+        } else {
+            if (resp.identities.size() > cnt)
+                resp.identities.resize(cnt);
+            auto n = (uint32_t) resp.identities.size();
+            if (n < cnt)
+                exhausted = true;
+            if (n == 0)
+                finished = true;
+            offset += n;
+            remaining -= n;
+            resp.size = (uint8_t) n;
+            resp.response = (int32_t) n;
+        }
+    }
+    resp.ntoh();
+    return resp.serialize(retBuf);
+}
+
+GatewayListStream::GatewayListStream(
+    GatewayService *aSvc,
+    const ListStreamRequest &aRequest,
+    int32_t aErrorCode
+)
+    : ListStream(aRequest), svc(aSvc), started(false), last(0)
+{
+    errorCode = aErrorCode;
+}
+
+/**
+ * Next entries after the last key, request offset is skipped first
+ */
+int GatewayListStream::listNext(
+    std::vector<GatewayIdentity> &retVal,
+    uint8_t size
+)
+{
+    if (!started) {
+        // skip offset entries once
+        uint32_t skip = offset;
+        while (skip) {
+            std::vector<GatewayIdentity> skipped;
+            auto n = (uint8_t) (skip < MAX_CHUNK_ENTRIES ? skip : MAX_CHUNK_ENTRIES);
+            int r = svc->listAfter(skipped, started ? &last : nullptr, n);
+            if (r < 0)
+                return r;
+            if (skipped.empty())
+                return CODE_OK; // less entries than offset
+            last = skipped.back().gatewayId;
+            started = true;
+            skip -= (uint32_t) skipped.size();
+        }
+    }
+    int r = svc->listAfter(retVal, started ? &last : nullptr, size);
+    if (r == CODE_OK && !retVal.empty()) {
+        last = retVal.back().gatewayId;
+        started = true;
+    }
+    return r;
+}
+
+size_t GatewayListStream::fetch(
+    unsigned char *retBuf,
+    size_t retSize
+)
+{
+    GatewayListResponse resp;
+    resp.tag = QUERY_GATEWAY_LIST;
+    resp.code = CODE_OK;
+    resp.accessCode = request.accessCode;
+    resp.offset = offset;
+    resp.size = 0;
+    resp.response = 0;
+    if (errorCode != CODE_OK) {
+        resp.code = errorCode;
+        resp.response = (uint32_t) errorCode;
+        finished = true;
+    } else if (exhausted || remaining == 0) {
+        finished = true;
+    } else {
+        size_t cnt = chunkEntries(retSize, MAX_GATEWAY_ENTRY_SIZE, remaining);
+        if (cnt == 0)
+            return 0;
+        int r = listNext(resp.identities, (uint8_t) cnt);
+        if (r < 0) {
+            resp.identities.clear();
+            resp.code = r;
+            resp.response = (uint32_t) r;
+            finished = true;
+        } else {
+            if (resp.identities.size() > cnt)
+                resp.identities.resize(cnt);
+            auto n = (uint32_t) resp.identities.size();
+            if (n < cnt)
+                exhausted = true;
+            if (n == 0)
+                finished = true;
+            offset += n;
+            remaining -= n;
+            resp.size = (uint8_t) n;
+            resp.response = n;
+        }
+    }
+    resp.ntoh();
+    return resp.serialize(retBuf);
+}
+
+bool isListStreamRequest(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    return buf && sz >= SIZE_LIST_STREAM_REQUEST
+        && (buf[0] == QUERY_IDENTITY_LIST_STREAM || buf[0] == QUERY_GATEWAY_LIST_STREAM);
+}
+
+bool isListStreamChunk(
+    const unsigned char *buf,
+    size_t sz
+)
+{
+    return buf && sz >= SIZE_LIST_STREAM_CHUNK_HEADER
+        && (buf[0] == QUERY_IDENTITY_LIST_STREAM || buf[0] == QUERY_GATEWAY_LIST_STREAM);
+}
+
+size_t listStreamChunkSize(
+    const unsigned char *buf
+)
+{
+    uint32_t len;
+    memmove(&len, &buf[1], sizeof(len));
+    return NTOH4(len);
+}
+
+ListStream* createListStream(
+    IdentitySerialization *identitySerialization,
+    GatewaySerialization *gatewaySerialization,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    if (!isListStreamRequest(request, sz))
+        return nullptr;
+    ListStreamRequest req(request, sz);
+    req.ntoh();
+    if (req.tag == QUERY_IDENTITY_LIST_STREAM) {
+        if (!identitySerialization || !identitySerialization->svc)
+            return nullptr;
+        bool allowed = req.code == identitySerialization->code && req.accessCode == identitySerialization->accessCode;
+        return new IdentityListStream(identitySerialization->svc, req, allowed ? CODE_OK : ERR_CODE_ACCESS_DENIED);
+    }
+    if (!gatewaySerialization || !gatewaySerialization->svc)
+        return nullptr;
+    bool allowed = req.code == gatewaySerialization->code && req.accessCode == gatewaySerialization->accessCode;
+    return new GatewayListStream(gatewaySerialization->svc, req, allowed ? CODE_OK : ERR_CODE_ACCESS_DENIED);
+}
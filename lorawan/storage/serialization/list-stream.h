@@ -0,0 +1,185 @@
+#ifndef LIST_STREAM_H_
+#define LIST_STREAM_H_	1
+
+#include <string>
+#include <vector>
+#include <cinttypes>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-serialization.h"
+#include "lorawan/storage/serialization/gateway-serialization.h"
+
+/**
+ * Streaming list over TCP.
+ * List request ('l', 'L') returns entries that fit one reply (up to 9 identities in 1432 bytes).
+ * Streaming request returns a sequence of chunks until the cursor is exhausted.
+ *
+ * Request:
+ *  0   tag 't' (identities) or 'T' (gateways)
+ *  1   code, 4 bytes
+ *  5   access code, 8 bytes
+ *  13  offset, 4 bytes
+ *  17  limit, 4 bytes, 0- all entries
+ *  21  filter expression size, 1 byte (identities only, 0- no filter)
+ *  22  filter expression e.g. "addr > '34000000'"
+ *
+ * Each chunk:
+ *  0   tag 't' or 'T'
+ *  1   list reply size, 4 bytes, network byte order
+ *  5   list reply ('l', 'L'), the same as reply to the list request
+ * Last chunk contains empty list. On error the last chunk has error code in the reply code field.
+ * Stream without filter pages by key (listAfter), entries added or removed between chunks
+ * do not shift the next chunk, offset is skipped once in the key order.
+ * Filtered stream pages by offset.
+ */
+#define QUERY_IDENTITY_LIST_STREAM      't'
+#define QUERY_GATEWAY_LIST_STREAM       'T'
+#define SIZE_LIST_STREAM_REQUEST        22
+#define SIZE_LIST_STREAM_CHUNK_HEADER   5
+
+class ListStreamRequest : public ServiceMessage {
+public:
+    uint32_t offset;
+    uint32_t limit;
+    std::string filter;
+    ListStreamRequest();
+    ListStreamRequest(
+        char tag,
+        uint32_t offset,
+        uint32_t limit,
+        const std::string &filter,
+        int32_t code,
+        uint64_t accessCode
+    );
+    ListStreamRequest(const unsigned char *buf, size_t sz);
+    ~ListStreamRequest() override = default;
+    void ntoh() override;
+    size_t serialize(unsigned char *retBuf) const override;
+    std::string toJsonString() const override;
+};
+
+/**
+ * Cursor produces chunks one by one. Listener writes next chunk when previous one is sent.
+ */
+class ListStream {
+protected:
+    ListStreamRequest request;
+    uint32_t offset;
+    uint32_t remaining;
+    bool exhausted; ///< backend has no more entries, next chunk is the last one
+    bool finished;  ///< last chunk is produced
+    int32_t errorCode;
+    /**
+     * Serialize list reply with next entries
+     * @param retBuf reply buffer
+     * @param retSize reply buffer size
+     * @return reply size
+     */
+    virtual size_t fetch(
+        unsigned char *retBuf,
+        size_t retSize
+    ) = 0;
+public:
+    explicit ListStream(
+        const ListStreamRequest &request
+    );
+    virtual ~ListStream();
+    /**
+     * Serialize next chunk
+     * @param retBuf chunk buffer
+     * @param retSize chunk buffer size
+     * @return chunk size, 0- stream is finished or buffer is too small
+     */
+    size_t next(
+        unsigned char *retBuf,
+        size_t retSize
+    );
+    bool isFinished() const;
+};
+
+class IdentityListStream : public ListStream {
+private:
+    IdentityService *svc;
+    std::vector<NETWORK_IDENTITY_FILTER> filters;
+    bool started;   ///< last is set
+    DEVADDR last;   ///< key of the last streamed or skipped entry
+    int listNext(
+        std::vector<NETWORKIDENTITY> &retVal,
+        uint8_t size
+    );
+protected:
+    size_t fetch(
+        unsigned char *retBuf,
+        size_t retSize
+    ) override;
+public:
+    IdentityListStream(
+        IdentityService *svc,
+        const ListStreamRequest &request,
+        int32_t errorCode = CODE_OK
+    );
+};
+
+class GatewayListStream : public ListStream {
+private:
+    GatewayService *svc;
+    bool started;   ///< last is set
+    uint64_t last;  ///< key of the last streamed or skipped entry
+    int listNext(
+        std::vector<GatewayIdentity> &retVal,
+        uint8_t size
+    );
+protected:
+    size_t fetch(
+        unsigned char *retBuf,
+        size_t retSize
+    ) override;
+public:
+    GatewayListStream(
+        GatewayService *svc,
+        const ListStreamRequest &request,
+        int32_t errorCode = CODE_OK
+    );
+};
+
+/**
+ * @return true if buffer contains streaming list request
+ */
+bool isListStreamRequest(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * @return true if buffer starts with streaming list chunk header
+ */
+bool isListStreamChunk(
+    const unsigned char *buf,
+    size_t sz
+);
+
+/**
+ * @return list reply size in the chunk header
+ */
+size_t listStreamChunkSize(
+    const unsigned char *buf
+);
+
+/**
+ * Create cursor for the streaming list request.
+ * Access code is checked against identity or gateway serialization,
+ * stream with wrong access code returns one chunk with ERR_CODE_ACCESS_DENIED.
+ * @param identitySerialization identity serialization, can be NULL
+ * @param gatewaySerialization gateway serialization, can be NULL
+ * @param request request
+ * @param sz request size
+ * @return NULL if it is not a streaming request or service is not available, delete it after use
+ */
+ListStream* createListStream(
+    IdentitySerialization *identitySerialization,
+    GatewaySerialization *gatewaySerialization,
+    const unsigned char *request,
+    size_t sz
+);
+
+#endif
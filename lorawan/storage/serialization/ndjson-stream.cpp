@@ -0,0 +1,174 @@
+#include "lorawan/storage/serialization/ndjson-stream.h"
+#include "lorawan/helper/json-writer.h"
+
+#include <cstring>
+#include <algorithm>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+// 15 bits window, +16: gzip header and trailer instead of zlib
+#define GZIP_WINDOW_BITS    (15 + 16)
+#define GZIP_MEM_LEVEL      8
+#endif
+
+#include "lorawan/lorawan-error.h"
+
+NDJSONStream::NDJSONStream(
+    bool gzip,
+    uint8_t aChunkSize
+)
+    : pendingPos(0), exhausted(false), finished(false), zStream(nullptr),
+    started(false), chunkSize(aChunkSize ? aChunkSize : DEF_NDJSON_CHUNK_SIZE)
+{
+#ifdef ENABLE_ZLIB
+    if (gzip) {
+        auto z = new z_stream;
+        memset(z, 0, sizeof(z_stream));
+        if (deflateInit2(z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK)
+            zStream = z;
+        else
+            delete z;
+    }
+#else
+    (void) gzip;
+#endif
+}
+
+NDJSONStream::~NDJSONStream()
+{
+#ifdef ENABLE_ZLIB
+    if (zStream) {
+        deflateEnd((z_stream *) zStream);
+        delete (z_stream *) zStream;
+    }
+#endif
+}
+
+bool NDJSONStream::gzipped() const
+{
+    return zStream != nullptr;
+}
+
+/**
+ * Fetch next chunk(s) from the backend until there is something to read
+ * @return CODE_OK or error code
+ */
+int NDJSONStream::refill()
+{
+    pending.clear();
+    pendingPos = 0;
+    while (pending.empty() && !finished) {
+        std::string raw;
+        if (!exhausted) {
+            int r = fetch(raw);
+            if (r < 0)
+                return r;
+            if (r < chunkSize)
+                exhausted = true;
+        }
+        if (!zStream) {
+            pending.swap(raw);
+            if (exhausted)
+                finished = true;
+            continue;
+        }
+#ifdef ENABLE_ZLIB
+        auto z = (z_stream *) zStream;
+        z->next_in = (Bytef *) raw.c_str();
+        z->avail_in = (uInt) raw.size();
+        int flush = exhausted ? Z_FINISH : Z_NO_FLUSH;
+        unsigned char out[16384];
+        int ret;
+        do {
+            z->next_out = out;
+            z->avail_out = sizeof(out);
+            ret = deflate(z, flush);
+            if (ret == Z_STREAM_ERROR)
+                return ERR_CODE_INVALID_PACKET;
+            pending.append((const char *) out, sizeof(out) - z->avail_out);
+        } while (z->avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+        if (ret == Z_STREAM_END)
+            finished = true;
+#endif
+    }
+    return CODE_OK;
+}
+
+ssize_t NDJSONStream::read(
+    char *buf,
+    size_t max
+)
+{
+    if (pendingPos >= pending.size()) {
+        if (finished)
+            return NDJSON_STREAM_END;
+        if (refill() != CODE_OK)
+            return NDJSON_STREAM_ERROR;
+        if (pending.empty())
+            return NDJSON_STREAM_END;
+    }
+    size_t sz = std::min(max, pending.size() - pendingPos);
+    memmove(buf, pending.c_str() + pendingPos, sz);
+    pendingPos += sz;
+    return (ssize_t) sz;
+}
+
+IdentityNDJSONStream::IdentityNDJSONStream(
+    IdentityService *aSvc,
+    bool gzip,
+    uint8_t chunkSize
+)
+    : NDJSONStream(gzip, chunkSize), svc(aSvc), last()
+{
+
+}
+
+int IdentityNDJSONStream::fetch(
+    std::string &retVal
+)
+{
+    std::vector<NETWORKIDENTITY> nis;
+    int r = svc->listAfter(nis, started ? &last : nullptr, chunkSize);
+    if (r < 0)
+        return r;
+    JsonWriter writer(retVal);
+    for (auto &ni : nis) {
+        ni.toJson(writer);
+        writer.raw('\n');
+    }
+    if (!nis.empty()) {
+        memmove(last.c, nis.back().value.devaddr.c, sizeof(last.c));
+        started = true;
+    }
+    return (int) nis.size();
+}
+
+GatewayNDJSONStream::GatewayNDJSONStream(
+    GatewayService *aSvc,
+    bool gzip,
+    uint8_t chunkSize
+)
+    : NDJSONStream(gzip, chunkSize), svc(aSvc), last(0)
+{
+
+}
+
+int GatewayNDJSONStream::fetch(
+    std::string &retVal
+)
+{
+    std::vector<GatewayIdentity> gws;
+    int r = svc->listAfter(gws, started ? &last : nullptr, chunkSize);
+    if (r < 0)
+        return r;
+    JsonWriter writer(retVal);
+    for (auto &gw : gws) {
+        gw.toJson(writer);
+        writer.raw('\n');
+    }
+    if (!gws.empty()) {
+        last = gws.back().gatewayId;
+        started = true;
+    }
+    return (int) gws.size();
+}
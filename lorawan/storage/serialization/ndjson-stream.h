@@ -0,0 +1,94 @@
+#ifndef NDJSON_STREAM_H_
+#define NDJSON_STREAM_H_	1
+
+#include <string>
+#include <cinttypes>
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <BaseTsd.h>
+typedef SSIZE_T ssize_t;
+#else
+#include <sys/types.h>
+#endif
+
+#include "lorawan/storage/service/identity-service.h"
+#include "lorawan/storage/service/gateway-service.h"
+
+#define NDJSON_STREAM_END   (-1)
+#define NDJSON_STREAM_ERROR (-2)
+
+#define DEF_NDJSON_CHUNK_SIZE   100
+
+/**
+ * Newline-delimited JSON export of the whole storage.
+ * Backend is walked by chunks, memory does not depend on the number of entries.
+ * Output is optionally gzip compressed on the fly (ENABLE_ZLIB).
+ */
+class NDJSONStream {
+private:
+    std::string pending;    ///< data ready to read (compressed if gzip)
+    size_t pendingPos;
+    bool exhausted;         ///< backend has no more entries
+    bool finished;          ///< all data including gzip trailer is in pending
+    void *zStream;
+    int refill();
+protected:
+    bool started;           ///< last key is set
+    uint8_t chunkSize;
+    /**
+     * Append next chunk of lines to the retVal and remember the last key.
+     * Next chunk starts after the last key, rows put or removed meanwhile do not shift it.
+     * @param retVal lines to append
+     * @return entries count, 0- no more entries, <0- error
+     */
+    virtual int fetch(std::string &retVal) = 0;
+public:
+    explicit NDJSONStream(
+        bool gzip = false,
+        uint8_t chunkSize = DEF_NDJSON_CHUNK_SIZE
+    );
+    virtual ~NDJSONStream();
+    /**
+     * @return true if output is gzip compressed
+     */
+    bool gzipped() const;
+    /**
+     * Copy next portion of stream to the buffer
+     * @param buf buffer
+     * @param max buffer size
+     * @return bytes copied, NDJSON_STREAM_END, NDJSON_STREAM_ERROR
+     */
+    ssize_t read(
+        char *buf,
+        size_t max
+    );
+};
+
+class IdentityNDJSONStream : public NDJSONStream {
+private:
+    IdentityService *svc;
+    DEVADDR last;
+protected:
+    int fetch(std::string &retVal) override;
+public:
+    explicit IdentityNDJSONStream(
+        IdentityService *svc,
+        bool gzip = false,
+        uint8_t chunkSize = DEF_NDJSON_CHUNK_SIZE
+    );
+};
+
+class GatewayNDJSONStream : public NDJSONStream {
+private:
+    GatewayService *svc;
+    uint64_t last;
+protected:
+    int fetch(std::string &retVal) override;
+public:
+    explicit GatewayNDJSONStream(
+        GatewayService *svc,
+        bool gzip = false,
+        uint8_t chunkSize = DEF_NDJSON_CHUNK_SIZE
+    );
+};
+
+#endif
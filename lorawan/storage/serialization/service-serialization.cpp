@@ -9,7 +9,7 @@
 #endif
 
 ServiceMessage::ServiceMessage()
-    : tag(0), code(0), accessCode(0)
+    : tag(0), code(0), accessCode(0), requestId(0)
 {
 
 }
@@ -19,7 +19,7 @@ ServiceMessage::ServiceMessage(
     int32_t aCode,
     uint64_t aAccessCode
 )
-    : tag(aTag), code(aCode), accessCode(aAccessCode)
+    : tag(aTag), code(aCode), accessCode(aAccessCode), requestId(0)
 {
 
 }
@@ -28,6 +28,7 @@ ServiceMessage::ServiceMessage(
     const unsigned char *buf,
     size_t sz
 )
+    : tag(0), code(0), accessCode(0), requestId(0)
 {
     if (sz >= SIZE_SERVICE_MESSAGE) {
         memmove(&tag, &buf[0], sizeof(tag));         // 1
@@ -64,6 +65,47 @@ std::string ServiceMessage::toJsonString() const
     return "";
 }
 
+void deserializeServiceHeader(
+    char &retTag,
+    int32_t &retCode,
+    uint64_t &retAccessCode,
+    const unsigned char *buf
+)
+{
+    retTag = (char) buf[0];                                     // 1
+    uint32_t c;
+    memmove(&c, &buf[1], sizeof(c));                            // 4
+    retCode = (int32_t) NTOH4(c);
+    memmove(&retAccessCode, &buf[5], sizeof(retAccessCode));    // 8
+    retAccessCode = NTOH8(retAccessCode);
+}
+
+bool hasServiceHeaderCredentials(
+    const unsigned char *buf,
+    int32_t code,
+    uint64_t accessCode
+)
+{
+    uint32_t c = NTOH4((uint32_t) code);
+    uint64_t a = NTOH8(accessCode);
+    return memcmp(&buf[1], &c, sizeof(c)) == 0 && memcmp(&buf[5], &a, sizeof(a)) == 0;
+}
+
+size_t serializeServiceHeader(
+    unsigned char *retBuf,
+    char tag,
+    int32_t code,
+    uint64_t accessCode
+)
+{
+    retBuf[0] = (unsigned char) tag;                // 1
+    uint32_t c = NTOH4((uint32_t) code);
+    memmove(&retBuf[1], &c, sizeof(c));             // 4
+    uint64_t a = NTOH8(accessCode);
+    memmove(&retBuf[5], &a, sizeof(a));             // 8
+    return SIZE_SERVICE_MESSAGE;                    // 13
+}
+
 struct in_addr_4 {
     union {
         struct {
@@ -12,6 +12,7 @@ public:
     char tag;
     int32_t code;           // "account#" in request
     uint64_t accessCode;    // magic number in request, retCode in response, negative is error code
+    uint32_t requestId;     // protocol version 2 (batch) request identifier, not serialized in the header. 0- version 1
     ServiceMessage();
     ServiceMessage(char tag, int32_t code, uint64_t accessCode);
     ServiceMessage(const unsigned char *buf, size_t sz);
@@ -21,6 +22,40 @@ public:
     virtual std::string toJsonString() const;
 };  // 5 bytes
 
+/**
+ * Read message header in place, values are in the host byte order
+ * @param buf at least SIZE_SERVICE_MESSAGE bytes
+ */
+void deserializeServiceHeader(
+    char &retTag,
+    int32_t &retCode,
+    uint64_t &retAccessCode,
+    const unsigned char *buf
+);
+
+/**
+ * Compare code and access code of the serialized header without decoding it
+ * @param buf at least SIZE_SERVICE_MESSAGE bytes
+ * @return true if the header has the same code and access code
+ */
+bool hasServiceHeaderCredentials(
+    const unsigned char *buf,
+    int32_t code,
+    uint64_t accessCode
+);
+
+/**
+ * Write message header in place in the network byte order
+ * @param retBuf at least SIZE_SERVICE_MESSAGE bytes
+ * @return SIZE_SERVICE_MESSAGE
+ */
+size_t serializeServiceHeader(
+    unsigned char *retBuf,
+    char tag,
+    int32_t code,
+    uint64_t accessCode
+);
+
 /**
  * Serialize Internet address v4, v6
  * @param retBuf return buffer
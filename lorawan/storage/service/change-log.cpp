@@ -0,0 +1,117 @@
+#include "lorawan/storage/service/change-log.h"
+
+#include <algorithm>
+
+#include "lorawan/lorawan-error.h"
+
+ChangeRecord::ChangeRecord()
+    : seq(0), op(0)
+{
+}
+
+ChangeRecord::ChangeRecord(
+    uint64_t aSeq,
+    char aOp,
+    const NETWORKIDENTITY &aIdentity
+)
+    : seq(aSeq), op(aOp), identity(aIdentity)
+{
+}
+
+ChangeLog::ChangeLog(
+    size_t aCapacity
+)
+    : lastSeq(0), capacity(aCapacity ? aCapacity : 1)
+{
+}
+
+uint64_t ChangeLog::append(
+    char op,
+    const NETWORKIDENTITY &identity
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    lastSeq++;
+    records.emplace_back(lastSeq, op, identity);
+    while (records.size() > capacity)
+        records.pop_front();
+    notify();
+    return lastSeq;
+}
+
+void ChangeLog::append(
+    const ChangeRecord &value
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (value.seq <= lastSeq)
+        return; // already applied
+    if (value.seq != lastSeq + 1)
+        records.clear();    // gap, readers of this log have to start from the snapshot
+    lastSeq = value.seq;
+    records.push_back(value);
+    while (records.size() > capacity)
+        records.pop_front();
+    notify();
+}
+
+void ChangeLog::reset(
+    uint64_t seq
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    records.clear();
+    lastSeq = seq;
+    notify();
+}
+
+int ChangeLog::since(
+    std::vector<ChangeRecord> &retVal,
+    uint64_t seq,
+    size_t maxCount
+) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (seq > lastSeq)
+        return ERR_CODE_REPLICA_SNAPSHOT;   // log of another primary or the primary is restarted
+    if (seq == lastSeq)
+        return CODE_OK;
+    if (records.empty() || records.front().seq > seq + 1)
+        return ERR_CODE_REPLICA_SNAPSHOT;
+    // records are consecutive
+    size_t i = (size_t) (seq + 1 - records.front().seq);
+    for (; i < records.size() && maxCount > 0; i++, maxCount--) {
+        retVal.push_back(records[i]);
+    }
+    return CODE_OK;
+}
+
+uint64_t ChangeLog::last() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return lastSeq;
+}
+
+void ChangeLog::addObserver(
+    ChangeLogObserver *value
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (value && std::find(observers.begin(), observers.end(), value) == observers.end())
+        observers.push_back(value);
+}
+
+void ChangeLog::removeObserver(
+    ChangeLogObserver *value
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    observers.erase(std::remove(observers.begin(), observers.end(), value), observers.end());
+}
+
+void ChangeLog::notify()
+{
+    for (auto o : observers) {
+        o->onChangeLogUpdated(lastSeq);
+    }
+}
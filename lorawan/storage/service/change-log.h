@@ -0,0 +1,99 @@
+#ifndef CHANGE_LOG_H_
+#define CHANGE_LOG_H_ 1
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <cinttypes>
+
+#include "lorawan/lorawan-types.h"
+
+// records kept for the replicas catching up
+#define DEF_CHANGE_LOG_CAPACITY 65536
+
+/**
+ * Committed change
+ */
+class ChangeRecord {
+public:
+    uint64_t seq;               ///< sequence number, starts with 1
+    char op;                    ///< QUERY_IDENTITY_ASSIGN ('p') or QUERY_IDENTITY_RM ('r')
+    NETWORKIDENTITY identity;   ///< rm has address only
+    ChangeRecord();
+    ChangeRecord(uint64_t seq, char op, const NETWORKIDENTITY &identity);
+};
+
+/**
+ * Notified when a record is appended or the log is reset.
+ * Called with the log locked from the thread changing the log, it must not block or call the log.
+ */
+class ChangeLogObserver {
+public:
+    virtual void onChangeLogUpdated(
+        uint64_t lastSeq
+    ) = 0;
+    virtual ~ChangeLogObserver() = default;
+};
+
+/**
+ * Bounded in-memory log of the committed put and rm operations.
+ * Oldest records are dropped, reader asking for the dropped records must start from the snapshot.
+ */
+class ChangeLog {
+private:
+    std::deque<ChangeRecord> records;
+    uint64_t lastSeq;
+    std::vector<ChangeLogObserver *> observers;
+    mutable std::mutex lock;
+    void notify();
+public:
+    size_t capacity;
+    explicit ChangeLog(
+        size_t capacity = DEF_CHANGE_LOG_CAPACITY
+    );
+    /**
+     * Append committed operation
+     * @return sequence number
+     */
+    uint64_t append(
+        char op,
+        const NETWORKIDENTITY &identity
+    );
+    /**
+     * Append record with the sequence number assigned by the primary
+     */
+    void append(
+        const ChangeRecord &value
+    );
+    /**
+     * Drop records, next record gets seq + 1
+     * @param seq last sequence number of the snapshot
+     */
+    void reset(
+        uint64_t seq
+    );
+    /**
+     * Copy records after the sequence number
+     * @param retVal return records
+     * @param seq last sequence number the reader has
+     * @param maxCount max records to return
+     * @return CODE_OK, ERR_CODE_REPLICA_SNAPSHOT- records are dropped or reader is ahead of the log
+     */
+    int since(
+        std::vector<ChangeRecord> &retVal,
+        uint64_t seq,
+        size_t maxCount
+    ) const;
+    /**
+     * @return last sequence number, 0- no changes
+     */
+    uint64_t last() const;
+    void addObserver(
+        ChangeLogObserver *value
+    );
+    void removeObserver(
+        ChangeLogObserver *value
+    );
+};
+
+#endif
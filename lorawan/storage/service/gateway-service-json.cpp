@@ -4,6 +4,7 @@
 
 #include "gateway-service-json.h"
 #include "lorawan/helper/ip-address.h"
+#include "lorawan/helper/json-writer.h"
 #include "lorawan/lorawan-error.h"
 #include "lorawan/lorawan-string.h"
 #include "nlohmann/json.hpp"
@@ -142,16 +143,24 @@ bool JsonGatewayService::load()
 bool JsonGatewayService::store()
 {
     std::ofstream f(fileName);
+    std::string buffer;
+    buffer.reserve(DEF_JSON_WRITER_FLUSH_SIZE * 2);
+    JsonWriter writer(buffer);
     bool isFirst = true;
-    f << "[\n";
+    writer.raw("[\n");
     for (auto& e : this->storage) {
         if (isFirst)
             isFirst = false;
         else
-            f << ",\n";
-        f << e.second.toJsonString();
+            writer.raw(",\n");
+        e.second.toJson(writer);
+        if (buffer.size() >= DEF_JSON_WRITER_FLUSH_SIZE) {
+            f.write(buffer.c_str(), (std::streamsize) buffer.size());
+            buffer.clear();
+        }
     }
-    f << "]\n";
+    writer.raw("]\n");
+    f.write(buffer.c_str(), (std::streamsize) buffer.size());
     f.close();
     return true;
 }
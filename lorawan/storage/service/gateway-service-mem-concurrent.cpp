@@ -0,0 +1,141 @@
+#include <cstring>
+
+#include "lorawan/storage/service/gateway-service-mem-concurrent.h"
+#include "lorawan/helper/ip-address.h"
+#include "lorawan/lorawan-error.h"
+
+/**
+ * Murmur3 64-bit finalizer
+ */
+uint32_t GatewayIdHash::operator()(
+    uint64_t value
+) const
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return (uint32_t) value;
+}
+
+ConcurrentMemoryGatewayService::ConcurrentMemoryGatewayService(
+    size_t shardCount
+)
+    : storage(shardCount)
+{
+}
+
+ConcurrentMemoryGatewayService::~ConcurrentMemoryGatewayService() = default;
+
+/**
+ * Get gateway by identifier or by address if identifier is 0
+ * @return CODE_OK- success
+ */
+int ConcurrentMemoryGatewayService::get(
+    GatewayIdentity &retVal,
+    const GatewayIdentity &request
+)
+{
+    if (request.gatewayId) {
+        if (storage.get(retVal, request.gatewayId))
+            return CODE_OK;
+        memset(&retVal.sockaddr, 0, sizeof(retVal.sockaddr));
+        return ERR_CODE_GATEWAY_NOT_FOUND;
+    }
+    // reverse find out by address
+    uint64_t id;
+    if (storage.find(id, retVal,
+        [&request](uint64_t, const GatewayIdentity &value) {
+            return sameSocketAddress(&request.sockaddr, &value.sockaddr);
+        }
+    ))
+        return CODE_OK;
+    return ERR_CODE_GATEWAY_NOT_FOUND;
+}
+
+int ConcurrentMemoryGatewayService::list(
+    std::vector<GatewayIdentity> &retVal,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    storage.forEach(offset, size,
+        [](uint64_t, const GatewayIdentity &) {
+            return true;
+        },
+        [&retVal](uint64_t, const GatewayIdentity &value) {
+            retVal.push_back(value);
+        }
+    );
+    return CODE_OK;
+}
+
+int ConcurrentMemoryGatewayService::listAfter(
+    std::vector<GatewayIdentity> &retVal,
+    const uint64_t *after,
+    uint8_t size
+)
+{
+    storage.forEachAfter(after, size,
+        [&retVal](uint64_t, const GatewayIdentity &value) {
+            retVal.push_back(value);
+        }
+    );
+    return CODE_OK;
+}
+
+size_t ConcurrentMemoryGatewayService::size()
+{
+    return storage.size();
+}
+
+int ConcurrentMemoryGatewayService::put(
+    const GatewayIdentity &request
+)
+{
+    storage.put(request.gatewayId, request);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryGatewayService::rm(
+    const GatewayIdentity &request
+)
+{
+    if (request.gatewayId) {
+        if (storage.rm(request.gatewayId))
+            return CODE_OK;
+    } else {
+        // reverse find out by address
+        if (storage.rmIf([&request](uint64_t, const GatewayIdentity &value) {
+                return sameSocketAddress(&request.sockaddr, &value.sockaddr);
+            }))
+            return CODE_OK;
+    }
+    return ERR_CODE_GATEWAY_NOT_FOUND;
+}
+
+int ConcurrentMemoryGatewayService::init(
+    const std::string &,
+    void *
+)
+{
+    return CODE_OK;
+}
+
+void ConcurrentMemoryGatewayService::flush()
+{
+}
+
+void ConcurrentMemoryGatewayService::done()
+{
+    storage.clear();
+}
+
+void ConcurrentMemoryGatewayService::setOption(
+    int,
+    void *
+)
+{
+    // nothing to do
+}
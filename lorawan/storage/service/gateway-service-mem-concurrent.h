@@ -0,0 +1,46 @@
+#ifndef GATEWAY_SERVICE_MEM_CONCURRENT_H_
+#define GATEWAY_SERVICE_MEM_CONCURRENT_H_ 1
+
+#include <vector>
+#include "lorawan/storage/service/gateway-service.h"
+#include "lorawan/storage/service/sharded-map.h"
+
+class GatewayIdHash {
+public:
+    uint32_t operator()(uint64_t value) const;
+};
+
+/**
+ * In-memory gateway service safe to share between listener threads and workers.
+ * Entries are split into buckets by gateway identifier hash, each bucket has own readers-writer lock.
+ */
+class ConcurrentMemoryGatewayService: public GatewayService {
+protected:
+    ShardedMap<uint64_t, GatewayIdentity, GatewayIdHash> storage;
+public:
+    explicit ConcurrentMemoryGatewayService(
+        size_t shardCount = DEF_SHARDED_MAP_SHARDS
+    );
+    ~ConcurrentMemoryGatewayService() override;
+    int get(GatewayIdentity &retVal, const GatewayIdentity &request) override;
+    // List entries
+    int list(std::vector<GatewayIdentity> &retVal,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int listAfter(std::vector<GatewayIdentity> &retVal,
+        const uint64_t *after,
+        uint8_t size
+    ) override;
+    // Entries count
+    size_t size() override;
+    int put(const GatewayIdentity &request) override;
+    int rm(const GatewayIdentity &addr) override;
+
+    int init(const std::string &option, void *data) override;
+    void flush() override;
+    void done() override;
+    void setOption(int option, void *value) override;
+};
+
+#endif
@@ -77,6 +77,20 @@ int  MemoryGatewayService::list(
     return CODE_OK;
 }
 
+int MemoryGatewayService::listAfter(
+    std::vector<GatewayIdentity> &retVal,
+    const uint64_t *after,
+    uint8_t size
+)
+{
+    size_t sz = 0;
+    for (auto it = after ? storage.upper_bound(*after) : storage.begin(); it != storage.end() && sz < size; it++) {
+        retVal.push_back(it->second);
+        sz++;
+    }
+    return CODE_OK;
+}
+
 // Entries count
 size_t MemoryGatewayService::size()
 {
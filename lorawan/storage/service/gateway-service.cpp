@@ -1,6 +1,43 @@
+#include <algorithm>
+
 #include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-error.h"
 #include "gateway-service.h"
 
+// list() page size of the default listAfter()
+#define LIST_AFTER_PAGE 255
+
 GatewayService::GatewayService() = default;
 
 GatewayService::~GatewayService() = default;
+
+int GatewayService::listAfter(
+    std::vector<GatewayIdentity> &retVal,
+    const uint64_t *after,
+    uint8_t size
+)
+{
+    std::vector<GatewayIdentity> found;
+    std::vector<GatewayIdentity> page;
+    uint32_t offset = 0;
+    while (true) {
+        page.clear();
+        int r = list(page, offset, LIST_AFTER_PAGE);
+        if (r != CODE_OK)
+            return r;
+        for (auto &gw : page) {
+            if (!after || *after < gw.gatewayId)
+                found.push_back(gw);
+        }
+        if (page.size() < LIST_AFTER_PAGE)
+            break;
+        offset += (uint32_t) page.size();
+    }
+    std::sort(found.begin(), found.end(), [](const GatewayIdentity &a, const GatewayIdentity &b) {
+        return a.gatewayId < b.gatewayId;
+    });
+    for (size_t i = 0; i < found.size() && i < size; i++) {
+        retVal.push_back(found[i]);
+    }
+    return CODE_OK;
+}
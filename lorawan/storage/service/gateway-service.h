@@ -44,6 +44,21 @@ public:
         uint8_t size
     ) = 0;
 
+    /**
+     * List entries in the gateway identifier order after the identifier of the last entry of the previous page.
+     * Entries put or removed between the pages do not shift the next page as offset does.
+     * Default implementation reads whole storage by list(), ordered storages override it.
+     * @param retVal return values
+     * @param after gateway identifier of the last entry of the previous page, nullptr- first page
+     * @param size entries count
+     * @return CODE_OK- success
+     */
+    virtual int listAfter(
+        std::vector<GatewayIdentity> &retVal,
+        const uint64_t *after,
+        uint8_t size
+    );
+
     // Entries count
     virtual size_t size() = 0;
 
@@ -0,0 +1,318 @@
+#include "lorawan/storage/service/identity-service-coalescing.h"
+
+#include <sstream>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+CoalescingIdentityService::Flight::Flight()
+    : done(false), result(CODE_OK)
+{
+}
+
+CoalescingIdentityService::CoalescingIdentityService(
+    IdentityService *aSvc
+)
+    : svc(aSvc), backendCalls(0), coalesced(0)
+{
+}
+
+CoalescingIdentityService::~CoalescingIdentityService() = default;
+
+std::string CoalescingIdentityService::toString() const
+{
+    std::stringstream ss;
+    ss << "coalescing: backend lookups " << backendCalls << ", coalesced " << coalesced;
+    return ss.str();
+}
+
+int CoalescingIdentityService::get(
+    DEVICEID &retVal,
+    const DEVADDR &request
+)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    auto it = addrFlights.find(request.u);
+    if (it != addrFlights.end()) {
+        std::shared_ptr<Flight> f = it->second;
+        coalesced++;
+        flightDone.wait(guard, [&f] { return f->done; });
+        retVal = f->value.value.devid;
+        return f->result;
+    }
+    auto f = std::make_shared<Flight>();
+    addrFlights[request.u] = f;
+    guard.unlock();
+
+    backendCalls++;
+    int r = svc->get(f->value.value.devid, request);
+
+    guard.lock();
+    f->result = r;
+    f->done = true;
+    it = addrFlights.find(request.u);
+    if (it != addrFlights.end() && it->second == f)
+        addrFlights.erase(it);
+    guard.unlock();
+    flightDone.notify_all();
+    retVal = f->value.value.devid;
+    return r;
+}
+
+int CoalescingIdentityService::getNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const DEVEUI &eui
+)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    auto it = euiFlights.find(eui.u);
+    if (it != euiFlights.end()) {
+        std::shared_ptr<Flight> f = it->second;
+        coalesced++;
+        flightDone.wait(guard, [&f] { return f->done; });
+        retVal.set(f->value);
+        return f->result;
+    }
+    auto f = std::make_shared<Flight>();
+    euiFlights[eui.u] = f;
+    guard.unlock();
+
+    backendCalls++;
+    int r = svc->getNetworkIdentity(f->value, eui);
+
+    guard.lock();
+    f->result = r;
+    f->done = true;
+    it = euiFlights.find(eui.u);
+    if (it != euiFlights.end() && it->second == f)
+        euiFlights.erase(it);
+    guard.unlock();
+    flightDone.notify_all();
+    retVal.set(f->value);
+    return r;
+}
+
+/**
+ * Lookups in flight can return the value before the change, next lookups start new flight.
+ * Called after the backend write, it drops flights started before or during the write.
+ * @param devAddr changed address
+ * @param eui EUI assigned to the address
+ * @param previous EUI the address had before the change
+ */
+void CoalescingIdentityService::forget(
+    const DEVADDR &devAddr,
+    uint64_t eui,
+    uint64_t previous
+)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    addrFlights.erase(devAddr.u);
+    euiFlights.erase(eui);
+    euiFlights.erase(previous);
+}
+
+/**
+ * @return EUI assigned to the address before the change, 0 if none
+ */
+uint64_t CoalescingIdentityService::previousEui(
+    const DEVADDR &devAddr
+)
+{
+    DEVICEID previous;
+    if (svc->get(previous, devAddr) != CODE_OK)
+        return 0;
+    return previous.id.devEUI.u;
+}
+
+/**
+ * Not coalesced, used when devices share the address
+ */
+int CoalescingIdentityService::getCandidates(
+    std::vector<DEVICEID> &retVal,
+    const DEVADDR &devAddr
+)
+{
+    return svc->getCandidates(retVal, devAddr);
+}
+
+int CoalescingIdentityService::put(
+    const DEVADDR &devAddr,
+    const DEVICEID &id
+)
+{
+    uint64_t previous = previousEui(devAddr);
+    int r = svc->put(devAddr, id);
+    forget(devAddr, id.id.devEUI.u, previous);
+    return r;
+}
+
+int CoalescingIdentityService::rm(
+    const DEVADDR &devAddr
+)
+{
+    uint64_t previous = previousEui(devAddr);
+    int r = svc->rm(devAddr);
+    forget(devAddr, previous, previous);
+    return r;
+}
+
+int CoalescingIdentityService::list(
+    std::vector<NETWORKIDENTITY> &retVal,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    return svc->list(retVal, offset, size);
+}
+
+int CoalescingIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+)
+{
+    return svc->listAfter(retVal, after, size);
+}
+
+int CoalescingIdentityService::filter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    return svc->filter(retVal, filters, offset, size);
+}
+
+size_t CoalescingIdentityService::size()
+{
+    return svc->size();
+}
+
+int CoalescingIdentityService::next(
+    NETWORKIDENTITY &retVal
+)
+{
+    return svc->next(retVal);
+}
+
+int CoalescingIdentityService::init(
+    const std::string &option,
+    void *data
+)
+{
+    return svc->init(option, data);
+}
+
+void CoalescingIdentityService::flush()
+{
+    svc->flush();
+}
+
+void CoalescingIdentityService::done()
+{
+    svc->done();
+}
+
+void CoalescingIdentityService::setOption(
+    int option,
+    void *value
+)
+{
+    svc->setOption(option, value);
+}
+
+NETID *CoalescingIdentityService::getNetworkId()
+{
+    return svc->getNetworkId();
+}
+
+void CoalescingIdentityService::setNetworkId(
+    const NETID &value
+)
+{
+    svc->setNetworkId(value);
+}
+
+// ------------------- asynchronous imitation -------------------
+int CoalescingIdentityService::cGet(const DEVADDR &request)
+{
+    IdentityGetResponse r;
+    r.response.value.devaddr = request;
+    get(r.response.value.devid, request);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int CoalescingIdentityService::cGetNetworkIdentity(const DEVEUI &eui)
+{
+    IdentityGetResponse r;
+    getNetworkIdentity(r.response, eui);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int CoalescingIdentityService::cPut(const DEVADDR &devAddr, const DEVICEID &id)
+{
+    IdentityOperationResponse r;
+    r.response = put(devAddr, id);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int CoalescingIdentityService::cRm(const DEVADDR &devAddr)
+{
+    IdentityOperationResponse r;
+    r.response = rm(devAddr);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int CoalescingIdentityService::cList(
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = list(r.identities, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int CoalescingIdentityService::cFilter(
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = filter(r.identities, filters, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int CoalescingIdentityService::cSize()
+{
+    IdentityOperationResponse r;
+    r.response = (uint32_t) size();
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int CoalescingIdentityService::cNext()
+{
+    IdentityGetResponse r;
+    next(r.response);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
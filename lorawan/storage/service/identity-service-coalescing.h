@@ -0,0 +1,90 @@
+#ifndef IDENTITY_SERVICE_COALESCING_H_
+#define IDENTITY_SERVICE_COALESCING_H_ 1
+
+#include <map>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "lorawan/storage/service/identity-service.h"
+
+/**
+ * Identity service wrapper sharing one backend lookup between concurrent identical lookups (single flight).
+ * First get (getNetworkIdentity) of the address (EUI) calls the backend, requests for the same key arriving
+ * while the call is in flight wait and get the same result. Lookup started after put or rm does not join
+ * the flight started before it: put and rm drop flights of the address, of the assigned and of the previous EUI.
+ * Put and rm read the previous EUI from the backend.
+ * Other calls are passed to the backend as is.
+ * Lookups overlap only if the backend is queried by several threads at once, e.g. thread safe storage
+ * queried by the scheduler workers, the listener and HTTP threads.
+ */
+class CoalescingIdentityService: public IdentityService {
+private:
+    class Flight {
+    public:
+        bool done;
+        int result;
+        NETWORKIDENTITY value;
+        Flight();
+    };
+    IdentityService *svc;
+    std::mutex lock;
+    std::condition_variable flightDone;
+    std::map<uint32_t, std::shared_ptr<Flight> > addrFlights;
+    std::map<uint64_t, std::shared_ptr<Flight> > euiFlights;
+    void forget(const DEVADDR &devAddr, uint64_t eui, uint64_t previous);
+    uint64_t previousEui(const DEVADDR &devAddr);
+public:
+    // counters
+    std::atomic<uint64_t> backendCalls;     ///< lookups passed to the backend
+    std::atomic<uint64_t> coalesced;        ///< lookups answered by the call of another request
+    std::string toString() const;
+
+    /**
+     * @param svc initialized identity service, not owned
+     */
+    explicit CoalescingIdentityService(
+        IdentityService *svc
+    );
+    ~CoalescingIdentityService() override;
+
+    // synchronous
+    int get(DEVICEID &retVal, const DEVADDR &request) override;
+    int getCandidates(std::vector<DEVICEID> &retVal, const DEVADDR &devAddr) override;
+    int getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) override;
+    int put(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int rm(const DEVADDR &devAddr) override;
+    int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
+    size_t size() override;
+    int next(NETWORKIDENTITY &retVal) override;
+    // asynchronous imitation
+    int cGet(const DEVADDR &request) override;
+    int cGetNetworkIdentity(const DEVEUI &eui) override;
+    int cPut(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int cRm(const DEVADDR &devAddr) override;
+    int cList(uint32_t offset, uint8_t size) override;
+    int cSize() override;
+    int cNext() override;
+    int filter(
+        std::vector<NETWORKIDENTITY> &retVal,
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int cFilter(
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int init(const std::string &option, void *data) override;
+    void flush() override;
+    void done() override;
+    void setOption(int option, void *value) override;
+    NETID *getNetworkId() override;
+    void setNetworkId(const NETID &value) override;
+};
+
+#endif
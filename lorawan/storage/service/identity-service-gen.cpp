@@ -208,7 +208,7 @@ void GenIdentityService::setOption(
 {
     if (!value)
         return;
-    if (option == 0)
+    if (option == IDENTITY_OPTION_MASTER_KEY)
         setMasterKey(*(std::string *) value);
 }
 
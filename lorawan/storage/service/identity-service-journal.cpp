@@ -0,0 +1,314 @@
+#include "lorawan/storage/service/identity-service-journal.h"
+
+#include <set>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+// list request size is uint8_t
+#define MAX_PAGE_ENTRIES    255
+
+JournalIdentityService::JournalIdentityService(
+    IdentityService *aSvc,
+    size_t capacity
+)
+    : svc(aSvc), readOnly(false), log(capacity)
+{
+}
+
+JournalIdentityService::~JournalIdentityService() = default;
+
+void JournalIdentityService::setReadOnly(
+    bool value
+)
+{
+    readOnly = value;
+}
+
+bool JournalIdentityService::isReadOnly()
+{
+    return readOnly;
+}
+
+int JournalIdentityService::applyChange(
+    const ChangeRecord &value
+)
+{
+    ExclusiveGuard guard(lock);
+    if (value.seq <= log.last())
+        return CODE_OK;
+    int r;
+    if (value.op == QUERY_IDENTITY_RM) {
+        r = svc->rm(value.identity.value.devaddr);
+        if (r == ERR_CODE_DEVICE_ADDRESS_NOTFOUND)
+            r = CODE_OK;    // snapshot is taken after rm
+    } else
+        r = svc->put(value.identity.value.devaddr, value.identity.value.devid);
+    if (r == CODE_OK)
+        log.append(value);
+    return r;
+}
+
+int JournalIdentityService::applySnapshot(
+    const std::vector<NETWORKIDENTITY> &entries,
+    uint64_t seq
+)
+{
+    ExclusiveGuard guard(lock);
+    std::set<DEVADDR> keep;
+    for (auto &e : entries) {
+        keep.insert(e.value.devaddr);
+    }
+    // remove entries missing in the snapshot
+    std::vector<DEVADDR> obsolete;
+    for (uint32_t o = 0; ; ) {
+        std::vector<NETWORKIDENTITY> page;
+        int r = svc->list(page, o, MAX_PAGE_ENTRIES);
+        if (r < 0)
+            return r;
+        for (auto &e : page) {
+            if (keep.find(e.value.devaddr) == keep.end())
+                obsolete.push_back(e.value.devaddr);
+        }
+        o += (uint32_t) page.size();
+        if (page.size() < MAX_PAGE_ENTRIES)
+            break;
+    }
+    for (auto &a : obsolete) {
+        svc->rm(a);
+    }
+    for (auto &e : entries) {
+        int r = svc->put(e.value.devaddr, e.value.devid);
+        if (r < 0)
+            return r;
+    }
+    log.reset(seq);
+    return CODE_OK;
+}
+
+int JournalIdentityService::get(
+    DEVICEID &retVal,
+    const DEVADDR &request
+)
+{
+    SharedGuard guard(lock);
+    return svc->get(retVal, request);
+}
+
+int JournalIdentityService::getCandidates(
+    std::vector<DEVICEID> &retVal,
+    const DEVADDR &devAddr
+)
+{
+    SharedGuard guard(lock);
+    return svc->getCandidates(retVal, devAddr);
+}
+
+int JournalIdentityService::getNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const DEVEUI &eui
+)
+{
+    SharedGuard guard(lock);
+    return svc->getNetworkIdentity(retVal, eui);
+}
+
+int JournalIdentityService::put(
+    const DEVADDR &devAddr,
+    const DEVICEID &id
+)
+{
+    ExclusiveGuard guard(lock);
+    if (readOnly)
+        return ERR_CODE_ACCESS_DENIED;
+    int r = svc->put(devAddr, id);
+    if (r == CODE_OK)
+        log.append(QUERY_IDENTITY_ASSIGN, NETWORKIDENTITY(devAddr, id));
+    return r;
+}
+
+int JournalIdentityService::rm(
+    const DEVADDR &devAddr
+)
+{
+    ExclusiveGuard guard(lock);
+    if (readOnly)
+        return ERR_CODE_ACCESS_DENIED;
+    int r = svc->rm(devAddr);
+    if (r == CODE_OK) {
+        NETWORKIDENTITY identity;
+        identity.value.devaddr = devAddr;
+        log.append(QUERY_IDENTITY_RM, identity);
+    }
+    return r;
+}
+
+int JournalIdentityService::list(
+    std::vector<NETWORKIDENTITY> &retVal,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    SharedGuard guard(lock);
+    return svc->list(retVal, offset, size);
+}
+
+int JournalIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+)
+{
+    SharedGuard guard(lock);
+    return svc->listAfter(retVal, after, size);
+}
+
+int JournalIdentityService::filter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    SharedGuard guard(lock);
+    return svc->filter(retVal, filters, offset, size);
+}
+
+size_t JournalIdentityService::size()
+{
+    SharedGuard guard(lock);
+    return svc->size();
+}
+
+int JournalIdentityService::next(
+    NETWORKIDENTITY &retVal
+)
+{
+    ExclusiveGuard guard(lock);
+    return svc->next(retVal);
+}
+
+int JournalIdentityService::init(
+    const std::string &option,
+    void *data
+)
+{
+    ExclusiveGuard guard(lock);
+    return svc->init(option, data);
+}
+
+void JournalIdentityService::flush()
+{
+    ExclusiveGuard guard(lock);
+    svc->flush();
+}
+
+void JournalIdentityService::done()
+{
+    ExclusiveGuard guard(lock);
+    svc->done();
+}
+
+void JournalIdentityService::setOption(
+    int option,
+    void *value
+)
+{
+    ExclusiveGuard guard(lock);
+    svc->setOption(option, value);
+}
+
+NETID *JournalIdentityService::getNetworkId()
+{
+    return svc->getNetworkId();
+}
+
+void JournalIdentityService::setNetworkId(
+    const NETID &value
+)
+{
+    svc->setNetworkId(value);
+}
+
+// ------------------- asynchronous imitation -------------------
+int JournalIdentityService::cGet(const DEVADDR &request)
+{
+    IdentityGetResponse r;
+    r.response.value.devaddr = request;
+    get(r.response.value.devid, request);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int JournalIdentityService::cGetNetworkIdentity(const DEVEUI &eui)
+{
+    IdentityGetResponse r;
+    getNetworkIdentity(r.response, eui);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int JournalIdentityService::cPut(const DEVADDR &devAddr, const DEVICEID &id)
+{
+    IdentityOperationResponse r;
+    r.response = put(devAddr, id);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int JournalIdentityService::cRm(const DEVADDR &devAddr)
+{
+    IdentityOperationResponse r;
+    r.response = rm(devAddr);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int JournalIdentityService::cList(
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = list(r.identities, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int JournalIdentityService::cFilter(
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = filter(r.identities, filters, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int JournalIdentityService::cSize()
+{
+    IdentityOperationResponse r;
+    r.response = (uint32_t) size();
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int JournalIdentityService::cNext()
+{
+    IdentityGetResponse r;
+    next(r.response);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
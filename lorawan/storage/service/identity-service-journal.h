@@ -0,0 +1,94 @@
+#ifndef IDENTITY_SERVICE_JOURNAL_H_
+#define IDENTITY_SERVICE_JOURNAL_H_ 1
+
+#include <atomic>
+
+#include "lorawan/helper/rw-lock.h"
+#include "lorawan/storage/service/identity-service.h"
+#include "lorawan/storage/service/change-log.h"
+
+/**
+ * Identity service wrapper logging committed put and rm operations with the sequence number.
+ * Primary serves the log to the replicas, replica applies primary changes by applyChange().
+ * Writes are serialized by the exclusive lock, reads share the lock and run side by side,
+ * the wrapped service must allow concurrent reads. Replica applies changes from its own thread.
+ */
+class JournalIdentityService: public IdentityService {
+private:
+    IdentityService *svc;
+    RWLock lock;
+    std::atomic<bool> readOnly;
+public:
+    ChangeLog log;
+
+    /**
+     * @param svc initialized identity service, not owned
+     * @param capacity change log capacity
+     */
+    explicit JournalIdentityService(
+        IdentityService *svc,
+        size_t capacity = DEF_CHANGE_LOG_CAPACITY
+    );
+    ~JournalIdentityService() override;
+
+    /**
+     * Replica rejects put and rm with ERR_CODE_ACCESS_DENIED
+     */
+    void setReadOnly(bool value);
+    bool isReadOnly();
+    /**
+     * Apply primary change, ignore already applied changes
+     * @return CODE_OK or error code
+     */
+    int applyChange(
+        const ChangeRecord &value
+    );
+    /**
+     * Replace all entries by the primary snapshot
+     * @param entries primary entries
+     * @param seq primary sequence number the snapshot is taken at
+     * @return CODE_OK or error code
+     */
+    int applySnapshot(
+        const std::vector<NETWORKIDENTITY> &entries,
+        uint64_t seq
+    );
+
+    // synchronous
+    int get(DEVICEID &retVal, const DEVADDR &request) override;
+    int getCandidates(std::vector<DEVICEID> &retVal, const DEVADDR &devAddr) override;
+    int getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) override;
+    int put(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int rm(const DEVADDR &devAddr) override;
+    int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
+    size_t size() override;
+    int next(NETWORKIDENTITY &retVal) override;
+    // asynchronous imitation
+    int cGet(const DEVADDR &request) override;
+    int cGetNetworkIdentity(const DEVEUI &eui) override;
+    int cPut(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int cRm(const DEVADDR &devAddr) override;
+    int cList(uint32_t offset, uint8_t size) override;
+    int cSize() override;
+    int cNext() override;
+    int filter(
+        std::vector<NETWORKIDENTITY> &retVal,
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int cFilter(
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int init(const std::string &option, void *data) override;
+    void flush() override;
+    void done() override;
+    void setOption(int option, void *value) override;
+    NETID *getNetworkId() override;
+    void setNetworkId(const NETID &value) override;
+};
+
+#endif
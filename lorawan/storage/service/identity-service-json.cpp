@@ -5,6 +5,7 @@
 #include "lorawan/lorawan-error.h"
 #include "lorawan/lorawan-string.h"
 #include "lorawan/helper/file-helper.h"
+#include "lorawan/helper/json-writer.h"
 
 #ifdef ESP_PLATFORM
 #include <iostream>
@@ -163,16 +164,24 @@ bool JsonIdentityService::load()
 bool JsonIdentityService::store()
 {
     std::ofstream f(fileName);
+    std::string buffer;
+    buffer.reserve(DEF_JSON_WRITER_FLUSH_SIZE * 2);
+    JsonWriter writer(buffer);
     bool isFirst = true;
-    f << "[\n";
+    writer.raw("[\n");
     for (auto& e : this->storage) {
         if (isFirst)
             isFirst = false;
         else
-            f << ",\n";
-        f << e.second.toJsonString(e.first);
+            writer.raw(",\n");
+        e.second.toJson(writer, e.first);
+        if (buffer.size() >= DEF_JSON_WRITER_FLUSH_SIZE) {
+            f.write(buffer.c_str(), (std::streamsize) buffer.size());
+            buffer.clear();
+        }
     }
-    f << "]\n";
+    writer.raw("]\n");
+    f.write(buffer.c_str(), (std::streamsize) buffer.size());
     f.close();
     return true;
 }
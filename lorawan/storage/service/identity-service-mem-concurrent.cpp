@@ -0,0 +1,243 @@
+#include "lorawan/storage/service/identity-service-mem-concurrent.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+/**
+ * Murmur3 finalizer, sequential addresses fall to the different buckets
+ */
+uint32_t DevAddrHash::operator()(
+    const DEVADDR &value
+) const
+{
+    uint32_t h = value.u;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+ConcurrentMemoryIdentityService::ConcurrentMemoryIdentityService(
+    size_t shardCount
+)
+    : storage(shardCount)
+{
+}
+
+ConcurrentMemoryIdentityService::~ConcurrentMemoryIdentityService() = default;
+
+int ConcurrentMemoryIdentityService::get(
+    DEVICEID &retVal,
+    const DEVADDR &request
+)
+{
+    if (!storage.get(retVal, request))
+        return ERR_CODE_GATEWAY_NOT_FOUND;
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::list(
+    std::vector<NETWORKIDENTITY> &retVal,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    storage.forEach(offset, size,
+        [](const DEVADDR &, const DEVICEID &) {
+            return true;
+        },
+        [&retVal](const DEVADDR &addr, const DEVICEID &id) {
+            retVal.emplace_back(addr, id);
+        }
+    );
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+)
+{
+    storage.forEachAfter(after, size,
+        [&retVal](const DEVADDR &addr, const DEVICEID &id) {
+            retVal.emplace_back(addr, id);
+        }
+    );
+    return CODE_OK;
+}
+
+size_t ConcurrentMemoryIdentityService::size()
+{
+    return storage.size();
+}
+
+int ConcurrentMemoryIdentityService::getNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const DEVEUI &eui
+)
+{
+    if (!storage.find(retVal.value.devaddr, retVal.value.devid,
+        [&eui](const DEVADDR &, const DEVICEID &id) {
+            return id.id.devEUI.u == eui.u;
+        }
+    ))
+        return ERR_CODE_DEVICE_EUI_NOT_FOUND;
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::put(
+    const DEVADDR &devAddr,
+    const DEVICEID &id
+)
+{
+    storage.put(devAddr, id);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::rm(
+    const DEVADDR &addr
+)
+{
+    if (!storage.rm(addr))
+        return ERR_CODE_DEVICE_ADDRESS_NOTFOUND;
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::init(
+    const std::string &,
+    void *
+)
+{
+    return CODE_OK;
+}
+
+void ConcurrentMemoryIdentityService::flush()
+{
+}
+
+void ConcurrentMemoryIdentityService::done()
+{
+    storage.clear();
+}
+
+/**
+ * Return next network address if available
+ * @return 0- success, ERR_CODE_ADDR_SPACE_FULL- no address available
+ */
+int ConcurrentMemoryIdentityService::next(
+    NETWORKIDENTITY &
+)
+{
+    return ERR_CODE_ADDR_SPACE_FULL;
+}
+
+void ConcurrentMemoryIdentityService::setOption(
+    int,
+    void *
+)
+{
+    // nothing to do
+}
+
+int ConcurrentMemoryIdentityService::filter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    storage.forEach(offset, size,
+        [&filters](const DEVADDR &addr, const DEVICEID &id) {
+            return isIdentityFilteredV2(addr, id.id, filters);
+        },
+        [&retVal](const DEVADDR &addr, const DEVICEID &id) {
+            retVal.emplace_back(addr, id);
+        }
+    );
+    return CODE_OK;
+}
+
+// ------------------- asynchronous imitation -------------------
+int ConcurrentMemoryIdentityService::cGet(const DEVADDR &request)
+{
+    IdentityGetResponse r;
+    r.response.value.devaddr = request;
+    get(r.response.value.devid, request);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::cGetNetworkIdentity(const DEVEUI &eui)
+{
+    IdentityGetResponse r;
+    getNetworkIdentity(r.response, eui);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::cPut(const DEVADDR &devAddr, const DEVICEID &id)
+{
+    IdentityOperationResponse r;
+    r.response = put(devAddr, id);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::cRm(const DEVADDR &devAddr)
+{
+    IdentityOperationResponse r;
+    r.response = rm(devAddr);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::cList(
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = list(r.identities, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::cFilter(
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = filter(r.identities, filters, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::cSize()
+{
+    IdentityOperationResponse r;
+    r.response = (uint32_t) size();
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int ConcurrentMemoryIdentityService::cNext()
+{
+    IdentityGetResponse r;
+    next(r.response);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
@@ -0,0 +1,62 @@
+#ifndef IDENTITY_SERVICE_MEM_CONCURRENT_H_
+#define IDENTITY_SERVICE_MEM_CONCURRENT_H_ 1
+
+#include "lorawan/storage/service/identity-service.h"
+#include "lorawan/storage/service/sharded-map.h"
+
+class DevAddrHash {
+public:
+    uint32_t operator()(const DEVADDR &value) const;
+};
+
+/**
+ * In-memory identity service safe to share between listener threads and workers.
+ * Entries are split into buckets by address hash, each bucket has own readers-writer lock.
+ * size() returns atomic count, list and filter return entries in address order as MemoryIdentityService does.
+ */
+class ConcurrentMemoryIdentityService: public IdentityService {
+protected:
+    ShardedMap<DEVADDR, DEVICEID, DevAddrHash> storage;
+public:
+    explicit ConcurrentMemoryIdentityService(
+        size_t shardCount = DEF_SHARDED_MAP_SHARDS
+    );
+    ~ConcurrentMemoryIdentityService() override;
+
+    // synchronous
+    int get(DEVICEID &retVal, const DEVADDR &request) override;
+    int getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) override;
+    int put(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int rm(const DEVADDR &devAddr) override;
+    int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
+    size_t size() override;
+    int next(NETWORKIDENTITY &retVal) override;
+    // asynchronous imitation
+    int cGet(const DEVADDR &request) override;
+    int cGetNetworkIdentity(const DEVEUI &eui) override;
+    int cPut(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int cRm(const DEVADDR &devAddr) override;
+    int cList(uint32_t offset, uint8_t size) override;
+    int cSize() override;
+    int cNext() override;
+
+    int filter(
+        std::vector<NETWORKIDENTITY> &retVal,
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int cFilter(
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+
+    int init(const std::string &dbName, void *db) override;
+    void flush() override;
+    void done() override;
+    void setOption(int option, void *value) override;
+};
+
+#endif
@@ -11,7 +11,10 @@
 #include "platform-defs.h"
 #endif
 
-MemoryIdentityService::MemoryIdentityService() = default;
+MemoryIdentityService::MemoryIdentityService()
+    : multiCandidate(false)
+{
+}
 
 MemoryIdentityService::~MemoryIdentityService() = default;
 
@@ -34,6 +37,24 @@ int MemoryIdentityService::get(
     return CODE_OK;
 }
 
+/**
+ * Last device put for the address goes first
+ */
+int MemoryIdentityService::getCandidates(
+    std::vector<DEVICEID> &retVal,
+    const DEVADDR &devAddr
+)
+{
+    auto r = storage.find(devAddr);
+    if (r == storage.end())
+        return ERR_CODE_DEVICE_ADDRESS_NOTFOUND;
+    retVal.push_back(r->second);
+    auto c = collisions.find(devAddr);
+    if (c != collisions.end())
+        retVal.insert(retVal.end(), c->second.begin(), c->second.end());
+    return CODE_OK;
+}
+
 // List entries
 int MemoryIdentityService::list(
     std::vector<NETWORKIDENTITY> &retVal,
@@ -56,6 +77,19 @@ int MemoryIdentityService::list(
     return CODE_OK;
 }
 
+int MemoryIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+) {
+    size_t sz = 0;
+    for (auto it = after ? storage.upper_bound(*after) : storage.begin(); it != storage.end() && sz < size; it++) {
+        retVal.emplace_back(it->first, it->second);
+        sz++;
+    }
+    return CODE_OK;
+}
+
 // Entries count
 size_t MemoryIdentityService::size()
 {
@@ -93,6 +127,19 @@ int MemoryIdentityService::put(
     const DEVICEID &id
 )
 {
+    if (multiCandidate) {
+        auto r = storage.find(devAddr);
+        if (r != storage.end() && r->second.id.devEUI.u != id.id.devEUI.u) {
+            std::vector<DEVICEID> &c = collisions[devAddr];
+            for (auto it = c.begin(); it != c.end(); ) {
+                if (it->id.devEUI.u == id.id.devEUI.u || it->id.devEUI.u == r->second.id.devEUI.u)
+                    it = c.erase(it);
+                else
+                    it++;
+            }
+            c.push_back(r->second);
+        }
+    }
     storage[devAddr] = id;
     return CODE_OK;
 }
@@ -105,6 +152,7 @@ int MemoryIdentityService::rm(
     auto r = storage.find(addr);
     if (r != storage.end()) {
         storage.erase(r);
+        collisions.erase(addr);
         return CODE_OK;
     }
     return ERR_CODE_DEVICE_ADDRESS_NOTFOUND;
@@ -125,6 +173,7 @@ void MemoryIdentityService::flush()
 void MemoryIdentityService::done()
 {
     storage.clear();
+    collisions.clear();
 }
 
 /**
@@ -144,7 +193,11 @@ void MemoryIdentityService::setOption(
 )
 
 {
-    // nothing to do
+    if (option == IDENTITY_OPTION_MULTI_CANDIDATE && value) {
+        multiCandidate = *(int32_t *) value != 0;
+        if (!multiCandidate)
+            collisions.clear();
+    }
 }
 
 EXPORT_SHARED_C_FUNC IdentityService* makeMemoryIdentityService()
@@ -7,16 +7,21 @@
 class MemoryIdentityService: public IdentityService {
 protected:
     std::map<DEVADDR, DEVICEID> storage;
+    // multi-candidate mode: devices replaced in the storage by the last one put for the same address
+    std::map<DEVADDR, std::vector<DEVICEID> > collisions;
+    bool multiCandidate;
 public:
     MemoryIdentityService();
     ~MemoryIdentityService() override;
 
     // synchronous
     int get(DEVICEID &retVal, const DEVADDR &request) override;
+    int getCandidates(std::vector<DEVICEID> &retVal, const DEVADDR &devAddr) override;
     int getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) override;
     int put(const DEVADDR &devAddr, const DEVICEID &id) override;
     int rm(const DEVADDR &devAddr) override;
     int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
     size_t size() override;
     int next(NETWORKIDENTITY &retVal) override;
     // asynchronous imitation
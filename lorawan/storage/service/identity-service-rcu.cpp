@@ -0,0 +1,544 @@
+#include <algorithm>
+#include <climits>
+#include <thread>
+
+#include "lorawan/storage/service/identity-service-rcu.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+size_t RcuTable::find(
+    const DEVADDR &addr
+) const
+{
+    auto it = std::lower_bound(addrs.begin(), addrs.end(), addr);
+    if (it == addrs.end() || !(*it == addr))
+        return addrs.size();
+    return (size_t) (it - addrs.begin());
+}
+
+size_t RcuTable::findEUI(
+    const DEVEUI &eui
+) const
+{
+    auto it = std::lower_bound(byEUI.begin(), byEUI.end(), eui.u,
+        [this](uint32_t index, uint64_t value) {
+            return ids[index].id.devEUI.u < value;
+        }
+    );
+    if (it == byEUI.end() || ids[*it].id.devEUI.u != eui.u)
+        return byEUI.size();
+    return (size_t) (it - byEUI.begin());
+}
+
+RcuSnapshot::RcuSnapshot()
+    : table(std::make_shared<RcuTable>()), count(0)
+{
+}
+
+bool RcuSnapshot::get(
+    DEVICEID &retVal,
+    const DEVADDR &addr
+) const
+{
+    auto d = delta.find(addr);
+    if (d != delta.end()) {
+        if (d->second.first)
+            retVal = d->second.second;
+        return d->second.first;
+    }
+    size_t i = table->find(addr);
+    if (i >= table->addrs.size())
+        return false;
+    retVal = table->ids[i];
+    return true;
+}
+
+bool RcuSnapshot::getNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const DEVEUI &eui
+) const
+{
+    bool found = false;
+    // table entries with the EUI are in address order, the first one not changed in the delta
+    for (size_t p = table->findEUI(eui); p < table->byEUI.size(); p++) {
+        uint32_t i = table->byEUI[p];
+        if (table->ids[i].id.devEUI.u != eui.u)
+            break;
+        if (delta.find(table->addrs[i]) != delta.end())
+            continue;
+        retVal.value.devaddr = table->addrs[i];
+        retVal.value.devid = table->ids[i];
+        found = true;
+        break;
+    }
+    for (auto &d : delta) {
+        if (found && !(d.first < retVal.value.devaddr))
+            break;
+        if (d.second.first && d.second.second.id.devEUI.u == eui.u) {
+            retVal.value.devaddr = d.first;
+            retVal.value.devid = d.second.second;
+            found = true;
+            break;
+        }
+    }
+    return found;
+}
+
+template <class F>
+void RcuSnapshot::forEach(
+    const DEVADDR *after,
+    F f
+) const
+{
+    const std::vector<DEVADDR> &addrs = table->addrs;
+    size_t i = after ? std::upper_bound(addrs.begin(), addrs.end(), *after) - addrs.begin() : 0;
+    auto d = after ? delta.upper_bound(*after) : delta.begin();
+    // merge sorted table and sorted changes
+    while (i < addrs.size() || d != delta.end()) {
+        if (d == delta.end() || (i < addrs.size() && addrs[i] < d->first)) {
+            if (!f(addrs[i], table->ids[i]))
+                return;
+            i++;
+            continue;
+        }
+        if (i < addrs.size() && addrs[i] == d->first)
+            i++;    // replaced or removed
+        if (d->second.first && !f(d->first, d->second.second))
+            return;
+        d++;
+    }
+}
+
+RcuIdentityService::ReaderStripe::ReaderStripe()
+    : padding{}
+{
+    count[0] = 0;
+    count[1] = 0;
+}
+
+RcuIdentityService::RcuIdentityService()
+    : current(new RcuSnapshot), epoch(0), batchSize(DEF_RCU_BATCH_SIZE), published(0), merged(0), reclaimed(0)
+{
+}
+
+RcuIdentityService::~RcuIdentityService()
+{
+    // no readers left
+    for (auto &r : retired) {
+        delete r.first;
+    }
+    delete current.load();
+}
+
+/**
+ * Each thread counts itself in one stripe
+ */
+static size_t threadStripe()
+{
+    static std::atomic<size_t> threads(0);
+    static thread_local size_t stripe = threads++ % RCU_READER_STRIPES;
+    return stripe;
+}
+
+const RcuSnapshot *RcuIdentityService::enter(
+    uint32_t &parity
+)
+{
+    parity = epoch.load() & 1;
+    stripes[threadStripe()].count[parity]++;
+    return current.load();
+}
+
+void RcuIdentityService::leave(
+    uint32_t parity
+)
+{
+    stripes[threadStripe()].count[parity]--;
+}
+
+void RcuIdentityService::reclaim()
+{
+    // readers which read the epoch before the last flip count in the parity the next flip gives to the new readers
+    uint32_t e = epoch.load();
+    uint32_t next = (e + 1) & 1;
+    bool drained = true;
+    for (auto &s : stripes) {
+        if (s.count[next].load() != 0) {
+            drained = false;
+            break;
+        }
+    }
+    if (drained)
+        e = ++epoch;
+    // flips E + 1 and E + 2 both found the parity drained after the replacement, no reader holds the snapshot
+    size_t kept = 0;
+    for (auto &r : retired) {
+        if (e - r.second >= 2) {
+            delete r.first;
+            reclaimed++;
+        } else
+            retired[kept++] = r;
+    }
+    retired.resize(kept);
+}
+
+void RcuIdentityService::synchronize()
+{
+    while (true) {
+        reclaim();
+        if (retired.empty())
+            break;
+        std::this_thread::yield();
+    }
+}
+
+void RcuIdentityService::replace(
+    const RcuSnapshot *snapshot
+)
+{
+    const RcuSnapshot *old = current.load();
+    current.store(snapshot);
+    retired.emplace_back(old, epoch.load());
+    published++;
+    reclaim();
+}
+
+void RcuIdentityService::change(
+    const DEVADDR &addr,
+    bool put,
+    const DEVICEID &id
+)
+{
+    const RcuSnapshot *old = current.load();
+    DEVICEID previous;
+    bool existed = old->get(previous, addr);
+    auto s = new RcuSnapshot;
+    s->table = old->table;
+    s->delta = old->delta;
+    s->delta[addr] = std::make_pair(put, id);
+    s->count = old->count;
+    if (put && !existed)
+        s->count++;
+    if (!put && existed)
+        s->count--;
+    replace(s);
+    if (s->delta.size() >= batchSize)
+        merge();
+}
+
+void RcuIdentityService::merge()
+{
+    const RcuSnapshot *old = current.load();
+    if (old->delta.empty())
+        return;
+    const RcuTable &t = *old->table;
+    auto table = std::make_shared<RcuTable>();
+    table->addrs.reserve(t.addrs.size() + old->delta.size());
+    table->ids.reserve(t.ids.size() + old->delta.size());
+    // merge sorted table and sorted changes
+    const uint32_t removed = UINT32_MAX;
+    std::vector<uint32_t> moved(t.addrs.size(), removed);     ///< old index -> new index
+    std::vector<uint32_t> added;                                ///< new indexes of the changes
+    size_t i = 0;
+    auto c = old->delta.begin();
+    while (i < t.addrs.size() || c != old->delta.end()) {
+        if (c == old->delta.end() || (i < t.addrs.size() && t.addrs[i] < c->first)) {
+            moved[i] = (uint32_t) table->addrs.size();
+            table->addrs.push_back(t.addrs[i]);
+            table->ids.push_back(t.ids[i]);
+            i++;
+            continue;
+        }
+        if (i < t.addrs.size() && t.addrs[i] == c->first)
+            i++;    // replaced or removed
+        if (c->second.first) {
+            added.push_back((uint32_t) table->addrs.size());
+            table->addrs.push_back(c->first);
+            table->ids.push_back(c->second.second);
+        }
+        c++;
+    }
+    // EUI index: merge the old index and sorted changes, indexes are in address order
+    const RcuTable *n = table.get();
+    auto euiLess = [n](uint32_t a, uint32_t b) {
+        if (n->ids[a].id.devEUI.u != n->ids[b].id.devEUI.u)
+            return n->ids[a].id.devEUI.u < n->ids[b].id.devEUI.u;
+        return a < b;
+    };
+    std::sort(added.begin(), added.end(), euiLess);
+    std::vector<uint32_t> kept;
+    kept.reserve(table->addrs.size());
+    for (auto k : t.byEUI) {
+        if (moved[k] != removed)
+            kept.push_back(moved[k]);
+    }
+    table->byEUI.resize(table->addrs.size());
+    std::merge(kept.begin(), kept.end(), added.begin(), added.end(), table->byEUI.begin(), euiLess);
+    auto s = new RcuSnapshot;
+    s->table = table;
+    s->count = table->addrs.size();
+    merged++;
+    replace(s);
+}
+
+void RcuIdentityService::publish()
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    merge();
+}
+
+int RcuIdentityService::get(
+    DEVICEID &retVal,
+    const DEVADDR &request
+)
+{
+    uint32_t parity;
+    const RcuSnapshot *s = enter(parity);
+    bool found = s->get(retVal, request);
+    leave(parity);
+    return found ? CODE_OK : ERR_CODE_DEVICE_ADDRESS_NOTFOUND;
+}
+
+int RcuIdentityService::getNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const DEVEUI &eui
+)
+{
+    uint32_t parity;
+    const RcuSnapshot *s = enter(parity);
+    bool found = s->getNetworkIdentity(retVal, eui);
+    leave(parity);
+    return found ? CODE_OK : ERR_CODE_DEVICE_EUI_NOT_FOUND;
+}
+
+int RcuIdentityService::put(
+    const DEVADDR &devAddr,
+    const DEVICEID &id
+)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    change(devAddr, true, id);
+    return CODE_OK;
+}
+
+int RcuIdentityService::rm(
+    const DEVADDR &addr
+)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    // snapshot is replaced by the writers only
+    DEVICEID id;
+    if (!current.load()->get(id, addr))
+        return ERR_CODE_DEVICE_ADDRESS_NOTFOUND;
+    change(addr, false, DEVICEID());
+    return CODE_OK;
+}
+
+int RcuIdentityService::list(
+    std::vector<NETWORKIDENTITY> &retVal,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    if (size == 0)
+        return CODE_OK;
+    uint32_t parity;
+    const RcuSnapshot *s = enter(parity);
+    uint32_t skipped = 0;
+    size_t sz = 0;
+    s->forEach(nullptr, [&](const DEVADDR &addr, const DEVICEID &id) {
+        if (skipped < offset) {
+            skipped++;
+            return true;
+        }
+        retVal.emplace_back(addr, id);
+        return ++sz < size;
+    });
+    leave(parity);
+    return CODE_OK;
+}
+
+int RcuIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+)
+{
+    if (size == 0)
+        return CODE_OK;
+    uint32_t parity;
+    const RcuSnapshot *s = enter(parity);
+    size_t sz = 0;
+    s->forEach(after, [&](const DEVADDR &addr, const DEVICEID &id) {
+        retVal.emplace_back(addr, id);
+        return ++sz < size;
+    });
+    leave(parity);
+    return CODE_OK;
+}
+
+int RcuIdentityService::filter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    if (size == 0)
+        return CODE_OK;
+    uint32_t parity;
+    const RcuSnapshot *s = enter(parity);
+    uint32_t skipped = 0;
+    size_t sz = 0;
+    s->forEach(nullptr, [&](const DEVADDR &addr, const DEVICEID &id) {
+        if (!isIdentityFilteredV2(addr, id.id, filters))
+            return true;
+        if (skipped < offset) {
+            // skip first
+            skipped++;
+            return true;
+        }
+        retVal.emplace_back(addr, id);
+        return ++sz < size;
+    });
+    leave(parity);
+    return CODE_OK;
+}
+
+size_t RcuIdentityService::size()
+{
+    uint32_t parity;
+    const RcuSnapshot *s = enter(parity);
+    size_t r = s->count;
+    leave(parity);
+    return r;
+}
+
+/**
+ * Return next network address if available
+ * @return 0- success, ERR_CODE_ADDR_SPACE_FULL- no address available
+ */
+int RcuIdentityService::next(
+    NETWORKIDENTITY &
+)
+{
+    return ERR_CODE_ADDR_SPACE_FULL;
+}
+
+int RcuIdentityService::init(
+    const std::string &,
+    void *
+)
+{
+    return CODE_OK;
+}
+
+void RcuIdentityService::flush()
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    merge();
+    synchronize();
+}
+
+void RcuIdentityService::done()
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    replace(new RcuSnapshot);
+    synchronize();
+}
+
+void RcuIdentityService::setOption(
+    int option,
+    void *value
+)
+{
+    if (option == IDENTITY_OPTION_BATCH_SIZE && value) {
+        std::lock_guard<std::mutex> guard(writeLock);
+        batchSize = *(size_t *) value;
+        if (!batchSize)
+            batchSize = 1;
+    }
+}
+
+// ------------------- asynchronous imitation -------------------
+int RcuIdentityService::cGet(const DEVADDR &request)
+{
+    IdentityGetResponse r;
+    r.response.value.devaddr = request;
+    get(r.response.value.devid, request);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int RcuIdentityService::cGetNetworkIdentity(const DEVEUI &eui)
+{
+    IdentityGetResponse r;
+    getNetworkIdentity(r.response, eui);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int RcuIdentityService::cPut(const DEVADDR &devAddr, const DEVICEID &id)
+{
+    IdentityOperationResponse r;
+    r.response = put(devAddr, id);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int RcuIdentityService::cRm(const DEVADDR &devAddr)
+{
+    IdentityOperationResponse r;
+    r.response = rm(devAddr);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int RcuIdentityService::cList(
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = list(r.identities, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int RcuIdentityService::cFilter(
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = filter(r.identities, filters, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int RcuIdentityService::cSize()
+{
+    IdentityOperationResponse r;
+    r.response = (uint32_t) size();
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int RcuIdentityService::cNext()
+{
+    IdentityGetResponse r;
+    next(r.response);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
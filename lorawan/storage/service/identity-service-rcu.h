@@ -0,0 +1,162 @@
+#ifndef IDENTITY_SERVICE_RCU_H_
+#define IDENTITY_SERVICE_RCU_H_ 1
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "lorawan/storage/service/identity-service.h"
+
+// reader counters are striped over the threads to keep them on different cache lines
+#define RCU_READER_STRIPES      64
+// changes kept in the snapshot delta before they are merged into the sorted table
+#define DEF_RCU_BATCH_SIZE      64
+
+/**
+ * Immutable sorted identity table. Addresses are kept apart from the identifiers, lookup is a binary search
+ * over the contiguous array of 4-byte keys.
+ */
+class RcuTable {
+public:
+    std::vector<DEVADDR> addrs;     ///< sorted
+    std::vector<DEVICEID> ids;      ///< ids[i] belongs to addrs[i]
+    std::vector<uint32_t> byEUI;    ///< indexes sorted by EUI, then by address
+    /**
+     * @return index of the address, addrs.size() if not found
+     */
+    size_t find(const DEVADDR &addr) const;
+    /**
+     * @return position in byEUI of the first entry with EUI, byEUI.size() if not found
+     */
+    size_t findEUI(const DEVEUI &eui) const;
+};
+
+/**
+ * Immutable published state: sorted table shared by the snapshots and the changes not merged into it yet
+ */
+class RcuSnapshot {
+public:
+    std::shared_ptr<const RcuTable> table;
+    std::map<DEVADDR, std::pair<bool, DEVICEID> > delta;    ///< changes: false- removed, true- put
+    size_t count;                                           ///< entries
+    RcuSnapshot();
+    bool get(DEVICEID &retVal, const DEVADDR &addr) const;
+    /**
+     * Find entry with the least address of the devices with EUI
+     */
+    bool getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) const;
+    /**
+     * Call f(addr, id) in address order while it returns true
+     * @param after start after the address, NULL- from the first one
+     */
+    template <class F>
+    void forEach(const DEVADDR *after, F f) const;
+};
+
+/**
+ * Read-copy-update identity service for read-mostly tables.
+ * Readers load the current snapshot by one atomic pointer load without locks, writers never block them.
+ * Each write publishes a new snapshot with the change in the delta, when batchSize changes are in the delta
+ * (or on flush()) the delta is merged into the new sorted table.
+ * Replaced snapshot is deleted after all readers which could see it are finished:
+ * reader counts itself in the reader counter of the current epoch parity. Writer flips the epoch
+ * when no reader counts in the parity the new readers get, snapshot replaced at epoch E is deleted at E + 2.
+ * Writer does not wait for the readers, flush() and done() do.
+ */
+class RcuIdentityService: public IdentityService {
+private:
+    class ReaderStripe {
+    public:
+        std::atomic<uint32_t> count[2];
+        char padding[64 - 2 * sizeof(std::atomic<uint32_t>)];
+        ReaderStripe();
+    };
+    std::atomic<const RcuSnapshot *> current;
+    std::atomic<uint32_t> epoch;
+    ReaderStripe stripes[RCU_READER_STRIPES];
+    std::mutex writeLock;
+    std::vector<std::pair<const RcuSnapshot *, uint32_t> > retired;    ///< replaced snapshots and the epoch of the replacement
+
+    const RcuSnapshot *enter(uint32_t &parity);
+    void leave(uint32_t parity);
+    /**
+     * Flip epoch if it is possible, delete replaced snapshots no reader can see. Never waits.
+     * Call with write lock held.
+     */
+    void reclaim();
+    /**
+     * Wait until readers of the replaced snapshots are finished and delete them. Call with write lock held.
+     */
+    void synchronize();
+    /**
+     * Publish snapshot, replaced one is deleted later. Call with write lock held.
+     */
+    void replace(const RcuSnapshot *snapshot);
+    /**
+     * Publish snapshot with the change in the delta. Call with write lock held.
+     */
+    void change(const DEVADDR &addr, bool put, const DEVICEID &id);
+    /**
+     * Merge delta into the new sorted table and publish it. Call with write lock held.
+     */
+    void merge();
+public:
+    size_t batchSize;               ///< changes kept in the delta
+    // counters
+    uint64_t published;             ///< snapshots published
+    uint64_t merged;                ///< sorted tables built
+    uint64_t reclaimed;             ///< replaced snapshots deleted
+
+    RcuIdentityService();
+    ~RcuIdentityService() override;
+
+    /**
+     * Merge changes into the sorted table now
+     */
+    void publish();
+
+    // synchronous
+    int get(DEVICEID &retVal, const DEVADDR &request) override;
+    int getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) override;
+    int put(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int rm(const DEVADDR &devAddr) override;
+    int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
+    size_t size() override;
+    int next(NETWORKIDENTITY &retVal) override;
+    // asynchronous imitation
+    int cGet(const DEVADDR &request) override;
+    int cGetNetworkIdentity(const DEVEUI &eui) override;
+    int cPut(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int cRm(const DEVADDR &devAddr) override;
+    int cList(uint32_t offset, uint8_t size) override;
+    int cSize() override;
+    int cNext() override;
+
+    int filter(
+        std::vector<NETWORKIDENTITY> &retVal,
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int cFilter(
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+
+    int init(const std::string &dbName, void *db) override;
+    /**
+     * Merge changes into the sorted table, delete replaced snapshots
+     */
+    void flush() override;
+    void done() override;
+    /**
+     * IDENTITY_OPTION_BATCH_SIZE (size_t)- changes kept in the delta
+     */
+    void setOption(int option, void *value) override;
+};
+
+#endif
@@ -0,0 +1,540 @@
+#include "lorawan/storage/service/identity-service-sharded.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/service/identity-service-udp.h"
+
+// list request size is uint8_t
+#define MAX_PAGE_ENTRIES    255
+
+/**
+ * Murmur3 finalizer, spreads sequential addresses over the ring
+ */
+static uint32_t mix32(
+    uint32_t h
+)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * FNV-1a
+ */
+static uint32_t hashString(
+    const std::string &value
+)
+{
+    uint32_t h = 2166136261u;
+    for (auto c : value) {
+        h ^= (uint8_t) c;
+        h *= 16777619u;
+    }
+    return mix32(h);
+}
+
+ShardedIdentityService::ShardedIdentityService()
+    : code(0), accessCode(0), cursorOffset(0), cursorFiltered(false), virtualNodes(DEF_SHARD_VIRTUAL_NODES)
+{
+}
+
+ShardedIdentityService::~ShardedIdentityService()
+{
+    done();
+}
+
+void ShardedIdentityService::addPoints(
+    size_t index
+)
+{
+    for (size_t i = 0; i < virtualNodes; i++) {
+        std::stringstream ss;
+        ss << shards[index].name << '#' << i;
+        // on collision the lesser name wins, ring does not depend on the order shards are added
+        auto h = hashString(ss.str());
+        auto it = ring.find(h);
+        if (it == ring.end() || shards[it->second].name > shards[index].name)
+            ring[h] = index;
+    }
+}
+
+size_t ShardedIdentityService::addShard(
+    const std::string &name,
+    IdentityService *svc,
+    bool owned
+)
+{
+    Shard s;
+    s.name = name;
+    s.svc = svc;
+    s.owned = owned;
+    shards.push_back(s);
+    addPoints(shards.size() - 1);
+    cursors.clear();
+    return shards.size() - 1;
+}
+
+size_t ShardedIdentityService::shardOf(
+    const DEVADDR &addr
+) const
+{
+    if (ring.empty())
+        return shards.size();
+    auto it = ring.lower_bound(mix32(addr.u));
+    if (it == ring.end())
+        it = ring.begin();
+    return it->second;
+}
+
+size_t ShardedIdentityService::shardCount() const
+{
+    return shards.size();
+}
+
+IdentityService *ShardedIdentityService::shard(
+    size_t index
+) const
+{
+    return index < shards.size() ? shards[index].svc : nullptr;
+}
+
+/**
+ * Shard is read in pages by address, moved entries precede the next page and do not shift it
+ */
+int ShardedIdentityService::reshard()
+{
+    int moved = 0;
+    for (size_t i = 0; i < shards.size(); i++) {
+        DEVADDR last;
+        const DEVADDR *after = nullptr;
+        while (true) {
+            std::vector<NETWORKIDENTITY> entries;
+            int r = shards[i].svc->listAfter(entries, after, MAX_PAGE_ENTRIES);
+            if (r < 0)
+                return r;
+            for (auto &e : entries) {
+                size_t owner = shardOf(e.value.devaddr);
+                if (owner == i)
+                    continue;
+                // copy first, entry is never lost if the source is unavailable
+                r = shards[owner].svc->put(e.value.devaddr, e.value.devid);
+                if (r < 0)
+                    return r;
+                shards[i].svc->rm(e.value.devaddr);
+                if (e.value.devid.id.devEUI.u)
+                    routes[e.value.devid.id.devEUI.u] = owner;
+                moved++;
+            }
+            if (entries.size() < MAX_PAGE_ENTRIES)
+                break;
+            last.u = entries.back().value.devaddr.u;
+            after = &last;
+        }
+    }
+    cursors.clear();
+    return moved;
+}
+
+int ShardedIdentityService::get(
+    DEVICEID &retVal,
+    const DEVADDR &request
+)
+{
+    size_t s = shardOf(request);
+    if (s >= shards.size())
+        return ERR_CODE_PARAM_INVALID;
+    return shards[s].svc->get(retVal, request);
+}
+
+int ShardedIdentityService::getCandidates(
+    std::vector<DEVICEID> &retVal,
+    const DEVADDR &devAddr
+)
+{
+    size_t s = shardOf(devAddr);
+    if (s >= shards.size())
+        return ERR_CODE_PARAM_INVALID;
+    return shards[s].svc->getCandidates(retVal, devAddr);
+}
+
+/**
+ * Entries are placed by address, EUI goes to the shard it was seen on, then to each other shard
+ */
+int ShardedIdentityService::getNetworkIdentity(
+    NETWORKIDENTITY &retVal,
+    const DEVEUI &eui
+)
+{
+    if (shards.empty())
+        return ERR_CODE_PARAM_INVALID;
+    size_t routed = shards.size();
+    auto it = routes.find(eui.u);
+    if (it != routes.end() && it->second < shards.size()) {
+        routed = it->second;
+        if (shards[routed].svc->getNetworkIdentity(retVal, eui) == CODE_OK)
+            return CODE_OK;
+    }
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (i == routed)
+            continue;
+        if (shards[i].svc->getNetworkIdentity(retVal, eui) == CODE_OK) {
+            routes[eui.u] = i;
+            return CODE_OK;
+        }
+    }
+    if (it != routes.end())
+        routes.erase(it);
+    return ERR_CODE_DEVICE_EUI_NOT_FOUND;
+}
+
+int ShardedIdentityService::put(
+    const DEVADDR &devAddr,
+    const DEVICEID &id
+)
+{
+    size_t s = shardOf(devAddr);
+    if (s >= shards.size())
+        return ERR_CODE_PARAM_INVALID;
+    int r = shards[s].svc->put(devAddr, id);
+    if (r == CODE_OK && id.id.devEUI.u)
+        routes[id.id.devEUI.u] = s;
+    return r;
+}
+
+int ShardedIdentityService::rm(
+    const DEVADDR &devAddr
+)
+{
+    size_t s = shardOf(devAddr);
+    if (s >= shards.size())
+        return ERR_CODE_PARAM_INVALID;
+    return shards[s].svc->rm(devAddr);
+}
+
+/**
+ * @return true if the last list or filter stopped at the offset with the same filters, first page is read again
+ */
+bool ShardedIdentityService::isCursorAt(
+    const std::vector<NETWORK_IDENTITY_FILTER> *filters,
+    uint32_t offset
+) const
+{
+    if (offset == 0 || cursors.size() != shards.size() || cursorOffset != offset || cursorFiltered != (filters != nullptr))
+        return false;
+    if (!filters)
+        return true;
+    return filters->size() == cursorFilters.size()
+        && memcmp(filters->data(), cursorFilters.data(), filters->size() * sizeof(NETWORK_IDENTITY_FILTER)) == 0;
+}
+
+/**
+ * Each shard is read in address order by key (listAfter) in pages, the least head entry is taken next.
+ * Offset entries are skipped unless the previous call stopped at the offset, then merge continues from the
+ * shard cursors. Filters are applied to the merged entries.
+ */
+int ShardedIdentityService::merge(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const std::vector<NETWORK_IDENTITY_FILTER> *filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    if (size == 0)
+        return CODE_OK;
+    uint32_t skip = 0;
+    if (!isCursorAt(filters, offset)) {
+        cursors.resize(shards.size());
+        for (auto &c : cursors) {
+            c.started = false;
+        }
+        skip = offset;
+    }
+    for (auto &c : cursors) {
+        // entries read ahead may be changed, re-read them
+        c.exhausted = false;
+        c.page.clear();
+        c.position = 0;
+    }
+    size_t count = 0;
+    while (count < size) {
+        size_t best = cursors.size();
+        for (size_t i = 0; i < cursors.size(); i++) {
+            auto &c = cursors[i];
+            if (c.position >= c.page.size() && !c.exhausted) {
+                // filtered out entries are not known in advance, read full pages
+                auto n = (uint8_t) (filters ? MAX_PAGE_ENTRIES : std::min<size_t>(MAX_PAGE_ENTRIES, skip + size - count));
+                c.page.clear();
+                c.position = 0;
+                int r = shards[i].svc->listAfter(c.page, c.started ? &c.after : nullptr, n);
+                if (r < 0) {
+                    cursors.clear();
+                    return r;
+                }
+                c.exhausted = c.page.size() < n;
+            }
+            if (c.position < c.page.size()
+                && (best == cursors.size() || c.page[c.position].value.devaddr < cursors[best].page[cursors[best].position].value.devaddr))
+                best = i;
+        }
+        if (best == cursors.size())
+            break;
+        auto &c = cursors[best];
+        auto &e = c.page[c.position];
+        c.position++;
+        c.after.u = e.value.devaddr.u;
+        c.started = true;
+        if (filters && !isIdentityFilteredV2(e.value.devaddr, e.value.devid.id, *filters))
+            continue;
+        if (skip) {
+            skip--;
+            continue;
+        }
+        retVal.emplace_back(e);
+        count++;
+    }
+    cursorOffset = offset + (uint32_t) count;
+    cursorFiltered = filters != nullptr;
+    if (filters)
+        cursorFilters = *filters;
+    for (auto &c : cursors) {
+        c.page.clear();
+    }
+    return CODE_OK;
+}
+
+int ShardedIdentityService::list(
+    std::vector<NETWORKIDENTITY> &retVal,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    return merge(retVal, nullptr, offset, size);
+}
+
+/**
+ * Each shard returns first size entries after the address, they are merged
+ */
+int ShardedIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+)
+{
+    if (size == 0)
+        return CODE_OK;
+    std::vector<NETWORKIDENTITY> entries;
+    for (auto &s : shards) {
+        int r = s.svc->listAfter(entries, after, size);
+        if (r < 0)
+            return r;
+    }
+    auto last = entries.size() < size ? entries.end() : entries.begin() + size;
+    std::partial_sort(entries.begin(), last, entries.end(),
+        [](const NETWORKIDENTITY &a, const NETWORKIDENTITY &b) {
+            return a.value.devaddr < b.value.devaddr;
+        }
+    );
+    retVal.insert(retVal.end(), entries.begin(), last);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::filter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    return merge(retVal, &filters, offset, size);
+}
+
+size_t ShardedIdentityService::size()
+{
+    size_t r = 0;
+    for (auto &s : shards) {
+        r += s.svc->size();
+    }
+    return r;
+}
+
+/**
+ * Return next network address of the first shard having one that is not used on the shard owning it
+ * @return 0- success, ERR_CODE_ADDR_SPACE_FULL- no address available
+ */
+int ShardedIdentityService::next(
+    NETWORKIDENTITY &retVal
+)
+{
+    for (auto &s : shards) {
+        NETWORKIDENTITY candidate;
+        if (s.svc->next(candidate) != CODE_OK)
+            continue;
+        size_t owner = shardOf(candidate.value.devaddr);
+        if (owner < shards.size() && shards[owner].svc != s.svc) {
+            // address is free on the shard issued it, entry with this address is put to the owner
+            DEVICEID id;
+            if (shards[owner].svc->get(id, candidate.value.devaddr) == CODE_OK)
+                continue;
+        }
+        retVal.set(candidate);
+        return CODE_OK;
+    }
+    return ERR_CODE_ADDR_SPACE_FULL;
+}
+
+int ShardedIdentityService::init(
+    const std::string &option,
+    void *
+)
+{
+    std::stringstream ss(option);
+    std::string endpoint;
+    while (std::getline(ss, endpoint, ',')) {
+        if (endpoint.empty())
+            continue;
+        auto svc = new ClientUDPIdentityService;
+        svc->setOption(IDENTITY_OPTION_CODE, &code);
+        svc->setOption(IDENTITY_OPTION_ACCESS_CODE, &accessCode);
+        int r = svc->init(endpoint, nullptr);
+        if (r) {
+            delete svc;
+            return r;
+        }
+        addShard(endpoint, svc, true);
+    }
+    return CODE_OK;
+}
+
+void ShardedIdentityService::flush()
+{
+    for (auto &s : shards) {
+        s.svc->flush();
+    }
+}
+
+void ShardedIdentityService::done()
+{
+    for (auto &s : shards) {
+        if (s.owned) {
+            s.svc->done();
+            delete s.svc;
+        }
+    }
+    shards.clear();
+    ring.clear();
+    routes.clear();
+    cursors.clear();
+}
+
+void ShardedIdentityService::setOption(
+    int option,
+    void *value
+)
+{
+    if (!value)
+        return;
+    switch (option) {
+        case IDENTITY_OPTION_CODE:
+            code = *(int32_t *) value;
+            break;
+        case IDENTITY_OPTION_ACCESS_CODE:
+            accessCode = *(uint64_t *) value;
+            break;
+        default:
+            break;
+    }
+    for (auto &s : shards) {
+        s.svc->setOption(option, value);
+    }
+}
+
+// ------------------- asynchronous imitation -------------------
+int ShardedIdentityService::cGet(const DEVADDR &request)
+{
+    IdentityGetResponse r;
+    r.response.value.devaddr = request;
+    get(r.response.value.devid, request);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::cGetNetworkIdentity(const DEVEUI &eui)
+{
+    IdentityGetResponse r;
+    getNetworkIdentity(r.response, eui);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::cPut(const DEVADDR &devAddr, const DEVICEID &id)
+{
+    IdentityOperationResponse r;
+    r.response = put(devAddr, id);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::cRm(const DEVADDR &devAddr)
+{
+    IdentityOperationResponse r;
+    r.response = rm(devAddr);
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::cList(
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = list(r.identities, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::cFilter(
+    const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+    uint32_t offset,
+    uint8_t size
+)
+{
+    IdentityListResponse r;
+    r.response = filter(r.identities, filters, offset, size);
+    r.size = (uint8_t) r.identities.size();
+    if (responseClient)
+        responseClient->onIdentityList(nullptr, &r);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::cSize()
+{
+    IdentityOperationResponse r;
+    r.response = (uint32_t) size();
+    if (responseClient)
+        responseClient->onIdentityOperation(nullptr, &r);
+    return CODE_OK;
+}
+
+int ShardedIdentityService::cNext()
+{
+    IdentityGetResponse r;
+    next(r.response);
+    if (responseClient)
+        responseClient->onIdentityGet(nullptr, &r);
+    return CODE_OK;
+}
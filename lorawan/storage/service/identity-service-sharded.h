@@ -0,0 +1,140 @@
+#ifndef IDENTITY_SERVICE_SHARDED_H_
+#define IDENTITY_SERVICE_SHARDED_H_ 1
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "lorawan/storage/service/identity-service.h"
+
+// points of each shard on the hash ring
+#define DEF_SHARD_VIRTUAL_NODES 64
+
+/**
+ * Identity service distributed over several identity services (shards), usually remote storage services.
+ * Entry is placed on the shard owning hash of the network address on the consistent-hash ring,
+ * get, put and rm go to one shard.
+ * EUI lookup goes to the shard the EUI was put to or found on before, unknown EUI costs a request to each shard.
+ * List and filter read each shard by address (listAfter) and merge, next page continues from the shard cursors.
+ * Size is sent to all shards.
+ * Adding a shard moves only the entries which hash falls to the new shard.
+ * Not thread safe, as the UDP client shards are.
+ */
+class ShardedIdentityService: public IdentityService {
+private:
+    class Shard {
+    public:
+        std::string name;
+        IdentityService *svc;
+        bool owned;     ///< delete on done()
+    };
+    /**
+     * Merge position in the shard
+     */
+    class Cursor {
+    public:
+        DEVADDR after;          ///< last shard entry taken by the merge
+        bool started;           ///< false- read from the first entry
+        bool exhausted;         ///< shard has no entries after the page
+        std::vector<NETWORKIDENTITY> page;
+        size_t position;        ///< next page entry
+    };
+    std::vector<Shard> shards;
+    std::map<uint32_t, size_t> ring;   ///< point hash -> shard index
+    std::map<uint64_t, size_t> routes; ///< EUI -> shard index the entry was put to or found on
+    int32_t code;
+    uint64_t accessCode;
+    // last list or filter stopped here, request of the next page continues from the cursors
+    std::vector<Cursor> cursors;
+    uint32_t cursorOffset;
+    bool cursorFiltered;
+    std::vector<NETWORK_IDENTITY_FILTER> cursorFilters;
+
+    void addPoints(size_t index);
+    bool isCursorAt(
+        const std::vector<NETWORK_IDENTITY_FILTER> *filters,
+        uint32_t offset
+    ) const;
+    int merge(
+        std::vector<NETWORKIDENTITY> &retVal,
+        const std::vector<NETWORK_IDENTITY_FILTER> *filters,
+        uint32_t offset,
+        uint8_t size
+    );
+public:
+    size_t virtualNodes;
+
+    ShardedIdentityService();
+    ~ShardedIdentityService() override;
+
+    /**
+     * Add shard
+     * @param name unique shard name e.g. "10.0.0.1:4244", ring points depend on the name only
+     * @param svc initialized identity service
+     * @param owned true- delete service on done()
+     * @return index of the shard
+     */
+    size_t addShard(
+        const std::string &name,
+        IdentityService *svc,
+        bool owned = false
+    );
+    /**
+     * Move entries to the shards owning them after the shard is added
+     * @return count of moved entries, <0- error code
+     */
+    int reshard();
+    /**
+     * @return shard index owning network address, shard count if there is no shard
+     */
+    size_t shardOf(
+        const DEVADDR &addr
+    ) const;
+    size_t shardCount() const;
+    IdentityService *shard(size_t index) const;
+
+    // synchronous
+    int get(DEVICEID &retVal, const DEVADDR &request) override;
+    int getCandidates(std::vector<DEVICEID> &retVal, const DEVADDR &devAddr) override;
+    int getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) override;
+    int put(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int rm(const DEVADDR &devAddr) override;
+    int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
+    size_t size() override;
+    int next(NETWORKIDENTITY &retVal) override;
+    // asynchronous imitation
+    int cGet(const DEVADDR &request) override;
+    int cGetNetworkIdentity(const DEVEUI &eui) override;
+    int cPut(const DEVADDR &devAddr, const DEVICEID &id) override;
+    int cRm(const DEVADDR &devAddr) override;
+    int cList(uint32_t offset, uint8_t size) override;
+    int cSize() override;
+    int cNext() override;
+    int filter(
+        std::vector<NETWORKIDENTITY> &retVal,
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    int cFilter(
+        const std::vector<NETWORK_IDENTITY_FILTER> &filters,
+        uint32_t offset,
+        uint8_t size
+    ) override;
+    /**
+     * Connect to the storage services over UDP
+     * @param option comma separated list of "host:port", e.g. "127.0.0.1:4244,127.0.0.1:4245"
+     * @param data not used
+     * @return CODE_OK- success
+     */
+    int init(const std::string &option, void *data) override;
+    void flush() override;
+    void done() override;
+    /**
+     * IDENTITY_OPTION_CODE, IDENTITY_OPTION_ACCESS_CODE, passed to the shards
+     */
+    void setOption(int option, void *value) override;
+};
+
+#endif
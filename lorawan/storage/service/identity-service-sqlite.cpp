@@ -107,6 +107,39 @@ int SqliteIdentityService::list(
     return CODE_OK;
 }
 
+int SqliteIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+) {
+    if (!db)
+        return ERR_CODE_DB_DATABASE_NOT_FOUND;
+    char *zErrMsg = nullptr;
+    std::stringstream statement;
+    // primary key index, no offset scan
+    statement << "SELECT " FIELD_LIST " FROM device";
+    if (after)
+        statement << " WHERE addr > '" << DEVADDR2string(*after) << "'";
+    statement << " ORDER BY addr LIMIT " << (int) size;
+    std::vector<std::vector<std::string>> table;
+    int r = sqlite3_exec(db, statement.str().c_str(), tableCallback, &table, &zErrMsg);
+    if (r != SQLITE_OK) {
+        if (zErrMsg) {
+            sqlite3_free(zErrMsg);
+        }
+        return ERR_CODE_DB_SELECT;
+    }
+    for (auto row : table) {
+        if (row.size() < 2)
+            continue;
+        NETWORKIDENTITY ni;
+        row2DEVICEID(ni.value.devid, row);
+        ni.value.devaddr = row[0];
+        retVal.push_back(ni);
+    }
+    return CODE_OK;
+}
+
 // Entries count
 size_t SqliteIdentityService::size()
 {
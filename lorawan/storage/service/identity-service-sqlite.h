@@ -19,6 +19,7 @@ public:
     int put(const DEVADDR &devAddr, const DEVICEID &id) override;
     int rm(const DEVADDR &addr) override;
     int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
     size_t size() override;
     int next(NETWORKIDENTITY &retVal) override;
 
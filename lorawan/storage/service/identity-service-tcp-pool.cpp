@@ -0,0 +1,43 @@
+#include "lorawan/storage/service/identity-service-tcp-pool.h"
+
+#include <sstream>
+
+#include "lorawan/lorawan-error.h"
+
+ClientTCPPoolIdentityService::ClientTCPPoolIdentityService()
+    : ClientUDPIdentityService(), connections(DEF_POOL_CONNECTIONS)
+{
+}
+
+AsyncQueryClient *ClientTCPPoolIdentityService::newClient(
+    const std::string &addrPort
+)
+{
+    std::vector<std::string> endpoints;
+    std::stringstream ss(addrPort);
+    std::string endpoint;
+    while (std::getline(ss, endpoint, ',')) {
+        if (!endpoint.empty())
+            endpoints.push_back(endpoint);
+    }
+    if (endpoints.empty())
+        return nullptr;
+    auto r = new TCPPoolClient(endpoints, connections, collector);
+    if (r->process(0) == ERR_CODE_SOCKET_ADDRESS) {
+        delete r;
+        return nullptr;
+    }
+    return r;
+}
+
+void ClientTCPPoolIdentityService::setOption(
+    int option,
+    void *value
+)
+{
+    if (value && option == IDENTITY_OPTION_CONNECTIONS) {
+        connections = * (size_t *) value;
+        return;
+    }
+    ClientUDPIdentityService::setOption(option, value);
+}
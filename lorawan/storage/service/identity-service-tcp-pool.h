@@ -0,0 +1,26 @@
+#ifndef IDENTITY_SERVICE_TCP_POOL_H_
+#define IDENTITY_SERVICE_TCP_POOL_H_ 1
+
+#include "lorawan/storage/service/identity-service-udp.h"
+#include "lorawan/storage/client/tcp-pool-client.h"
+
+/**
+ * Identity service backed by the cluster of the storage services over the pool of TCP connections.
+ * init() address is comma separated list of "host:port", e.g. "10.0.0.1:4244,10.0.0.2:4244"
+ */
+class ClientTCPPoolIdentityService: public ClientUDPIdentityService {
+protected:
+    AsyncQueryClient *newClient(
+        const std::string &addrPort
+    ) override;
+public:
+    size_t connections; ///< connections per storage service
+
+    ClientTCPPoolIdentityService();
+    /**
+     * IDENTITY_OPTION_CODE, IDENTITY_OPTION_ACCESS_CODE, IDENTITY_OPTION_CONNECTIONS- connections per storage service (size_t)
+     */
+    void setOption(int option, void *value) override;
+};
+
+#endif
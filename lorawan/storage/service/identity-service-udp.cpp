@@ -1,33 +1,59 @@
-#include <iostream>
+#include "lorawan/storage/service/identity-service-udp.h"
+
+#include <algorithm>
 
+#include "lorawan/lorawan-error.h"
 #include "lorawan/helper/ip-address.h"
-#include "lorawan/storage/service/identity-service-udp.h"
-#include "lorawan/lorawan-string.h"
-#include "lorawan/helper/file-helper.h"
-#include "lorawan/storage/client/udp-client.h"
-#include "lorawan/storage/serialization/gateway-binary-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
 
 #ifdef ESP_PLATFORM
-#include <iostream>
 #include "platform-defs.h"
 #endif
 
+// poll interval while synchronous call waits for the reply
+#define SYNC_POLL_MILLIS    10
+// list reply of this many entries fits one batch frame datagram, longer lists are requested in pages
+#define UDP_LIST_PAGE       ((MAX_BATCH_FRAME_SIZE - SIZE_BATCH_HEADER - SIZE_BATCH_ITEM_HEADER - SIZE_OPERATION_RESPONSE) / SIZE_NETWORK_IDENTITY)
+
 /*
 IdentityQueryTag
 QUERY_IDENTITY_ADDR = 'a',
 QUERY_IDENTITY_EUI = 'i',
 QUERY_IDENTITY_LIST = 'l',
 QUERY_IDENTITY_COUNT = 'c',
+QUERY_IDENTITY_NEXT = 'n',
 QUERY_IDENTITY_ASSIGN = 'p',
 QUERY_IDENTITY_RM = 'r',
 QUERY_IDENTITY_FORCE_SAVE = 's',
 QUERY_IDENTITY_CLOSE_RESOURCES = 'e'
+QUERY_IDENTITY_FILTER = 'f'
 */
 
-class ResponseService : public ResponseClient {
+UDPServiceResult::UDPServiceResult()
+    : received(false), code(CODE_OK), response(0)
+{
+}
+
+/**
+ * Store replies to the synchronous calls, pass other replies to the service responseClient
+ */
+class UDPResultCollector : public ResponseClient {
+private:
+    /**
+     * @return result waiting for the reply, NULL if it is asynchronous call
+     */
+    UDPServiceResult *find(
+        uint32_t requestId
+    ) {
+        auto it = svc->results.find(requestId);
+        if (it == svc->results.end())
+            return nullptr;
+        return &it->second;
+    }
 public:
     ClientUDPIdentityService *svc;
-    explicit ResponseService(
+    explicit UDPResultCollector(
         ClientUDPIdentityService *aSvc
     )
         : svc(aSvc)
@@ -39,135 +65,167 @@ public:
         const int32_t code,
         const int errorCode
     ) override {
-        std::cerr << ERR_MESSAGE << code << ", errno: " << errorCode << "\n";
-        client->stop();
+        // failed request passes request identifier in errorCode
+        auto r = find((uint32_t) errorCode);
+        if (r) {
+            r->received = true;
+            r->code = code;
+            return;
+        }
         svc->retCode = code;
+        if (svc->responseClient)
+            svc->responseClient->onError(client, code, errorCode);
     }
 
     void onIdentityGet(
         QueryClient* client,
         const IdentityGetResponse *response
     ) override {
-        if (response) {
-            if (!response->response.value.devid.empty()) {
-                if (svc->verbose)
-                    std::cout << response->toJsonString() << std::endl;
-                else
-                    std::cout << response->response.toString() << std::endl;
-            }
+        auto r = find(response->requestId);
+        if (r) {
+            r->received = true;
+            r->identity.set(response->response);
+            return;
         }
+        if (svc->responseClient)
+            svc->responseClient->onIdentityGet(client, response);
     }
 
     void onIdentityOperation(
         QueryClient* client,
         const IdentityOperationResponse *response
     ) override {
-        if (response) {
-            if (svc->verbose) {
-                if (response->response != 0)
-                    std::cout << response->toJsonString() << std::endl;
-                else {
-                    std::cerr << identityTag2string((IdentityQueryTag) response->tag)
-                              // << " " << (int) response->size
-                              << " completed\n";
-                }
-            } else {
-                if (response->response != 0) {
-                    std::cerr << ERR_MESSAGE << response->response << std::endl;
-                }
-            }
+        auto r = find(response->requestId);
+        if (r) {
+            r->received = true;
+            r->response = response->response;
+            return;
         }
+        if (svc->responseClient)
+            svc->responseClient->onIdentityOperation(client, response);
     }
 
     void onIdentityList(
         QueryClient* client,
         const IdentityListResponse *response
     ) override {
-        if (response) {
-            if (svc->verbose) {
-                std::cout << response->toJsonString() << std::endl;
-            } else {
-                for (auto i = 0; i < response->response; i++) {
-                    std::cout << response->identities[i].toString() << std::endl;
-                }
-            }
+        auto r = find(response->requestId);
+        if (r) {
+            r->received = true;
+            r->response = response->response;
+            r->identities = response->identities;
+            return;
         }
+        if (svc->responseClient)
+            svc->responseClient->onIdentityList(client, response);
     }
 
     void onGatewayOperation(
-        QueryClient* client,
-        const GatewayOperationResponse *response
+        QueryClient*,
+        const GatewayOperationResponse *
     ) override {
-        if (response) {
-            if (svc->verbose) {
-                if (response->response != 0)
-                    std::cout << response->toJsonString() << std::endl;
-                else {
-                    std::cerr << gatewayTag2string((GatewayQueryTag) response->tag)
-                              // << " " << (int) response->size
-                              << " completed\n";
-                }
-            } else {
-                if (response->response != 0) {
-                    std::cerr << ERR_MESSAGE << response->response << std::endl;
-                }
-            }
-        }
+        // identity service does not receive gateway replies
     }
 
     void onGatewayGet(
-        QueryClient* client,
-        const GatewayGetResponse *response
+        QueryClient*,
+        const GatewayGetResponse *
     ) override {
-        if (response) {
-            if (svc->verbose)
-                std::cout << response->toJsonString() << std::endl;
-            else
-            if (isIP(&response->response.sockaddr) && response->response.gatewayId) {
-                std::cout
-                    << std::hex << response->response.gatewayId << "\t"
-                    << sockaddr2string(&response->response.sockaddr) << std::endl;
-            }
-        }
+        // identity service does not receive gateway replies
     }
 
     void onGatewayList(
-        QueryClient* client,
-        const GatewayListResponse *response
+        QueryClient*,
+        const GatewayListResponse *
     ) override {
-        if (response) {
-            if (svc->verbose) {
-                std::cout << response->toJsonString() << std::endl;
-            } else {
-                for (uint32_t i = 0; i < response->response; i++) {
-                    std::cout << std::hex << response->identities[i].gatewayId
-                        << "\t" << sockaddr2string(&response->identities[i].sockaddr)
-                        << std::endl;
-                }
-            }
-        }
+        // identity service does not receive gateway replies
     }
 
     void onDisconnected(
         QueryClient* client
     ) override {
-        if (svc->verbose) {
-            std::cerr << "disconnected \n";
-        }
+        if (svc->responseClient)
+            svc->responseClient->onDisconnected(client);
     }
 };
 
 ClientUDPIdentityService::ClientUDPIdentityService()
-    :  port(0), code(0), accessCode(0), client(nullptr), retCode(CODE_OK), verbose(0)
+    : collector(new UDPResultCollector(this)), port(0), code(0), accessCode(0), client(nullptr), verbose(0),
+    retCode(CODE_OK)
 {
 }
 
 ClientUDPIdentityService::~ClientUDPIdentityService()
 {
-    if (client) {
-        delete client;
-        client = nullptr;
+    done();
+    delete collector;
+}
+
+/**
+ * Send request of the synchronous call
+ * @param value request
+ * @return request identifier, 0- client is not initialized
+ */
+uint32_t ClientUDPIdentityService::requestSync(
+    ServiceMessage &value
+)
+{
+    if (!client)
+        return 0;
+    client->request(&value);
+    results[value.requestId];
+    return value.requestId;
+}
+
+/**
+ * Wait for the reply to the synchronous call.
+ * AsyncUDPClient retransmits request and reports ERR_CODE_TIMEOUT when retries are exhausted.
+ * @param retVal reply
+ * @param requestId request identifier returned by requestSync()
+ * @return CODE_OK or error code
+ */
+int ClientUDPIdentityService::wait(
+    UDPServiceResult &retVal,
+    uint32_t requestId
+)
+{
+    if (!requestId)
+        return retCode != CODE_OK ? retCode : ERR_CODE_SOCKET_ADDRESS;
+    auto it = results.find(requestId);
+    while (it != results.end() && !it->second.received) {
+        int r = client->process(SYNC_POLL_MILLIS);
+        if (r < 0) {
+            results.erase(requestId);
+            return r;
+        }
+        it = results.find(requestId);
     }
+    if (it == results.end())
+        return ERR_CODE_STOPPED;
+    UDPServiceResult &r = it->second;
+    retVal.received = r.received;
+    retVal.code = r.code;
+    retVal.response = r.response;
+    retVal.identity.set(r.identity);
+    retVal.identities.swap(r.identities);
+    results.erase(it);
+    return retVal.code;
+}
+
+/**
+ * Send request, replies are passed to the responseClient
+ * @param value request
+ * @return CODE_OK or error code
+ */
+int ClientUDPIdentityService::requestAsync(
+    ServiceMessage &value
+)
+{
+    if (!client)
+        return retCode != CODE_OK ? retCode : ERR_CODE_SOCKET_ADDRESS;
+    client->request(&value);
+    int r = client->process(0);
+    return r < 0 ? r : CODE_OK;
 }
 
 // synchronous calls
@@ -179,11 +237,17 @@ ClientUDPIdentityService::~ClientUDPIdentityService()
  */
 int ClientUDPIdentityService::get(
     DEVICEID &retVal,
-    const DEVADDR &addr
+    const DEVADDR &devAddr
 )
 {
-    IdentityAddrRequest req(QUERY_IDENTITY_EUI, addr, code, accessCode);
-    syncClient.request(&req);
+    IdentityAddrRequest req(QUERY_IDENTITY_EUI, devAddr, code, accessCode);
+    UDPServiceResult r;
+    int c = wait(r, requestSync(req));
+    if (c != CODE_OK)
+        return c;
+    if (r.identity.value.devid.empty())
+        return ERR_CODE_DEVICE_ADDRESS_NOTFOUND;
+    retVal = r.identity.value.devid;
     return CODE_OK;
 }
 
@@ -193,8 +257,86 @@ int ClientUDPIdentityService::list(
     uint32_t offset,
     uint8_t size
 ) {
-    IdentityOperationRequest req(QUERY_IDENTITY_LIST, offset, size, code, accessCode);
-    syncClient.request(&req);
+    // service shortens the list to fit the reply, short page means no more entries only if the page fits
+    while (size) {
+        auto n = (uint8_t) (size < UDP_LIST_PAGE ? size : UDP_LIST_PAGE);
+        IdentityOperationRequest req(QUERY_IDENTITY_LIST, offset, n, code, accessCode);
+        UDPServiceResult r;
+        int c = wait(r, requestSync(req));
+        if (c != CODE_OK)
+            return c;
+        retVal.insert(retVal.end(), r.identities.begin(), r.identities.end());
+        if (r.identities.size() < n)
+            break;
+        offset += n;
+        size -= n;
+    }
+    return CODE_OK;
+}
+
+int ClientUDPIdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+)
+{
+    if (size == 0)
+        return CODE_OK;
+    uint32_t offset = 0;
+    if (after) {
+        auto it = cursor.find(after->u);
+        if (it != cursor.end()) {
+            std::vector<NETWORKIDENTITY> page;
+            int c = list(page, it->second - 1, 1);
+            if (c != CODE_OK)
+                return c;
+            // entries before the cursor are added or removed, read from the start
+            if (page.size() == 1 && page[0].value.devaddr == *after)
+                offset = it->second;
+        }
+    }
+    cursor.clear();
+    // service may return entries in any order, cursor is kept for the sorted list only
+    uint32_t before = offset;
+    bool sorted = true;
+    bool hasPrev = offset > 0;
+    DEVADDR prev;
+    if (hasPrev)
+        prev.u = after->u;
+    std::vector<NETWORKIDENTITY> found;
+    std::vector<NETWORKIDENTITY> page;
+    while (true) {
+        page.clear();
+        int c = list(page, offset, size);
+        if (c != CODE_OK)
+            return c;
+        for (auto &ni : page) {
+            if (hasPrev && !(prev < ni.value.devaddr))
+                sorted = false;
+            prev.u = ni.value.devaddr.u;
+            hasPrev = true;
+            if (!after || *after < ni.value.devaddr)
+                found.emplace_back(ni);
+            else
+                before++;
+        }
+        if (page.size() < size || (sorted && found.size() >= size))
+            break;
+        offset += (uint32_t) page.size();
+    }
+    size_t n = std::min(found.size(), (size_t) size);
+    if (!sorted) {
+        std::partial_sort(found.begin(), found.begin() + (long) n, found.end(),
+            [](const NETWORKIDENTITY &a, const NETWORKIDENTITY &b) {
+                return a.value.devaddr < b.value.devaddr;
+            }
+        );
+    }
+    for (size_t i = 0; i < n; i++) {
+        retVal.emplace_back(found[i]);
+        if (sorted)
+            cursor[found[i].value.devaddr.u] = before + (uint32_t) i + 1;
+    }
     return CODE_OK;
 }
 
@@ -202,8 +344,10 @@ int ClientUDPIdentityService::list(
 size_t ClientUDPIdentityService::size()
 {
     IdentityOperationRequest req(QUERY_IDENTITY_COUNT, 0, 0, code, accessCode);
-    syncClient.request(&req);
-    return CODE_OK;
+    UDPServiceResult r;
+    if (wait(r, requestSync(req)) != CODE_OK)
+        return 0;
+    return (uint32_t) r.response;
 }
 
 /**
@@ -218,7 +362,13 @@ int ClientUDPIdentityService::getNetworkIdentity(
 )
 {
     IdentityEUIRequest req(QUERY_IDENTITY_ADDR, devEUI, code, accessCode);
-    syncClient.request(&req);
+    UDPServiceResult r;
+    int c = wait(r, requestSync(req));
+    if (c != CODE_OK)
+        return c;
+    if (r.identity.value.devid.empty())
+        return ERR_CODE_DEVICE_EUI_NOT_FOUND;
+    retVal.set(r.identity);
     return CODE_OK;
 }
 
@@ -233,8 +383,11 @@ int ClientUDPIdentityService::put(
 )
 {
     IdentityAssignRequest req(QUERY_IDENTITY_ASSIGN, NETWORKIDENTITY(devAddr, devId), code, accessCode);
-    syncClient.request(&req);
-    return CODE_OK;
+    UDPServiceResult r;
+    int c = wait(r, requestSync(req));
+    if (c != CODE_OK)
+        return c;
+    return r.response;
 }
 
 int ClientUDPIdentityService::rm(
@@ -242,30 +395,59 @@ int ClientUDPIdentityService::rm(
 )
 {
     IdentityAddrRequest req(QUERY_IDENTITY_RM, devAddr, code, accessCode);
-    syncClient.request(&req);
-    return CODE_OK;
+    UDPServiceResult r;
+    int c = wait(r, requestSync(req));
+    if (c != CODE_OK)
+        return c;
+    return r.response;
 }
 
+/**
+ * @param addrPort storage service address and port e.g. "127.0.0.1:4244"
+ * @param database not used
+ * @return CODE_OK- success
+ */
 int ClientUDPIdentityService::init(
     const std::string &addrPort,
-    void *database
+    void *
 )
 {
-    splitAddress(addr, port, addrPort);
-    ResponseService onResp(this);
-
-#ifdef ENABLE_LIBUV
-    client = new UvClient(params.useTcp, params.address, params.port, &onResp);
-#else
-    client = new UDPClient(addr, port, &onResp);
-#endif
-    // request first address to resolve
-    client->start();
+    done();
+    client = newClient(addrPort);
+    if (!client) {
+        retCode = ERR_CODE_SOCKET_ADDRESS;
+        return retCode;
+    }
+    int r = client->process(0);
+    if (r < 0) {
+        retCode = r;
+        done();
+        return r;
+    }
+    retCode = CODE_OK;
     return CODE_OK;
 }
 
+AsyncQueryClient *ClientUDPIdentityService::newClient(
+    const std::string &addrPort
+)
+{
+    if (!splitAddress(addr, port, addrPort))
+        return nullptr;
+    return new AsyncUDPClient(addr, port, collector);
+}
+
+/**
+ * Wait for replies to all asynchronous calls
+ */
 void ClientUDPIdentityService::flush()
 {
+    if (!client)
+        return;
+    while (client->pending()) {
+        if (client->process(SYNC_POLL_MILLIS) < 0)
+            break;
+    }
 }
 
 void ClientUDPIdentityService::done()
@@ -274,6 +456,7 @@ void ClientUDPIdentityService::done()
         delete client;
         client = nullptr;
     }
+    results.clear();
 }
 
 /**
@@ -281,11 +464,17 @@ void ClientUDPIdentityService::done()
  * @return 0- success, ERR_CODE_ADDR_SPACE_FULL- no address available
  */
 int ClientUDPIdentityService::next(
-    NETWORKIDENTITY &retval
+    NETWORKIDENTITY &retVal
 )
 {
     IdentityOperationRequest req(QUERY_IDENTITY_NEXT, 0, 0, code, accessCode);
-    syncClient.request(&req);
+    UDPServiceResult r;
+    int c = wait(r, requestSync(req));
+    if (c != CODE_OK)
+        return c;
+    if (r.identity.value.devaddr.u == 0)
+        return ERR_CODE_ADDR_SPACE_FULL;
+    retVal.set(r.identity);
     return CODE_OK;
 }
 
@@ -297,10 +486,10 @@ void ClientUDPIdentityService::setOption(
     if (!value)
         return;
     switch (option) {
-        case 1:
+        case IDENTITY_OPTION_CODE:
             code = * (int32_t *)value;
             break;
-        case 2:
+        case IDENTITY_OPTION_ACCESS_CODE:
             accessCode = * (uint64_t *) value;
             break;
         default:
@@ -312,30 +501,26 @@ void ClientUDPIdentityService::setOption(
 
 int ClientUDPIdentityService::cGet(const DEVADDR &request)
 {
-    IdentityAddrRequest req(QUERY_IDENTITY_EUI, addr, code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    IdentityAddrRequest req(QUERY_IDENTITY_EUI, request, code, accessCode);
+    return requestAsync(req);
 }
 
 int ClientUDPIdentityService::cGetNetworkIdentity(const DEVEUI &devEUI)
 {
     IdentityEUIRequest req(QUERY_IDENTITY_ADDR, devEUI, code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    return requestAsync(req);
 }
 
 int ClientUDPIdentityService::cPut(const DEVADDR &devAddr, const DEVICEID &devId)
 {
     IdentityAssignRequest req(QUERY_IDENTITY_ASSIGN, NETWORKIDENTITY(devAddr, devId), code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    return requestAsync(req);
 }
 
 int ClientUDPIdentityService::cRm(const DEVADDR &devAddr)
 {
     IdentityAddrRequest req(QUERY_IDENTITY_RM, devAddr, code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    return requestAsync(req);
 }
 
 int ClientUDPIdentityService::cList(
@@ -344,24 +529,25 @@ int ClientUDPIdentityService::cList(
 )
 {
     IdentityOperationRequest req(QUERY_IDENTITY_LIST, offset, size, code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    return requestAsync(req);
 }
 
 int ClientUDPIdentityService::cSize()
 {
     IdentityOperationRequest req(QUERY_IDENTITY_COUNT, 0, 0, code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    return requestAsync(req);
 }
 
 int ClientUDPIdentityService::cNext()
 {
     IdentityOperationRequest req(QUERY_IDENTITY_NEXT, 0, 0, code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    return requestAsync(req);
 }
 
+/**
+ * Up to MAX_IDENTITY_FILTERS filters fit the request datagram
+ * @return CODE_OK, ERR_CODE_PARAM_INVALID- too many filters, or error code
+ */
 int ClientUDPIdentityService::filter(
     std::vector<NETWORKIDENTITY> &retVal,
     const std::vector<NETWORK_IDENTITY_FILTER> &filters,
@@ -369,8 +555,21 @@ int ClientUDPIdentityService::filter(
     uint8_t size
 )
 {
-    IdentityOperationRequest req(QUERY_IDENTITY_FILTER, offset, size, code, accessCode);
-    syncClient.request(&req);
+    if (filters.size() > MAX_IDENTITY_FILTERS)
+        return ERR_CODE_PARAM_INVALID;
+    while (size) {
+        auto n = (uint8_t) (size < UDP_LIST_PAGE ? size : UDP_LIST_PAGE);
+        IdentityFilterRequest req(offset, n, filters, code, accessCode);
+        UDPServiceResult r;
+        int c = wait(r, requestSync(req));
+        if (c != CODE_OK)
+            return c;
+        retVal.insert(retVal.end(), r.identities.begin(), r.identities.end());
+        if (r.identities.size() < n)
+            break;
+        offset += n;
+        size -= n;
+    }
     return CODE_OK;
 }
 
@@ -380,9 +579,10 @@ int ClientUDPIdentityService::cFilter(
     uint8_t size
 )
 {
-    IdentityOperationRequest req(QUERY_IDENTITY_FILTER, offset, size, code, accessCode);
-    client->request(&req);
-    return CODE_OK;
+    if (filters.size() > MAX_IDENTITY_FILTERS)
+        return ERR_CODE_PARAM_INVALID;
+    IdentityFilterRequest req(offset, size, filters, code, accessCode);
+    return requestAsync(req);
 }
 
 EXPORT_SHARED_C_FUNC IdentityService* makeIdentityService4()
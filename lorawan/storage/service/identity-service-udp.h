@@ -1,21 +1,56 @@
 #ifndef IDENTITY_SERVICE_UDP_H_
 #define IDENTITY_SERVICE_UDP_H_ 1
 
+#include <map>
+
 #include "lorawan/storage/service/identity-service.h"
-#include "lorawan/storage/client/query-client.h"
-#include "cli-helper.h"
+#include "lorawan/storage/client/async-udp-client.h"
 #include "lorawan/lorawan-msg.h"
-#include "lorawan/storage/client/sync-query-client.h"
 #include "lorawan/helper/plugin-helper.h"
 
+/**
+ * Reply to the synchronous call
+ */
+class UDPServiceResult {
+public:
+    bool received;                              ///< reply or error is received
+    int32_t code;                               ///< CODE_OK or error code
+    int32_t response;                           ///< operation result or entries count
+    NETWORKIDENTITY identity;                   ///< get, next
+    std::vector<NETWORKIDENTITY> identities;    ///< list
+    UDPServiceResult();
+};
+
+/**
+ * Identity service backed by the remote storage over UDP.
+ * Requests are multiplexed over one AsyncUDPClient socket.
+ * Synchronous calls wait for the reply with the same request identifier,
+ * asynchronous calls return immediately, replies are passed to the responseClient.
+ */
 class ClientUDPIdentityService: public IdentityService {
+private:
+    std::map<uint32_t, UDPServiceResult> results;  ///< replies to the synchronous calls
+    std::map<uint32_t, uint32_t> cursor;    ///< address returned by the last listAfter() -> offset of the following entry
+    uint32_t requestSync(ServiceMessage &value);
+    int wait(UDPServiceResult &retVal, uint32_t requestId);
+    int requestAsync(ServiceMessage &value);
+    friend class UDPResultCollector;
+protected:
+    ResponseClient *collector;  ///< replies of the client
+    /**
+     * Create client connected to the storage service
+     * @param addrPort storage service address and port
+     * @return NULL if address is invalid
+     */
+    virtual AsyncQueryClient *newClient(
+        const std::string &addrPort
+    );
 public:
     std::string addr;
     uint16_t port;
     int32_t code;  // "account#" in request
     uint64_t accessCode;  // magic number in request, retCode in response, negative is error code
-    QueryClient *client;
-    SyncQueryClient syncClient;
+    AsyncQueryClient *client;
     int verbose;
     int32_t retCode;
 
@@ -28,6 +63,13 @@ public:
     int put(const DEVADDR &devAddr, const DEVICEID &id) override;
     int rm(const DEVADDR &devAddr) override;
     int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override;
+    /**
+     * Protocol has no keyed list request, entries are read by offset.
+     * Next page continues at the offset remembered for the last page entries
+     * if the entry at that offset is still the one the page starts after,
+     * otherwise the service is read from the start.
+     */
+    int listAfter(std::vector<NETWORKIDENTITY> &retVal, const DEVADDR *after, uint8_t size) override;
     size_t size() override;
     int next(NETWORKIDENTITY &retVal) override;
 
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cstring>
 #include "lorawan/storage/service/identity-service.h"
 #include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-error.h"
 
 IdentityService::IdentityService()
     : responseClient(nullptr)
@@ -26,6 +28,58 @@ IdentityService::IdentityService(
 
 IdentityService::~IdentityService() = default;
 
+int IdentityService::getCandidates(
+    std::vector<DEVICEID> &retVal,
+    const DEVADDR &devAddr
+)
+{
+    DEVICEID id;
+    int r = get(id, devAddr);
+    if (r == CODE_OK)
+        retVal.push_back(id);
+    return r;
+}
+
+// list() page size of the default listAfter()
+#define LIST_AFTER_PAGE 255
+
+int IdentityService::listAfter(
+    std::vector<NETWORKIDENTITY> &retVal,
+    const DEVADDR *after,
+    uint8_t size
+)
+{
+    std::vector<NETWORKIDENTITY> found;
+    std::vector<NETWORKIDENTITY> page;
+    uint32_t offset = 0;
+    while (true) {
+        page.clear();
+        int r = list(page, offset, LIST_AFTER_PAGE);
+        if (r != CODE_OK)
+            return r;
+        for (auto &ni : page) {
+            if (!after || *after < ni.value.devaddr)
+                found.emplace_back(ni);
+        }
+        if (page.size() < LIST_AFTER_PAGE)
+            break;
+        offset += (uint32_t) page.size();
+    }
+    // storage order may differ, sort indexes by address
+    std::vector<size_t> idx(found.size());
+    for (size_t i = 0; i < idx.size(); i++) {
+        idx[i] = i;
+    }
+    size_t n = std::min(idx.size(), (size_t) size);
+    std::partial_sort(idx.begin(), idx.begin() + n, idx.end(), [&found](size_t a, size_t b) {
+        return found[a].value.devaddr < found[b].value.devaddr;
+    });
+    for (size_t i = 0; i < n; i++) {
+        retVal.emplace_back(found[idx[i]]);
+    }
+    return CODE_OK;
+}
+
 int IdentityService::joinAccept(
     JOIN_ACCEPT_FRAME_HEADER &retval,
     NETWORKIDENTITY &networkIdentity
@@ -7,6 +7,20 @@
 #include "lorawan/lorawan-types.h"
 #include "lorawan/storage/client/response-client.h"
 
+// setOption() options
+// master key pass phrase (std::string) of the key generator
+#define IDENTITY_OPTION_MASTER_KEY          0
+// code (int32_t) of the storage service client
+#define IDENTITY_OPTION_CODE                1
+// access code (uint64_t) of the storage service client
+#define IDENTITY_OPTION_ACCESS_CODE         2
+// TCP connections (size_t) per storage service of the pool client
+#define IDENTITY_OPTION_CONNECTIONS         3
+// changes (size_t) kept in the RCU delta before the merge
+#define IDENTITY_OPTION_BATCH_SIZE          4
+// keep every device put for the same address, value int32_t 1- on, 0- off
+#define IDENTITY_OPTION_MULTI_CANDIDATE     5
+
 /**
  * Identity service interface
  * Get device identifier and keys by the network address
@@ -62,6 +76,19 @@ public:
      */
     virtual int cGet(const DEVADDR &devAddr) = 0;
 
+    /**
+     * synchronous request all devices registered for the network address,
+     * e.g. ABP devices of roaming networks sharing it. Pick one by MIC using resolveIdentity().
+     * Service without multi-candidate mode returns the one get() returns.
+     * @param retVal device identifiers, appended
+     * @param devAddr network address
+     * @return CODE_OK- success
+     */
+    virtual int getCandidates(
+        std::vector<DEVICEID> &retVal,
+        const DEVADDR &devAddr
+    );
+
     /**
     * synchronous request network identity(with address) by network address. Return 0 if success, retval = EUI and keys
     * @param retval network identity(with address)
@@ -118,6 +145,21 @@ public:
         uint8_t size
     ) = 0;
 
+    /**
+     * synchronous list entries in the address order after the address of the last entry of the previous page.
+     * Entries put or removed between the pages do not shift the next page as offset does.
+     * Default implementation reads whole storage by list(), ordered storages override it.
+     * @param retVal return values
+     * @param after address of the last entry of the previous page, nullptr- first page
+     * @param size entries count
+     * @return CODE_OK- success
+     */
+    virtual int listAfter(
+        std::vector<NETWORKIDENTITY> &retVal,
+        const DEVADDR *after,
+        uint8_t size
+    );
+
     /**
      * synchronous list entries with filter(s)
      * @param retVal return values
@@ -0,0 +1,236 @@
+#ifndef SHARDED_MAP_H_
+#define SHARDED_MAP_H_ 1
+
+#include <map>
+#include <vector>
+#include <queue>
+#include <atomic>
+#include <cinttypes>
+
+#include "lorawan/helper/rw-lock.h"
+
+// buckets of the concurrent in-memory services
+#define DEF_SHARDED_MAP_SHARDS  64
+
+/**
+ * Ordered map split into the buckets by key hash, each bucket has own readers-writer lock.
+ * Lookups of the different buckets do not contend, lookups of the same bucket run concurrently.
+ * Ordered traversal merges buckets holding all bucket read locks.
+ * Hash is a functor returning uint32_t of the key.
+ */
+template <class K, class V, class Hash>
+class ShardedMap {
+private:
+    class Shard {
+    public:
+        RWLock lock;
+        std::map<K, V> storage;
+    };
+    std::vector<Shard> shards;
+    std::atomic<size_t> count;
+
+    Shard &shardOf(
+        const K &key
+    ) {
+        return shards[Hash()(key) % shards.size()];
+    }
+
+    typedef typename std::map<K, V>::const_iterator Position;
+    class Head {
+    public:
+        Position it;
+        size_t shard;
+    };
+    class HeadGreater {
+    public:
+        bool operator()(const Head &a, const Head &b) const {
+            return b.it->first < a.it->first;
+        }
+    };
+public:
+    explicit ShardedMap(
+        size_t shardCount = DEF_SHARDED_MAP_SHARDS
+    )
+        : shards(shardCount ? shardCount : 1), count(0)
+    {
+    }
+
+    /**
+     * @return false if not found
+     */
+    bool get(
+        V &retVal,
+        const K &key
+    ) {
+        Shard &s = shardOf(key);
+        SharedGuard guard(s.lock);
+        auto it = s.storage.find(key);
+        if (it == s.storage.end())
+            return false;
+        retVal = it->second;
+        return true;
+    }
+
+    /**
+     * Insert or replace
+     */
+    void put(
+        const K &key,
+        const V &value
+    ) {
+        Shard &s = shardOf(key);
+        ExclusiveGuard guard(s.lock);
+        auto r = s.storage.insert(std::make_pair(key, value));
+        if (r.second)
+            count++;
+        else
+            r.first->second = value;
+    }
+
+    /**
+     * @return false if not found
+     */
+    bool rm(
+        const K &key
+    ) {
+        Shard &s = shardOf(key);
+        ExclusiveGuard guard(s.lock);
+        if (s.storage.erase(key) == 0)
+            return false;
+        count--;
+        return true;
+    }
+
+    /**
+     * Remove first entry matching predicate(key, value)
+     * @return false if not found
+     */
+    template <class P>
+    bool rmIf(
+        P predicate
+    ) {
+        for (auto &s : shards) {
+            ExclusiveGuard guard(s.lock);
+            for (auto it = s.storage.begin(); it != s.storage.end(); it++) {
+                if (predicate(it->first, it->second)) {
+                    s.storage.erase(it);
+                    count--;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Find the first entry in key order matching predicate(key, value), as the scan of the ordered map does
+     * @return false if not found
+     */
+    template <class P>
+    bool find(
+        K &retKey,
+        V &retVal,
+        P predicate
+    ) {
+        bool found = false;
+        for (auto &s : shards) {
+            SharedGuard guard(s.lock);
+            for (auto &it : s.storage) {
+                // entries of the shard are ordered, rest of the shard follows the found key
+                if (found && !(it.first < retKey))
+                    break;
+                if (predicate(it.first, it.second)) {
+                    retKey = it.first;
+                    retVal = it.second;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+
+    /**
+     * Call f(key, value) for size entries in key order matching predicate(key, value) after skipping offset ones
+     */
+    template <class P, class F>
+    void forEach(
+        uint32_t offset,
+        size_t size,
+        P predicate,
+        F f
+    ) {
+        walk(nullptr, offset, size, predicate, f);
+    }
+
+    /**
+     * Call f(key, value) for size entries in key order with key greater than after
+     * @param after nullptr- from the first entry
+     */
+    template <class F>
+    void forEachAfter(
+        const K *after,
+        size_t size,
+        F f
+    ) {
+        walk(after, 0, size, [](const K &, const V &) { return true; }, f);
+    }
+
+private:
+    template <class P, class F>
+    void walk(
+        const K *after,
+        uint32_t offset,
+        size_t size,
+        P predicate,
+        F f
+    ) {
+        if (size == 0)
+            return;
+        // locks are taken in the same order, writers take one lock only
+        for (auto &s : shards) {
+            s.lock.lockShared();
+        }
+        std::priority_queue<Head, std::vector<Head>, HeadGreater> heads;
+        for (size_t i = 0; i < shards.size(); i++) {
+            Position it = after ? shards[i].storage.upper_bound(*after) : shards[i].storage.begin();
+            if (it != shards[i].storage.end())
+                heads.push(Head { it, i });
+        }
+        size_t o = 0;
+        size_t sz = 0;
+        while (!heads.empty() && sz < size) {
+            Head h = heads.top();
+            heads.pop();
+            if (predicate(h.it->first, h.it->second)) {
+                if (o < offset)
+                    o++;
+                else {
+                    f(h.it->first, h.it->second);
+                    sz++;
+                }
+            }
+            h.it++;
+            if (h.it != shards[h.shard].storage.end())
+                heads.push(h);
+        }
+        for (auto &s : shards) {
+            s.lock.unlockShared();
+        }
+    }
+
+public:
+    size_t size() const {
+        return count.load();
+    }
+
+    void clear() {
+        for (auto &s : shards) {
+            ExclusiveGuard guard(s.lock);
+            count -= s.storage.size();
+            s.storage.clear();
+        }
+    }
+};
+
+#endif
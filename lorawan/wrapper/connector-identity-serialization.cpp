@@ -14,9 +14,76 @@ extern "C" {
 }
 #endif
 
+static_assert(sizeof(C_NETWORKIDENTITY) == 112, "C_NETWORKIDENTITY layout changed");
+
+static void identity2C(
+    C_NETWORKIDENTITY &retVal,
+    const NETWORKIDENTITY &identity
+)
+{
+    const DEVICE_ID &id = identity.value.devid.id;
+    retVal.devEUI = id.devEUI.u;
+    retVal.appEUI = id.appEUI.u;
+    retVal.addr = identity.value.devaddr.u;
+    retVal.joinNonce = id.joinNonce.get();
+    retVal.devNonce = id.devNonce.u;
+    retVal.activation = (uint8_t) id.activation;
+    retVal.deviceClass = (uint8_t) id.deviceclass;
+    retVal.versionMajor = id.version.major;
+    retVal.versionMinor = id.version.minor;
+    retVal.versionRelease = id.version.release;
+    retVal.reserved = 0;
+    memmove(retVal.nwkSKey, &id.nwkSKey.c, sizeof(retVal.nwkSKey));
+    memmove(retVal.appSKey, &id.appSKey.c, sizeof(retVal.appSKey));
+    memmove(retVal.appKey, &id.appKey.c, sizeof(retVal.appKey));
+    memmove(retVal.nwkKey, &id.nwkKey.c, sizeof(retVal.nwkKey));
+    memset(retVal.name, 0, sizeof(retVal.name));
+    memmove(retVal.name, &id.name.c, sizeof(id.name.c));
+}
+
+static void C2identity(
+    NETWORKIDENTITY &retVal,
+    const C_NETWORKIDENTITY &identity
+)
+{
+    DEVICE_ID &id = retVal.value.devid.id;
+    retVal.value.devaddr = DEVADDR(identity.addr);
+    id.activation = (ACTIVATION) identity.activation;
+    id.deviceclass = (DEVICECLASS) identity.deviceClass;
+    id.devEUI.u = identity.devEUI;
+    memmove(&id.nwkSKey.c, identity.nwkSKey, sizeof(identity.nwkSKey));
+    memmove(&id.appSKey.c, identity.appSKey, sizeof(identity.appSKey));
+    id.version = LORAWAN_VERSION(identity.versionMajor, identity.versionMinor, identity.versionRelease);
+    // OTAA
+    id.appEUI.u = identity.appEUI;
+    memmove(&id.appKey.c, identity.appKey, sizeof(identity.appKey));
+    memmove(&id.nwkKey.c, identity.nwkKey, sizeof(identity.nwkKey));
+    id.devNonce = DEVNONCE(identity.devNonce);
+    // inverse of JOINNONCE::get()
+    id.joinNonce.c[0] = identity.joinNonce & 0xff;
+    id.joinNonce.c[1] = (identity.joinNonce >> 8) & 0xff;
+    id.joinNonce.c[2] = (identity.joinNonce >> 16) & 0xff;
+    // added for searching
+    memmove(&id.name.c, identity.name, sizeof(id.name.c));
+}
+
+/**
+ * @return identities count in the list response, ERR_CODE_INVALID_PACKET
+ */
+static int listResponseCount(
+    const char *buf,
+    size_t size
+)
+{
+    // empty list is valid too, so validateIdentityResponse() is not used
+    if (!buf || size < SIZE_OPERATION_RESPONSE || buf[0] != QUERY_IDENTITY_LIST)
+        return ERR_CODE_INVALID_PACKET;
+    return (int) ((size - SIZE_OPERATION_RESPONSE) / SIZE_NETWORK_IDENTITY);
+}
+
 EXPORT_SHARED_C_FUNC int connectorIdentityVersion()
 {
-    return 1;
+    return 2;
 }
 
 EXPORT_SHARED_C_FUNC int binaryIdentityEUIRequest(
@@ -98,6 +165,27 @@ EXPORT_SHARED_C_FUNC int binaryIdentityAssignRequest(
     return (int) r.serialize(reinterpret_cast<unsigned char *>(retBuf));
 }
 
+EXPORT_SHARED_C_FUNC int binaryIdentityAssignRequestStruct(
+    char *retBuf,
+    size_t bufSize,
+    char aTag,
+    const C_NETWORKIDENTITY *identity,
+    int32_t code,
+    uint64_t accessCode
+)
+{
+    if (bufSize < SIZE_ASSIGN_REQUEST)
+        return ERR_CODE_INSUFFICIENT_MEMORY;
+    if (!identity)
+        return ERR_CODE_WRONG_PARAM;
+    NETWORKIDENTITY ni;
+    C2identity(ni, *identity);
+    IdentityAssignRequest r(aTag, ni, code, accessCode);
+    // struct and credentials are in the host byte order, request is in the network byte order
+    r.ntoh();
+    return (int) r.serialize(reinterpret_cast<unsigned char *>(retBuf));
+}
+
 EXPORT_SHARED_C_FUNC int binaryIdentityOperationRequest(
     char *retBuf,
     size_t bufSize,
@@ -197,6 +285,30 @@ EXPORT_SHARED_C_FUNC int binaryIdentityGetResponse(
     return CODE_OK;
 }
 
+EXPORT_SHARED_C_FUNC int binaryIdentityGetResponseStruct(
+    const char *buf,
+    size_t size,
+    C_NETWORKIDENTITY *retVal
+)
+{
+    if (!buf || !retVal)
+        return ERR_CODE_INVALID_PACKET;
+    enum IdentityQueryTag tag = validateIdentityResponse(reinterpret_cast<const unsigned char *>(buf), size);
+    switch (tag) {
+        case QUERY_IDENTITY_EUI:
+        case QUERY_IDENTITY_ADDR:
+        {
+            NETWORKIDENTITY ni;
+            deserializeNetworkIdentity(ni, reinterpret_cast<const unsigned char *>(buf) + SIZE_GET_RESPONSE - SIZE_NETWORK_IDENTITY);
+            identity2C(*retVal, ni);
+        }
+            break;
+        default:
+            return ERR_CODE_INVALID_PACKET;
+    }
+    return CODE_OK;
+}
+
 EXPORT_SHARED_C_FUNC int binaryIdentityListResponse(
     char *buf,
     size_t size,
@@ -259,3 +371,33 @@ EXPORT_SHARED_C_FUNC int binaryIdentityOperationResponse(
     }
     return CODE_OK;
 }
+
+EXPORT_SHARED_C_FUNC int binaryIdentityListResponseCount(
+    const char *buf,
+    size_t size
+)
+{
+    return listResponseCount(buf, size);
+}
+
+EXPORT_SHARED_C_FUNC int binaryIdentityListResponseStruct(
+    const char *buf,
+    size_t size,
+    C_NETWORKIDENTITY *retArray,
+    size_t arraySize
+)
+{
+    int cnt = listResponseCount(buf, size);
+    if (cnt < 0)
+        return cnt;
+    if ((size_t) cnt > arraySize)
+        cnt = (int) arraySize;
+    auto p = reinterpret_cast<const unsigned char *>(buf) + SIZE_OPERATION_RESPONSE;
+    NETWORKIDENTITY ni;
+    for (int i = 0; i < cnt; i++) {
+        deserializeNetworkIdentity(ni, p);
+        identity2C(retArray[i], ni);
+        p += SIZE_NETWORK_IDENTITY;
+    }
+    return cnt;
+}
@@ -4,6 +4,30 @@
 #include "lorawan/helper/plugin-helper.h"
 #include <cinttypes>
 
+/**
+ * Identity in the caller-owned fixed layout, 112 bytes, no pointers inside.
+ * Numbers are in the host byte order, keys are raw 16 bytes as stored in the identity record.
+ * Version 2 of the connector.
+ */
+typedef struct {
+    uint64_t devEUI;            ///< 0 device identifier (ABP device may not store EUI)
+    uint64_t appEUI;            ///< 8 OTAA application identifier
+    uint32_t addr;              ///< 16 network address
+    uint32_t joinNonce;         ///< 20 last Join nonce, 3 bytes
+    uint16_t devNonce;          ///< 24 last device nonce
+    uint8_t activation;         ///< 26 0- ABP, 1- OTAA
+    uint8_t deviceClass;        ///< 27 0- A, 1- B, 2- C
+    uint8_t versionMajor;       ///< 28 LoRaWAN version e.g. 1.0.0
+    uint8_t versionMinor;       ///< 29
+    uint8_t versionRelease;     ///< 30
+    uint8_t reserved;           ///< 31 always 0
+    uint8_t nwkSKey[16];        ///< 32 shared session key
+    uint8_t appSKey[16];        ///< 48 private key
+    uint8_t appKey[16];         ///< 64 OTAA application private key
+    uint8_t nwkKey[16];         ///< 80 OTAA network key
+    char name[16];              ///< 96 up to 8 characters, zero padded
+} C_NETWORKIDENTITY;
+
 EXPORT_SHARED_C_FUNC int connectorIdentityVersion();
 
 // Requests
@@ -52,6 +76,20 @@ EXPORT_SHARED_C_FUNC int binaryIdentityAssignRequest(
     uint64_t accessCode
 );
 
+/**
+ * Same as binaryIdentityAssignRequest() but identity is passed as is, without parsing strings.
+ * Identity, code and access code are in the host byte order.
+ * @return request size, ERR_CODE_INSUFFICIENT_MEMORY if buffer is too small
+ */
+EXPORT_SHARED_C_FUNC int binaryIdentityAssignRequestStruct(
+    char *retBuf,
+    size_t bufSize,
+    char aTag,
+    const C_NETWORKIDENTITY *identity,
+    int32_t code,
+    uint64_t accessCode
+);
+
 EXPORT_SHARED_C_FUNC int binaryIdentityOperationRequest(
     char *retBuf,
     size_t bufSize,
@@ -88,6 +126,19 @@ EXPORT_SHARED_C_FUNC int binaryIdentityGetResponse(
     char **name
 );
 
+/**
+ * Same as binaryIdentityGetResponse() but fill caller-owned struct, nothing is allocated or formatted
+ * @param buf get response
+ * @param size response size
+ * @param retVal returned identity
+ * @return CODE_OK, ERR_CODE_INVALID_PACKET
+ */
+EXPORT_SHARED_C_FUNC int binaryIdentityGetResponseStruct(
+    const char *buf,
+    size_t size,
+    C_NETWORKIDENTITY *retVal
+);
+
 EXPORT_SHARED_C_FUNC int binaryIdentityOperationResponse(
     char *buf,
     size_t size,
@@ -107,4 +158,30 @@ EXPORT_SHARED_C_FUNC int binaryIdentityListResponse(
     size_t bufSize
 );
 
+/**
+ * Count identities in the list response to allocate array for binaryIdentityListResponseStruct()
+ * @param buf list response
+ * @param size response size
+ * @return identities count, ERR_CODE_INVALID_PACKET
+ */
+EXPORT_SHARED_C_FUNC int binaryIdentityListResponseCount(
+    const char *buf,
+    size_t size
+);
+
+/**
+ * Decode list response into caller-owned array, nothing is allocated or formatted
+ * @param buf list response
+ * @param size response size
+ * @param retArray array to fill
+ * @param arraySize array capacity, extra identities are skipped
+ * @return identities decoded, ERR_CODE_INVALID_PACKET
+ */
+EXPORT_SHARED_C_FUNC int binaryIdentityListResponseStruct(
+    const char *buf,
+    size_t size,
+    C_NETWORKIDENTITY *retArray,
+    size_t arraySize
+);
+
 #endif
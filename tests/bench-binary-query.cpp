@@ -0,0 +1,235 @@
+/**
+ * Binary query dispatch microbenchmark.
+ * Compares object based dispatch (IdentitySerialization::query(), GatewaySerialization::query()) with the in-place
+ * dispatch of IdentityBinarySerialization and GatewayBinarySerialization. Responses must be the same.
+ * Prints ns/request and heap allocations/request of each path.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/helper/ip-address.h"
+#include "lorawan/storage/service/identity-service-mem.h"
+#include "lorawan/storage/service/gateway-service-mem.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/serialization/gateway-binary-serialization.h"
+
+#define ENTRIES     1024
+#define ITERATIONS  100000
+#define CODE        1
+#define ACCESS_CODE 42
+
+static size_t allocations = 0;
+
+void *operator new(
+    size_t sz
+)
+{
+    allocations++;
+    void *r = malloc(sz ? sz : 1);
+    if (!r)
+        throw std::bad_alloc();
+    return r;
+}
+
+void operator delete(
+    void *p
+) noexcept
+{
+    free(p);
+}
+
+class QueryStat {
+public:
+    double ns;
+    double allocations;
+};
+
+template <class Q>
+static QueryStat measure(
+    Q q,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    unsigned char r[4096];
+    size_t a = allocations;
+    auto t = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        q(r, sizeof(r), request, sz);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count();
+    return QueryStat { (double) ns / ITERATIONS, (double) (allocations - a) / ITERATIONS };
+}
+
+/**
+ * Check responses are the same, print timings
+ * @return 0- responses are the same
+ */
+template <class Before, class After>
+static int bench(
+    const char *name,
+    Before before,
+    After after,
+    const unsigned char *request,
+    size_t sz
+)
+{
+    unsigned char b[4096];
+    unsigned char a[4096];
+    memset(b, 0, sizeof(b));
+    memset(a, 0, sizeof(a));
+    size_t bs = before(b, sizeof(b), request, sz);
+    size_t as = after(a, sizeof(a), request, sz);
+    if (bs != as || memcmp(b, a, bs) != 0) {
+        std::cerr << name << ": response differs, size " << bs << " before, " << as << " after" << std::endl;
+        return 1;
+    }
+    QueryStat sb = measure(before, request, sz);
+    QueryStat sa = measure(after, request, sz);
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+        << " before " << std::setw(8) << sb.ns << " ns/request " << std::setw(4) << sb.allocations << " alloc"
+        << ", after " << std::setw(8) << sa.ns << " ns/request " << std::setw(4) << sa.allocations << " alloc"
+        << std::endl;
+    return 0;
+}
+
+static DEVICEID deviceId(
+    uint64_t eui
+)
+{
+    DEVEUI e;
+    e.u = eui;
+    DEVICEID r(e);
+    r.id.appEUI.u = eui ^ 0xffff;
+    r.id.devNonce.u = (uint16_t) eui;
+    memset(r.id.nwkSKey.c, (int) eui, sizeof(r.id.nwkSKey.c));
+    return r;
+}
+
+int main(
+    int,
+    char **
+)
+{
+    int r = 0;
+    MemoryIdentityService identityService;
+    MemoryGatewayService gatewayService;
+    for (uint32_t i = 1; i <= ENTRIES; i++) {
+        identityService.put(DEVADDR(i), deviceId(0x1000 + i));
+        GatewayIdentity gi(0x2000 + i);
+        string2sockaddr(&gi.sockaddr, "10.0.0." + std::to_string(i % 250 + 1) + ":" + std::to_string(1700 + i));
+        gatewayService.put(gi);
+    }
+    IdentityBinarySerialization is(&identityService, CODE, ACCESS_CODE);
+    GatewayBinarySerialization gs(&gatewayService, CODE, ACCESS_CODE);
+    auto identityBefore = [&is](unsigned char *retBuf, size_t retSize, const unsigned char *request, size_t sz) {
+        return is.IdentitySerialization::query(retBuf, retSize, request, sz);
+    };
+    auto identityAfter = [&is](unsigned char *retBuf, size_t retSize, const unsigned char *request, size_t sz) {
+        return is.query(retBuf, retSize, request, sz);
+    };
+    auto gatewayBefore = [&gs](unsigned char *retBuf, size_t retSize, const unsigned char *request, size_t sz) {
+        return gs.GatewaySerialization::query(retBuf, retSize, request, sz);
+    };
+    auto gatewayAfter = [&gs](unsigned char *retBuf, size_t retSize, const unsigned char *request, size_t sz) {
+        return gs.query(retBuf, retSize, request, sz);
+    };
+
+    unsigned char q[256];
+    size_t sz;
+    {
+        IdentityAddrRequest req(QUERY_IDENTITY_EUI, DEVADDR(ENTRIES / 2), CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("identity by address", identityBefore, identityAfter, q, sz);
+    }
+    {
+        IdentityAddrRequest req(QUERY_IDENTITY_EUI, DEVADDR(ENTRIES + 1), CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("identity not found", identityBefore, identityAfter, q, sz);
+    }
+    {
+        DEVEUI eui;
+        eui.u = 0x1000 + 7;
+        IdentityEUIRequest req(QUERY_IDENTITY_ADDR, eui, CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("identity by EUI", identityBefore, identityAfter, q, sz);
+    }
+    {
+        IdentityAssignRequest req(QUERY_IDENTITY_ASSIGN, NETWORKIDENTITY(DEVADDR(3), deviceId(0x1000 + 3)),
+            CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("identity put", identityBefore, identityAfter, q, sz);
+    }
+    {
+        IdentityOperationRequest req(QUERY_IDENTITY_COUNT, 0, 0, CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("identity count", identityBefore, identityAfter, q, sz);
+    }
+    {
+        IdentityOperationRequest req(QUERY_IDENTITY_LIST, 100, 10, CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("identity list 10", identityBefore, identityAfter, q, sz);
+    }
+    {
+        IdentityAddrRequest req(QUERY_IDENTITY_EUI, DEVADDR(1), CODE, ACCESS_CODE + 1);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("identity access denied", identityBefore, identityAfter, q, sz);
+    }
+    {
+        // remove, restore and remove again
+        IdentityAddrRequest req(QUERY_IDENTITY_RM, DEVADDR(5), CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        unsigned char b[64];
+        unsigned char a[64];
+        size_t bs = identityBefore(b, sizeof(b), q, sz);
+        identityService.put(DEVADDR(5), deviceId(0x1000 + 5));
+        size_t as = identityAfter(a, sizeof(a), q, sz);
+        if (bs != as || memcmp(b, a, bs) != 0) {
+            std::cerr << "identity rm: response differs" << std::endl;
+            r |= 1;
+        }
+        identityService.put(DEVADDR(5), deviceId(0x1000 + 5));
+    }
+    {
+        GatewayIdRequest req(QUERY_GATEWAY_ADDR, 0x2000 + 9, CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("gateway by id", gatewayBefore, gatewayAfter, q, sz);
+    }
+    {
+        GatewayIdentity gi;
+        gatewayService.get(gi, GatewayIdentity(0x2000 + 9));
+        GatewayAddrRequest req(gi.sockaddr, CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("gateway by address", gatewayBefore, gatewayAfter, q, sz);
+    }
+    {
+        GatewayIdentity gi;
+        gatewayService.get(gi, GatewayIdentity(0x2000 + 11));
+        GatewayIdAddrRequest req(QUERY_GATEWAY_ASSIGN, gi, CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("gateway put", gatewayBefore, gatewayAfter, q, sz);
+    }
+    {
+        GatewayOperationRequest req(QUERY_GATEWAY_COUNT, 0, 0, CODE, ACCESS_CODE);
+        req.ntoh();
+        sz = req.serialize(q);
+        r |= bench("gateway count", gatewayBefore, gatewayAfter, q, sz);
+    }
+    return r;
+}
@@ -0,0 +1,430 @@
+/**
+ * Hex and base64 codec benchmark.
+ * Converts identities to strings and back as row2DEVICEID() and the JSON serialization do, compares stringstream
+ * and strtol() based conversions with the codec-helper ones on each instruction set. Results must be the same.
+ * Usage: bench-string-codec [identity count], default 1000000
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "base64/base64.h"
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-string.h"
+#include "lorawan/helper/codec-helper.h"
+
+#define DEF_IDENTITIES  1000000
+#define RANDOM_STRINGS  20000
+#define PAYLOAD_SIZE    222
+
+static uint64_t seed = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// ------------------- conversions before codec-helper -------------------
+static std::string oldHexString(
+    const void *buffer,
+    size_t size
+)
+{
+    std::stringstream r;
+    auto *p = (const unsigned char *) buffer;
+    for (size_t i = 0; i < size; i++) {
+        r << std::setfill('0') << std::setw(2) << std::hex << (int) p[i];
+    }
+    return r.str();
+}
+
+static std::string oldHex2string(
+    const std::string &hex
+)
+{
+    std::stringstream s(hex);
+    std::stringstream r;
+    s >> std::noskipws;
+    char c[3] = {0, 0, 0};
+    while (s >> c[0]) {
+        if (!(s >> c[1]))
+            break;
+        r << (unsigned char) strtol(c, nullptr, 16);
+    }
+    return r.str();
+}
+
+static std::string oldDEVEUI2string(
+    const DEVEUI &value
+)
+{
+    uint64_t v = SWAP_BYTES_8(value.u);
+    return oldHexString(&v, sizeof(v));
+}
+
+static std::string oldDEVADDR2string(
+    const DEVADDR &value
+)
+{
+    uint32_t v = SWAP_BYTES_4(value.u);
+    return oldHexString(&v, sizeof(v));
+}
+
+static void oldString2KEY(
+    KEY128 &retVal,
+    const char *str
+)
+{
+    char c[3] = {0, 0, 0};
+    int i = 0;
+    while (*str) {
+        c[0] = *str;
+        str++;
+        if (!*str)
+            break;
+        c[1] = *str;
+        retVal.c[i] = (unsigned char) strtol(c, nullptr, 16);
+        i++;
+        if (i > 15)
+            break;
+        str++;
+    }
+}
+
+// ------------------- identity rows -------------------
+class Row {
+public:
+    std::string addr;
+    std::string devEUI;
+    std::string appEUI;
+    std::string nwkSKey;
+    std::string appSKey;
+    std::string appKey;
+    std::string nwkKey;
+};
+
+static void randomKey(
+    KEY128 &key
+)
+{
+    key.u[0] = rnd();
+    key.u[1] = rnd();
+}
+
+static NETWORKIDENTITY randomIdentity()
+{
+    NETWORKIDENTITY r;
+    r.value.devaddr.u = (uint32_t) rnd();
+    r.value.devid.id.devEUI.u = rnd();
+    r.value.devid.id.appEUI.u = rnd();
+    randomKey(r.value.devid.id.nwkSKey);
+    randomKey(r.value.devid.id.appSKey);
+    randomKey(r.value.devid.id.appKey);
+    randomKey(r.value.devid.id.nwkKey);
+    return r;
+}
+
+static void toRow(
+    Row &retVal,
+    const NETWORKIDENTITY &v
+)
+{
+    retVal.addr = DEVADDR2string(v.value.devaddr);
+    retVal.devEUI = DEVEUI2string(v.value.devid.id.devEUI);
+    retVal.appEUI = DEVEUI2string(v.value.devid.id.appEUI);
+    retVal.nwkSKey = KEY2string(v.value.devid.id.nwkSKey);
+    retVal.appSKey = KEY2string(v.value.devid.id.appSKey);
+    retVal.appKey = KEY2string(v.value.devid.id.appKey);
+    retVal.nwkKey = KEY2string(v.value.devid.id.nwkKey);
+}
+
+static void oldToRow(
+    Row &retVal,
+    const NETWORKIDENTITY &v
+)
+{
+    retVal.addr = oldDEVADDR2string(v.value.devaddr);
+    retVal.devEUI = oldDEVEUI2string(v.value.devid.id.devEUI);
+    retVal.appEUI = oldDEVEUI2string(v.value.devid.id.appEUI);
+    retVal.nwkSKey = oldHexString(&v.value.devid.id.nwkSKey, sizeof(KEY128));
+    retVal.appSKey = oldHexString(&v.value.devid.id.appSKey, sizeof(KEY128));
+    retVal.appKey = oldHexString(&v.value.devid.id.appKey, sizeof(KEY128));
+    retVal.nwkKey = oldHexString(&v.value.devid.id.nwkKey, sizeof(KEY128));
+}
+
+static void fromRow(
+    NETWORKIDENTITY &retVal,
+    const Row &row
+)
+{
+    string2DEVADDR(retVal.value.devaddr, row.addr);
+    string2DEVEUI(retVal.value.devid.id.devEUI, row.devEUI);
+    string2DEVEUI(retVal.value.devid.id.appEUI, row.appEUI);
+    string2KEY(retVal.value.devid.id.nwkSKey, row.nwkSKey);
+    string2KEY(retVal.value.devid.id.appSKey, row.appSKey);
+    string2KEY(retVal.value.devid.id.appKey, row.appKey);
+    string2KEY(retVal.value.devid.id.nwkKey, row.nwkKey);
+}
+
+static void oldFromRow(
+    NETWORKIDENTITY &retVal,
+    const Row &row
+)
+{
+    retVal.value.devaddr.u = strtoul(row.addr.c_str(), nullptr, 16);
+    retVal.value.devid.id.devEUI.u = strtoull(row.devEUI.c_str(), nullptr, 16);
+    retVal.value.devid.id.appEUI.u = strtoull(row.appEUI.c_str(), nullptr, 16);
+    oldString2KEY(retVal.value.devid.id.nwkSKey, row.nwkSKey.c_str());
+    oldString2KEY(retVal.value.devid.id.appSKey, row.appSKey.c_str());
+    oldString2KEY(retVal.value.devid.id.appKey, row.appKey.c_str());
+    oldString2KEY(retVal.value.devid.id.nwkKey, row.nwkKey.c_str());
+}
+
+static bool sameIdentity(
+    const NETWORKIDENTITY &a,
+    const NETWORKIDENTITY &b
+)
+{
+    return a.value.devaddr.u == b.value.devaddr.u
+        && a.value.devid.id.devEUI.u == b.value.devid.id.devEUI.u
+        && a.value.devid.id.appEUI.u == b.value.devid.id.appEUI.u
+        && memcmp(&a.value.devid.id.nwkSKey, &b.value.devid.id.nwkSKey, sizeof(KEY128)) == 0
+        && memcmp(&a.value.devid.id.appSKey, &b.value.devid.id.appSKey, sizeof(KEY128)) == 0
+        && memcmp(&a.value.devid.id.appKey, &b.value.devid.id.appKey, sizeof(KEY128)) == 0
+        && memcmp(&a.value.devid.id.nwkKey, &b.value.devid.id.nwkKey, sizeof(KEY128)) == 0;
+}
+
+static bool sameRow(
+    const Row &a,
+    const Row &b
+)
+{
+    return a.addr == b.addr && a.devEUI == b.devEUI && a.appEUI == b.appEUI && a.nwkSKey == b.nwkSKey
+        && a.appSKey == b.appSKey && a.appKey == b.appKey && a.nwkKey == b.nwkKey;
+}
+
+template <class F>
+static double measure(
+    F f
+)
+{
+    auto t = std::chrono::steady_clock::now();
+    f();
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count();
+}
+
+static void print(
+    const std::string &name,
+    double ns,
+    size_t count,
+    const char *unit = "identity"
+)
+{
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << ns / count << " ns/" << std::left << std::setw(10) << unit
+        << std::right << std::setw(10) << ns / 1e6 << " ms" << std::endl;
+}
+
+// ------------------- random strings -------------------
+static std::string randomBytes(
+    size_t size
+)
+{
+    std::string r(size, '\0');
+    for (auto &c : r) {
+        c = (char) rnd();
+    }
+    return r;
+}
+
+/**
+ * Mostly hex digits, sometimes spaces, signs, 'x' and any other byte
+ */
+static std::string randomHex(
+    size_t size
+)
+{
+    static const char chars[] = "0123456789abcdefABCDEF +-xX";
+    std::string r(size, '\0');
+    bool dirty = rnd() % 4 == 0;
+    for (auto &c : r) {
+        if (dirty && rnd() % 8 == 0)
+            c = (rnd() % 2) ? (char) rnd() : chars[rnd() % (sizeof(chars) - 1)];
+        else
+            c = chars[rnd() % 22];
+    }
+    return r;
+}
+
+/**
+ * @return "!" + message if decoder throws
+ */
+template <class D>
+static std::string tryDecode(
+    D d,
+    const std::string &s
+)
+{
+    try {
+        return d(s);
+    } catch (std::runtime_error &e) {
+        return std::string("!") + e.what();
+    }
+}
+
+/**
+ * Compare with the old conversions and third-party base64 on random and corrupted strings
+ * @return 0- the same
+ */
+static int checkRandomStrings()
+{
+    auto before = [](const std::string &s) {
+        return base64_decode(s);
+    };
+    auto after = [](const std::string &s) {
+        return base64Decode(s.c_str(), s.size());
+    };
+    for (int i = 0; i < RANDOM_STRINGS; i++) {
+        size_t sz = rnd() % 300;
+        std::string b = randomBytes(sz);
+        if (hexString(b) != oldHexString(b.c_str(), b.size())) {
+            std::cerr << "hexString differs, size " << sz << std::endl;
+            return 1;
+        }
+        std::string h = randomHex(sz);
+        if (hex2string(h) != oldHex2string(h)) {
+            std::cerr << "hex2string differs: " << h << std::endl;
+            return 1;
+        }
+        KEY128 k1, k2;
+        std::string kh = h.substr(0, 40);
+        string2KEY(k1, kh);
+        oldString2KEY(k2, kh.c_str());
+        if (memcmp(&k1, &k2, sizeof(KEY128)) != 0) {
+            std::cerr << "string2KEY differs: " << kh << std::endl;
+            return 1;
+        }
+        std::string eh = h.substr(0, 16);
+        DEVEUI e;
+        string2DEVEUI(e, eh);
+        if (e.u != strtoull(eh.c_str(), nullptr, 16)) {
+            std::cerr << "string2DEVEUI differs: " << eh << std::endl;
+            return 1;
+        }
+        std::string ah = h.substr(0, 8);
+        DEVADDR a;
+        string2DEVADDR(a, ah);
+        if (a.u != (uint32_t) strtoul(ah.c_str(), nullptr, 16)) {
+            std::cerr << "string2DEVADDR differs: " << ah << std::endl;
+            return 1;
+        }
+        bool url = rnd() % 2;
+        std::string e64 = base64Encode(b.c_str(), b.size(), url);
+        if (e64 != base64_encode(b, url)) {
+            std::cerr << "base64 encoding differs, size " << sz << std::endl;
+            return 1;
+        }
+        // corrupt some
+        if (!e64.empty() && rnd() % 4 == 0)
+            e64[rnd() % e64.size()] = (rnd() % 2) ? (char) rnd() : "=.-_+/"[rnd() % 6];
+        if (tryDecode(before, e64) != tryDecode(after, e64)) {
+            std::cerr << "base64 decoding differs: " << e64 << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(
+    int argc,
+    char **argv
+)
+{
+    size_t count = DEF_IDENTITIES;
+    if (argc > 1)
+        count = strtoul(argv[1], nullptr, 10);
+    if (count == 0)
+        count = 1;
+    std::vector<NETWORKIDENTITY> identities;
+    identities.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        identities.push_back(randomIdentity());
+    }
+    std::vector<Row> rows(count);
+    std::vector<Row> newRows(count);
+    std::vector<NETWORKIDENTITY> parsed(count);
+
+    std::cout << count << " identities, 7 conversions each way" << std::endl;
+    double ns = measure([&] {
+        for (size_t i = 0; i < count; i++) {
+            oldToRow(rows[i], identities[i]);
+        }
+    });
+    print("to string stringstream", ns, count);
+    ns = measure([&] {
+        for (size_t i = 0; i < count; i++) {
+            oldFromRow(parsed[i], rows[i]);
+        }
+    });
+    print("from string strtol", ns, count);
+    for (size_t i = 0; i < count; i++) {
+        if (!sameIdentity(parsed[i], identities[i])) {
+            std::cerr << "strtol conversion differs, identity " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // LoRaWAN payload
+    std::string payload = randomBytes(PAYLOAD_SIZE);
+    size_t payloads = count / 10 + 1;
+    ns = measure([&] {
+        for (size_t i = 0; i < payloads; i++) {
+            if (base64_decode(base64_encode(payload)) != payload)
+                std::cerr << "base64 round trip failed" << std::endl;
+        }
+    });
+    print("base64 third-party", ns, payloads, "payload");
+
+    const CODEC_LEVEL supported = codecLevel();
+    for (int l = CODEC_SCALAR; l <= supported; l++) {
+        CODEC_LEVEL level = setCodecLevel((CODEC_LEVEL) l);
+        std::string name = codecLevelName(level);
+        ns = measure([&] {
+            for (size_t i = 0; i < count; i++) {
+                toRow(newRows[i], identities[i]);
+            }
+        });
+        print("to string " + name, ns, count);
+        ns = measure([&] {
+            for (size_t i = 0; i < count; i++) {
+                fromRow(parsed[i], rows[i]);
+            }
+        });
+        print("from string " + name, ns, count);
+        for (size_t i = 0; i < count; i++) {
+            if (!sameRow(newRows[i], rows[i]) || !sameIdentity(parsed[i], identities[i])) {
+                std::cerr << name << " conversion differs, identity " << i << std::endl;
+                return 1;
+            }
+        }
+        ns = measure([&] {
+            for (size_t i = 0; i < payloads; i++) {
+                std::string e = base64Encode(payload.c_str(), payload.size());
+                if (base64Decode(e.c_str(), e.size()) != payload)
+                    std::cerr << "base64 round trip failed" << std::endl;
+            }
+        });
+        print("base64 " + name, ns, payloads, "payload");
+        if (checkRandomStrings())
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <cassert>
+#include <iostream>
+#include <cstring>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/listener/admission-control.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+#define CODE        42
+#define ACCESS_CODE 42
+
+static struct sockaddr_in client(
+    uint8_t n
+)
+{
+    struct sockaddr_in a {};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(0x7f000000 + n);
+    return a;
+}
+
+/**
+ * Get by address request
+ */
+static size_t lookup(
+    unsigned char *retBuf,
+    int32_t code = CODE,
+    uint64_t accessCode = ACCESS_CODE
+)
+{
+    IdentityAddrRequest req(QUERY_IDENTITY_EUI, DEVADDR(1), code, accessCode);
+    req.ntoh();
+    return req.serialize(retBuf);
+}
+
+static int admit(
+    AdmissionControl &ac,
+    uint8_t n,
+    int32_t code = CODE,
+    uint64_t accessCode = ACCESS_CODE
+)
+{
+    unsigned char buf[64];
+    size_t sz = lookup(buf, code, accessCode);
+    struct sockaddr_in a = client(n);
+    return ac.admit((const struct sockaddr *) &a, buf, sz);
+}
+
+/**
+ * Burst is admitted, then requests are throttled, other client has own bucket
+ */
+static void testAddressLimit()
+{
+    AdmissionControl ac;
+    ac.addressLimit[ADMISSION_LOOKUP] = AdmissionLimit(1, 3);
+    assert(ac.enabled());
+    for (int i = 0; i < 3; i++) {
+        assert(admit(ac, 1) == CODE_OK);
+    }
+    assert(admit(ac, 1) == ERR_CODE_THROTTLED);
+    assert(admit(ac, 2) == CODE_OK);
+    assert(ac.admitted == 4);
+    assert(ac.throttled == 1);
+    std::cout << "Address limit OK" << std::endl;
+}
+
+/**
+ * Account bucket is shared by all client addresses using the code and access code
+ */
+static void testAccountLimit()
+{
+    AdmissionControl ac;
+    ac.accountLimit[ADMISSION_LOOKUP] = AdmissionLimit(1, 2);
+    assert(admit(ac, 1) == CODE_OK);
+    assert(admit(ac, 2) == CODE_OK);
+    assert(admit(ac, 3) == ERR_CODE_THROTTLED);
+    assert(admit(ac, 3, CODE + 1) == CODE_OK);
+    assert(admit(ac, 3, CODE, ACCESS_CODE + 1) == CODE_OK);
+    assert(admit(ac, 3, CODE, ACCESS_CODE + 1) == CODE_OK);
+    assert(admit(ac, 3, CODE, ACCESS_CODE + 1) == ERR_CODE_THROTTLED);
+    std::cout << "Account limit OK" << std::endl;
+}
+
+/**
+ * Full table replaces the least recently seen client, the replaced one comes back with the full bucket
+ */
+static void testEviction()
+{
+    AdmissionControl ac;
+    ac.setMaxClients(2);
+    ac.addressLimit[ADMISSION_LOOKUP] = AdmissionLimit(1, 1);
+    assert(admit(ac, 1) == CODE_OK);
+    assert(admit(ac, 2) == CODE_OK);
+    assert(admit(ac, 1) == ERR_CODE_THROTTLED);
+    // client 2 is the least recently seen one
+    assert(admit(ac, 3) == CODE_OK);
+    assert(admit(ac, 2) == CODE_OK);
+    // client 1 is replaced by client 2
+    assert(admit(ac, 1) == CODE_OK);
+    assert(admit(ac, 3) == CODE_OK);
+
+    // many clients, each one starts with the full bucket
+    ac.setMaxClients(DEF_ADMISSION_MAX_CLIENTS);
+    for (int i = 0; i < 100000; i++) {
+        unsigned char buf[64];
+        size_t sz = lookup(buf);
+        struct sockaddr_in a {};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(0x0a000000 + i);
+        assert(ac.admit((const struct sockaddr *) &a, buf, sz) == CODE_OK);
+    }
+    std::cout << "Eviction OK" << std::endl;
+}
+
+/**
+ * Batch costing more than the bucket size is admitted with the full bucket, next requests pay the debt
+ */
+static void testLargeBatch()
+{
+    AdmissionControl ac;
+    ac.addressLimit[ADMISSION_LOOKUP] = AdmissionLimit(1, 4);
+    unsigned char frame[MAX_BATCH_FRAME_SIZE];
+    BatchWriter writer(frame, sizeof(frame));
+    for (uint32_t i = 0; i < 10; i++) {
+        unsigned char buf[64];
+        size_t sz = lookup(buf);
+        assert(writer.add(i, buf, sz));
+    }
+    struct sockaddr_in a = client(1);
+    assert(ac.admit((const struct sockaddr *) &a, frame, writer.size()) == CODE_OK);
+    // 6 tokens debt
+    assert(admit(ac, 1) == ERR_CODE_THROTTLED);
+    assert(ac.admit((const struct sockaddr *) &a, frame, writer.size()) == ERR_CODE_THROTTLED);
+    std::cout << "Large batch OK" << std::endl;
+}
+
+int main() {
+    testAddressLimit();
+    testAccountLimit();
+    testEviction();
+    testLargeBatch();
+    return 0;
+}
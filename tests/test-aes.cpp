@@ -0,0 +1,417 @@
+/**
+ * AES and AES-CMAC known-answer tests.
+ * Checks FIPS-197 and RFC 4493 vectors, then compares AesKey/AesCmac, encryptPayload(), decryptJoinAccept() and
+ * calculateMICFrmPayload() on each implementation with the third-party aes.c and cmac.c code they replaced.
+ * Checks expanded key cache used by LORAWAN_MESSAGE_STORAGE::decode() and matchMic().
+ * Prints blocks per second of both implementations.
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "system/crypto/aes.h"
+#include "system/crypto/cmac.h"
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-mic.h"
+#include "lorawan/lorawan-packet-batch.h"
+#include "lorawan/lorawan-packet-storage.h"
+#include "lorawan/helper/aes-helper.h"
+#include "lorawan/helper/aes-accel.h"
+#include "lorawan/helper/aes-key-cache.h"
+
+#define RANDOM_RUNS 2000
+#define BENCH_BLOCKS 1000000
+
+static int failures = 0;
+
+#define CHECK(cond, msg) if (!(cond)) { std::cerr << "FAIL " << msg << " at line " << __LINE__ << std::endl; failures++; }
+
+static uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static void rndBytes(
+    uint8_t *retVal,
+    size_t size
+)
+{
+    for (size_t i = 0; i < size; i++)
+        retVal[i] = (uint8_t) rnd();
+}
+
+static void hex2bytes(
+    uint8_t *retVal,
+    const char *hex
+)
+{
+    for (; hex[0] && hex[1]; hex += 2)
+        *retVal++ = (uint8_t) std::stoi(std::string(hex, 2), nullptr, 16);
+}
+
+// ------------------- third-party code used before aes-accel -------------------
+static void oldCmac(
+    uint8_t *retVal,
+    const uint8_t *key,
+    const uint8_t *prefix,
+    size_t prefixSize,
+    const uint8_t *data,
+    size_t size
+)
+{
+    AES_CMAC_CTX ctx;
+    AES_CMAC_Init(&ctx);
+    AES_CMAC_SetKey(&ctx, key);
+    if (prefixSize)
+        AES_CMAC_Update(&ctx, prefix, (uint32_t) prefixSize);
+    AES_CMAC_Update(&ctx, data, (uint32_t) size);
+    AES_CMAC_Final(retVal, &ctx);
+}
+
+static void oldEncryptPayload(
+    uint8_t *payload,
+    size_t size,
+    unsigned int frameCounter,
+    unsigned char direction,
+    const DEVADDR &devAddr,
+    const KEY128 &appSKey
+)
+{
+    aes_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    aes_set_key(appSKey.c, 16, &ctx);
+    uint8_t a[16] = { 1, 0, 0, 0, 0, direction, devAddr.c[0], devAddr.c[1], devAddr.c[2], devAddr.c[3],
+        (uint8_t) (frameCounter & 0xff), (uint8_t) ((frameCounter >> 8) & 0xff), 0, 0, 0, 0 };
+    uint8_t s[16];
+    uint16_t ctr = 1;
+    for (size_t ofs = 0; ofs < size; ofs += 16) {
+        a[15] = ctr++ & 0xff;
+        aes_encrypt(a, s, &ctx);
+        for (size_t i = 0; i < 16 && ofs + i < size; i++)
+            payload[ofs + i] ^= s[i];
+    }
+}
+
+static uint32_t oldMICFrmPayload(
+    const uint8_t *data,
+    uint8_t size,
+    unsigned int frameCounter,
+    unsigned char direction,
+    const DEVADDR &devAddr,
+    const KEY128 &key
+)
+{
+    uint8_t b[16] = { 0x49, 0, 0, 0, 0, direction, devAddr.c[0], devAddr.c[1], devAddr.c[2], devAddr.c[3],
+        (uint8_t) (frameCounter & 0xff), (uint8_t) ((frameCounter >> 8) & 0xff), 0, 0, 0, size };
+    uint8_t mic[16];
+    oldCmac(mic, key.c, b, sizeof(b), data, size);
+    return (uint32_t) mic[3] << 24 | (uint32_t) mic[2] << 16 | (uint32_t) mic[1] << 8 | (uint32_t) mic[0];
+}
+
+// ------------------- tests -------------------
+static void testVectors()
+{
+    // FIPS-197 Appendix C.1
+    uint8_t key[16], plain[16], expected[16], r[16];
+    hex2bytes(key, "000102030405060708090a0b0c0d0e0f");
+    hex2bytes(plain, "00112233445566778899aabbccddeeff");
+    hex2bytes(expected, "69c4e0d86a7b0430d8cdb78070b4c55a");
+    AesKey k(key);
+    k.encrypt(r, plain);
+    CHECK(memcmp(r, expected, 16) == 0, "FIPS-197 C.1")
+
+    // RFC 4493 4. Test Vectors
+    hex2bytes(key, "2b7e151628aed2a6abf7158809cf4f3c");
+    uint8_t m[64];
+    hex2bytes(m, "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+        "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    const char *macs[4] = {
+        "bb1d6929e95937287fa37d129b756746",
+        "070a16b46b4d4144f79bdd9dd04a287c",
+        "dfa66747de9ae63030ca32611497c827",
+        "51f0bebf7e3b9d92fc49741779363cfe"
+    };
+    const size_t sizes[4] = { 0, 16, 40, 64 };
+    k.set(key);
+    uint8_t k1[16], k2[16];
+    hex2bytes(k1, "fbeed618357133667c85e08f7236a8de");
+    hex2bytes(k2, "f7ddac306ae266ccf90bc11ee46d513b");
+    CHECK(memcmp(k.k1, k1, 16) == 0 && memcmp(k.k2, k2, 16) == 0, "RFC 4493 subkeys")
+    for (int i = 0; i < 4; i++) {
+        hex2bytes(expected, macs[i]);
+        AesCmac cmac(k);
+        cmac.update(m, sizes[i]);
+        cmac.final(r);
+        CHECK(memcmp(r, expected, 16) == 0, "RFC 4493 example " << i + 1)
+    }
+}
+
+static void testRandom()
+{
+    uint8_t key[16], data[300], r[300], expected[300];
+    for (int run = 0; run < RANDOM_RUNS; run++) {
+        rndBytes(key, sizeof(key));
+        size_t sz = rnd() % 257;
+        rndBytes(data, sz);
+        AesKey k(key);
+
+        // blocks
+        aes_context ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        aes_set_key(key, 16, &ctx);
+        size_t blocks = sz / 16;
+        for (size_t b = 0; b < blocks; b++)
+            aes_encrypt(data + b * 16, expected + b * 16, &ctx);
+        k.encryptBlocks(r, data, blocks);
+        CHECK(memcmp(r, expected, blocks * 16) == 0, "encryptBlocks " << blocks)
+        memmove(r, data, blocks * 16);
+        k.encryptBlocks(r, r, blocks);
+        CHECK(memcmp(r, expected, blocks * 16) == 0, "encryptBlocks in place " << blocks)
+
+        // CMAC split at random point
+        size_t split = sz ? rnd() % (sz + 1) : 0;
+        oldCmac(expected, key, data, split, data + split, sz - split);
+        AesCmac cmac(k);
+        cmac.update(data, split);
+        cmac.update(data + split, sz - split);
+        cmac.final(r);
+        CHECK(memcmp(r, expected, 16) == 0, "CMAC size " << sz << " split " << split)
+
+        // payload, MIC
+        KEY128 appSKey;
+        memmove(appSKey.c, key, 16);
+        DEVADDR addr((uint32_t) rnd());
+        auto fcnt = (unsigned int) rnd();
+        auto direction = (unsigned char) (rnd() & 1);
+        size_t psz = sz > 255 ? 255 : sz;
+        memmove(expected, data, psz);
+        memmove(r, data, psz);
+        oldEncryptPayload(expected, psz, fcnt, direction, addr, appSKey);
+        encryptPayload(r, psz, fcnt, direction, addr, appSKey);
+        CHECK(memcmp(r, expected, psz) == 0, "encryptPayload size " << psz)
+        CHECK(calculateMICFrmPayload(data, (uint8_t) psz, fcnt, direction, addr, appSKey)
+            == oldMICFrmPayload(data, (uint8_t) psz, fcnt, direction, addr, appSKey), "MIC size " << psz)
+
+        // Join Accept
+        memmove(expected, data, psz);
+        memmove(r, data, psz);
+        for (size_t ofs = 1; ofs + 16 <= psz; ofs += 16)
+            aes_encrypt(expected + ofs, expected + ofs, &ctx);
+        decryptJoinAccept(r, psz, appSKey);
+        CHECK(memcmp(r, expected, psz) == 0, "decryptJoinAccept size " << psz)
+    }
+}
+
+static void testCache()
+{
+    AesKeyCache cache(4);
+    KEY128 key1, key2;
+    rndBytes(key1.c, 16);
+    rndBytes(key2.c, 16);
+    AesKey expected1(key1), expected2(key2), r;
+    uint8_t block[16], a[16], b[16];
+    rndBytes(block, 16);
+    expected1.encrypt(a, block);
+
+    cache.get(r, DEVADDR((uint32_t) 1), AES_KEY_APPSKEY, key1);
+    cache.get(r, DEVADDR((uint32_t) 1), AES_KEY_APPSKEY, key1);
+    CHECK(cache.hits == 1 && cache.misses == 1, "cache hit")
+    r.encrypt(b, block);
+    CHECK(memcmp(a, b, 16) == 0, "cached key")
+    // NwkSKey is another entry
+    cache.get(r, DEVADDR((uint32_t) 1), AES_KEY_NWKSKEY, key2);
+    CHECK(cache.misses == 2 && cache.size() == 2, "key type")
+    // new key after rejoin
+    cache.get(r, DEVADDR((uint32_t) 1), AES_KEY_APPSKEY, key2);
+    expected2.encrypt(a, block);
+    r.encrypt(b, block);
+    CHECK(cache.misses == 3 && memcmp(a, b, 16) == 0, "changed key")
+    // bounded, recently used entry is kept
+    for (uint32_t i = 2; i < 10; i++) {
+        cache.get(r, DEVADDR(i), AES_KEY_APPSKEY, key1);
+        cache.get(r, DEVADDR((uint32_t) 1), AES_KEY_APPSKEY, key2);
+    }
+    CHECK(cache.size() == 4, "cache size " << cache.size())
+    CHECK(cache.misses == 11 && cache.hits == 9, "least recently used replaced")
+    cache.remove(DEVADDR((uint32_t) 9));
+    CHECK(cache.size() == 3, "remove size")
+    cache.get(r, DEVADDR((uint32_t) 9), AES_KEY_APPSKEY, key1);
+    CHECK(cache.misses == 12, "remove")
+    AesKeyCache disabled(0);
+    disabled.get(r, DEVADDR((uint32_t) 1), AES_KEY_APPSKEY, key2);
+    r.encrypt(b, block);
+    CHECK(disabled.size() == 0 && memcmp(a, b, 16) == 0, "cache disabled")
+
+    // decode() and matchMic() through process wide cache
+    LORAWAN_MESSAGE_STORAGE m;
+    m.mhdr.f.mtype = MTYPE_UNCONFIRMED_DATA_UP;
+    m.data.uplink.devaddr = DEVADDR((uint32_t) 0x01020304);
+    m.data.uplink.fcnt = 7;
+    m.data.uplink.f.foptslen = 0;
+    uint8_t payload[51];
+    rndBytes(payload, sizeof(payload));
+    m.setPayload(payload, sizeof(payload));
+    m.payloadSize = sizeof(payload);
+    LORAWAN_MESSAGE_STORAGE m2(m);
+    aesKeyCache().clear();
+    size_t hits = aesKeyCache().hits;
+    m.decode(m.data.uplink.devaddr, key1);
+    m = m2;
+    m.decode(m.data.uplink.devaddr, key1);
+    CHECK(aesKeyCache().hits == hits + 1, "decode uses cache")
+    // expanded again
+    aesKeyCache().clear();
+    m2.decode(m2.data.uplink.devaddr, key1);
+    CHECK(memcmp(m.data.uplink.payload(), m2.data.uplink.payload(), sizeof(payload)) == 0, "decode")
+    CHECK(m.matchMic(key2) == (m.mic() == m.mic(key2)), "matchMic")
+    CHECK(m.matchMic(key2) == (m.mic() == m.mic(key2)), "matchMic cached")
+}
+
+static void testBatchCmac()
+{
+    const size_t n = 40;
+    AesKey keys[n];
+    AesCmacJob jobs[n];
+    uint8_t data[n][100];
+    for (size_t i = 0; i < n; i++) {
+        uint8_t key[16];
+        rndBytes(key, sizeof(key));
+        keys[i].set(key);
+        rndBytes(data[i], sizeof(data[i]));
+        jobs[i].key = &keys[i];
+        jobs[i].data = data[i];
+        jobs[i].size = rnd() % sizeof(data[i]);
+    }
+    jobs[0].size = 0;
+    jobs[1].size = 16;
+    aesCmacBatch(jobs, n);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t mac[16];
+        AesCmac cmac(keys[i]);
+        cmac.update(data[i], jobs[i].size);
+        cmac.final(mac);
+        CHECK(memcmp(mac, jobs[i].mac, 16) == 0, "batch CMAC size " << jobs[i].size)
+    }
+
+    PayloadCryptJob crypts[n];
+    uint8_t payloads[n][100], expected[n][100];
+    for (size_t i = 0; i < n; i++) {
+        rndBytes(payloads[i], sizeof(payloads[i]));
+        memmove(expected[i], payloads[i], sizeof(payloads[i]));
+        PayloadCryptJob &c = crypts[i];
+        c.payload = payloads[i];
+        c.size = rnd() % sizeof(payloads[i]);
+        c.frameCounter = (unsigned int) rnd();
+        c.direction = rnd() & 1;
+        c.devAddr = DEVADDR((uint32_t) rnd());
+        c.appSKey = &keys[i];
+        encryptPayload(expected[i], c.size, c.frameCounter, c.direction, c.devAddr, keys[i]);
+    }
+    encryptPayloadBatch(crypts, n);
+    for (size_t i = 0; i < n; i++) {
+        CHECK(memcmp(payloads[i], expected[i], sizeof(payloads[i])) == 0, "batch payload size " << crypts[i].size)
+    }
+}
+
+static void testBatchDecode()
+{
+    const size_t n = 700;
+    const size_t devices = 50;
+    std::vector<NetworkIdentity> identities(devices);
+    for (size_t d = 0; d < devices; d++) {
+        identities[d].devaddr = DEVADDR((uint32_t) (0x26000000 + d));
+        rndBytes(identities[d].nwkSKey.c, 16);
+        rndBytes(identities[d].appSKey.c, 16);
+    }
+    std::vector<LORAWAN_MESSAGE_STORAGE> frames(n), expected;
+    std::vector<PacketBatchItem> items(n);
+    for (size_t i = 0; i < n; i++) {
+        NetworkIdentity &id = identities[i % devices];
+        LORAWAN_MESSAGE_STORAGE &m = frames[i];
+        m.mhdr.f.mtype = (rnd() & 1) ? MTYPE_UNCONFIRMED_DATA_UP : MTYPE_CONFIRMED_DATA_DOWN;
+        m.data.uplink.devaddr = id.devaddr;
+        m.data.uplink.fcnt = (uint16_t) rnd();
+        m.data.uplink.f.foptslen = 0;
+        uint8_t payload[60];
+        rndBytes(payload, sizeof(payload));
+        size_t sz = rnd() % sizeof(payload);
+        m.setPayload(payload, sz);
+        m.payloadSize = (int) sz;
+        // every third frame is signed by another key
+        uint32_t mic = m.mic(i % 3 ? id.nwkSKey : id.appSKey);
+        memmove(&m.mhdr.i + 1 + SIZE_DOWNLINK_EMPTY_STORAGE + (sz ? 1 + sz : 0), &mic, sizeof(mic));
+        items[i].message = &m;
+        items[i].identity = i % 7 ? &id : nullptr;
+    }
+    // join request is verified the usual way
+    frames[5].mhdr.f.mtype = MTYPE_JOIN_REQUEST;
+    expected = frames;
+    std::vector<bool> matched(n), decoded(n);
+    size_t matchedCount = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!items[i].identity)
+            continue;
+        matched[i] = expected[i].matchMic(items[i].identity->nwkSKey);
+        if (matched[i]) {
+            matchedCount++;
+            decoded[i] = expected[i].decode(items[i].identity);
+        }
+    }
+    CHECK(matchedCount > n / 3 && matchedCount < n, "batch test frames")
+    std::vector<LORAWAN_MESSAGE_STORAGE> copy(frames);
+    CHECK(decodePacketBatch(items.data(), n) == matchedCount, "batch matched count")
+    for (size_t i = 0; i < n; i++) {
+        CHECK(items[i].micMatched == matched[i] && items[i].decoded == decoded[i], "batch frame " << i)
+        CHECK(memcmp(&frames[i], &expected[i], sizeof(LORAWAN_MESSAGE_STORAGE)) == 0, "batch frame " << i << " content")
+    }
+    // split across threads
+    frames = copy;
+    for (size_t i = 0; i < n; i++) {
+        items[i].message = &frames[i];
+    }
+    PacketBatchDecoder decoder(4, 64);
+    CHECK(decoder.decode(items.data(), n) == matchedCount, "threads matched count")
+    for (size_t i = 0; i < n; i++) {
+        CHECK(items[i].micMatched == matched[i] && memcmp(&frames[i], &expected[i], sizeof(LORAWAN_MESSAGE_STORAGE)) == 0, "threads frame " << i)
+    }
+    frames = copy;
+    CHECK(decoder.decode(items.data(), n) == matchedCount, "threads second batch")
+}
+
+static void bench()
+{
+    uint8_t key[16], data[16 * 16];
+    rndBytes(key, sizeof(key));
+    rndBytes(data, sizeof(data));
+    AesKey k(key);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_BLOCKS / 16; i++)
+        k.encryptBlocks(data, data, 16);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << aesLevelName(aesLevel()) << ": " << BENCH_BLOCKS << " blocks " << us << "us, checksum " << (int) data[0] << std::endl;
+}
+
+int main() {
+    AES_LEVEL level = aesLevel();
+    for (int l = level; l >= AES_PORTABLE; l--) {
+        setAesLevel((AES_LEVEL) l);
+        std::cout << "Test " << aesLevelName(aesLevel()) << std::endl;
+        testVectors();
+        testRandom();
+        testCache();
+        testBatchCmac();
+        testBatchDecode();
+        bench();
+    }
+    setAesLevel(level);
+    if (failures)
+        std::cerr << failures << " failures" << std::endl;
+    return failures ? 1 : 0;
+}
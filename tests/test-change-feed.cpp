@@ -0,0 +1,218 @@
+#include <cassert>
+#include <iostream>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/listener/udp-listener.h"
+#include "lorawan/storage/serialization/change-feed-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/service/identity-service-mem.h"
+#include "lorawan/storage/service/identity-service-journal.h"
+
+#define CODE            42
+#define ACCESS_CODE     42
+#define LOG_CAPACITY    16
+
+static DEVICEID deviceId(
+    uint32_t addr
+)
+{
+    DEVEUI eui;
+    eui.u = 0x1000000 + addr;
+    return DEVICEID(eui);
+}
+
+/**
+ * Serialize subscribe request, subscribe client, return reply
+ */
+static WatchResponse subscribe(
+    ChangeFeed &feed,
+    const void *client,
+    uint64_t seq,
+    int32_t code = CODE
+)
+{
+    WatchRequest req(seq, code, ACCESS_CODE);
+    unsigned char buf[SIZE_WATCH_REQUEST];
+    req.ntoh();
+    size_t sz = req.serialize(buf);
+    unsigned char reply[SIZE_WATCH_RESPONSE];
+    int r = feed.subscribe(client, reply, buf, sz);
+    WatchResponse resp(reply, sizeof(reply));
+    resp.ntoh();
+    assert(resp.code == r);
+    return resp;
+}
+
+/**
+ * Parse events written to the client
+ */
+static std::vector<ChangeEvent> receive(
+    ChangeFeed &feed,
+    const void *client
+)
+{
+    std::vector<ChangeEvent> r;
+    unsigned char buf[SIZE_CHANGE_EVENT * 4];
+    // small buffer, events are written in several writes
+    while (size_t sz = feed.next(client, buf, sizeof(buf))) {
+        assert(sz % SIZE_CHANGE_EVENT == 0);
+        for (size_t i = 0; i < sz; i += SIZE_CHANGE_EVENT) {
+            r.emplace_back(buf + i, SIZE_CHANGE_EVENT);
+        }
+    }
+    return r;
+}
+
+/**
+ * Subscribe from the last change, resume from the received one, access denied
+ */
+static void testSubscribe()
+{
+    MemoryIdentityService mem;
+    JournalIdentityService journal(&mem, LOG_CAPACITY);
+    IdentityBinarySerialization serialization(&journal, CODE, ACCESS_CODE);
+    ChangeFeed feed(&serialization, &journal.log);
+    int a, b, c;
+
+    for (uint32_t i = 1; i <= 5; i++) {
+        journal.put(DEVADDR(i), deviceId(i));
+    }
+    // new changes only
+    WatchResponse resp = subscribe(feed, &a, 0);
+    assert(resp.code == CODE_OK);
+    assert(resp.seq == 5);
+    assert(feed.isSubscribed(&a));
+    assert(receive(feed, &a).empty());
+
+    // resume after the received change
+    resp = subscribe(feed, &b, 3);
+    assert(resp.code == CODE_OK);
+    auto events = receive(feed, &b);
+    assert(events.size() == 2);
+    assert(events[0].seq == 4 && events[0].addr.u == 4);
+    assert(events[1].seq == 5 && events[1].addr.u == 5);
+
+    resp = subscribe(feed, &c, 0, CODE + 1);
+    assert(resp.code == ERR_CODE_ACCESS_DENIED);
+    assert(!feed.isSubscribed(&c));
+    assert(feed.next(&c, nullptr, 0) == 0);
+    assert(feed.clients().size() == 2);
+    std::cout << "Subscribe OK" << std::endl;
+}
+
+/**
+ * Each subscriber gets put and rm events in order, disconnected one gets nothing
+ */
+static void testDelivery()
+{
+    MemoryIdentityService mem;
+    JournalIdentityService journal(&mem, LOG_CAPACITY);
+    IdentityBinarySerialization serialization(&journal, CODE, ACCESS_CODE);
+    ChangeFeed feed(&serialization, &journal.log);
+    int a, b;
+
+    subscribe(feed, &a, 0);
+    subscribe(feed, &b, 0);
+    for (uint32_t i = 1; i <= 10; i++) {
+        journal.put(DEVADDR(i), deviceId(i));
+    }
+    journal.rm(DEVADDR(3));
+    for (auto client : { (const void *) &a, (const void *) &b }) {
+        auto events = receive(feed, client);
+        assert(events.size() == 11);
+        for (size_t i = 0; i < 10; i++) {
+            assert(events[i].op == QUERY_IDENTITY_ASSIGN);
+            assert(events[i].seq == i + 1);
+            assert(events[i].addr.u == i + 1);
+        }
+        assert(events[10].op == QUERY_IDENTITY_RM);
+        assert(events[10].addr.u == 3);
+    }
+
+    // disconnected client is not served
+    feed.unsubscribe(&b);
+    journal.put(DEVADDR(11), deviceId(11));
+    unsigned char buf[SIZE_WATCH_RESPONSE];
+    assert(feed.next(&b, buf, sizeof(buf)) == 0);
+    assert(feed.clients().size() == 1);
+    assert(receive(feed, &a).size() == 1);
+    std::cout << "Delivery OK" << std::endl;
+}
+
+/**
+ * Slow subscriber misses changes dropped from the log: it gets the ERR_CODE_REPLICA_SNAPSHOT notice
+ * and continues from the last change
+ */
+static void testLostChanges()
+{
+    MemoryIdentityService mem;
+    JournalIdentityService journal(&mem, LOG_CAPACITY);
+    IdentityBinarySerialization serialization(&journal, CODE, ACCESS_CODE);
+    ChangeFeed feed(&serialization, &journal.log);
+    int a, b;
+
+    subscribe(feed, &a, 0);
+    for (uint32_t i = 1; i <= LOG_CAPACITY + 4; i++) {
+        journal.put(DEVADDR(i), deviceId(i));
+    }
+    unsigned char buf[SIZE_CHANGE_EVENT * 4];
+    size_t sz = feed.next(&a, buf, sizeof(buf));
+    assert(sz == SIZE_WATCH_RESPONSE);
+    WatchResponse notice(buf, sz);
+    notice.ntoh();
+    assert(notice.code == ERR_CODE_REPLICA_SNAPSHOT);
+    assert(notice.seq == LOG_CAPACITY + 4);
+    assert(receive(feed, &a).empty());
+    journal.rm(DEVADDR(1));
+    auto events = receive(feed, &a);
+    assert(events.size() == 1);
+    assert(events[0].op == QUERY_IDENTITY_RM && events[0].seq == LOG_CAPACITY + 5);
+
+    // resume after the dropped change is subscribed from the last one
+    WatchResponse resp = subscribe(feed, &b, 1);
+    assert(resp.code == ERR_CODE_REPLICA_SNAPSHOT);
+    assert(resp.seq == LOG_CAPACITY + 5);
+    assert(feed.isSubscribed(&b));
+    assert(receive(feed, &b).empty());
+    std::cout << "Lost changes OK" << std::endl;
+}
+
+/**
+ * Service without the change log and listener without the change feed answer ERR_CODE_NO_CHANGE_FEED
+ */
+static void testNoChangeFeed()
+{
+    MemoryIdentityService mem;
+    IdentityBinarySerialization serialization(&mem, CODE, ACCESS_CODE);
+    ChangeFeed feed(&serialization, nullptr);
+    int a;
+    WatchResponse resp = subscribe(feed, &a, 0);
+    assert(resp.code == ERR_CODE_NO_CHANGE_FEED);
+    assert(!feed.isSubscribed(&a));
+    // credentials are checked first
+    resp = subscribe(feed, &a, 0, CODE + 1);
+    assert(resp.code == ERR_CODE_ACCESS_DENIED);
+
+    JournalIdentityService journal(&mem, LOG_CAPACITY);
+    IdentityBinarySerialization journalSerialization(&journal, CODE, ACCESS_CODE);
+    UDPListener listener(&journalSerialization, nullptr);
+    WatchRequest req(0, CODE, ACCESS_CODE);
+    req.ntoh();
+    unsigned char request[SIZE_WATCH_REQUEST];
+    size_t sz = req.serialize(request);
+    unsigned char reply[256];
+    size_t rs = listener.query(reply, sizeof(reply), request, sz);
+    assert(rs == SIZE_WATCH_RESPONSE);
+    resp = WatchResponse(reply, rs);
+    resp.ntoh();
+    assert(resp.code == ERR_CODE_NO_CHANGE_FEED);
+    std::cout << "No change feed OK" << std::endl;
+}
+
+int main() {
+    testSubscribe();
+    testDelivery();
+    testLostChanges();
+    testNoChangeFeed();
+    return 0;
+}
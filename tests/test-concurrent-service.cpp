@@ -0,0 +1,306 @@
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/service/identity-service-mem-concurrent.h"
+#include "lorawan/storage/service/gateway-service-mem-concurrent.h"
+#include "lorawan/storage/service/identity-service-coalescing.h"
+#include "lorawan/storage/serialization/list-stream.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+
+#define THREADS     8
+#define OPERATIONS  20000
+// entries of each thread, checked after each write
+#define OWN_KEYS    256
+// entries shared by all threads
+#define SHARED_KEYS 1024
+
+static DEVICEID deviceId(
+    uint64_t eui
+)
+{
+    DEVEUI e;
+    e.u = eui;
+    return DEVICEID(e);
+}
+
+static void identityWorker(
+    ConcurrentMemoryIdentityService *svc,
+    int n,
+    std::atomic<int> *failures
+)
+{
+    uint32_t seed = 2463534242u + n;
+    for (int i = 0; i < OPERATIONS; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        DEVICEID id;
+        // own range: written by this thread only, must read back exactly
+        DEVADDR own(0x10000000 + n * OWN_KEYS + seed % OWN_KEYS);
+        switch (seed % 3) {
+            case 0:
+                svc->put(own, deviceId(own.u));
+                if (svc->get(id, own) != CODE_OK || id.id.devEUI.u != own.u)
+                    (*failures)++;
+                break;
+            case 1:
+                svc->rm(own);
+                if (svc->get(id, own) == CODE_OK)
+                    (*failures)++;
+                break;
+            default:
+                if (svc->get(id, own) == CODE_OK && id.id.devEUI.u != own.u)
+                    (*failures)++;
+                break;
+        }
+        // shared range: any thread writes, value always matches the key
+        DEVADDR shared((seed >> 8) % SHARED_KEYS + 1);
+        switch ((seed >> 4) % 4) {
+            case 0:
+                svc->put(shared, deviceId(shared.u));
+                break;
+            case 1:
+                svc->rm(shared);
+                break;
+            case 2:
+                {
+                    std::vector<NETWORKIDENTITY> l;
+                    svc->list(l, seed % 64, 32);
+                    for (size_t j = 1; j < l.size(); j++) {
+                        if (!(l[j - 1].value.devaddr < l[j].value.devaddr))
+                            (*failures)++;
+                    }
+                }
+                break;
+            default:
+                if (svc->get(id, shared) == CODE_OK && id.id.devEUI.u != shared.u)
+                    (*failures)++;
+                break;
+        }
+    }
+}
+
+static void testIdentityService()
+{
+    ConcurrentMemoryIdentityService svc;
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int n = 0; n < THREADS; n++) {
+        threads.emplace_back(identityWorker, &svc, n, &failures);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    assert(failures == 0);
+    // atomic counter matches entries
+    size_t count = 0;
+    std::vector<NETWORKIDENTITY> l;
+    for (uint32_t o = 0; ; o += (uint32_t) l.size()) {
+        l.clear();
+        svc.list(l, o, 255);
+        for (auto &e : l) {
+            DEVICEID id;
+            assert(svc.get(id, e.value.devaddr) == CODE_OK);
+            assert(id.id.devEUI.u == e.value.devaddr.u);
+        }
+        count += l.size();
+        if (l.size() < 255)
+            break;
+    }
+    assert(count == svc.size());
+    std::cout << "identities " << svc.size() << std::endl;
+
+    // key pages: strictly ascending, nothing lost
+    count = 0;
+    bool started = false;
+    DEVADDR last;
+    std::vector<NETWORKIDENTITY> page;
+    do {
+        page.clear();
+        assert(svc.listAfter(page, started ? &last : nullptr, 100) == CODE_OK);
+        for (auto &e : page) {
+            assert(!started || last < e.value.devaddr);
+            last = e.value.devaddr;
+            started = true;
+        }
+        count += page.size();
+    } while (page.size() == 100);
+    assert(count == svc.size());
+
+    NETWORKIDENTITY ni;
+    DEVEUI eui;
+    eui.u = l.empty() ? 0 : l.back().value.devaddr.u;
+    if (!l.empty())
+        assert(svc.getNetworkIdentity(ni, eui) == CODE_OK && ni.value.devaddr == l.back().value.devaddr);
+    svc.done();
+    assert(svc.size() == 0);
+
+    // devices sharing the EUI in different buckets: the least address, as the ordered map scan finds
+    for (uint32_t a = 200; a > 0; a--) {
+        svc.put(DEVADDR(a), deviceId(0x777));
+    }
+    eui.u = 0x777;
+    assert(svc.getNetworkIdentity(ni, eui) == CODE_OK && ni.value.devaddr.u == 1);
+    svc.done();
+}
+
+static void testGatewayService()
+{
+    ConcurrentMemoryGatewayService svc;
+    std::vector<std::thread> threads;
+    for (int n = 0; n < THREADS; n++) {
+        threads.emplace_back([&svc, n] {
+            for (int i = 0; i < OPERATIONS; i++) {
+                GatewayIdentity gw;
+                gw.gatewayId = (uint64_t) (i * 7 + n) % SHARED_KEYS + 1;
+                if (i % 3)
+                    svc.put(gw);
+                else
+                    svc.rm(gw);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::vector<GatewayIdentity> l;
+    svc.list(l, 0, 255);
+    for (size_t j = 1; j < l.size(); j++) {
+        assert(l[j - 1].gatewayId < l[j].gatewayId);
+    }
+    size_t count = 0;
+    for (uint32_t o = 0; ; o += (uint32_t) l.size()) {
+        l.clear();
+        svc.list(l, o, 255);
+        count += l.size();
+        if (l.size() < 255)
+            break;
+    }
+    assert(count == svc.size());
+
+    count = 0;
+    uint64_t last = 0;
+    const uint64_t *after = nullptr;
+    do {
+        l.clear();
+        assert(svc.listAfter(l, after, 100) == CODE_OK);
+        for (auto &gw : l) {
+            assert(!after || last < gw.gatewayId);
+            last = gw.gatewayId;
+            after = &last;
+        }
+        count += l.size();
+    } while (l.size() == 100);
+    assert(count == svc.size());
+    std::cout << "gateways " << svc.size() << std::endl;
+}
+
+/**
+ * Entries removed between chunks do not shift the stream, no entry is skipped
+ */
+static void testListStream()
+{
+    ConcurrentMemoryIdentityService svc;
+    for (uint32_t i = 1; i <= 100; i++) {
+        svc.put(DEVADDR(i), deviceId(i));
+    }
+    ListStreamRequest req(QUERY_IDENTITY_LIST_STREAM, 0, 0, "", 0, 0);
+    IdentityListStream stream(&svc, req);
+    // 10 entries in each chunk
+    unsigned char buf[SIZE_LIST_STREAM_CHUNK_HEADER + SIZE_OPERATION_RESPONSE + 10 * SIZE_NETWORK_IDENTITY];
+    std::vector<uint32_t> streamed;
+    while (!stream.isFinished()) {
+        size_t sz = stream.next(buf, sizeof(buf));
+        assert(sz > SIZE_LIST_STREAM_CHUNK_HEADER);
+        IdentityListResponse resp(buf + SIZE_LIST_STREAM_CHUNK_HEADER, sz - SIZE_LIST_STREAM_CHUNK_HEADER);
+        resp.ntoh();
+        for (auto &e : resp.identities) {
+            streamed.push_back(e.value.devaddr.u);
+        }
+        if (streamed.size() == 10) {
+            // one streamed entry and the next one
+            svc.rm(DEVADDR(5));
+            svc.rm(DEVADDR(11));
+        }
+    }
+    assert(streamed.size() == 99);
+    for (size_t i = 0; i < 10; i++) {
+        assert(streamed[i] == i + 1);
+    }
+    for (size_t i = 10; i < streamed.size(); i++) {
+        assert(streamed[i] == i + 2);
+    }
+
+    // offset is skipped in the key order
+    ListStreamRequest skip(QUERY_IDENTITY_LIST_STREAM, 20, 5, "", 0, 0);
+    IdentityListStream skipped(&svc, skip);
+    size_t sz = skipped.next(buf, sizeof(buf));
+    IdentityListResponse resp(buf + SIZE_LIST_STREAM_CHUNK_HEADER, sz - SIZE_LIST_STREAM_CHUNK_HEADER);
+    resp.ntoh();
+    assert(resp.identities.size() == 5);
+    assert(resp.identities[0].value.devaddr.u == 23);
+    std::cout << "list stream " << streamed.size() << std::endl;
+}
+
+/**
+ * Backend answering EUI lookups slowly, lookups overlap
+ */
+class SlowIdentityService : public ConcurrentMemoryIdentityService {
+public:
+    int getNetworkIdentity(NETWORKIDENTITY &retVal, const DEVEUI &eui) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return ConcurrentMemoryIdentityService::getNetworkIdentity(retVal, eui);
+    }
+};
+
+/**
+ * Write drops flights of the changed entry only, lookup after the write reads the new value
+ */
+static void testCoalescing()
+{
+    SlowIdentityService backend;
+    CoalescingIdentityService svc(&backend);
+    svc.put(DEVADDR(1), deviceId(0x100));
+    svc.put(DEVADDR(2), deviceId(0x200));
+
+    DEVEUI eui;
+    eui.u = 0x200;
+    NETWORKIDENTITY first, second;
+    std::thread t1([&] {
+        assert(svc.getNetworkIdentity(first, eui) == CODE_OK);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // other entry changes while the lookup is in flight
+    svc.put(DEVADDR(1), deviceId(0x101));
+    std::thread t2([&] {
+        assert(svc.getNetworkIdentity(second, eui) == CODE_OK);
+    });
+    t1.join();
+    t2.join();
+    assert(svc.backendCalls == 1);
+    assert(svc.coalesced == 1);
+    assert(first.value.devaddr.u == 2 && second.value.devaddr.u == 2);
+
+    NETWORKIDENTITY ni;
+    eui.u = 0x101;
+    assert(svc.getNetworkIdentity(ni, eui) == CODE_OK && ni.value.devaddr.u == 1);
+    eui.u = 0x100;
+    assert(svc.getNetworkIdentity(ni, eui) != CODE_OK);
+    svc.rm(DEVADDR(1));
+    eui.u = 0x101;
+    assert(svc.getNetworkIdentity(ni, eui) != CODE_OK);
+    std::cout << svc.toString() << std::endl;
+}
+
+int main() {
+    testIdentityService();
+    testGatewayService();
+    testListStream();
+    testCoalescing();
+    return 0;
+}
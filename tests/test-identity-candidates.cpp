@@ -0,0 +1,128 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/lorawan-packet-batch.h"
+#include "lorawan/lorawan-packet-storage.h"
+#include "lorawan/helper/aes-accel.h"
+#include "lorawan/storage/service/identity-service-mem.h"
+
+#define CANDIDATES  20
+
+static uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+static void rndBytes(
+    uint8_t *retVal,
+    size_t size
+)
+{
+    for (size_t i = 0; i < size; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        retVal[i] = (uint8_t) seed;
+    }
+}
+
+/**
+ * Every device put for the address is a candidate, last put first
+ */
+static void testCandidates(
+    MemoryIdentityService &svc,
+    const DEVADDR &addr,
+    std::vector<DEVICEID> &devices
+)
+{
+    for (size_t i = 0; i < devices.size(); i++) {
+        devices[i].id.devEUI.u = 0x1000 + i;
+        rndBytes(devices[i].id.nwkSKey.c, 16);
+        rndBytes(devices[i].id.appSKey.c, 16);
+        svc.put(addr, devices[i]);
+    }
+    // same device again is not a new candidate
+    svc.put(addr, devices[3]);
+    std::vector<DEVICEID> candidates;
+    assert(svc.getCandidates(candidates, addr) == CODE_OK);
+    assert(candidates.size() == devices.size());
+    assert(candidates[0].id.devEUI.u == devices[3].id.devEUI.u);
+    // get() sees the last device put only
+    DEVICEID id;
+    assert(svc.get(id, addr) == CODE_OK);
+    assert(id.id.devEUI.u == devices[3].id.devEUI.u);
+    assert(svc.size() == 1);
+    std::cout << "Candidates OK" << std::endl;
+}
+
+/**
+ * Candidate whose NwkSKey validates the MIC is resolved
+ */
+static void testResolve(
+    MemoryIdentityService &svc,
+    const DEVADDR &addr,
+    const std::vector<DEVICEID> &devices
+)
+{
+    LORAWAN_MESSAGE_STORAGE m;
+    m.mhdr.f.mtype = MTYPE_UNCONFIRMED_DATA_UP;
+    m.data.uplink.devaddr = addr;
+    m.data.uplink.fcnt = 11;
+    m.data.uplink.f.foptslen = 0;
+    uint8_t payload[20];
+    rndBytes(payload, sizeof(payload));
+    m.setPayload(payload, sizeof(payload));
+    m.payloadSize = sizeof(payload);
+    uint8_t *micPosition = &m.mhdr.i + 1 + SIZE_DOWNLINK_EMPTY_STORAGE + 1 + sizeof(payload);
+    uint32_t mic = m.mic(devices[13].id.nwkSKey);
+    memmove(micPosition, &mic, sizeof(mic));
+    NetworkIdentity identity;
+    assert(resolveIdentity(identity, svc, m) == CODE_OK);
+    assert(identity.devEUI.u == devices[13].id.devEUI.u);
+    mic++;
+    memmove(micPosition, &mic, sizeof(mic));
+    assert(resolveIdentity(identity, svc, m) == ERR_CODE_INVALID_MIC);
+    std::cout << "Resolve by MIC OK" << std::endl;
+}
+
+/**
+ * Option off keeps one device, rm() drops all candidates
+ */
+static void testOptionOff(
+    MemoryIdentityService &svc,
+    const DEVADDR &addr,
+    const std::vector<DEVICEID> &devices
+)
+{
+    int32_t off = 0;
+    svc.setOption(IDENTITY_OPTION_MULTI_CANDIDATE, &off);
+    std::vector<DEVICEID> candidates;
+    svc.getCandidates(candidates, addr);
+    assert(candidates.size() == 1);
+    int32_t on = 1;
+    svc.setOption(IDENTITY_OPTION_MULTI_CANDIDATE, &on);
+    svc.put(addr, devices[0]);
+    svc.rm(addr);
+    candidates.clear();
+    assert(svc.getCandidates(candidates, addr) != CODE_OK);
+    assert(candidates.empty());
+    std::cout << "Option off OK" << std::endl;
+}
+
+int main() {
+    AES_LEVEL level = aesLevel();
+    for (int l = level; l >= AES_PORTABLE; l--) {
+        setAesLevel((AES_LEVEL) l);
+        std::cout << "Test " << aesLevelName(aesLevel()) << std::endl;
+        MemoryIdentityService svc;
+        int32_t on = 1;
+        svc.setOption(IDENTITY_OPTION_MULTI_CANDIDATE, &on);
+        DEVADDR addr((uint32_t) 0x26011234);
+        std::vector<DEVICEID> devices(CANDIDATES);
+        testCandidates(svc, addr, devices);
+        testResolve(svc, addr, devices);
+        testOptionOff(svc, addr, devices);
+    }
+    setAesLevel(level);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include "lorawan/lorawan-conv.h"
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/listener/udp-listener.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/service/identity-service-mem.h"
+#include "lorawan/wrapper/connector-identity-serialization.h"
+
+#define CODE        42
+#define ACCESS_CODE 42
+#define ENTRIES     10
+
+/**
+ * Identity with each field set, key bytes depend on the address
+ */
+static C_NETWORKIDENTITY identity(
+    uint32_t addr
+)
+{
+    C_NETWORKIDENTITY r;
+    memset(&r, 0, sizeof(r));
+    r.devEUI = 0x0102030405060000ULL + addr;
+    r.appEUI = 0x1112131415160000ULL + addr;
+    r.addr = addr;
+    r.joinNonce = 0x123456;
+    r.devNonce = (uint16_t) (0x4000 + addr);
+    r.activation = 1;
+    r.deviceClass = 2;
+    r.versionMajor = 1;
+    r.versionMinor = 0;
+    r.versionRelease = 3;
+    for (int i = 0; i < 16; i++) {
+        r.nwkSKey[i] = (uint8_t) (addr + i);
+        r.appSKey[i] = (uint8_t) (addr + i + 16);
+        r.appKey[i] = (uint8_t) (addr + i + 32);
+        r.nwkKey[i] = (uint8_t) (addr + i + 48);
+    }
+    strcpy(r.name, "dev");
+    r.name[3] = (char) ('0' + addr % 10);
+    return r;
+}
+
+/**
+ * Send request built by the connector to the listener
+ * @return response size
+ */
+static size_t query(
+    UDPListener &listener,
+    char *retBuf,
+    size_t retSize,
+    const char *request,
+    int sz
+)
+{
+    assert(sz > 0);
+    return listener.query((unsigned char *) retBuf, retSize, (const unsigned char *) request, (size_t) sz);
+}
+
+/**
+ * @return CODE_OK and identity, empty identity if address is not found
+ */
+static int get(
+    UDPListener &listener,
+    C_NETWORKIDENTITY &retVal,
+    uint32_t addr
+)
+{
+    char request[64];
+    // address request copies numbers as is, they are in the network byte order
+    int sz = binaryIdentityAddrRequest(request, sizeof(request), QUERY_IDENTITY_EUI, HTON4(addr), HTON4(CODE), HTON8(ACCESS_CODE));
+    char response[256];
+    size_t rs = query(listener, response, sizeof(response), request, sz);
+    return binaryIdentityGetResponseStruct(response, rs, &retVal);
+}
+
+/**
+ * Put identities by the struct request, get each one back, list them, remove one
+ */
+static void testRoundTrip()
+{
+    MemoryIdentityService svc;
+    IdentityBinarySerialization serialization(&svc, CODE, ACCESS_CODE);
+    UDPListener listener(&serialization, nullptr);
+    assert(connectorIdentityVersion() == 2);
+
+    char request[256];
+    char response[4096];
+    for (uint32_t a = 1; a <= ENTRIES; a++) {
+        C_NETWORKIDENTITY c = identity(a);
+        int sz = binaryIdentityAssignRequestStruct(request, sizeof(request), QUERY_IDENTITY_ASSIGN, &c, CODE, ACCESS_CODE);
+        query(listener, response, sizeof(response), request, sz);
+    }
+    assert(svc.size() == ENTRIES);
+    C_NETWORKIDENTITY c = identity(1);
+    assert(binaryIdentityAssignRequestStruct(request, 10, QUERY_IDENTITY_ASSIGN, &c, CODE, ACCESS_CODE) == ERR_CODE_INSUFFICIENT_MEMORY);
+
+    // each field survives put and get
+    for (uint32_t a = 1; a <= ENTRIES; a++) {
+        C_NETWORKIDENTITY r;
+        assert(get(listener, r, a) == CODE_OK);
+        C_NETWORKIDENTITY expected = identity(a);
+        assert(memcmp(&r, &expected, sizeof(r)) == 0);
+    }
+
+    // list into the caller array
+    int sz = binaryIdentityOperationRequest(request, sizeof(request), QUERY_IDENTITY_LIST, 0, ENTRIES, HTON4(CODE), HTON8(ACCESS_CODE));
+    size_t rs = query(listener, response, sizeof(response), request, sz);
+    assert(binaryIdentityListResponseCount(response, rs) == ENTRIES);
+    C_NETWORKIDENTITY list[ENTRIES];
+    assert(binaryIdentityListResponseStruct(response, rs, list, 4) == 4);
+    assert(binaryIdentityListResponseStruct(response, rs, list, ENTRIES) == ENTRIES);
+    for (uint32_t i = 0; i < ENTRIES; i++) {
+        C_NETWORKIDENTITY expected = identity(i + 1);
+        assert(memcmp(&list[i], &expected, sizeof(expected)) == 0);
+    }
+    assert(binaryIdentityListResponseCount(response, 1) == ERR_CODE_INVALID_PACKET);
+
+    // removed identity is returned empty
+    sz = binaryIdentityAddrRequest(request, sizeof(request), QUERY_IDENTITY_RM, HTON4(5), HTON4(CODE), HTON8(ACCESS_CODE));
+    query(listener, response, sizeof(response), request, sz);
+    assert(svc.size() == ENTRIES - 1);
+    C_NETWORKIDENTITY r;
+    assert(get(listener, r, 5) == CODE_OK);
+    assert(r.addr == 5 && r.devEUI == 0 && r.name[0] == 0);
+    assert(get(listener, r, 6) == CODE_OK);
+    assert(r.devEUI == identity(6).devEUI);
+    assert(binaryIdentityGetResponseStruct(response, 1, &r) == ERR_CODE_INVALID_PACKET);
+    std::cout << "Round trip OK" << std::endl;
+}
+
+int main() {
+    testRoundTrip();
+    return 0;
+}
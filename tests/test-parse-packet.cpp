@@ -1,7 +1,11 @@
 #include <cassert>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 #include "lorawan/lorawan-string.h"
+#include "lorawan/lorawan-frame-view.h"
+#include "lorawan/lorawan-mic.h"
+#include "lorawan/helper/aes-helper.h"
 
 static void testIdentityProp()
 {
@@ -50,8 +54,97 @@ static void testFilter() {
     std::cout << NETWORK_IDENTITY_FILTERS2string(filters) << std::endl;
 }
 
+static void testFrameView() {
+    KEY128 nwkSKey, appSKey;
+    for (int i = 0; i < 16; i++) {
+        nwkSKey.c[i] = (uint8_t) (i + 1);
+        appSKey.c[i] = (uint8_t) (0xf0 - i);
+    }
+    // unconfirmed up, DevAddr 26011234, FCtrl with 2 bytes FOpts, FCnt 0x0102, FPort 10, 5 bytes payload
+    uint8_t frame[] = { 0x40, 0x34, 0x12, 0x01, 0x26, 0x02, 0x02, 0x01, 0x03, 0x00, 0x0a, 1, 2, 3, 4, 5, 0, 0, 0, 0 };
+    const size_t sz = sizeof(frame);
+    DEVADDR addr;
+    memmove(addr.c, frame + 1, 4);
+    uint32_t mic = calculateMICFrmPayload(frame, (unsigned char) (sz - SIZE_MIC), 0x0102, LORAWAN_UPLINK, addr, nwkSKey);
+    memmove(frame + sz - SIZE_MIC, &mic, SIZE_MIC);
+
+    LorawanFrameView v(frame, sz);
+    assert(v.isData());
+    assert(v.mtype() == MTYPE_UNCONFIRMED_DATA_UP);
+    assert(v.direction() == LORAWAN_UPLINK);
+    assert(v.header() == (const RFM_HEADER *) frame);
+    assert(v.devAddr() == addr);
+    assert(v.fcnt() == 0x0102);
+    assert(v.foptsSize() == 2 && v.fopts() == frame + 8);
+    assert(v.hasFPort() && v.fport() == 10);
+    assert(v.payload() == frame + 11 && v.payloadSize() == 5);
+    assert(v.mic() == mic);
+    assert(v.matchMic(nwkSKey));
+    assert(!v.matchMic(appSKey));
+
+    uint8_t expected[5] = { 1, 2, 3, 4, 5 };
+    encryptPayload(expected, 5, 0x0102, LORAWAN_UPLINK, addr, appSKey);
+    uint8_t pld[5];
+    assert(v.decrypt(pld, appSKey) == 5);
+    assert(memcmp(pld, expected, 5) == 0);
+    assert(v.decrypt(pld, appSKey, nwkSKey) == 5);
+    assert(memcmp(pld, expected, 5) == 0);
+    // read-only view does not write to the frame
+    assert(v.decrypt((void *) v.payload(), appSKey) == 0);
+    assert(v.decrypt((void *) v.payload(), appSKey, nwkSKey) == 0);
+    assert(frame[11] == 1);
+
+    // MAC commands in FPort 0 payload are encrypted by NwkSKey
+    frame[10] = 0;
+    uint8_t mac[5] = { 1, 2, 3, 4, 5 };
+    encryptPayload(mac, 5, 0x0102, LORAWAN_UPLINK, addr, nwkSKey);
+    assert(v.fport() == 0);
+    assert(v.decrypt(pld, appSKey) == 0);
+    assert(v.decrypt(pld, appSKey, nwkSKey) == 5);
+    assert(memcmp(pld, mac, 5) == 0);
+
+    // in place
+    LorawanMutableFrameView w(frame, sz);
+    assert(w.decrypt(appSKey, nwkSKey) == 5);
+    assert(memcmp(frame + 11, mac, 5) == 0);
+    frame[10] = 0x0a;
+    memmove(frame + 11, "\1\2\3\4\5", 5);
+    assert(w.decrypt(appSKey, nwkSKey) == 5);
+    assert(w.payload() == frame + 11);
+    assert(memcmp(frame + 11, expected, 5) == 0);
+
+    // FPort only, no payload
+    LorawanFrameView e(frame, SIZE_RFM_HEADER + 2 + SIZE_FPORT + SIZE_MIC);
+    assert(e.isData() && e.hasFPort() && !e.payload() && e.payloadSize() == 0);
+    // FOpts only
+    LorawanFrameView t(frame, SIZE_RFM_HEADER + 2 + SIZE_MIC);
+    assert(t.isData() && !t.hasFPort() && !t.payload());
+    // FOpts truncated
+    LorawanFrameView u(frame, SIZE_RFM_HEADER + 1 + SIZE_MIC);
+    assert(!u.isData());
+    LorawanFrameView o(frame, SIZE_RFM_HEADER + 1);
+    assert(!o.fopts() && o.fcnt() == 0x0102);
+    // fields beyond the buffer are empty
+    LorawanFrameView j(frame, 3);
+    assert(!j.isData() && !j.header() && j.mic() == 0);
+    assert(j.devAddr().u == 0 && j.fcnt() == 0 && !j.fopts() && !j.payload() && j.calculateMic(nwkSKey) == 0);
+    LorawanFrameView n;
+    assert(!n.mhdr() && !n.isData());
+    assert(n.devAddr().u == 0 && n.fcnt() == 0 && !n.fopts() && n.payloadSize() == 0);
+
+    // longer than the radio frame, MIC size byte would overflow
+    uint8_t big[MAX_FRAME_SIZE + 20] = {};
+    memmove(big, frame, SIZE_RFM_HEADER);
+    LorawanFrameView b(big, sizeof(big));
+    assert(!b.isData() && b.calculateMic(nwkSKey) == 0 && !b.matchMic(nwkSKey));
+    assert(b.decrypt(big, appSKey) == 0);
+    LorawanFrameView m(big, MAX_FRAME_SIZE);
+    assert(m.isData() && m.payloadSize() == MAX_FRAME_SIZE - SIZE_RFM_HEADER - 2 - SIZE_FPORT - SIZE_MIC);
+}
+
 int main() {
     // testIdentityProp();
     testFilter();
+    testFrameView();
     return 0;
 }
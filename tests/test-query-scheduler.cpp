@@ -0,0 +1,255 @@
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/listener/query-scheduler.h"
+#include "lorawan/storage/listener/udp-listener.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/service/identity-service-mem.h"
+
+#define CODE        42
+#define ACCESS_CODE 42
+#define SCAN_MILLIS 300
+
+/**
+ * Backend with slow scans
+ */
+class SlowListService : public MemoryIdentityService {
+public:
+    int list(std::vector<NETWORKIDENTITY> &retVal, uint32_t offset, uint8_t size) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SCAN_MILLIS));
+        return MemoryIdentityService::list(retVal, offset, size);
+    }
+};
+
+/**
+ * Collect queued queries in the completion order
+ */
+class DoneTasks : public QueryTaskHandler {
+public:
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<QueryTask *> tasks;
+
+    ~DoneTasks() override {
+        for (auto t : tasks) {
+            delete t;
+        }
+    }
+
+    void onQueryDone(QueryTask *task) override {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            tasks.push_back(task);
+        }
+        changed.notify_all();
+    }
+
+    void waitFor(size_t count) {
+        std::unique_lock<std::mutex> guard(lock);
+        bool done = changed.wait_for(guard, std::chrono::seconds(5), [this, count] { return tasks.size() >= count; });
+        assert(done);
+    }
+};
+
+static std::string getRequest(
+    uint32_t addr
+)
+{
+    IdentityAddrRequest req(QUERY_IDENTITY_EUI, DEVADDR(addr), CODE, ACCESS_CODE);
+    req.ntoh();
+    unsigned char buf[64];
+    return std::string((const char *) buf, req.serialize(buf));
+}
+
+static std::string listRequest()
+{
+    IdentityOperationRequest req(QUERY_IDENTITY_LIST, 0, 10, CODE, ACCESS_CODE);
+    req.ntoh();
+    unsigned char buf[64];
+    return std::string((const char *) buf, req.serialize(buf));
+}
+
+static QueryTask *task(
+    const std::string &request,
+    void *client
+)
+{
+    return new QueryTask((const unsigned char *) request.c_str(), request.size(), 2048, client);
+}
+
+/**
+ * Scans and bulk writes go to the background lane
+ */
+static void testLane()
+{
+    std::string r = getRequest(1);
+    assert(QueryScheduler::lane((const unsigned char *) r.c_str(), r.size()) == LANE_LOOKUP);
+    r = listRequest();
+    assert(QueryScheduler::lane((const unsigned char *) r.c_str(), r.size()) == LANE_BACKGROUND);
+
+    for (size_t writes = SCHEDULER_BULK_WRITES; writes <= SCHEDULER_BULK_WRITES + 1; writes++) {
+        unsigned char frame[MAX_BATCH_FRAME_SIZE];
+        BatchWriter writer(frame, sizeof(frame));
+        for (size_t i = 0; i < writes; i++) {
+            IdentityAddrRequest req(QUERY_IDENTITY_RM, DEVADDR((uint32_t) i + 1), CODE, ACCESS_CODE);
+            req.ntoh();
+            unsigned char buf[256];
+            assert(writer.add((uint32_t) i, buf, req.serialize(buf)));
+        }
+        QueryLane l = QueryScheduler::lane(frame, writer.size());
+        assert(l == (writes > SCHEDULER_BULK_WRITES ? LANE_BACKGROUND : LANE_LOOKUP));
+    }
+    std::cout << "Lane OK" << std::endl;
+}
+
+/**
+ * Lookup runs in the caller thread while the storage service is free.
+ * While a scan runs, the caller does not wait, queued lookup runs before the queued scan.
+ */
+static void testLookupsFirst()
+{
+    SlowListService svc;
+    for (uint32_t i = 1; i <= 10; i++) {
+        DEVEUI eui;
+        eui.u = 0x100 + i;
+        svc.put(DEVADDR(i), DEVICEID(eui));
+    }
+    IdentityBinarySerialization serialization(&svc, CODE, ACCESS_CODE);
+    UDPListener listener(&serialization, nullptr);
+    QueryScheduler scheduler(&listener, 1);
+    DoneTasks done;
+    scheduler.start(&done);
+
+    std::string get = getRequest(5);
+    unsigned char reply[2048];
+    size_t len = 0;
+    assert(scheduler.tryQuery(reply, sizeof(reply), (const unsigned char *) get.c_str(), get.size(), len));
+    IdentityGetResponse resp(reply, len);
+    resp.ntoh();
+    assert(resp.response.value.devid.id.devEUI.u == 0x105);
+
+    int scan1, lookup, scan2;
+    std::string list = listRequest();
+    assert(scheduler.schedule(task(list, &scan1)));
+    // wait until the worker runs the scan
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto started = std::chrono::steady_clock::now();
+    assert(!scheduler.tryQuery(reply, sizeof(reply), (const unsigned char *) get.c_str(), get.size(), len));
+    assert(!scheduler.tryEnter());
+    assert(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(SCAN_MILLIS / 2));
+    assert(scheduler.schedule(task(list, &scan2)));
+    assert(scheduler.schedule(task(get, &lookup), LANE_LOOKUP));
+    assert(scheduler.stats(LANE_LOOKUP).depth == 1);
+
+    done.waitFor(3);
+    assert(done.tasks[0]->client == &scan1);
+    assert(done.tasks[1]->client == &lookup);
+    assert(done.tasks[2]->client == &scan2);
+    IdentityGetResponse queued((const unsigned char *) done.tasks[1]->response.c_str(), done.tasks[1]->response.size());
+    queued.ntoh();
+    assert(queued.response.value.devid.id.devEUI.u == 0x105);
+    IdentityListResponse scanned((const unsigned char *) done.tasks[0]->response.c_str(), done.tasks[0]->response.size());
+    scanned.ntoh();
+    assert(scanned.identities.size() == 10);
+
+    // storage service is free again
+    assert(scheduler.tryEnter());
+    scheduler.leave();
+    assert(scheduler.stats(LANE_LOOKUP).count == 2);
+    assert(scheduler.stats(LANE_BACKGROUND).count == 2);
+    scheduler.stop();
+    std::cout << "Lookups first OK" << std::endl;
+}
+
+/**
+ * Full lane rejects the query, stopped scheduler drops queued ones
+ */
+static void testQueueFull()
+{
+    SlowListService svc;
+    IdentityBinarySerialization serialization(&svc, CODE, ACCESS_CODE);
+    UDPListener listener(&serialization, nullptr);
+    QueryScheduler scheduler(&listener, 1, 2);
+    DoneTasks done;
+    std::string list = listRequest();
+    // not started
+    QueryTask *t = task(list, nullptr);
+    assert(!scheduler.schedule(t));
+    delete t;
+
+    scheduler.start(&done);
+    assert(scheduler.schedule(task(list, nullptr)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    assert(scheduler.schedule(task(list, nullptr)));
+    assert(scheduler.schedule(task(list, nullptr)));
+    t = task(list, nullptr);
+    assert(!scheduler.schedule(t));
+    delete t;
+    assert(scheduler.stats(LANE_BACKGROUND).rejected == 2);
+    // running scan completes, queued ones are dropped
+    scheduler.stop();
+    assert(done.tasks.size() == 1);
+    assert(scheduler.stats(LANE_BACKGROUND).depth == 0);
+    std::cout << "Queue full OK" << std::endl;
+}
+
+/**
+ * Thread safe storage service: scans of two workers run side by side, lookup is not blocked by them
+ */
+static void testConcurrent()
+{
+    SlowListService svc;
+    for (uint32_t i = 1; i <= 10; i++) {
+        DEVEUI eui;
+        eui.u = 0x100 + i;
+        svc.put(DEVADDR(i), DEVICEID(eui));
+    }
+    IdentityBinarySerialization serialization(&svc, CODE, ACCESS_CODE);
+    UDPListener listener(&serialization, nullptr);
+    QueryScheduler scheduler(&listener, 2);
+    scheduler.concurrentService = true;
+    DoneTasks done;
+    scheduler.start(&done);
+
+    auto started = std::chrono::steady_clock::now();
+    std::string list = listRequest();
+    assert(scheduler.schedule(task(list, nullptr)));
+    assert(scheduler.schedule(task(list, nullptr)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::string get = getRequest(5);
+    unsigned char reply[2048];
+    size_t len = 0;
+    assert(scheduler.tryQuery(reply, sizeof(reply), (const unsigned char *) get.c_str(), get.size(), len));
+    assert(len > 0);
+    assert(scheduler.tryEnter());
+    scheduler.leave();
+    done.waitFor(2);
+    assert(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(SCAN_MILLIS * 3 / 2));
+    scheduler.stop();
+
+    // not thread safe: one worker, scans one after another
+    QueryScheduler serialized(&listener, 2);
+    DoneTasks done2;
+    serialized.start(&done2);
+    started = std::chrono::steady_clock::now();
+    assert(serialized.schedule(task(list, nullptr)));
+    assert(serialized.schedule(task(list, nullptr)));
+    done2.waitFor(2);
+    assert(std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(SCAN_MILLIS * 2));
+    serialized.stop();
+    std::cout << "Concurrent OK" << std::endl;
+}
+
+int main() {
+    testLane();
+    testLookupsFirst();
+    testQueueFull();
+    testConcurrent();
+    return 0;
+}
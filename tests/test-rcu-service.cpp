@@ -0,0 +1,151 @@
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/service/identity-service-rcu.h"
+
+#define ENTRIES         2000
+#define READERS         4
+#define WRITES          20000
+
+static DEVICEID deviceId(
+    uint32_t addr
+)
+{
+    DEVEUI eui;
+    eui.u = 0x1000000 + addr;
+    return DEVICEID(eui);
+}
+
+/**
+ * Changes are visible before the merge, merged table returns the same entries in address order
+ */
+static void testDelta()
+{
+    RcuIdentityService svc;
+    size_t batch = 8;
+    svc.setOption(IDENTITY_OPTION_BATCH_SIZE, &batch);
+    for (uint32_t i = 1; i <= 5; i++) {
+        assert(svc.put(DEVADDR(i * 2), deviceId(i * 2)) == CODE_OK);
+    }
+    assert(svc.merged == 0);
+    DEVICEID id;
+    assert(svc.get(id, DEVADDR(4)) == CODE_OK);
+    assert(id.id.devEUI.u == deviceId(4).id.devEUI.u);
+    assert(svc.size() == 5);
+
+    // odd addresses go to the delta, 10 is removed
+    svc.publish();
+    assert(svc.merged == 1);
+    svc.put(DEVADDR(3), deviceId(3));
+    svc.put(DEVADDR(4), deviceId(3));
+    assert(svc.rm(DEVADDR(10)) == CODE_OK);
+    assert(svc.rm(DEVADDR(10)) == ERR_CODE_DEVICE_ADDRESS_NOTFOUND);
+    assert(svc.get(id, DEVADDR(10)) == ERR_CODE_DEVICE_ADDRESS_NOTFOUND);
+    assert(svc.size() == 5);
+
+    // lowest address with the EUI, in the table or in the delta
+    NETWORKIDENTITY ni;
+    assert(svc.getNetworkIdentity(ni, deviceId(3).id.devEUI) == CODE_OK);
+    assert(ni.value.devaddr.u == 3);
+    assert(svc.getNetworkIdentity(ni, deviceId(4).id.devEUI) == ERR_CODE_DEVICE_EUI_NOT_FOUND);
+
+    uint32_t expected[] = { 2, 3, 4, 6, 8 };
+    for (int merge = 0; merge < 2; merge++) {
+        std::vector<NETWORKIDENTITY> entries;
+        svc.list(entries, 0, 10);
+        assert(entries.size() == 5);
+        for (size_t i = 0; i < entries.size(); i++) {
+            assert(entries[i].value.devaddr.u == expected[i]);
+        }
+        entries.clear();
+        DEVADDR after(3);
+        svc.listAfter(entries, &after, 2);
+        assert(entries.size() == 2);
+        assert(entries[0].value.devaddr.u == 4 && entries[1].value.devaddr.u == 6);
+        svc.flush();
+        assert(svc.merged == 2);
+    }
+    assert(svc.reclaimed == svc.published);
+    std::cout << "Delta OK" << std::endl;
+}
+
+/**
+ * Readers check each found entry while writers replace snapshots,
+ * all replaced snapshots are deleted after the flush
+ */
+static void testConcurrent()
+{
+    RcuIdentityService svc;
+    for (uint32_t i = 1; i <= ENTRIES; i++) {
+        svc.put(DEVADDR(i), deviceId(i));
+    }
+    svc.flush();
+    // even addresses are never removed
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < READERS; r++) {
+        readers.emplace_back([&svc, &stop, &reads, r] {
+            uint32_t a = r;
+            while (!stop.load()) {
+                a = a % ENTRIES + 1;
+                DEVICEID id;
+                int c = svc.get(id, DEVADDR(a));
+                assert(c == CODE_OK || a % 2);
+                if (c == CODE_OK)
+                    assert(id.id.devEUI.u == deviceId(a).id.devEUI.u);
+                NETWORKIDENTITY ni;
+                c = svc.getNetworkIdentity(ni, deviceId(a).id.devEUI);
+                assert(c == CODE_OK || a % 2);
+                if (c == CODE_OK)
+                    assert(ni.value.devaddr.u == a);
+                if (a % 64 == 0) {
+                    std::vector<NETWORKIDENTITY> entries;
+                    svc.list(entries, a, 100);
+                    for (size_t i = 0; i < entries.size(); i++) {
+                        assert(entries[i].value.devid.id.devEUI.u == deviceId(entries[i].value.devaddr.u).id.devEUI.u);
+                        if (i)
+                            assert(entries[i - 1].value.devaddr < entries[i].value.devaddr);
+                    }
+                }
+                reads++;
+            }
+        });
+    }
+    std::thread writer([&svc] {
+        for (uint32_t w = 0; w < WRITES; w++) {
+            uint32_t a = (w * 7919) % ENTRIES + 1;
+            if (a % 2 && (w & 1))
+                svc.rm(DEVADDR(a));
+            else
+                svc.put(DEVADDR(a), deviceId(a));
+        }
+    });
+    writer.join();
+    stop = true;
+    for (auto &t : readers) {
+        t.join();
+    }
+    assert(svc.published >= WRITES);
+    assert(svc.merged > 0);
+    svc.flush();
+    assert(svc.reclaimed == svc.published);
+    for (uint32_t i = 2; i <= ENTRIES; i += 2) {
+        DEVICEID id;
+        assert(svc.get(id, DEVADDR(i)) == CODE_OK);
+    }
+    svc.done();
+    assert(svc.size() == 0);
+    assert(svc.reclaimed == svc.published);
+    std::cout << "Concurrent OK, " << reads << " reads, " << svc.published << " snapshots" << std::endl;
+}
+
+int main() {
+    testDelta();
+    testConcurrent();
+    return 0;
+}
@@ -0,0 +1,315 @@
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <chrono>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/lorawan-string.h"
+#include "lorawan/storage/listener/udp-listener.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/service/identity-service-mem.h"
+#include "lorawan/storage/service/identity-service-udp.h"
+#include "lorawan/storage/service/identity-service-sharded.h"
+
+#define CODE        42
+#define ACCESS_CODE 42
+#define FIRST_PORT  47240
+// more than one list page of a shard and more than one UDP reply
+#define ENTRIES     600
+
+/**
+ * Storage service daemon in the thread: UDP listener over the memory identity service
+ */
+class LoopbackDaemon {
+private:
+    IdentityBinarySerialization serialization;
+    UDPListener listener;
+    std::thread thread;
+public:
+    MemoryIdentityService svc;
+    std::string address;
+
+    explicit LoopbackDaemon(
+        uint16_t port
+    )
+        : serialization(&svc, CODE, ACCESS_CODE), listener(&serialization, nullptr),
+        address("127.0.0.1:" + std::to_string(port))
+    {
+        listener.setAddress("127.0.0.1", port);
+        thread = std::thread([this] {
+            listener.run();
+        });
+        // wait for bind
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    ~LoopbackDaemon() {
+        listener.stop();
+        thread.join();
+    }
+};
+
+static DEVICEID deviceId(
+    uint32_t addr
+)
+{
+    DEVEUI eui;
+    eui.u = 0x1000000 + addr;
+    return DEVICEID(eui);
+}
+
+static ClientUDPIdentityService *connect(
+    const LoopbackDaemon &daemon
+)
+{
+    auto c = new ClientUDPIdentityService;
+    int32_t code = CODE;
+    uint64_t accessCode = ACCESS_CODE;
+    c->setOption(IDENTITY_OPTION_CODE, &code);
+    c->setOption(IDENTITY_OPTION_ACCESS_CODE, &accessCode);
+    int r = c->init(daemon.address, nullptr);
+    assert(r == CODE_OK);
+    return c;
+}
+
+/**
+ * Each entry is stored in the daemon owning its address only
+ */
+static void checkPlacement(
+    ShardedIdentityService &sharded,
+    LoopbackDaemon **daemons,
+    size_t count
+)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        DEVADDR last;
+        const DEVADDR *after = nullptr;
+        while (true) {
+            std::vector<NETWORKIDENTITY> entries;
+            daemons[i]->svc.listAfter(entries, after, 255);
+            if (entries.empty())
+                break;
+            for (auto &e : entries) {
+                assert(sharded.shardOf(e.value.devaddr) == i);
+            }
+            total += entries.size();
+            last.u = entries.back().value.devaddr.u;
+            after = &last;
+        }
+    }
+    assert(total == ENTRIES);
+}
+
+/**
+ * Sharded service over two daemons: get, put, rm, EUI lookup, size, list and filter merged in address order
+ */
+static void testOperations()
+{
+    LoopbackDaemon a(FIRST_PORT);
+    LoopbackDaemon b(FIRST_PORT + 1);
+    LoopbackDaemon *daemons[] = { &a, &b };
+
+    ShardedIdentityService sharded;
+    int32_t code = CODE;
+    uint64_t accessCode = ACCESS_CODE;
+    sharded.setOption(IDENTITY_OPTION_CODE, &code);
+    sharded.setOption(IDENTITY_OPTION_ACCESS_CODE, &accessCode);
+    int r = sharded.init(a.address + "," + b.address, nullptr);
+    assert(r == CODE_OK);
+    assert(sharded.shardCount() == 2);
+
+    for (uint32_t i = 1; i <= ENTRIES; i++) {
+        r = sharded.put(DEVADDR(i), deviceId(i));
+        assert(r == CODE_OK);
+    }
+    checkPlacement(sharded, daemons, 2);
+    // both shards have entries
+    assert(a.svc.size() > 0 && b.svc.size() > 0);
+    assert(sharded.size() == ENTRIES);
+
+    DEVICEID id;
+    r = sharded.get(id, DEVADDR(77));
+    assert(r == CODE_OK);
+    assert(id.id.devEUI.u == deviceId(77).id.devEUI.u);
+
+    NETWORKIDENTITY ni;
+    r = sharded.getNetworkIdentity(ni, deviceId(123).id.devEUI);
+    assert(r == CODE_OK);
+    assert(ni.value.devaddr.u == 123);
+
+    // merged list in address order, over the UDP reply size
+    std::vector<NETWORKIDENTITY> entries;
+    r = sharded.list(entries, 100, 200);
+    assert(r == CODE_OK);
+    assert(entries.size() == 200);
+    for (size_t i = 0; i < entries.size(); i++) {
+        assert(entries[i].value.devaddr.u == 101 + i);
+    }
+
+    // key pagination
+    entries.clear();
+    DEVADDR after(500);
+    r = sharded.listAfter(entries, &after, 255);
+    assert(r == CODE_OK);
+    assert(entries.size() == ENTRIES - 500);
+    assert(entries.front().value.devaddr.u == 501);
+
+    // binary filter request goes to each shard, results are merged
+    std::vector<NETWORK_IDENTITY_FILTER> filters;
+    std::string expression = "addr = '0000002a'";
+    string2NETWORK_IDENTITY_FILTERS(filters, expression.c_str(), expression.size());
+    entries.clear();
+    r = sharded.filter(entries, filters, 0, 10);
+    assert(r == CODE_OK);
+    assert(entries.size() == 1);
+    assert(entries[0].value.devaddr.u == 42);
+    assert(entries[0].value.devid.id.devEUI.u == deviceId(42).id.devEUI.u);
+
+    expression = "addr <> '0000002a'";
+    filters.clear();
+    string2NETWORK_IDENTITY_FILTERS(filters, expression.c_str(), expression.size());
+    entries.clear();
+    r = sharded.filter(entries, filters, 0, 255);
+    assert(r == CODE_OK);
+    assert(entries.size() == 255);
+    for (size_t i = 1; i < entries.size(); i++) {
+        assert(entries[i - 1].value.devaddr < entries[i].value.devaddr);
+    }
+
+    // pages in sequence continue from the shard cursors, each entry once
+    uint32_t expected = 1;
+    for (uint32_t offset = 0; ; offset += 50) {
+        entries.clear();
+        r = sharded.list(entries, offset, 50);
+        assert(r == CODE_OK);
+        for (auto &e : entries) {
+            assert(e.value.devaddr.u == expected++);
+        }
+        if (entries.size() < 50)
+            break;
+        // entry removed behind the cursors does not shift the next page
+        if (offset == 100)
+            assert(sharded.rm(DEVADDR(3)) == CODE_OK);
+    }
+    assert(expected == ENTRIES + 1);
+    sharded.put(DEVADDR(3), deviceId(3));
+
+    r = sharded.rm(DEVADDR(42));
+    assert(r == CODE_OK);
+    assert(sharded.get(id, DEVADDR(42)) != CODE_OK);
+    assert(sharded.size() == ENTRIES - 1);
+
+    // key pagination of the UDP client: next page after the last entry, then after an address before the cursor
+    entries.clear();
+    ClientUDPIdentityService *shard = (ClientUDPIdentityService *) sharded.shard(0);
+    r = shard->listAfter(entries, nullptr, 20);
+    assert(r == CODE_OK && entries.size() == 20);
+    DEVADDR last(entries.back().value.devaddr.u);
+    std::vector<NETWORKIDENTITY> page;
+    shard->listAfter(page, &last, 20);
+    assert(page.size() == 20 && last < page.front().value.devaddr);
+    assert(a.svc.rm(entries[0].value.devaddr) == CODE_OK);
+    DEVADDR third(entries[2].value.devaddr.u);
+    page.clear();
+    shard->listAfter(page, &third, 5);
+    assert(page.size() == 5 && page.front().value.devaddr == entries[3].value.devaddr);
+    sharded.done();
+    std::cout << "Sharded operations OK" << std::endl;
+}
+
+/**
+ * Entries of one daemon are moved to the added daemon owning them
+ */
+static void testReshard()
+{
+    LoopbackDaemon a(FIRST_PORT + 2);
+    LoopbackDaemon b(FIRST_PORT + 3);
+    LoopbackDaemon *daemons[] = { &a, &b };
+
+    ShardedIdentityService sharded;
+    sharded.addShard(a.address, connect(a), true);
+    for (uint32_t i = 1; i <= ENTRIES; i++) {
+        int r = sharded.put(DEVADDR(i), deviceId(i));
+        assert(r == CODE_OK);
+    }
+    assert(a.svc.size() == ENTRIES);
+
+    sharded.addShard(b.address, connect(b), true);
+    size_t owned = 0;
+    for (uint32_t i = 1; i <= ENTRIES; i++) {
+        if (sharded.shardOf(DEVADDR(i)) == 1)
+            owned++;
+    }
+    int moved = sharded.reshard();
+    assert(moved == (int) owned);
+    assert(b.svc.size() == owned);
+    checkPlacement(sharded, daemons, 2);
+    // nothing left to move
+    assert(sharded.reshard() == 0);
+
+    DEVICEID id;
+    for (uint32_t i = 1; i <= ENTRIES; i++) {
+        int r = sharded.get(id, DEVADDR(i));
+        assert(r == CODE_OK);
+        assert(id.id.devEUI.u == deviceId(i).id.devEUI.u);
+    }
+    sharded.done();
+    std::cout << "Reshard OK, moved " << moved << std::endl;
+}
+
+/**
+ * Each shard issues the same addresses
+ */
+class NextService: public MemoryIdentityService {
+public:
+    uint32_t addr;
+    NextService() : addr(1) {}
+    int next(NETWORKIDENTITY &retVal) override {
+        retVal.value.devaddr.u = addr;
+        return CODE_OK;
+    }
+};
+
+/**
+ * Address issued by a shard is not used on the shard owning it, EUI lookup goes to the shard it was put to
+ */
+static void testNext()
+{
+    NextService a;
+    NextService b;
+    ShardedIdentityService sharded;
+    sharded.addShard("a", &a);
+    sharded.addShard("b", &b);
+    // address owned by another shard
+    uint32_t addr = 1;
+    while (sharded.shardOf(DEVADDR(addr)) != 1)
+        addr++;
+    a.addr = addr;
+    b.addr = addr + 1;
+    NETWORKIDENTITY ni;
+    assert(sharded.next(ni) == CODE_OK);
+    assert(ni.value.devaddr.u == addr);
+    sharded.put(DEVADDR(addr), deviceId(addr));
+    assert(b.size() == 1);
+    // a issues used address, b issues free one
+    assert(sharded.next(ni) == CODE_OK);
+    assert(ni.value.devaddr.u == addr + 1);
+    assert(sharded.getNetworkIdentity(ni, deviceId(addr).id.devEUI) == CODE_OK);
+    assert(ni.value.devaddr.u == addr);
+    // entry moved by other client is found on other shard
+    b.rm(DEVADDR(addr));
+    a.put(DEVADDR(addr), deviceId(addr));
+    assert(sharded.getNetworkIdentity(ni, deviceId(addr).id.devEUI) == CODE_OK);
+    a.rm(DEVADDR(addr));
+    assert(sharded.getNetworkIdentity(ni, deviceId(addr).id.devEUI) == ERR_CODE_DEVICE_EUI_NOT_FOUND);
+    sharded.done();
+    std::cout << "Next OK" << std::endl;
+}
+
+int main() {
+    testOperations();
+    testNext();
+    testReshard();
+    return 0;
+}
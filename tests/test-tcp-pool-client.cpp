@@ -0,0 +1,329 @@
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "lorawan/lorawan-error.h"
+#include "lorawan/storage/client/tcp-pool-client.h"
+#include "lorawan/storage/client/response-client.h"
+#include "lorawan/storage/serialization/batch-serialization.h"
+#include "lorawan/storage/serialization/identity-binary-serialization.h"
+#include "lorawan/storage/service/identity-service-mem.h"
+
+#define CODE        42
+#define ACCESS_CODE 42
+#define DEVICES     64
+// more than connections * frame items, requests wait in the connection queues
+#define REQUESTS    40
+
+/**
+ * Storage service stand-in: answers batch frames by queryBatch(), can hold replies or drop connections
+ */
+class LoopbackServer {
+private:
+    MemoryIdentityService svc;
+    IdentityBinarySerialization serialization;
+    int listenSock;
+    std::thread thread;
+
+    void run() {
+        std::vector<int> clients;
+        std::map<int, std::string> rx;
+        while (!stopped) {
+            if (dropAll) {
+                for (auto s : clients) {
+                    close(s);
+                }
+                clients.clear();
+                rx.clear();
+                dropAll = false;
+            }
+            std::vector<struct pollfd> fds;
+            struct pollfd l {};
+            l.fd = listenSock;
+            l.events = POLLIN;
+            fds.push_back(l);
+            for (auto s : clients) {
+                struct pollfd fd {};
+                fd.fd = s;
+                fd.events = POLLIN;
+                fds.push_back(fd);
+            }
+            if (poll(fds.data(), fds.size(), 10) <= 0)
+                continue;
+            if (fds[0].revents & POLLIN) {
+                int s = accept(listenSock, nullptr, nullptr);
+                if (s >= 0) {
+                    clients.push_back(s);
+                    accepted++;
+                }
+            }
+            for (size_t i = 1; i < fds.size(); i++) {
+                if (!fds[i].revents)
+                    continue;
+                int s = fds[i].fd;
+                unsigned char buf[4096];
+                ssize_t r = recv(s, buf, sizeof(buf), 0);
+                if (r <= 0) {
+                    close(s);
+                    rx.erase(s);
+                    for (auto it = clients.begin(); it != clients.end(); ++it) {
+                        if (*it == s) {
+                            clients.erase(it);
+                            break;
+                        }
+                    }
+                    continue;
+                }
+                std::string &b = rx[s];
+                b.append((const char *) buf, (size_t) r);
+                if (hold)
+                    continue;
+                while (true) {
+                    size_t sz = batchMessageSize((const unsigned char *) b.c_str(), b.size());
+                    if (!sz)
+                        break;
+                    unsigned char reply[4096];
+                    size_t rs = queryBatch(&serialization, nullptr, reply, sizeof(reply), (const unsigned char *) b.c_str(), sz);
+                    b.erase(0, sz);
+                    if (rs)
+                        send(s, reply, rs, MSG_NOSIGNAL);
+                }
+            }
+        }
+        for (auto s : clients) {
+            close(s);
+        }
+    }
+public:
+    uint16_t port;
+    std::atomic<bool> stopped;
+    std::atomic<bool> hold;     ///< read requests, do not reply
+    std::atomic<bool> dropAll;  ///< close accepted connections
+    std::atomic<int> accepted;
+
+    LoopbackServer()
+        : serialization(&svc, CODE, ACCESS_CODE), listenSock(-1), port(0),
+        stopped(false), hold(false), dropAll(false), accepted(0)
+    {
+        for (int i = 1; i <= DEVICES; i++) {
+            DEVEUI eui;
+            eui.u = 0x1000 + i;
+            svc.put(DEVADDR(i), DEVICEID(eui));
+        }
+        listenSock = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in a {};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = 0;
+        bind(listenSock, (const struct sockaddr *) &a, sizeof(a));
+        listen(listenSock, 16);
+        socklen_t len = sizeof(a);
+        getsockname(listenSock, (struct sockaddr *) &a, &len);
+        port = ntohs(a.sin_port);
+        thread = std::thread(&LoopbackServer::run, this);
+    }
+
+    ~LoopbackServer() {
+        stopped = true;
+        thread.join();
+        close(listenSock);
+    }
+
+    std::string address() const {
+        return "127.0.0.1:" + std::to_string(port);
+    }
+};
+
+/**
+ * Collect replies and errors by the request identifier
+ */
+class Replies : public ResponseClient {
+public:
+    std::map<uint32_t, uint64_t> euis;
+    std::map<uint32_t, int32_t> errors;
+    int disconnects;
+
+    Replies()
+        : disconnects(0)
+    {
+    }
+
+    void onIdentityGet(QueryClient *, const IdentityGetResponse *response) override {
+        euis[response->requestId] = response->response.value.devid.id.devEUI.u;
+    }
+    void onIdentityOperation(QueryClient *, const IdentityOperationResponse *) override {}
+    void onIdentityList(QueryClient *, const IdentityListResponse *) override {}
+    void onGatewayGet(QueryClient *, const GatewayGetResponse *) override {}
+    void onGatewayOperation(QueryClient *, const GatewayOperationResponse *) override {}
+    void onGatewayList(QueryClient *, const GatewayListResponse *) override {}
+    void onError(QueryClient *, int32_t code, int requestId) override {
+        errors[(uint32_t) requestId] = code;
+    }
+    void onDisconnected(QueryClient *) override {
+        disconnects++;
+    }
+};
+
+/**
+ * Get identity by address, QUERY_IDENTITY_EUI is the request by address
+ */
+static void requestAll(
+    TCPPoolClient &pool,
+    uint32_t firstId
+)
+{
+    for (uint32_t i = 0; i < REQUESTS; i++) {
+        IdentityAddrRequest req(QUERY_IDENTITY_EUI, DEVADDR(i % DEVICES + 1), CODE, ACCESS_CODE);
+        req.requestId = firstId + i;
+        pool.request(&req);
+    }
+}
+
+static void processUntil(
+    TCPPoolClient &pool,
+    int timeoutMillis
+)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while (pool.pending() && std::chrono::steady_clock::now() < end) {
+        pool.process(50);
+    }
+}
+
+static void checkReplies(
+    const Replies &replies,
+    uint32_t firstId
+)
+{
+    for (uint32_t i = 0; i < REQUESTS; i++) {
+        auto it = replies.euis.find(firstId + i);
+        assert(it != replies.euis.end());
+        assert(it->second == 0x1000 + i % DEVICES + 1);
+    }
+}
+
+/**
+ * Requests are spread over the pool connections, connections are reused by the next requests
+ */
+static void testCheckoutReturn()
+{
+    LoopbackServer server;
+    Replies replies;
+    TCPPoolClient pool({ server.address() }, 2, &replies);
+    requestAll(pool, 1);
+    // all requests are queued or in flight, not answered yet
+    assert(pool.pending() == REQUESTS);
+    processUntil(pool, 5000);
+    assert(pool.pending() == 0);
+    assert(replies.errors.empty());
+    checkReplies(replies, 1);
+    assert(pool.connected() == 2);
+    assert(server.accepted == 2);
+
+    // connections are back to the pool, no new connection is made
+    requestAll(pool, 1001);
+    processUntil(pool, 5000);
+    checkReplies(replies, 1001);
+    assert(replies.errors.empty());
+    assert(server.accepted == 2);
+    assert(pool.reconnects == 0);
+    std::cout << "Checkout/return OK" << std::endl;
+}
+
+/**
+ * Connections closed by the service are reconnected, requests sent after that are answered
+ */
+static void testReconnect()
+{
+    LoopbackServer server;
+    Replies replies;
+    TCPPoolClient pool({ server.address() }, 2, &replies);
+    requestAll(pool, 1);
+    processUntil(pool, 5000);
+    checkReplies(replies, 1);
+
+    server.dropAll = true;
+    // wait until the client notices both connections are closed
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (replies.disconnects < 2 && std::chrono::steady_clock::now() < end) {
+        pool.process(50);
+    }
+    assert(replies.disconnects == 2);
+    assert(pool.connected() < 2);
+
+    // requests wait for the reconnect, then they are answered
+    requestAll(pool, 2001);
+    processUntil(pool, 5000);
+    assert(pool.pending() == 0);
+    checkReplies(replies, 2001);
+    assert(replies.errors.empty());
+    assert(pool.reconnects >= 2);
+    assert(server.accepted == 4);
+    std::cout << "Reconnect OK" << std::endl;
+}
+
+/**
+ * Every connection has a frame in flight and the service does not answer:
+ * queued requests wait, then each one fails with ERR_CODE_TIMEOUT exactly once
+ */
+static void testExhausted()
+{
+    LoopbackServer server;
+    server.hold = true;
+    Replies replies;
+    TCPPoolClient pool({ server.address() }, 2, &replies);
+    pool.requestTimeoutMillis = 300;
+    pool.maxRetries = 0;
+    requestAll(pool, 1);
+    pool.process(50);
+    // frames in flight, the rest is queued
+    assert(pool.pending() == REQUESTS);
+    processUntil(pool, 5000);
+    assert(pool.pending() == 0);
+    assert(replies.euis.empty());
+    assert(replies.errors.size() == REQUESTS);
+    for (auto &e : replies.errors) {
+        assert(e.second == ERR_CODE_TIMEOUT);
+    }
+
+    // no service at all: requests wait in the backlog and time out
+    uint16_t port;
+    {
+        // closed port, connections are refused
+        LoopbackServer closed;
+        port = closed.port;
+    }
+    Replies nobody;
+    TCPPoolClient down({ "127.0.0.1:" + std::to_string(port) }, 2, &nobody);
+    down.requestTimeoutMillis = 300;
+    requestAll(down, 1);
+    assert(down.pending() == REQUESTS);
+    processUntil(down, 5000);
+    assert(down.pending() == 0);
+    assert(down.connected() == 0);
+    assert(nobody.euis.empty());
+    assert(nobody.errors.size() == REQUESTS);
+    for (auto &e : nobody.errors) {
+        assert(e.second == ERR_CODE_TIMEOUT);
+    }
+    std::cout << "Exhausted OK" << std::endl;
+}
+
+int main() {
+    testCheckoutReturn();
+    testReconnect();
+    testExhausted();
+    return 0;
+}